@@ -5,10 +5,127 @@
 #define WIFI_SSID     "Grove Island"
 #define WIFI_PASSWORD "island1234"
 
+// WiFi fast connect: reuse the BSSID + channel of the last connection
+// (NVS) instead of a full scan. Set WIFI_STATIC_IP to skip DHCP as well.
+#define WIFI_FAST_CONNECT 1
+#define WIFI_STATIC_IP    ""
+#define WIFI_GATEWAY      "192.168.1.1"
+#define WIFI_NETMASK      "255.255.255.0"
+
+// WiFi reconnect: one immediate retry on the cached channel, then jittered
+// exponential backoff; the driver is restarted after the watchdog time offline
+#define WIFI_RECONNECT_MIN_MS       500
+#define WIFI_RECONNECT_MAX_MS       60000
+#define WIFI_RECONNECT_WATCHDOG_MS  120000
+
+// WiFi power save: modem kept awake (WIFI_PS_NONE) for WIFI_PS_COMMAND_HOLD_MS
+// after a command and during an e-stop, at most min modem sleep for
+// WIFI_PS_ACTIVITY_HOLD_MS after elevator activity, WIFI_PS_IDLE_MODE
+// otherwise (see comm/wifi_power.h). A timestamp probe on MQTT_TOPIC_PROBE
+// measures command arrival latency per mode. Set WIFI_PS_POLICY to 0 for
+// the driver default (min modem sleep).
+#define WIFI_PS_POLICY              1
+#define WIFI_PS_COMMAND_HOLD_MS     30000
+#define WIFI_PS_ACTIVITY_HOLD_MS    300000
+#define WIFI_PS_IDLE_MODE           WIFI_POWER_MAX_MODEM
+#define WIFI_PS_PROBE_INTERVAL_MS   30000
+
+// Deferred trace log for UART / MQTT hot paths (comm/trace.h): records are
+// formatted later by a low-priority task. Sites above TRACE_LEVEL
+// (TRACE_LEVEL_NONE .. TRACE_LEVEL_DEBUG) are compiled out.
+#define TRACE_LEVEL         TRACE_LEVEL_INFO
+#define TRACE_RING_RECORDS  64      // per core, power of two
+
+// UART capture: the raw byte stream to and from the MAX32655 is recorded in
+// a RAM ring (comm/uart/capture_format.h). Publish "start", "stop" or
+// "dump" to MQTT_TOPIC_CAPTURE; a dump freezes the ring and sends it to
+// MQTT_TOPIC_CAPTURE_DUMP in chunks (app/capture_dump.h). Replay it on
+// Linux with tools/uart_replay. 0 = no capture.
+#define UART_CAPTURE_BYTES      8192
+#define UART_CAPTURE_CHUNK      400     // trace bytes per dump message
+
+// Task report (CPU share, stack high-water marks, scheduling latency per
+// core, see comm/task_stats.h) published to MQTT_TOPIC_TASKS; 0 = off.
+// Core affinity and priorities are in comm/task_table.h.
+#define TASK_STATS_INTERVAL_MS  30000
+
+// Static memory: app task stacks live in .bss (comm/task_table.h), and the
+// esp-mqtt client keeps unacknowledged messages in a fixed pool
+// (comm/mqtt_pool, needs CONFIG_MQTT_CUSTOM_OUTBOX). Once the boot is done,
+// heap allocations by app tasks are counted and reported with the task
+// stats (comm/heap_watch.h, needs CONFIG_HEAP_USE_HOOKS). Every build
+// (PlatformIO or idf.py) prints the static RAM per subsystem
+// (tools/mem_budget.py).
+#define STATIC_MEMORY_MODE      1
+#define MQTT_POOL_SLOTS         16
+#define MQTT_POOL_SLOT_SIZE     512     // fixed header + topic + payload
+
 // MQTT Broker settings
 #define MQTT_HOST "alderaan.software-engineering.ie"
 #define MQTT_PORT 1883
 
+// MQTT session: persistent session under a stable client id, fast
+// keepalive, and jittered exponential reconnect backoff
+#define MQTT_PERSISTENT_SESSION   1
+#define MQTT_CLIENT_ID_PREFIX     "upanddown"
+#define MQTT_KEEPALIVE_S          15
+#define MQTT_RECONNECT_MIN_MS     250
+#define MQTT_RECONNECT_MAX_MS     30000
+#define MQTT_SKIP_RESUBSCRIBE     1
+
+// MQTT 5 (sdkconfig needs CONFIG_MQTT_PROTOCOL_5): topic aliases on
+// outgoing publishes, and command results sent to the request's Response
+// Topic with its Correlation Data
+#define MQTT_USE_V5               0
+#define MQTT5_TOPIC_ALIAS_MAX     8
+#define MQTT5_SESSION_EXPIRY_S    3600
+
 // MQTT Topics
 #define MQTT_TOPIC_EVENTS "computor/esp32/events"
 #define MQTT_TOPIC_CMD    "computor/esp32/cmd"
+#define MQTT_CMD_QOS      2
+// Binary commands: payload is 1-3 encoded cmd_request_t (see protocol.h)
+#define MQTT_TOPIC_CMD_BINARY "computor/esp32/cmd_bin"
+#define MQTT_TOPIC_BOOT       MQTT_TOPIC_EVENTS "/boot"
+#define MQTT_TOPIC_PROBE      "computor/esp32/probe"
+#define MQTT_TOPIC_TASKS      MQTT_TOPIC_EVENTS "/tasks"
+#define MQTT_TOPIC_CAPTURE    "computor/esp32/capture"
+#define MQTT_TOPIC_CAPTURE_DUMP MQTT_TOPIC_EVENTS "/capture"
+
+// Events are routed by class under the events topic (see max_comm.c):
+//   <events>             stopped_at_floor    QoS 1, batched (except text)
+//   <events>/buttons     cabin/call buttons  QoS 0, batched
+//   <events>/estop       e-stop              QoS 2
+//   <events>/cmd_result  command results     QoS 1
+//   <events>/cmd_result/replay/<id>  duplicate command id answered from cache
+//                        (MQTT 5 requesters get it on their response topic)
+//   <events>/link        MAX32655 link       QoS 1, retained
+//   <events>/state       current state       QoS 1, retained
+//   <events>/boot        start-up timeline   QoS 1, retained (once per boot)
+//   <events>/tasks       task report         QoS 0, every TASK_STATS_INTERVAL_MS
+//   <events>/capture     UART capture dump   QoS 1, on request
+
+// Event payload formats per topic (EVENT_FMT_TEXT / _JSON / _CBOR / _MSGPACK /
+// _BINARY, see app/event_codec.h). MQTT_TOPIC_EVENTS keeps the plain event
+// strings ("stopped_at_floor_2", one per message) existing subscribers parse.
+// Timestamped, batched JSON (v2) and CBOR sinks are opt-in: every enabled
+// sink publishes its own copy of each event, so each one adds to the
+// broker message rate. Once subscribers have moved to v2, switch
+// MQTT_EVENTS_FORMAT to EVENT_FMT_JSON instead to get batching on one topic.
+#define MQTT_EVENTS_FORMAT          EVENT_FMT_TEXT
+// #define MQTT_TOPIC_EVENTS_V2        "computor/esp32/v2/events"
+#define MQTT_EVENTS_V2_FORMAT       EVENT_FMT_JSON
+// #define MQTT_TOPIC_EVENTS_BINARY    "computor/esp32/events_cbor"
+#define MQTT_EVENTS_BINARY_FORMAT   EVENT_FMT_CBOR
+
+// Outbound event batching (window 0 = publish every event on its own)
+#define MQTT_BATCH_WINDOW_MS  50
+#define MQTT_BATCH_MAX_EVENTS 8
+
+// Store-and-forward outbox for publishes while the broker is unreachable
+// (OUTBOX_DROP_OLDEST / _DROP_BY_CLASS / _COMPACT_STATE, see comm/mqtt_outbox.h).
+// Overflow spills to NVS; set MQTT_OUTBOX_NVS_RECORDS to 0 for RAM only.
+#define MQTT_OUTBOX_POLICY              OUTBOX_COMPACT_STATE
+#define MQTT_OUTBOX_NVS_RECORDS         32
+#define MQTT_OUTBOX_REPLAY_INTERVAL_MS  20
+#define MQTT_OUTBOX_REPLAY_BURST        4
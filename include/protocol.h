@@ -3,7 +3,8 @@
  * @brief Shared communication protocol between ESP32 and MAX32655
  *
  * This header defines the message structures and enums used for
- * UART communication over TinyFrame between the two MCUs.
+ * UART communication over TinyFrame between the two MCUs. Messages,
+ * commands and events are declared in protocol_schema.h and expanded here.
  *
  * Include this file in both projects to ensure consistent message formats.
  */
@@ -12,81 +13,311 @@
 #define PROTOCOL_H
 
 #include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stddef.h>
+#include "protocol_schema.h"
 
 // ============================================
-// Command IDs (ESP -> Maxim)
+// Protocol Version / Capabilities
+// ============================================
+#define PROTO_VERSION           1
+
+// Capability bits (exchanged in caps_msg_t, peers use the intersection)
+#define PROTO_CAP_COMPACT_CMD   0x01  // variable-length cmd request/response
+#define PROTO_CAP_TIMESTAMPS    0x02  // time sync + MAX timestamp on events/responses
+#define PROTO_CAP_CMD_SEQ       0x04  // sequence number on compact cmd request/response
+
+// ============================================
+// Enums (generated from protocol_schema.h)
 // ============================================
+
+#define PROTO_GEN_MSG_TYPE(name, id)        MSG_TYPE_##name = id,
+#define PROTO_GEN_CMD(name, id)             CMD_##name = id,
+#define PROTO_GEN_EVENT(name, id, str, d)   PROTO_EVT_##name = id,
+#define PROTO_GEN_CALL_BTN(name, id)        CALL_BTN_##name = id,
+
+// TinyFrame message types
 typedef enum {
-    CMD_NOP             = 0x00,
-    CMD_GET_STATUS      = 0x01,
-    CMD_MOVE_TO_FLOOR   = 0x02,
-    CMD_RESET           = 0x03,
+    PROTO_MSG_TYPES(PROTO_GEN_MSG_TYPE)
+} proto_msg_type_t;
+
+// Command IDs (ESP -> Maxim)
+typedef enum {
+    PROTO_COMMANDS(PROTO_GEN_CMD)
 } cmd_id_t;
 
-// ============================================
 // Command Response Status (Maxim -> ESP)
-// ============================================
 typedef enum {
-    CMD_OK              = 0x00,
-    CMD_ERR_UNKNOWN     = 0x01,
-    CMD_ERR_INVALID     = 0x02,
-    CMD_ERR_BUSY        = 0x03,
+    PROTO_CMD_STATUSES(PROTO_GEN_CMD)
 } cmd_status_t;
 
-// ============================================
 // Protocol Event Types (Maxim -> ESP, unsolicited)
 // Prefixed with PROTO_ to avoid collision with internal state machine events
-// ============================================
 typedef enum {
-    PROTO_EVT_STOPPED_AT_FLOOR  = 0x01,  // data = floor number
-    PROTO_EVT_CABIN_BUTTON      = 0x02,  // data = destination floor
-    PROTO_EVT_CALL_BUTTON       = 0x03,  // data = call_button_t
-    PROTO_EVT_ESTOP_ACTIVATED   = 0x04,  // data = unused
-    PROTO_EVT_ESTOP_RELEASED    = 0x05,  // data = unused
+    PROTO_EVENTS(PROTO_GEN_EVENT)
 } proto_event_type_t;
 
-// ============================================
 // Call Button IDs
-// ============================================
 typedef enum {
-    CALL_BTN_0      = 0x00,  // ground floor
-    CALL_BTN_1_DOWN = 0x01,
-    CALL_BTN_1_UP   = 0x02,
-    CALL_BTN_2      = 0x03,  // top floor
+    PROTO_CALL_BUTTONS(PROTO_GEN_CALL_BTN)
 } call_button_t;
 
 // ============================================
-// Message Structs
+// Message Structs (generated from protocol_schema.h)
 // ============================================
+// Packed so the in-memory layout equals the wire layout on both
+// (little-endian) MCUs; new code should still go through the codecs below.
 
-/**
- * Command request (ESP -> Maxim)
- * Sent via TF_QuerySimple, expects cmd_response_t back
- */
-typedef struct __attribute__((packed)) {
-    uint8_t cmd_id;       // cmd_id_t
-    uint8_t params[16];   // command-specific parameters
-    uint8_t params_len;   // number of valid bytes in params
-} cmd_request_t;
+#define PROTO_CTYPE_u8                      uint8_t
+#define PROTO_CTYPE_u16                     uint16_t
+#define PROTO_CTYPE_u32                     uint32_t
+#define PROTO_GEN_STRUCT_S(kind, field)     PROTO_CTYPE_##kind field;
+#define PROTO_GEN_STRUCT_A(field, count)    uint8_t field[count];
+#define PROTO_GEN_STRUCT(name, type) \
+    typedef struct __attribute__((packed)) { \
+        PROTO_FIELDS_##name(PROTO_GEN_STRUCT_S, PROTO_GEN_STRUCT_A) \
+    } type;
 
-/**
- * Command response (Maxim -> ESP)
- * Sent via TF_Respond in reply to cmd_request_t
- */
-typedef struct __attribute__((packed)) {
-    uint8_t cmd_id;       // echo of cmd_id_t from request
-    uint8_t status;       // cmd_status_t
-    uint8_t data[16];     // response data (command-specific)
-    uint8_t data_len;     // number of valid bytes in data
-} cmd_response_t;
+PROTO_MESSAGES(PROTO_GEN_STRUCT)
 
-/**
- * State event (Maxim -> ESP, unsolicited)
- * Sent via TF_SendSimple when state changes occur
- */
-typedef struct __attribute__((packed)) {
-    uint8_t event_type;   // event_type_t
-    uint8_t data;         // interpretation depends on event_type
-} state_event_t;
+// ============================================
+// Wire sizes (compile time)
+// ============================================
+
+#define PROTO_SIZE_u8                       1
+#define PROTO_SIZE_u16                      2
+#define PROTO_SIZE_u32                      4
+#define PROTO_GEN_SIZE_S(kind, field)       + PROTO_SIZE_##kind
+#define PROTO_GEN_SIZE_A(field, count)      + (count)
+#define PROTO_GEN_WIRE_SIZE(name, type) \
+    PROTO_WIRE_SIZE_##name = 0 PROTO_FIELDS_##name(PROTO_GEN_SIZE_S, PROTO_GEN_SIZE_A),
+
+enum {
+    PROTO_MESSAGES(PROTO_GEN_WIRE_SIZE)
+};
+
+#define PROTO_GEN_SIZE_CHECK(name, type) \
+    _Static_assert(sizeof(type) == PROTO_WIRE_SIZE_##name, #type " does not match its wire size");
+
+PROTO_MESSAGES(PROTO_GEN_SIZE_CHECK)
+
+// ============================================
+// Encoders / Decoders (generated from protocol_schema.h)
+// ============================================
+// proto_encode_<name>(msg, buf) writes PROTO_WIRE_SIZE_<name> bytes.
+// proto_decode_<name>(buf, len, msg) fails only if len is too short;
+// trailing bytes (e.g. timestamps) are ignored.
+// Both are straight-line field copies with explicit little-endian order.
+
+static inline void proto_put_u8(uint8_t **p, uint8_t v)   { *(*p)++ = v; }
+static inline void proto_put_u16(uint8_t **p, uint16_t v) { proto_put_u8(p, (uint8_t)v); proto_put_u8(p, (uint8_t)(v >> 8)); }
+static inline void proto_put_u32(uint8_t **p, uint32_t v) { proto_put_u16(p, (uint16_t)v); proto_put_u16(p, (uint16_t)(v >> 16)); }
+
+static inline uint8_t proto_get_u8(const uint8_t **p)     { return *(*p)++; }
+static inline uint16_t proto_get_u16(const uint8_t **p)   { uint16_t lo = proto_get_u8(p); return (uint16_t)(lo | (proto_get_u8(p) << 8)); }
+static inline uint32_t proto_get_u32(const uint8_t **p)   { uint32_t lo = proto_get_u16(p); return lo | ((uint32_t)proto_get_u16(p) << 16); }
+
+#define PROTO_GEN_ENC_S(kind, field)        proto_put_##kind(&p, msg->field);
+#define PROTO_GEN_ENC_A(field, count)       memcpy(p, msg->field, (count)); p += (count);
+#define PROTO_GEN_DEC_S(kind, field)        msg->field = proto_get_##kind(&p);
+#define PROTO_GEN_DEC_A(field, count)       memcpy(msg->field, p, (count)); p += (count);
+#define PROTO_GEN_CODEC(name, type) \
+    static inline uint16_t proto_encode_##name(const type *msg, uint8_t *buf) \
+    { \
+        uint8_t *p = buf; \
+        PROTO_FIELDS_##name(PROTO_GEN_ENC_S, PROTO_GEN_ENC_A) \
+        return PROTO_WIRE_SIZE_##name; \
+    } \
+    static inline bool proto_decode_##name(const uint8_t *buf, uint16_t len, type *msg) \
+    { \
+        if (buf == NULL || len < PROTO_WIRE_SIZE_##name) { \
+            return false; \
+        } \
+        const uint8_t *p = buf; \
+        PROTO_FIELDS_##name(PROTO_GEN_DEC_S, PROTO_GEN_DEC_A) \
+        return true; \
+    }
+
+PROTO_MESSAGES(PROTO_GEN_CODEC)
+
+// ============================================
+// Command validation (generated from protocol_schema.h)
+// ============================================
+
+#define PROTO_GEN_CMD_CASE(name, id)        case id:
+
+static inline bool proto_cmd_known(uint8_t cmd_id)
+{
+    switch (cmd_id) {
+        PROTO_COMMANDS(PROTO_GEN_CMD_CASE)
+            return true;
+        default:
+            return false;
+    }
+}
+
+// Check an encoded cmd_request_t in place (no decode): known command and
+// params_len within params
+static inline bool proto_check_cmd_request(const uint8_t *buf, uint16_t len)
+{
+    return buf != NULL && len >= PROTO_WIRE_SIZE_cmd_request &&
+           proto_cmd_known(buf[offsetof(cmd_request_t, cmd_id)]) &&
+           buf[offsetof(cmd_request_t, params_len)] <= sizeof(((cmd_request_t *)0)->params);
+}
+
+// ============================================
+// Event descriptors (generated from protocol_schema.h)
+// ============================================
+
+typedef struct {
+    const char *name;     // published event name, NULL if type is unknown
+    bool has_data;        // append "_<data>" to the name
+} proto_event_desc_t;
+
+#define PROTO_GEN_EVENT_DESC(name, id, str, d)  [id] = { str, d },
+
+// Descriptor for an event type (O(1) table lookup), NULL if unknown
+static inline const proto_event_desc_t *proto_event_desc(uint8_t event_type)
+{
+    static const proto_event_desc_t descs[] = {
+        PROTO_EVENTS(PROTO_GEN_EVENT_DESC)
+    };
+
+    if (event_type >= sizeof(descs) / sizeof(descs[0]) || descs[event_type].name == NULL) {
+        return NULL;
+    }
+    return &descs[event_type];
+}
+
+// ============================================
+// Timestamps (PROTO_CAP_TIMESTAMPS)
+// ============================================
+// When negotiated, Maxim appends a 4-byte little-endian timestamp (same
+// clock as time_sync_msg_t) after the payload of every state event and
+// command response. Receivers that only check the minimum length ignore it.
+
+#define PROTO_TIMESTAMP_LEN     4
+
+// Read trailing timestamp located at payload_len, returns false if absent
+static inline bool proto_read_timestamp(const uint8_t *buf, uint16_t len,
+                                        uint16_t payload_len, uint32_t *ts)
+{
+    if (len < payload_len + PROTO_TIMESTAMP_LEN) {
+        return false;
+    }
+    const uint8_t *p = &buf[payload_len];
+    *ts = proto_get_u32(&p);
+    return true;
+}
+
+// ============================================
+// Compact Wire Format (PROTO_CAP_COMPACT_CMD)
+// ============================================
+// cmd_request_t / cmd_response_t stay the in-memory API. On the wire the
+// compact form only carries the valid bytes:
+//
+//   request:  | cmd_id | params_len | params[params_len] |
+//   response: | cmd_id | status | data_len | data[data_len] |
+
+#define CMD_REQUEST_COMPACT_HDR_LEN   2
+#define CMD_RESPONSE_COMPACT_HDR_LEN  3
+#define CMD_REQUEST_COMPACT_MAX_LEN   (CMD_REQUEST_COMPACT_HDR_LEN + sizeof(((cmd_request_t *)0)->params))
+#define CMD_RESPONSE_COMPACT_MAX_LEN  (CMD_RESPONSE_COMPACT_HDR_LEN + sizeof(((cmd_response_t *)0)->data))
+
+// Encode request into buf, returns number of bytes written (0 if invalid)
+static inline uint16_t proto_encode_cmd_compact(const cmd_request_t *cmd, uint8_t *buf)
+{
+    if (cmd->params_len > sizeof(cmd->params)) {
+        return 0;
+    }
+    buf[0] = cmd->cmd_id;
+    buf[1] = cmd->params_len;
+    memcpy(&buf[CMD_REQUEST_COMPACT_HDR_LEN], cmd->params, cmd->params_len);
+    return (uint16_t)(CMD_REQUEST_COMPACT_HDR_LEN + cmd->params_len);
+}
+
+// Decode request from buf into a zero-filled cmd_request_t
+static inline bool proto_decode_cmd_compact(const uint8_t *buf, uint16_t len, cmd_request_t *cmd)
+{
+    if (len < CMD_REQUEST_COMPACT_HDR_LEN) {
+        return false;
+    }
+    uint8_t params_len = buf[1];
+    if (params_len > sizeof(cmd->params) || len < CMD_REQUEST_COMPACT_HDR_LEN + params_len) {
+        return false;
+    }
+    memset(cmd, 0, sizeof(*cmd));
+    cmd->cmd_id = buf[0];
+    cmd->params_len = params_len;
+    memcpy(cmd->params, &buf[CMD_REQUEST_COMPACT_HDR_LEN], params_len);
+    return true;
+}
+
+// Encode response into buf, returns number of bytes written (0 if invalid)
+static inline uint16_t proto_encode_resp_compact(const cmd_response_t *resp, uint8_t *buf)
+{
+    if (resp->data_len > sizeof(resp->data)) {
+        return 0;
+    }
+    buf[0] = resp->cmd_id;
+    buf[1] = resp->status;
+    buf[2] = resp->data_len;
+    memcpy(&buf[CMD_RESPONSE_COMPACT_HDR_LEN], resp->data, resp->data_len);
+    return (uint16_t)(CMD_RESPONSE_COMPACT_HDR_LEN + resp->data_len);
+}
+
+// Decode response from buf into a zero-filled cmd_response_t
+static inline bool proto_decode_resp_compact(const uint8_t *buf, uint16_t len, cmd_response_t *resp)
+{
+    if (len < CMD_RESPONSE_COMPACT_HDR_LEN) {
+        return false;
+    }
+    uint8_t data_len = buf[2];
+    if (data_len > sizeof(resp->data) || len < CMD_RESPONSE_COMPACT_HDR_LEN + data_len) {
+        return false;
+    }
+    memset(resp, 0, sizeof(*resp));
+    resp->cmd_id = buf[0];
+    resp->status = buf[1];
+    resp->data_len = data_len;
+    memcpy(resp->data, &buf[CMD_RESPONSE_COMPACT_HDR_LEN], data_len);
+    return true;
+}
+
+// ============================================
+// Command Sequence Numbers (PROTO_CAP_CMD_SEQ)
+// ============================================
+// Negotiated on top of PROTO_CAP_COMPACT_CMD. The ESP appends one byte to
+// every compact request: a sequence number that changes for each new
+// command and is reused when the same command is retransmitted. Maxim
+// keeps the responses of the last PROTO_CMD_SEQ_WINDOW commands it
+// executed, by seq, and answers a request whose seq is among them with the
+// cached response instead of executing it again. It echoes the seq after
+// the response data (before the timestamp, if any):
+//
+//   request:  | cmd_id | params_len | params[params_len] | seq |
+//   response: | cmd_id | status | data_len | data[data_len] | seq |
+//
+// The ESP never has more than PROTO_CMD_SEQ_WINDOW commands outstanding,
+// so the retransmit of any of them still finds its cached response while
+// newer commands are pipelined behind it.
+
+#define PROTO_CMD_SEQ_LEN       1
+#define PROTO_CMD_SEQ_WINDOW    8
+
+// Read the seq echoed after a compact response, returns false if absent
+static inline bool proto_read_resp_seq(const uint8_t *buf, uint16_t len, uint8_t *seq)
+{
+    if (len < CMD_RESPONSE_COMPACT_HDR_LEN) {
+        return false;
+    }
+    uint16_t at = (uint16_t)(CMD_RESPONSE_COMPACT_HDR_LEN + buf[2]);
+    if (len < at + PROTO_CMD_SEQ_LEN) {
+        return false;
+    }
+    *seq = buf[at];
+    return true;
+}
 
 #endif // PROTOCOL_H
@@ -0,0 +1,108 @@
+/**
+ * @file protocol_schema.h
+ * @brief Message schema shared between ESP32 and MAX32655
+ *
+ * Single source of truth for the UART protocol, written as X-macros.
+ * protocol.h expands it into the enums, packed structs, wire sizes,
+ * encoders/decoders and lookup tables used by both firmwares, so adding
+ * a command, event or message only means adding a line here.
+ *
+ * Do not include directly - include protocol.h.
+ */
+
+#ifndef PROTOCOL_SCHEMA_H
+#define PROTOCOL_SCHEMA_H
+
+// ============================================
+// TinyFrame message types: X(NAME, type)
+// ============================================
+#define PROTO_MSG_TYPES(X) \
+    X(HEARTBEAT,    0x01) \
+    X(ESTOP,        0x02) \
+    X(CMD,          0x03)  /* cmd_request_t / cmd_response_t */ \
+    X(EVENT,        0x04)  /* state_event_t */ \
+    X(CAPS,         0x05)  /* caps_msg_t */ \
+    X(CMD_COMPACT,  0x06)  /* compact cmd request/response */ \
+    X(TIME_SYNC,    0x07)  /* time_sync_msg_t */
+
+// ============================================
+// Command IDs (ESP -> Maxim): X(NAME, id)
+// ============================================
+#define PROTO_COMMANDS(X) \
+    X(NOP,              0x00) \
+    X(GET_STATUS,       0x01) \
+    X(MOVE_TO_FLOOR,    0x02) \
+    X(RESET,            0x03)
+
+// ============================================
+// Command response status (Maxim -> ESP): X(NAME, id)
+// ============================================
+#define PROTO_CMD_STATUSES(X) \
+    X(OK,               0x00) \
+    X(ERR_UNKNOWN,      0x01) \
+    X(ERR_INVALID,      0x02) \
+    X(ERR_BUSY,         0x03)
+
+// ============================================
+// State events (Maxim -> ESP): X(NAME, id, mqtt_name, has_data)
+// mqtt_name is the published event name; has_data appends "_<data>"
+// ============================================
+#define PROTO_EVENTS(X) \
+    X(STOPPED_AT_FLOOR, 0x01, "stopped_at_floor", 1)  /* data = floor number */ \
+    X(CABIN_BUTTON,     0x02, "cabin_button",     1)  /* data = destination floor */ \
+    X(CALL_BUTTON,      0x03, "call_button",      1)  /* data = call_button_t */ \
+    X(ESTOP_ACTIVATED,  0x04, "estop_activated",  0) \
+    X(ESTOP_RELEASED,   0x05, "estop_released",   0)
+
+// ============================================
+// Call button IDs: X(NAME, id)
+// ============================================
+#define PROTO_CALL_BUTTONS(X) \
+    X(0,                0x00)  /* ground floor */ \
+    X(1_DOWN,           0x01) \
+    X(1_UP,             0x02) \
+    X(2,                0x03)  /* top floor */
+
+// ============================================
+// Fixed-layout messages: X(name, c_type)
+// Fields are listed in PROTO_FIELDS_<name>(S, A) in wire order:
+//   S(kind, field)   scalar, kind = u8 / u16 / u32 (little-endian)
+//   A(field, count)  byte array
+// ============================================
+#define PROTO_MESSAGES(X) \
+    X(cmd_request,      cmd_request_t) \
+    X(cmd_response,     cmd_response_t) \
+    X(state_event,      state_event_t) \
+    X(caps,             caps_msg_t) \
+    X(time_sync,        time_sync_msg_t)
+
+// Command request (ESP -> Maxim), answered with cmd_response
+#define PROTO_FIELDS_cmd_request(S, A) \
+    S(u8,  cmd_id)          /* cmd_id_t */ \
+    A(params, 16)           /* command-specific parameters */ \
+    S(u8,  params_len)      /* number of valid bytes in params */
+
+// Command response (Maxim -> ESP)
+#define PROTO_FIELDS_cmd_response(S, A) \
+    S(u8,  cmd_id)          /* echo of cmd_id_t from request */ \
+    S(u8,  status)          /* cmd_status_t */ \
+    A(data, 16)             /* response data (command-specific) */ \
+    S(u8,  data_len)        /* number of valid bytes in data */
+
+// State event (Maxim -> ESP, unsolicited)
+#define PROTO_FIELDS_state_event(S, A) \
+    S(u8,  event_type)      /* proto_event_type_t */ \
+    S(u8,  data)            /* interpretation depends on event_type */
+
+// Capability handshake (both directions)
+#define PROTO_FIELDS_caps(S, A) \
+    S(u8,  version)         /* PROTO_VERSION of sender */ \
+    S(u8,  caps)            /* PROTO_CAP_* bitmask */
+
+// Clock sync exchange (ESP query, Maxim response)
+#define PROTO_FIELDS_time_sync(S, A) \
+    S(u32, t1)              /* ESP send time (low 32 bits, echoed back) */ \
+    S(u32, t2)              /* Maxim receive time */ \
+    S(u32, t3)              /* Maxim transmit time */
+
+#endif // PROTOCOL_SCHEMA_H
@@ -42,8 +42,9 @@ typedef uint8_t TF_COUNT;
 // Size of the sending buffer
 #define TF_SENDBUF_LEN    64
 
-// Listener slot counts
-#define TF_MAX_ID_LST   4
+// Listener slot counts (ID listeners = queries in flight: heartbeat, caps,
+// time sync and up to a batch of pipelined commands)
+#define TF_MAX_ID_LST   8
 #define TF_MAX_TYPE_LST 4
 #define TF_MAX_GEN_LST  2
 
@@ -53,7 +54,9 @@ typedef uint8_t TF_COUNT;
 // Disable mutex (we handle thread safety ourselves)
 #define TF_USE_MUTEX  0
 
-// Error reporting via ESP-IDF logging
+// Error reporting via ESP-IDF logging (host tools may provide their own)
+#ifndef TF_Error
 #define TF_Error(format, ...) printf("[TF] " format "\n", ##__VA_ARGS__)
+#endif
 
 #endif // TF_CONFIG_H
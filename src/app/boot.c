@@ -0,0 +1,121 @@
+// Concurrent start-up graph runner
+
+#include "app/boot.h"
+#include "comm/task_table.h"
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/event_groups.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+
+static const char *TAG = "BOOT";
+
+// Stage completion bits. Created once and never deleted: a stage task can
+// still be inside xEventGroupSetBits (the SMP port reads the group after
+// waking the waiter) when boot_run returns and app_main's stack goes away.
+static StaticEventGroup_t done_buf;
+static EventGroupHandle_t done = NULL;
+
+typedef struct {
+    const boot_stage_t *stage;
+    boot_stage_result_t *result;
+    EventGroupHandle_t done;
+    int index;
+} stage_run_t;
+
+static void stage_task(void *arg)
+{
+    stage_run_t *run = arg;
+
+    run->result->start_us = esp_timer_get_time();
+    run->result->ok = run->stage->start(run->stage->ctx);
+    run->result->done_us = esp_timer_get_time();
+
+    // run lives on boot_run's stack: don't touch it after this
+    xEventGroupSetBits(run->done, BOOT_DEP(run->index));
+    vTaskDelete(NULL);
+}
+
+bool boot_run(const boot_stage_t *stages, int count, boot_stage_result_t *results)
+{
+    boot_stage_result_t local[BOOT_MAX_STAGES];
+    stage_run_t runs[BOOT_MAX_STAGES];
+
+    if (count <= 0 || count > BOOT_MAX_STAGES) {
+        return false;
+    }
+    if (results == NULL) {
+        results = local;
+    }
+    memset(results, 0, count * sizeof(results[0]));
+
+    if (done == NULL) {
+        done = xEventGroupCreateStatic(&done_buf);
+    }
+    xEventGroupClearBits(done, BOOT_DEP(BOOT_MAX_STAGES) - 1);
+
+    uint32_t all = BOOT_DEP(count) - 1;
+    uint32_t started = 0;
+    uint32_t finished = 0;
+    uint32_t failed = 0;
+    int64_t boot_us = esp_timer_get_time();
+
+    while (finished != all) {
+        // Start every stage whose dependencies are done, skip those with a
+        // failed one (repeat: a skip can unblock further skips)
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            for (int i = 0; i < count; i++) {
+                uint32_t bit = BOOT_DEP(i);
+                if (started & bit) {
+                    continue;
+                }
+                if (stages[i].deps & failed) {
+                    ESP_LOGW(TAG, "%s skipped (dependency failed)", stages[i].name);
+                    started |= bit;
+                    finished |= bit;
+                    failed |= bit;
+                    changed = true;
+                } else if ((stages[i].deps & ~finished) == 0) {
+                    runs[i] = (stage_run_t){ &stages[i], &results[i], done, i };
+                    started |= bit;
+                    if (!task_create(TASK_BOOT_STAGE, stages[i].name, stage_task, &runs[i], NULL)) {
+                        ESP_LOGE(TAG, "%s: no task", stages[i].name);
+                        finished |= bit;
+                        failed |= bit;
+                        changed = true;
+                    }
+                }
+            }
+        }
+
+        uint32_t running = started & ~finished;
+        if (running == 0) {
+            if (finished != all) {
+                ESP_LOGE(TAG, "Unresolvable dependencies (0x%lx left)", (unsigned long)(all & ~finished));
+                failed |= all & ~finished;
+            }
+            break;
+        }
+
+        EventBits_t bits = xEventGroupWaitBits(done, running, pdFALSE, pdFALSE, portMAX_DELAY);
+        uint32_t newly = (uint32_t)bits & running;
+        for (int i = 0; i < count; i++) {
+            if (!(newly & BOOT_DEP(i))) {
+                continue;
+            }
+            finished |= BOOT_DEP(i);
+            if (!results[i].ok) {
+                failed |= BOOT_DEP(i);
+            }
+            ESP_LOGI(TAG, "%s %s at %lld ms (took %lld ms)", stages[i].name,
+                     results[i].ok ? "done" : "FAILED",
+                     (long long)((results[i].done_us - boot_us) / 1000),
+                     (long long)((results[i].done_us - results[i].start_us) / 1000));
+        }
+    }
+
+    return failed == 0;
+}
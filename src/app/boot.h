@@ -0,0 +1,38 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Start-up graph: each stage starts as soon as the stages it depends on
+// have finished, and independent stages run concurrently (one short-lived
+// task per stage). Services are only reached through the start callbacks,
+// so a graph can be run against mocks.
+
+#define BOOT_MAX_STAGES     16
+#define BOOT_DEP(stage)     (1u << (stage))
+
+typedef struct {
+    const char *name;
+    bool (*start)(void *ctx);   // must not block on the network; false = failed
+    void *ctx;
+    uint32_t deps;              // BOOT_DEP() mask of stage indices
+} boot_stage_t;
+
+typedef struct {
+    int64_t start_us;           // esp_timer time, 0 = never started
+    int64_t done_us;
+    bool ok;                    // false if failed or skipped
+} boot_stage_result_t;
+
+// Run the graph; returns once every stage has finished or been skipped
+// because a dependency failed. True if all stages succeeded. results
+// (count entries) may be NULL. One graph at a time (not reentrant).
+bool boot_run(const boot_stage_t *stages, int count, boot_stage_result_t *results);
+
+#ifdef __cplusplus
+}
+#endif
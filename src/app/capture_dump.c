@@ -0,0 +1,86 @@
+// UART capture over MQTT: start/stop/dump commands and the paced dump
+
+#include "app/capture_dump.h"
+#include "comm/mqtt_util.h"
+#include "comm/uart/tf_transport.h"
+#include "comm/uart/capture_format.h"
+#include "config.h"
+#include <string.h>
+#include "esp_timer.h"
+#include "esp_log.h"
+
+static const char *TAG = "CAPTURE";
+
+static const char *s_dump_topic = NULL;
+static esp_timer_handle_t s_dump_timer = NULL;
+
+// Dump in progress: next offset and total length (esp_timer task only)
+static uint32_t s_dump_offset = 0;
+static uint32_t s_dump_total = 0;
+
+static void dump_timer_cb(void *arg)
+{
+    (void)arg;
+    uint8_t msg[CAPTURE_DUMP_HEADER_SIZE + UART_CAPTURE_CHUNK];
+
+    uint32_t len = tf_transport_capture_read(s_dump_offset, msg + CAPTURE_DUMP_HEADER_SIZE,
+                                             UART_CAPTURE_CHUNK);
+    capture_put_u32(msg, s_dump_offset);
+    capture_put_u32(msg + 4, s_dump_total);
+
+    // Queue full: same chunk on the next tick
+    if (!mqtt_publish(s_dump_topic, msg, (int)(CAPTURE_DUMP_HEADER_SIZE + len), 1, false)) {
+        return;
+    }
+    s_dump_offset += len;
+    if (len == 0 || s_dump_offset >= s_dump_total) {
+        esp_timer_stop(s_dump_timer);
+        ESP_LOGI(TAG, "Dump sent (%lu bytes)", (unsigned long)s_dump_total);
+    }
+}
+
+static void dump_start(void)
+{
+    // Restart a dump already in progress (the ring is frozen, same data)
+    esp_timer_stop(s_dump_timer);
+    tf_transport_capture_stop();
+    s_dump_offset = 0;
+    s_dump_total = tf_transport_capture_size();
+    ESP_LOGI(TAG, "Dumping %lu bytes to %s", (unsigned long)s_dump_total, s_dump_topic);
+    esp_timer_start_periodic(s_dump_timer, CAPTURE_DUMP_INTERVAL_MS * 1000);
+}
+
+static void on_capture_cmd(const char *topic, int topic_len, const char *payload, int len,
+                           const mqtt_reply_t *reply, void *ctx)
+{
+    (void)topic;
+    (void)topic_len;
+    (void)reply;
+    (void)ctx;
+
+    if (len == 5 && memcmp(payload, "start", 5) == 0) {
+        esp_timer_stop(s_dump_timer);
+        tf_transport_capture_start();
+        ESP_LOGI(TAG, "Recording");
+    } else if (len == 4 && memcmp(payload, "stop", 4) == 0) {
+        tf_transport_capture_stop();
+        ESP_LOGI(TAG, "Stopped (%lu bytes)", (unsigned long)tf_transport_capture_size());
+    } else if (len == 4 && memcmp(payload, "dump", 4) == 0) {
+        dump_start();
+    } else {
+        ESP_LOGW(TAG, "Unknown capture command: %.*s", len, payload);
+    }
+}
+
+bool capture_dump_init(const char *cmd_topic, const char *dump_topic)
+{
+    s_dump_topic = dump_topic;
+
+    const esp_timer_create_args_t timer_args = {
+        .callback = dump_timer_cb,
+        .name = "capture_dump",
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&timer_args, &s_dump_timer));
+
+    return mqtt_subscribe(cmd_topic, 1, on_capture_cmd, NULL);
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// MQTT control of the UART capture (comm/uart/tf_transport.h). Payloads on
+// the command topic:
+//   start   clear the ring and record
+//   stop    freeze the ring
+//   dump    freeze the ring and publish it to the dump topic (QoS 1)
+// A dump is a series of messages, each an 8-byte header (u32 offset, u32
+// total trace length, little-endian) followed by up to UART_CAPTURE_CHUNK
+// trace bytes. Chunks are paced through the publish queue. The ring stays
+// frozen after a dump (so it can be dumped again) until the next start.
+// tools/uart_capture_join.py rebuilds the trace file from
+// `mosquitto_sub -t <dump topic> -F %x`.
+
+#define CAPTURE_DUMP_HEADER_SIZE    8
+#define CAPTURE_DUMP_INTERVAL_MS    20
+
+// Subscribe to cmd_topic (call before mqtt_init)
+bool capture_dump_init(const char *cmd_topic, const char *dump_topic);
+
+#ifdef __cplusplus
+}
+#endif
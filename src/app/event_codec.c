@@ -0,0 +1,330 @@
+// Event payload encoders (text / JSON / CBOR / MessagePack / fixed binary)
+
+#include "app/event_codec.h"
+#include "protocol.h"
+#include <string.h>
+
+// Output cursor; stays valid (ok = false) once the buffer is exhausted
+typedef struct {
+    uint8_t *buf;
+    size_t cap;
+    size_t len;
+    bool ok;
+} writer_t;
+
+static void put_bytes(writer_t *w, const void *data, size_t len)
+{
+    if (!w->ok || w->len + len > w->cap) {
+        w->ok = false;
+        return;
+    }
+    memcpy(&w->buf[w->len], data, len);
+    w->len += len;
+}
+
+static void put_u8(writer_t *w, uint8_t v)
+{
+    put_bytes(w, &v, 1);
+}
+
+static void put_be(writer_t *w, uint64_t v, int bytes)
+{
+    for (int i = bytes - 1; i >= 0; i--) {
+        put_u8(w, (uint8_t)(v >> (8 * i)));
+    }
+}
+
+static void put_str(writer_t *w, const char *s)
+{
+    put_bytes(w, s, strlen(s));
+}
+
+static void put_dec(writer_t *w, int64_t v)
+{
+    char tmp[20];
+    int n = 0;
+    uint64_t u = (v < 0) ? (uint64_t)0 - (uint64_t)v : (uint64_t)v;
+    do {
+        tmp[n++] = (char)('0' + (u % 10));
+        u /= 10;
+    } while (u > 0);
+    if (v < 0) {
+        put_u8(w, '-');
+    }
+    while (n > 0) {
+        put_u8(w, (uint8_t)tmp[--n]);
+    }
+}
+
+static void put_hex2(writer_t *w, uint8_t v)
+{
+    static const char digits[] = "0123456789ABCDEF";
+    put_u8(w, (uint8_t)digits[v >> 4]);
+    put_u8(w, (uint8_t)digits[v & 0x0F]);
+}
+
+// === Event view (name + values, shared by all formats) ===
+
+static const char *direction_str(uint8_t dir)
+{
+    switch (dir) {
+        case 0: return "stopped";
+        case 1: return "up";
+        case 2: return "down";
+        default: return "unknown";
+    }
+}
+
+static const char *event_name(const app_event_t *evt, uint8_t *value_count)
+{
+    *value_count = evt->value_count;
+
+    switch (evt->kind) {
+        case APP_EVT_STATE: {
+            const proto_event_desc_t *desc = proto_event_desc(evt->code);
+            if (desc == NULL) {
+                *value_count = 0;
+                return "unknown_event";
+            }
+            if (!desc->has_data) {
+                *value_count = 0;
+            }
+            return desc->name;
+        }
+        case APP_EVT_STATUS:      return "status";
+        case APP_EVT_CMD_OK:      return "cmd_ok";
+        case APP_EVT_CMD_ERR:     return "cmd_err";
+        case APP_EVT_CMD_TIMEOUT: return "cmd_timeout";
+        case APP_EVT_LINK_UP:     return "max32655_connected";
+        case APP_EVT_LINK_DOWN:   return "max32655_disconnected";
+        case APP_EVT_SNAPSHOT:    return "state";
+        case APP_EVT_CMD_BUSY:    return "busy";
+        default:                  return "unknown";
+    }
+}
+
+// === Text: the legacy event string, also the "e" of JSON ===
+
+static void encode_text(writer_t *w, const app_event_t *evt)
+{
+    uint8_t count;
+    const char *name = event_name(evt, &count);
+
+    put_str(w, name);
+
+    if (evt->kind == APP_EVT_STATUS && count >= 3) {
+        put_str(w, ":floor=");
+        put_dec(w, evt->values[0]);
+        put_str(w, ",dir=");
+        put_str(w, direction_str(evt->values[1]));
+        put_str(w, ",dest=0x");
+        put_hex2(w, evt->values[2]);
+    } else if (evt->kind == APP_EVT_SNAPSHOT && count >= 5) {
+        put_str(w, ":floor=");
+        put_dec(w, evt->values[0]);
+        put_str(w, ",dir=");
+        put_str(w, direction_str(evt->values[1]));
+        put_str(w, ",dest=0x");
+        put_hex2(w, evt->values[2]);
+        put_str(w, ",calls=0x");
+        put_hex2(w, evt->values[3]);
+        put_str(w, ",estop=");
+        put_dec(w, evt->values[4]);
+    } else if (evt->kind == APP_EVT_STATE && count == 0 && proto_event_desc(evt->code) == NULL) {
+        put_u8(w, '_');
+        put_dec(w, evt->code);
+    } else {
+        for (uint8_t i = 0; i < count; i++) {
+            put_u8(w, '_');
+            put_dec(w, evt->values[i]);
+        }
+    }
+}
+
+// === JSON: {"e":"<legacy event string>","t":<us>} ===
+
+static void encode_json(writer_t *w, const app_event_t *evt)
+{
+    put_str(w, "{\"e\":\"");
+    encode_text(w, evt);
+    put_str(w, "\",\"t\":");
+    put_dec(w, evt->timestamp_us);
+    put_u8(w, '}');
+}
+
+// === CBOR (RFC 8949): [name, t, values...] ===
+
+static void cbor_head(writer_t *w, uint8_t major, uint64_t v)
+{
+    major <<= 5;
+    if (v < 24) {
+        put_u8(w, major | (uint8_t)v);
+    } else if (v <= 0xFF) {
+        put_u8(w, major | 24);
+        put_be(w, v, 1);
+    } else if (v <= 0xFFFF) {
+        put_u8(w, major | 25);
+        put_be(w, v, 2);
+    } else if (v <= 0xFFFFFFFFULL) {
+        put_u8(w, major | 26);
+        put_be(w, v, 4);
+    } else {
+        put_u8(w, major | 27);
+        put_be(w, v, 8);
+    }
+}
+
+static void cbor_int(writer_t *w, int64_t v)
+{
+    if (v >= 0) {
+        cbor_head(w, 0, (uint64_t)v);
+    } else {
+        cbor_head(w, 1, (uint64_t)(-1 - v));
+    }
+}
+
+static void encode_cbor(writer_t *w, const app_event_t *evt)
+{
+    uint8_t count;
+    const char *name = event_name(evt, &count);
+
+    cbor_head(w, 4, 2 + count);
+    cbor_head(w, 3, strlen(name));
+    put_str(w, name);
+    cbor_int(w, evt->timestamp_us);
+    for (uint8_t i = 0; i < count; i++) {
+        cbor_head(w, 0, evt->values[i]);
+    }
+}
+
+// === MessagePack: [name, t, values...] ===
+
+static void msgpack_uint(writer_t *w, uint64_t v)
+{
+    if (v < 0x80) {
+        put_u8(w, (uint8_t)v);
+    } else if (v <= 0xFF) {
+        put_u8(w, 0xCC);
+        put_be(w, v, 1);
+    } else if (v <= 0xFFFF) {
+        put_u8(w, 0xCD);
+        put_be(w, v, 2);
+    } else if (v <= 0xFFFFFFFFULL) {
+        put_u8(w, 0xCE);
+        put_be(w, v, 4);
+    } else {
+        put_u8(w, 0xCF);
+        put_be(w, v, 8);
+    }
+}
+
+static void msgpack_int(writer_t *w, int64_t v)
+{
+    if (v >= 0) {
+        msgpack_uint(w, (uint64_t)v);
+    } else {
+        put_u8(w, 0xD3);
+        put_be(w, (uint64_t)v, 8);
+    }
+}
+
+static void msgpack_str(writer_t *w, const char *s)
+{
+    size_t len = strlen(s);
+    if (len < 32) {
+        put_u8(w, (uint8_t)(0xA0 | len));
+    } else {
+        put_u8(w, 0xD9);
+        put_u8(w, (uint8_t)len);
+    }
+    put_bytes(w, s, len);
+}
+
+static void encode_msgpack(writer_t *w, const app_event_t *evt)
+{
+    uint8_t count;
+    const char *name = event_name(evt, &count);
+
+    put_u8(w, (uint8_t)(0x90 | (2 + count)));
+    msgpack_str(w, name);
+    msgpack_int(w, evt->timestamp_us);
+    for (uint8_t i = 0; i < count; i++) {
+        msgpack_uint(w, evt->values[i]);
+    }
+}
+
+// === Fixed binary: kind, code, v0..v4, t (int64 LE) ===
+
+static void encode_binary(writer_t *w, const app_event_t *evt)
+{
+    put_u8(w, (uint8_t)evt->kind);
+    put_u8(w, evt->code);
+    for (uint8_t i = 0; i < APP_EVT_MAX_VALUES; i++) {
+        put_u8(w, i < evt->value_count ? evt->values[i] : 0);
+    }
+    uint64_t t = (uint64_t)evt->timestamp_us;
+    for (int i = 0; i < 8; i++) {
+        put_u8(w, (uint8_t)(t >> (8 * i)));
+    }
+}
+
+size_t event_encode(event_format_t fmt, const app_event_t *evt, uint8_t *buf, size_t cap)
+{
+    writer_t w = { .buf = buf, .cap = cap, .len = 0, .ok = true };
+
+    switch (fmt) {
+        case EVENT_FMT_TEXT:    encode_text(&w, evt);    break;
+        case EVENT_FMT_JSON:    encode_json(&w, evt);    break;
+        case EVENT_FMT_CBOR:    encode_cbor(&w, evt);    break;
+        case EVENT_FMT_MSGPACK: encode_msgpack(&w, evt); break;
+        case EVENT_FMT_BINARY:  encode_binary(&w, evt);  break;
+        default: return 0;
+    }
+
+    return w.ok ? w.len : 0;
+}
+
+// === Batch framing ===
+
+static void frame_json(uint8_t *buf, size_t len, uint8_t count)
+{
+    (void)count;
+    buf[0] = '[';
+    buf[len] = ']';
+}
+
+static void frame_cbor(uint8_t *buf, size_t len, uint8_t count)
+{
+    (void)count;
+    buf[0] = 0x9F;      // indefinite-length array
+    buf[len] = 0xFF;    // break
+}
+
+static void frame_msgpack(uint8_t *buf, size_t len, uint8_t count)
+{
+    (void)len;
+    buf[0] = 0xDC;      // array 16
+    buf[1] = 0;
+    buf[2] = count;
+}
+
+static void frame_binary(uint8_t *buf, size_t len, uint8_t count)
+{
+    (void)len;
+    buf[0] = count;
+}
+
+static const mqtt_batch_framing_t framings[] = {
+    [EVENT_FMT_JSON]    = { .header_len = 1, .separator_len = 1, .separator = ',', .footer_len = 1, .frame = frame_json },
+    [EVENT_FMT_CBOR]    = { .header_len = 1, .footer_len = 1, .frame = frame_cbor },
+    [EVENT_FMT_MSGPACK] = { .header_len = 3, .frame = frame_msgpack },
+    [EVENT_FMT_BINARY]  = { .header_len = 1, .frame = frame_binary },
+};
+
+const mqtt_batch_framing_t *event_batch_framing(event_format_t fmt)
+{
+    if ((size_t)fmt >= sizeof(framings) / sizeof(framings[0]) || framings[fmt].frame == NULL) {
+        return NULL;
+    }
+    return &framings[fmt];
+}
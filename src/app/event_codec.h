@@ -0,0 +1,57 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "comm/mqtt_batch.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Payload encoders for published events. All of them write straight into
+// a caller-provided buffer: no heap, no printf.
+
+typedef enum {
+    EVENT_FMT_TEXT,       // stopped_at_floor_2 (legacy event strings, not batchable)
+    EVENT_FMT_JSON,       // {"e":"stopped_at_floor_2","t":<us>}
+    EVENT_FMT_CBOR,       // [name, t, values...]
+    EVENT_FMT_MSGPACK,    // [name, t, values...]
+    EVENT_FMT_BINARY,     // fixed 15 bytes: kind, code, v0..v4, t (int64 LE)
+} event_format_t;
+
+typedef enum {
+    APP_EVT_STATE,        // MAX32655 state event: code = proto_event_type_t
+    APP_EVT_STATUS,       // values = floor, direction, dest_bitmask
+    APP_EVT_CMD_OK,
+    APP_EVT_CMD_ERR,      // values = cmd_status_t
+    APP_EVT_CMD_TIMEOUT,
+    APP_EVT_LINK_UP,
+    APP_EVT_LINK_DOWN,
+    APP_EVT_SNAPSHOT,     // values = floor, direction, dest_bitmask, call_bitmask, estop
+    APP_EVT_CMD_BUSY,     // command rejected by admission control (CMD_ERR_BUSY)
+} app_event_kind_t;
+
+#define APP_EVT_MAX_VALUES  5
+
+typedef struct {
+    app_event_kind_t kind;
+    uint8_t code;
+    uint8_t value_count;
+    uint8_t values[APP_EVT_MAX_VALUES];
+    int64_t timestamp_us; // wall clock
+} app_event_t;
+
+#define EVENT_BINARY_LEN    (2 + APP_EVT_MAX_VALUES + 8)
+#define EVENT_ITEM_MAX_LEN  96
+
+// Encode one event, returns bytes written or 0 if it does not fit
+size_t event_encode(event_format_t fmt, const app_event_t *evt, uint8_t *buf, size_t cap);
+
+// Batch framing matching the format (for mqtt_batch), NULL if the format
+// has to go out one event per message
+const mqtt_batch_framing_t *event_batch_framing(event_format_t fmt);
+
+#ifdef __cplusplus
+}
+#endif
@@ -3,37 +3,597 @@
 #include "app/max_comm.h"
 #include "comm/uart/tf_transport.h"
 #include "comm/uart/protocol_handler.h"
+#include "comm/mqtt_batch.h"
 #include "comm/mqtt_util.h"
+#include "comm/wifi_util.h"
+#include "app/event_codec.h"
+#define TRACE_TAG "MAX_COMM"
+#include "comm/trace.h"
+#include "config.h"
 #include "protocol.h"
+#include "freertos/FreeRTOS.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include <string.h>
-#include <stdlib.h>
+#include <sys/time.h>
 
 static const char *TAG = "MAX_COMM";
 
 // Track connection state
 static bool max32655_connected = false;
 
+// === Elevator state cache ===
+// Kept current from state events and reconciled against CMD_GET_STATUS, so
+// "status" queries can be answered without a UART round trip.
+
+#define STATUS_RECONCILE_MS     30000   // periodic CMD_GET_STATUS
+#define STATUS_MAX_AGE_MS       60000   // serve from cache if reconciled within this
+
+#define DIR_STOPPED 0
+#define DIR_UP      1
+#define DIR_DOWN    2
+
+static elevator_state_t elevator_state;
+static portMUX_TYPE state_lock = portMUX_INITIALIZER_UNLOCKED;
+static esp_timer_handle_t reconcile_timer = NULL;
+
+// Call buttons located at a floor (cleared when the cabin stops there)
+static uint8_t call_buttons_at_floor(uint8_t floor)
+{
+    switch (floor) {
+        case 0: return 1 << CALL_BTN_0;
+        case 1: return (1 << CALL_BTN_1_DOWN) | (1 << CALL_BTN_1_UP);
+        case 2: return 1 << CALL_BTN_2;
+        default: return 0;
+    }
+}
+
+// Returns true if floor, direction or e-stop changed (worth a retained snapshot;
+// button presses alone are not)
+static bool state_apply_event(const state_event_t *evt, int64_t timestamp_us)
+{
+    // Bitmasks hold 8 floors / call buttons
+    bool data_fits = evt->data < 8;
+
+    portENTER_CRITICAL(&state_lock);
+    elevator_state_t before = elevator_state;
+    switch (evt->event_type) {
+        case PROTO_EVT_STOPPED_AT_FLOOR:
+            elevator_state.floor = evt->data;
+            elevator_state.direction = DIR_STOPPED;
+            if (data_fits) {
+                elevator_state.dest_bitmask &= (uint8_t)~(1u << evt->data);
+                elevator_state.call_bitmask &= (uint8_t)~call_buttons_at_floor(evt->data);
+            }
+            break;
+        case PROTO_EVT_CABIN_BUTTON:
+            if (data_fits) {
+                elevator_state.dest_bitmask |= (uint8_t)(1u << evt->data);
+            }
+            break;
+        case PROTO_EVT_CALL_BUTTON:
+            if (data_fits) {
+                elevator_state.call_bitmask |= (uint8_t)(1u << evt->data);
+            }
+            break;
+        case PROTO_EVT_ESTOP_ACTIVATED:
+            elevator_state.estop = true;
+            break;
+        case PROTO_EVT_ESTOP_RELEASED:
+            elevator_state.estop = false;
+            break;
+        default:
+            break;
+    }
+    elevator_state.updated_us = timestamp_us;
+    bool changed = before.floor != elevator_state.floor ||
+                   before.direction != elevator_state.direction ||
+                   before.estop != elevator_state.estop;
+    portEXIT_CRITICAL(&state_lock);
+    return changed;
+}
+
+// Returns true if the reconciled state differs from what the cache believed
+static bool state_apply_status(uint8_t floor, uint8_t direction, uint8_t dest_bitmask,
+                               int64_t timestamp_us)
+{
+    portENTER_CRITICAL(&state_lock);
+    bool changed = !elevator_state.valid ||
+                   elevator_state.floor != floor ||
+                   elevator_state.direction != direction ||
+                   elevator_state.dest_bitmask != dest_bitmask;
+    elevator_state.floor = floor;
+    elevator_state.direction = direction;
+    elevator_state.dest_bitmask = dest_bitmask;
+    elevator_state.valid = true;
+    elevator_state.updated_us = timestamp_us;
+    elevator_state.reconciled_us = timestamp_us;
+    portEXIT_CRITICAL(&state_lock);
+    return changed;
+}
+
+static void state_invalidate(void)
+{
+    portENTER_CRITICAL(&state_lock);
+    elevator_state.valid = false;
+    portEXIT_CRITICAL(&state_lock);
+}
+
+static void reconcile_timer_cb(void *arg)
+{
+    (void)arg;
+    if (max32655_connected) {
+        MaxComm_SendGetStatus();
+    }
+}
+
+// Convert an esp_timer timestamp to wall-clock microseconds (uptime-based
+// until the system clock has been set)
+static int64_t to_wall_clock_us(int64_t timestamp_us)
+{
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    int64_t wall_now = (int64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+    return wall_now - (esp_timer_get_time() - timestamp_us);
+}
+
+// === Event publishing ===
+// Each event class has a route: topic suffix, QoS, retain and whether it is
+// batched. Every event is encoded once per sink (base topic + payload format)
+// straight into a stack buffer, then either batched or published directly.
+
+typedef enum {
+    ROUTE_MOTION,     // stopped_at_floor
+    ROUTE_BUTTON,     // cabin / call buttons
+    ROUTE_ESTOP,      // e-stop activated / released
+    ROUTE_CMD,        // command results and status replies
+    ROUTE_LINK,       // MAX32655 connected / disconnected (retained)
+    ROUTE_STATE,      // current state snapshot (retained)
+    ROUTE_COUNT,
+} event_route_id_t;
+
+typedef struct {
+    const char *suffix;   // appended to the sink's base topic
+    uint8_t qos;
+    bool retain;
+    bool batched;
+} event_route_t;
+
+static const event_route_t event_routes[ROUTE_COUNT] = {
+    [ROUTE_MOTION] = { "",            1, false, true  },
+    [ROUTE_BUTTON] = { "/buttons",    0, false, true  },
+    [ROUTE_ESTOP]  = { "/estop",      2, false, false },
+    [ROUTE_CMD]    = { "/cmd_result", 1, false, false },
+    [ROUTE_LINK]   = { "/link",       1, true,  false },
+    [ROUTE_STATE]  = { "/state",      1, true,  false },
+};
+
+static event_route_id_t route_for(app_event_kind_t kind, uint8_t code)
+{
+    switch (kind) {
+        case APP_EVT_STATE:
+            switch (code) {
+                case PROTO_EVT_CABIN_BUTTON:
+                case PROTO_EVT_CALL_BUTTON:     return ROUTE_BUTTON;
+                case PROTO_EVT_ESTOP_ACTIVATED:
+                case PROTO_EVT_ESTOP_RELEASED:  return ROUTE_ESTOP;
+                default:                        return ROUTE_MOTION;
+            }
+        case APP_EVT_SNAPSHOT:  return ROUTE_STATE;
+        case APP_EVT_LINK_UP:
+        case APP_EVT_LINK_DOWN: return ROUTE_LINK;
+        default:                return ROUTE_CMD;
+    }
+}
+
+#define EVENT_TOPIC_MAX_LEN 64
+#define BATCHED_ROUTE_COUNT 2   // routes with .batched set
+
+typedef struct {
+    const char *base_topic;
+    event_format_t format;
+    char topics[ROUTE_COUNT][EVENT_TOPIC_MAX_LEN];
+    mqtt_batch_t batches[BATCHED_ROUTE_COUNT];
+    mqtt_batch_t *route_batch[ROUTE_COUNT];   // NULL for unbatched routes
+} event_sink_t;
+
+static event_sink_t event_sinks[] = {
+    { .base_topic = MQTT_TOPIC_EVENTS, .format = MQTT_EVENTS_FORMAT },
+#ifdef MQTT_TOPIC_EVENTS_V2
+    { .base_topic = MQTT_TOPIC_EVENTS_V2, .format = MQTT_EVENTS_V2_FORMAT },
+#endif
+#ifdef MQTT_TOPIC_EVENTS_BINARY
+    { .base_topic = MQTT_TOPIC_EVENTS_BINARY, .format = MQTT_EVENTS_BINARY_FORMAT },
+#endif
+};
+
+#define EVENT_SINK_COUNT (sizeof(event_sinks) / sizeof(event_sinks[0]))
+
+static void event_sinks_init(void)
+{
+    for (size_t i = 0; i < EVENT_SINK_COUNT; i++) {
+        event_sink_t *sink = &event_sinks[i];
+        size_t next_batch = 0;
+
+        for (int r = 0; r < ROUTE_COUNT; r++) {
+            snprintf(sink->topics[r], EVENT_TOPIC_MAX_LEN, "%s%s",
+                     sink->base_topic, event_routes[r].suffix);
+
+            if (!event_routes[r].batched) {
+                continue;
+            }
+            configASSERT(next_batch < BATCHED_ROUTE_COUNT);
+            // Formats without framing (legacy text) go out one per message
+            const mqtt_batch_framing_t *framing = event_batch_framing(sink->format);
+            mqtt_batch_config_t cfg = {
+                .topic = sink->topics[r],
+                .framing = framing,
+                .qos = event_routes[r].qos,
+                .retain = event_routes[r].retain,
+                .window_ms = framing ? MQTT_BATCH_WINDOW_MS : 0,
+                .max_events = MQTT_BATCH_MAX_EVENTS,
+            };
+            sink->route_batch[r] = &sink->batches[next_batch++];
+            mqtt_batch_init(sink->route_batch[r], &cfg);
+        }
+    }
+}
+
+// Publish with the wall-clock time the event happened (on the MAX32655 when
+// timestamp_us came from it)
+static void make_event(app_event_t *evt, app_event_kind_t kind, uint8_t code,
+                       const uint8_t *values, uint8_t value_count, int64_t timestamp_us)
+{
+    evt->kind = kind;
+    evt->code = code;
+    evt->value_count = value_count;
+    evt->timestamp_us = to_wall_clock_us(timestamp_us);
+    if (value_count > 0) {
+        memcpy(evt->values, values, value_count);
+    }
+}
+
+static void publish_event(app_event_kind_t kind, uint8_t code, const uint8_t *values,
+                          uint8_t value_count, int64_t timestamp_us)
+{
+    app_event_t evt;
+    make_event(&evt, kind, code, values, value_count, timestamp_us);
+
+    event_route_id_t route = route_for(kind, code);
+
+    for (size_t i = 0; i < EVENT_SINK_COUNT; i++) {
+        event_sink_t *sink = &event_sinks[i];
+        uint8_t item[EVENT_ITEM_MAX_LEN];
+        size_t len = event_encode(sink->format, &evt, item, sizeof(item));
+        if (len == 0) {
+            continue;
+        }
+
+        if (sink->route_batch[route]) {
+            mqtt_batch_add(sink->route_batch[route], item, len, false);
+        } else {
+            // E-stop goes out immediately, after whatever led up to it
+            if (route == ROUTE_ESTOP) {
+                for (size_t b = 0; b < BATCHED_ROUTE_COUNT; b++) {
+                    mqtt_batch_flush(&sink->batches[b]);
+                }
+            }
+            mqtt_publish(sink->topics[route], item, (int)len,
+                         event_routes[route].qos, event_routes[route].retain);
+        }
+    }
+}
+
+// Retained snapshot of the cached state on the state topic
+static void publish_snapshot(void)
+{
+    elevator_state_t state;
+    MaxComm_GetState(&state);
+    if (!state.valid) {
+        return;
+    }
+
+    uint8_t values[] = { state.floor, state.direction, state.dest_bitmask,
+                         state.call_bitmask, state.estop };
+    publish_event(APP_EVT_SNAPSHOT, 0, values, sizeof(values), state.updated_us);
+}
+
+// Events without data that originate on the ESP itself
+static void publish_event_now(app_event_kind_t kind)
+{
+    publish_event(kind, 0, NULL, 0, esp_timer_get_time());
+}
+
 // === Protocol callbacks ===
 
-static const char *direction_str(uint8_t dir)
+static void publish_status(uint8_t floor, uint8_t direction, uint8_t dest_bitmask,
+                           int64_t timestamp_us)
 {
-    switch (dir) {
-        case 0: return "stopped";
-        case 1: return "up";
-        case 2: return "down";
-        default: return "unknown";
+    uint8_t values[] = { floor, direction, dest_bitmask };
+    publish_event(APP_EVT_STATUS, 0, values, sizeof(values), timestamp_us);
+}
+
+// === Command de-duplication ===
+// A text command payload may start with an id: "<id>@floor:2;status". The
+// results of recent ids are kept in a small LRU cache, so a repeat (QoS 2
+// redelivery after a reconnect, a cloud-side retry) gets the cached results
+// again instead of re-running the commands - on its response topic, or on
+// <events>/cmd_result/replay/<id> - and a repeat while the first copy is
+// still running is dropped. Busy rejections are not cached so a
+// retry can still go through.
+
+#define CMD_ID_MAX_LEN          16
+#define CMD_DEDUP_SLOTS         16
+#define CMD_DEDUP_TTL_MS        120000
+#define CMD_DEDUP_MAX_RESULTS   4
+
+typedef struct {
+    uint8_t kind;             // app_event_kind_t
+    uint8_t code;
+    uint8_t value_count;
+    uint8_t values[3];
+} cmd_result_t;
+
+typedef struct {
+    bool used;
+    uint16_t gen;             // bumped on reuse so late results can't land in a new entry
+    uint8_t id_len;
+    char id[CMD_ID_MAX_LEN];
+    int64_t last_us;          // LRU order and expiry
+    uint8_t cmd_count;
+    uint8_t done_mask;        // bit per command that has a result
+    cmd_result_t results[CMD_DEDUP_MAX_RESULTS];
+} dedup_entry_t;
+
+typedef enum {
+    DEDUP_NEW,                // first time seen, entry created
+    DEDUP_IN_PROGRESS,        // seen, results still outstanding
+    DEDUP_DONE,               // seen, all results cached
+} dedup_state_t;
+
+static dedup_entry_t dedup_cache[CMD_DEDUP_SLOTS];
+static uint16_t dedup_gen_counter = 0;
+
+// Find id or claim an entry for it (free, expired or least recently used).
+// On DEDUP_DONE the entry is copied to *cached.
+static dedup_state_t dedup_check(const char *id, uint8_t id_len, uint8_t cmd_count,
+                                 int *slot, uint16_t *gen, dedup_entry_t *cached)
+{
+    int64_t now = esp_timer_get_time();
+    int victim = 0;
+    dedup_state_t result = DEDUP_NEW;
+
+    portENTER_CRITICAL(&state_lock);
+    for (int i = 0; i < CMD_DEDUP_SLOTS; i++) {
+        dedup_entry_t *e = &dedup_cache[i];
+        bool expired = e->used && now - e->last_us > CMD_DEDUP_TTL_MS * 1000LL;
+        if (expired) {
+            e->used = false;
+        }
+        if (e->used && e->id_len == id_len && memcmp(e->id, id, id_len) == 0) {
+            uint8_t all = (uint8_t)((1u << e->cmd_count) - 1);
+            e->last_us = now;
+            if (e->done_mask == all) {
+                *cached = *e;
+                result = DEDUP_DONE;
+            } else {
+                result = DEDUP_IN_PROGRESS;
+            }
+            break;
+        }
+        const dedup_entry_t *v = &dedup_cache[victim];
+        if (v->used && (!e->used || e->last_us < v->last_us)) {
+            victim = i;     // free entry, else least recently used
+        }
+    }
+
+    if (result == DEDUP_NEW) {
+        dedup_entry_t *e = &dedup_cache[victim];
+        memset(e, 0, sizeof(*e));
+        e->used = true;
+        e->gen = ++dedup_gen_counter;
+        e->id_len = id_len;
+        memcpy(e->id, id, id_len);
+        e->last_us = now;
+        e->cmd_count = cmd_count;
+        *slot = victim;
+        *gen = e->gen;
+    }
+    portEXIT_CRITICAL(&state_lock);
+
+    return result;
+}
+
+static void dedup_record(int slot, uint16_t gen, uint8_t index, const cmd_result_t *result)
+{
+    portENTER_CRITICAL(&state_lock);
+    dedup_entry_t *e = &dedup_cache[slot];
+    if (e->used && e->gen == gen && index < e->cmd_count) {
+        e->results[index] = *result;
+        e->done_mask |= (uint8_t)(1u << index);
+    }
+    portEXIT_CRITICAL(&state_lock);
+}
+
+static void dedup_forget(int slot, uint16_t gen)
+{
+    portENTER_CRITICAL(&state_lock);
+    if (dedup_cache[slot].gen == gen) {
+        dedup_cache[slot].used = false;
+    }
+    portEXIT_CRITICAL(&state_lock);
+}
+
+// === MQTT 5 request/response ===
+// Commands that arrive with a response topic get their result published
+// there (same encoding as the primary event sink) with the request's
+// correlation data, in addition to the normal event stream. Each UART
+// command carries the handle of its pending entry as protocol context, so
+// its response or (final, after retries) timeout finds the requester even
+// when retries reorder the answers.
+
+#define PENDING_REPLY_MAX 8
+
+// Where a command's result goes besides the event stream
+typedef struct {
+    bool has_reply;
+    mqtt_reply_t reply;       // MQTT 5 reply target
+    int8_t dedup_slot;        // command id cache entry, -1 if none
+    uint16_t dedup_gen;
+    uint8_t dedup_index;      // position in the batch
+    bool publish_status;      // CMD_GET_STATUS asked for over MQTT: publish the reply
+} cmd_target_t;
+
+typedef struct {
+    bool used;
+    uint32_t seq;             // handle and issue order (oldest is evicted first), never 0
+    cmd_target_t target;
+} pending_reply_t;
+
+static pending_reply_t pending_replies[PENDING_REPLY_MAX];
+static uint32_t pending_reply_seq = 0;
+
+static void send_reply(const mqtt_reply_t *reply, app_event_kind_t kind, uint8_t code,
+                       const uint8_t *values, uint8_t value_count, int64_t timestamp_us)
+{
+    if (reply == NULL) {
+        return;
+    }
+
+    app_event_t evt;
+    make_event(&evt, kind, code, values, value_count, timestamp_us);
+
+    uint8_t buf[EVENT_ITEM_MAX_LEN];
+    size_t len = event_encode(EVENT_FMT_JSON, &evt, buf, sizeof(buf));
+    if (len > 0) {
+        mqtt_publish_reply(reply, buf, (int)len);
+    }
+}
+
+static void cmd_target_init(cmd_target_t *target, const mqtt_reply_t *reply)
+{
+    memset(target, 0, sizeof(*target));
+    target->has_reply = reply != NULL;
+    if (reply) {
+        target->reply = *reply;
+    }
+    target->dedup_slot = -1;
+}
+
+// Deliver a command result to its reply target and the de-duplication cache
+static void cmd_complete(const cmd_target_t *target, app_event_kind_t kind, uint8_t code,
+                         const uint8_t *values, uint8_t value_count, int64_t timestamp_us)
+{
+    if (target == NULL) {
+        return;
+    }
+
+    if (target->has_reply) {
+        send_reply(&target->reply, kind, code, values, value_count, timestamp_us);
+    }
+
+    if (target->dedup_slot >= 0) {
+        cmd_result_t result = {
+            .kind = (uint8_t)kind,
+            .code = code,
+            .value_count = value_count < sizeof(result.values) ? value_count : sizeof(result.values),
+        };
+        if (result.value_count > 0) {
+            memcpy(result.values, values, result.value_count);
+        }
+        dedup_record(target->dedup_slot, target->dedup_gen, target->dedup_index, &result);
     }
 }
 
-static void on_cmd_response(const cmd_response_t *resp)
+// Remember where a command's result goes; evicts the oldest entry when
+// full. Returns the context to send the command with, NULL if there is
+// nothing to remember.
+static void *pending_reply_add(const cmd_target_t *target)
 {
-    ESP_LOGI(TAG, "CMD response: cmd=%d status=%d data_len=%d", resp->cmd_id, resp->status, resp->data_len);
+    if (target == NULL || (!target->has_reply && target->dedup_slot < 0 && !target->publish_status)) {
+        return NULL;
+    }
+
+    portENTER_CRITICAL(&state_lock);
+    int slot = 0;
+    for (int i = 0; i < PENDING_REPLY_MAX; i++) {
+        if (!pending_replies[i].used) {
+            slot = i;
+            break;
+        }
+        if (pending_replies[i].seq - pending_replies[slot].seq > UINT32_MAX / 2) {
+            slot = i;   // older
+        }
+    }
+    bool evicted = pending_replies[slot].used;
+    cmd_target_t evicted_target = pending_replies[slot].target;
+    if (++pending_reply_seq == 0) {
+        pending_reply_seq = 1;
+    }
+    pending_replies[slot].used = true;
+    pending_replies[slot].seq = pending_reply_seq;
+    pending_replies[slot].target = *target;
+    void *ctx = (void *)(uintptr_t)pending_reply_seq;
+    portEXIT_CRITICAL(&state_lock);
+
+    // Its result will never be delivered: answer it as timed out, so the
+    // requester hears back and a redelivery gets that from the dedup cache
+    // instead of being dropped as still running
+    if (evicted) {
+        TRACE_W("Pending reply evicted");
+        cmd_complete(&evicted_target, APP_EVT_CMD_TIMEOUT, 0, NULL, 0, esp_timer_get_time());
+    }
+    return ctx;
+}
 
+// Remove the entry of ctx; true (and its target) if it was still there
+static bool pending_reply_take(void *ctx, cmd_target_t *out)
+{
+    uint32_t seq = (uint32_t)(uintptr_t)ctx;
+    bool found = false;
+
+    if (seq == 0) {
+        return false;
+    }
+    portENTER_CRITICAL(&state_lock);
+    for (int i = 0; i < PENDING_REPLY_MAX; i++) {
+        if (pending_replies[i].used && pending_replies[i].seq == seq) {
+            if (out) {
+                *out = pending_replies[i].target;
+            }
+            pending_replies[i].used = false;
+            found = true;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&state_lock);
+
+    return found;
+}
+
+static void reply_cmd_response(const cmd_target_t *target, const cmd_response_t *resp, int64_t timestamp_us)
+{
     if (resp->status != CMD_OK) {
-        char msg[32];
-        snprintf(msg, sizeof(msg), "cmd_err_%d", resp->status);
-        mqtt_publish_event(msg);
+        cmd_complete(target, APP_EVT_CMD_ERR, resp->cmd_id, &resp->status, 1, timestamp_us);
+    } else if (resp->cmd_id == CMD_GET_STATUS && resp->data_len >= 3) {
+        cmd_complete(target, APP_EVT_STATUS, 0, resp->data, 3, timestamp_us);
+    } else {
+        cmd_complete(target, APP_EVT_CMD_OK, resp->cmd_id, NULL, 0, timestamp_us);
+    }
+}
+
+static void on_cmd_response(const cmd_response_t *resp, int64_t timestamp_us, void *ctx)
+{
+    TRACE_I("CMD response: cmd=%d status=%d data_len=%d", resp->cmd_id, resp->status, resp->data_len);
+
+    cmd_target_t target;
+    bool has_target = pending_reply_take(ctx, &target);
+    if (has_target) {
+        reply_cmd_response(&target, resp, timestamp_us);
+    }
+
+    if (resp->status != CMD_OK) {
+        publish_event(APP_EVT_CMD_ERR, resp->cmd_id, &resp->status, 1, timestamp_us);
         return;
     }
 
@@ -43,64 +603,68 @@ static void on_cmd_response(const cmd_response_t *resp)
         uint8_t direction = resp->data[1];
         uint8_t dest_bitmask = resp->data[2];
 
-        char msg[64];
-        snprintf(msg, sizeof(msg), "status:floor=%d,dir=%s,dest=0x%02X",
-                 floor, direction_str(direction), dest_bitmask);
-        mqtt_publish_event(msg);
+        bool changed = state_apply_status(floor, direction, dest_bitmask, timestamp_us);
+
+        // Periodic reconciliation stays quiet unless it corrected the cache
+        bool requested = has_target && target.publish_status;
+        if (requested || changed) {
+            publish_status(floor, direction, dest_bitmask, timestamp_us);
+        }
+        if (changed) {
+            publish_snapshot();
+        }
     } else {
-        mqtt_publish_event("cmd_ok");
+        publish_event(APP_EVT_CMD_OK, resp->cmd_id, NULL, 0, timestamp_us);
     }
 }
 
-static void on_cmd_timeout(void)
+static void on_cmd_timeout(uint8_t cmd_id, void *ctx)
 {
-    ESP_LOGW(TAG, "CMD timeout - no response from MAX32655");
-    mqtt_publish_event("cmd_timeout");
+    ESP_LOGW(TAG, "CMD %d timeout - no response from MAX32655", cmd_id);
+    publish_event_now(APP_EVT_CMD_TIMEOUT);
+
+    cmd_target_t target;
+    if (pending_reply_take(ctx, &target)) {
+        cmd_complete(&target, APP_EVT_CMD_TIMEOUT, 0, NULL, 0, esp_timer_get_time());
+    }
 }
 
-static void on_state_event(const state_event_t *evt)
+static void on_state_event(const state_event_t *evt, int64_t timestamp_us)
 {
-    ESP_LOGI(TAG, "State event: type=%d data=%d", evt->event_type, evt->data);
+    TRACE_I("State event: type=%d data=%d", evt->event_type, evt->data);
 
-    char msg[64];
+    bool snapshot_changed = state_apply_event(evt, timestamp_us);
 
+    // Commands are likely while the elevator is in use; an e-stop keeps
+    // the WiFi modem awake until it is released
     switch (evt->event_type) {
-        case PROTO_EVT_STOPPED_AT_FLOOR:
-            snprintf(msg, sizeof(msg), "stopped_at_floor_%d", evt->data);
-            break;
-
-        case PROTO_EVT_CABIN_BUTTON:
-            snprintf(msg, sizeof(msg), "cabin_button_%d", evt->data);
-            break;
-
-        case PROTO_EVT_CALL_BUTTON:
-            snprintf(msg, sizeof(msg), "call_button_%d", evt->data);
-            break;
-
         case PROTO_EVT_ESTOP_ACTIVATED:
-            snprintf(msg, sizeof(msg), "estop_activated");
+            wifi_note_activity(WIFI_POWER_EVT_ESTOP_ON);
             break;
-
         case PROTO_EVT_ESTOP_RELEASED:
-            snprintf(msg, sizeof(msg), "estop_released");
+            wifi_note_activity(WIFI_POWER_EVT_ESTOP_OFF);
             break;
-
         default:
-            snprintf(msg, sizeof(msg), "unknown_event_%d", evt->event_type);
+            wifi_note_activity(WIFI_POWER_EVT_ACTIVITY);
             break;
     }
 
-    mqtt_publish_event(msg);
+    // Event names come from the protocol schema (see event_codec.c)
+    publish_event(APP_EVT_STATE, evt->event_type, &evt->data, 1, timestamp_us);
+
+    if (snapshot_changed) {
+        publish_snapshot();
+    }
 }
 
 static void on_heartbeat(const uint8_t *data, uint16_t len)
 {
-    ESP_LOGI(TAG, "MAX32655 responded: %.*s", len, data);
+    TRACE_I("MAX32655 responded (%d bytes)", len);
 
     if (!max32655_connected) {
         max32655_connected = true;
         ESP_LOGI(TAG, "MAX32655 connected!");
-        mqtt_publish_event("max32655_connected");
+        publish_event_now(APP_EVT_LINK_UP);
     }
 }
 
@@ -110,7 +674,8 @@ static void on_heartbeat_timeout(void)
 
     if (max32655_connected) {
         max32655_connected = false;
-        mqtt_publish_event("max32655_disconnected");
+        state_invalidate();
+        publish_event_now(APP_EVT_LINK_DOWN);
     }
 }
 
@@ -118,6 +683,8 @@ static void on_heartbeat_timeout(void)
 
 void MaxComm_Init(void)
 {
+    event_sinks_init();
+
     // Initialize transport layer
     tf_transport_init();
 
@@ -130,16 +697,37 @@ void MaxComm_Init(void)
         .on_heartbeat_timeout = on_heartbeat_timeout,
         .heartbeat_interval_ms = 10000,
         .heartbeat_timeout_ticks = 500,
-        .cmd_timeout_ticks = 500,
+        .cmd_timeout_ticks = 150,       // per attempt, the protocol handler retries
+        .time_sync_interval_ms = 5000,
     };
     protocol_init(&proto_cfg);
 
+    const esp_timer_create_args_t timer_args = {
+        .callback = reconcile_timer_cb,
+        .name = "state_reconcile",
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&timer_args, &reconcile_timer));
+    ESP_ERROR_CHECK(esp_timer_start_periodic(reconcile_timer, STATUS_RECONCILE_MS * 1000ULL));
+
     ESP_LOGI(TAG, "MAX32655 communication initialized");
 }
 
 bool MaxComm_SendCmd(const cmd_request_t *cmd)
 {
-    return protocol_send_cmd(cmd);
+    return protocol_send_cmd(cmd, NULL);
+}
+
+// UART command whose result goes to the pending entry of ctx
+static bool send_cmd(uint8_t cmd_id, const uint8_t *params, uint8_t params_len, void *ctx)
+{
+    cmd_request_t cmd = {
+        .cmd_id = cmd_id,
+        .params_len = params_len,
+    };
+    if (params_len > 0) {
+        memcpy(cmd.params, params, params_len);
+    }
+    return protocol_send_cmd(&cmd, ctx);
 }
 
 bool MaxComm_SendEstop(void)
@@ -150,54 +738,534 @@ bool MaxComm_SendEstop(void)
 
 bool MaxComm_SendMoveToFloor(uint8_t floor)
 {
-    cmd_request_t cmd = {
-        .cmd_id = CMD_MOVE_TO_FLOOR,
-        .params_len = 1,
-    };
-    cmd.params[0] = floor;
-    return protocol_send_cmd(&cmd);
+    return send_cmd(CMD_MOVE_TO_FLOOR, &floor, 1, NULL);
 }
 
 bool MaxComm_SendGetStatus(void)
 {
-    cmd_request_t cmd = {
-        .cmd_id = CMD_GET_STATUS,
-        .params_len = 0,
-    };
-    return protocol_send_cmd(&cmd);
+    return send_cmd(CMD_GET_STATUS, NULL, 0, NULL);
+}
+
+void MaxComm_GetState(elevator_state_t *state)
+{
+    portENTER_CRITICAL(&state_lock);
+    *state = elevator_state;
+    portEXIT_CRITICAL(&state_lock);
+}
+
+// Cached state if it is recent enough to answer a status request. No
+// event reports a departure, only the stop, so the cached direction only
+// holds while nothing is queued: with a destination or call pending the
+// cabin may be on its way.
+static bool status_from_cache(elevator_state_t *state)
+{
+    MaxComm_GetState(state);
+
+    int64_t age_us = esp_timer_get_time() - state->reconciled_us;
+    bool idle = state->dest_bitmask == 0 && state->call_bitmask == 0;
+    return state->valid && max32655_connected && idle && age_us <= STATUS_MAX_AGE_MS * 1000LL;
+}
+
+// CMD_GET_STATUS whose reply is published as a status event and delivered
+// to target (may be NULL)
+static bool query_status(const cmd_target_t *target)
+{
+    cmd_target_t status_target;
+    cmd_target_init(&status_target, NULL);
+    if (target) {
+        status_target = *target;
+    }
+    status_target.publish_status = true;
+
+    void *ctx = pending_reply_add(&status_target);
+    if (!send_cmd(CMD_GET_STATUS, NULL, 0, ctx)) {
+        pending_reply_take(ctx, NULL);
+        return false;
+    }
+    return true;
+}
+
+bool MaxComm_RequestStatus(void)
+{
+    elevator_state_t state;
+    if (status_from_cache(&state)) {
+        publish_status(state.floor, state.direction, state.dest_bitmask, state.updated_us);
+        return true;
+    }
+    return query_status(NULL);
 }
 
 bool MaxComm_SendReset(void)
 {
-    cmd_request_t cmd = {
-        .cmd_id = CMD_RESET,
-        .params_len = 0,
-    };
-    return protocol_send_cmd(&cmd);
+    return send_cmd(CMD_RESET, NULL, 0, NULL);
 }
 
-// Parse simple commands from MQTT
-// Format: "CMD_NAME" or "CMD_NAME:param"
-void MaxComm_OnMqttCommand(const char *payload, int len)
+// === Command admission ===
+// Inbound MQTT commands pass two checks before they reach the UART: a token
+// bucket per command class, and a cap on UART queries in flight so a
+// command flood can't crowd out heartbeats (a late heartbeat reads as link
+// loss). A batch is admitted or rejected as a whole; rejected commands get
+// a "busy" result (CMD_ERR_BUSY). E-stop bypasses both checks. A full batch
+// must be admissible when the link is idle, hence the asserts below the
+// parser's MQTT_CMD_MAX_BATCH.
+
+#define CMD_MAX_IN_FLIGHT   3   // of TF_MAX_ID_LST, leaves room for HB / caps / time sync
+#define CMD_MOTION_BURST    3   // MOVE_TO_FLOOR tokens
+
+typedef struct {
+    uint32_t period_ms;       // one token per period
+    uint8_t burst;            // bucket size in tokens
+    int64_t credit_us;        // accumulated period time, capped at burst * period
+    int64_t last_us;
+} token_bucket_t;
+
+static token_bucket_t cmd_buckets[CMD_CLASS_COUNT] = {
+    [CMD_CLASS_QUERY]  = { .period_ms = 250,  .burst = 4 },
+    [CMD_CLASS_MOTION] = { .period_ms = 500,  .burst = CMD_MOTION_BURST },
+    [CMD_CLASS_ADMIN]  = { .period_ms = 5000, .burst = 1 },
+};
+
+// Commands reach admission from the MQTT task only
+static cmd_admission_stats_t admission_stats;
+
+static cmd_class_t cmd_class_for(uint8_t cmd_id)
 {
-    ESP_LOGI(TAG, "MQTT cmd: %.*s", len, payload);
+    switch (cmd_id) {
+        case CMD_MOVE_TO_FLOOR: return CMD_CLASS_MOTION;
+        case CMD_RESET:         return CMD_CLASS_ADMIN;
+        default:                return CMD_CLASS_QUERY;
+    }
+}
 
-    // Simple string matching for now
-    if (strncmp(payload, "status", len) == 0 || strncmp(payload, "STATUS", len) == 0) {
-        MaxComm_SendGetStatus();
+static void bucket_refill(token_bucket_t *bucket, int64_t now)
+{
+    int64_t cap_us = (int64_t)bucket->burst * bucket->period_ms * 1000;
+
+    if (bucket->last_us == 0) {
+        bucket->credit_us = cap_us;   // start full
+    } else {
+        bucket->credit_us += now - bucket->last_us;
+        if (bucket->credit_us > cap_us) {
+            bucket->credit_us = cap_us;
+        }
     }
-    else if (strncmp(payload, "reset", len) == 0 || strncmp(payload, "RESET", len) == 0) {
-        MaxComm_SendReset();
+    bucket->last_us = now;
+}
+
+// Take class_counts[c] tokens from every class and reserve queries UART
+// slots, all or nothing
+static bool cmd_admit(const uint8_t class_counts[CMD_CLASS_COUNT], int queries)
+{
+    if (protocol_cmds_in_flight() + queries > CMD_MAX_IN_FLIGHT) {
+        admission_stats.rejected_in_flight++;
+        return false;
     }
-    else if (strncmp(payload, "estop", len) == 0 || strncmp(payload, "ESTOP", len) == 0) {
-        MaxComm_SendEstop();
+
+    int64_t now = esp_timer_get_time();
+    for (int c = 0; c < CMD_CLASS_COUNT; c++) {
+        bucket_refill(&cmd_buckets[c], now);
+        if (cmd_buckets[c].credit_us < (int64_t)class_counts[c] * cmd_buckets[c].period_ms * 1000) {
+            admission_stats.rejected_rate[c]++;
+            return false;
+        }
+    }
+
+    for (int c = 0; c < CMD_CLASS_COUNT; c++) {
+        cmd_buckets[c].credit_us -= (int64_t)class_counts[c] * cmd_buckets[c].period_ms * 1000;
+        admission_stats.admitted[c] += class_counts[c];
+    }
+    return true;
+}
+
+static void reject_busy(uint8_t cmd_id, const mqtt_reply_t *reply)
+{
+    int64_t now = esp_timer_get_time();
+    TRACE_W("CMD %d rejected: busy", cmd_id);
+    publish_event(APP_EVT_CMD_BUSY, cmd_id, NULL, 0, now);
+    send_reply(reply, APP_EVT_CMD_BUSY, cmd_id, NULL, 0, now);
+}
+
+void MaxComm_GetAdmissionStats(cmd_admission_stats_t *stats)
+{
+    *stats = admission_stats;
+}
+
+// === MQTT command parsing ===
+// Payload: optional "<id>@" (see de-duplication above), then one or more
+// commands separated by ';', e.g. "floor:1;floor:2;status".
+// Each command is "name" or "name:arg" (names are case-insensitive). The whole
+// batch is validated before anything is sent, then issued back to back so the
+// UART queries are pipelined.
+
+#define MQTT_CMD_MAX_BATCH  3
+#define MQTT_CMD_HASH_SIZE  8
+
+_Static_assert(MQTT_CMD_MAX_BATCH <= CMD_DEDUP_MAX_RESULTS, "dedup cache can't hold a full batch");
+_Static_assert(MQTT_CMD_MAX_BATCH <= CMD_MAX_IN_FLIGHT, "a full batch could never be admitted");
+_Static_assert(MQTT_CMD_MAX_BATCH <= CMD_MOTION_BURST, "a batch of moves could never be admitted");
+
+typedef enum {
+    MQTT_CMD_STATUS,
+    MQTT_CMD_RESET,
+    MQTT_CMD_ESTOP,
+    MQTT_CMD_FLOOR,
+} mqtt_cmd_t;
+
+typedef struct {
+    const char *name;
+    uint8_t name_len;
+    bool takes_arg;
+    mqtt_cmd_t cmd;
+} mqtt_cmd_entry_t;
+
+typedef struct {
+    mqtt_cmd_t cmd;
+    uint8_t arg;
+} mqtt_cmd_parsed_t;
+
+// UART command behind each MQTT command (e-stop is not a query)
+static const uint8_t mqtt_cmd_ids[] = {
+    [MQTT_CMD_STATUS] = CMD_GET_STATUS,
+    [MQTT_CMD_RESET]  = CMD_RESET,
+    [MQTT_CMD_ESTOP]  = CMD_NOP,
+    [MQTT_CMD_FLOOR]  = CMD_MOVE_TO_FLOOR,
+};
+
+static inline char ascii_lower(char c)
+{
+    return (c >= 'A' && c <= 'Z') ? (char)(c + ('a' - 'A')) : c;
+}
+
+// Perfect hash over the command names: (first char ^ length) & 7 gives
+// estop=0, floor=3, status=5, reset=7. Keep it collision free when adding.
+static inline uint8_t mqtt_cmd_hash(const char *name, int len)
+{
+    return (uint8_t)((ascii_lower(name[0]) ^ len) & (MQTT_CMD_HASH_SIZE - 1));
+}
+
+static const mqtt_cmd_entry_t mqtt_cmd_table[MQTT_CMD_HASH_SIZE] = {
+    [0] = { "estop",  5, false, MQTT_CMD_ESTOP  },
+    [3] = { "floor",  5, true,  MQTT_CMD_FLOOR  },
+    [5] = { "status", 6, false, MQTT_CMD_STATUS },
+    [7] = { "reset",  5, false, MQTT_CMD_RESET  },
+};
+
+static const mqtt_cmd_entry_t *mqtt_cmd_lookup(const char *name, int len)
+{
+    if (len <= 0) {
+        return NULL;
+    }
+    const mqtt_cmd_entry_t *entry = &mqtt_cmd_table[mqtt_cmd_hash(name, len)];
+    if (entry->name == NULL || entry->name_len != len) {
+        return NULL;
+    }
+    for (int i = 0; i < len; i++) {
+        if (ascii_lower(name[i]) != entry->name[i]) {
+            return NULL;
+        }
+    }
+    return entry;
+}
+
+// Strict 0..255 decimal: digits only, no sign, no whitespace
+static bool parse_u8(const char *s, int len, uint8_t *out)
+{
+    if (len <= 0 || len > 3) {
+        return false;
     }
-    else if (strncmp(payload, "floor:", 6) == 0 && len > 6) {
-        // Parse floor number: "floor:2"
-        int floor = atoi(payload + 6);
-        MaxComm_SendMoveToFloor((uint8_t)floor);
+    unsigned value = 0;
+    for (int i = 0; i < len; i++) {
+        if (s[i] < '0' || s[i] > '9') {
+            return false;
+        }
+        value = value * 10 + (unsigned)(s[i] - '0');
     }
-    else {
-        ESP_LOGW(TAG, "Unknown MQTT command: %.*s", len, payload);
+    if (value > 255) {
+        return false;
+    }
+    *out = (uint8_t)value;
+    return true;
+}
+
+static bool parse_mqtt_cmd(const char *token, int len, mqtt_cmd_parsed_t *out)
+{
+    const char *colon = memchr(token, ':', len);
+    int name_len = colon ? (int)(colon - token) : len;
+
+    const mqtt_cmd_entry_t *entry = mqtt_cmd_lookup(token, name_len);
+    if (entry == NULL || entry->takes_arg != (colon != NULL)) {
+        return false;
+    }
+
+    out->cmd = entry->cmd;
+    out->arg = 0;
+    if (colon) {
+        return parse_u8(colon + 1, len - name_len - 1, &out->arg);
+    }
+    return true;
+}
+
+static void execute_mqtt_cmd(const mqtt_cmd_parsed_t *cmd, const cmd_target_t *target)
+{
+    int64_t now = esp_timer_get_time();
+    elevator_state_t state;
+    uint8_t cmd_id = mqtt_cmd_ids[cmd->cmd];
+
+    // Answered without a UART query
+    if (cmd->cmd == MQTT_CMD_ESTOP) {
+        bool sent = MaxComm_SendEstop();
+        cmd_complete(target, sent ? APP_EVT_CMD_OK : APP_EVT_CMD_ERR, 0, NULL, 0, now);
+        return;
+    }
+    if (cmd->cmd == MQTT_CMD_STATUS) {
+        if (status_from_cache(&state)) {
+            uint8_t values[] = { state.floor, state.direction, state.dest_bitmask };
+            publish_status(state.floor, state.direction, state.dest_bitmask, state.updated_us);
+            cmd_complete(target, APP_EVT_STATUS, 0, values, sizeof(values), state.updated_us);
+        } else if (!query_status(target)) {
+            cmd_complete(target, APP_EVT_CMD_ERR, cmd_id, NULL, 0, now);
+        }
+        return;
+    }
+
+    void *ctx = pending_reply_add(target);
+
+    bool sent = false;
+    switch (cmd->cmd) {
+        case MQTT_CMD_RESET: sent = send_cmd(CMD_RESET, NULL, 0, ctx);              break;
+        case MQTT_CMD_FLOOR: sent = send_cmd(CMD_MOVE_TO_FLOOR, &cmd->arg, 1, ctx); break;
+        default:                                                                    break;
+    }
+
+    if (!sent) {
+        pending_reply_take(ctx, NULL);
+        cmd_complete(target, APP_EVT_CMD_ERR, cmd_id, NULL, 0, now);
+    }
+}
+
+// A cached result on <events>/cmd_result/replay/<id>, so cmd_result
+// subscribers don't mistake it for a second execution
+static void publish_cmd_replay(const char *id, int id_len, const cmd_result_t *r, int64_t timestamp_us)
+{
+    app_event_t evt;
+    make_event(&evt, (app_event_kind_t)r->kind, r->code, r->values, r->value_count, timestamp_us);
+
+    for (size_t i = 0; i < EVENT_SINK_COUNT; i++) {
+        event_sink_t *sink = &event_sinks[i];
+        uint8_t item[EVENT_ITEM_MAX_LEN];
+        size_t len = event_encode(sink->format, &evt, item, sizeof(item));
+        if (len == 0) {
+            continue;
+        }
+
+        char topic[EVENT_TOPIC_MAX_LEN + CMD_ID_MAX_LEN + 8];
+        int n = snprintf(topic, sizeof(topic), "%s/replay/%.*s", sink->topics[ROUTE_CMD], id_len, id);
+        if (n < 0 || n >= (int)sizeof(topic)) {
+            continue;
+        }
+        mqtt_publish(topic, item, (int)len, event_routes[ROUTE_CMD].qos, event_routes[ROUTE_CMD].retain);
+    }
+}
+
+// Answer a duplicate with the results of the first copy: to the requester
+// alone when it gave a response topic, else on the shared event stream
+static void replay_cached_results(const dedup_entry_t *entry, const char *id, int id_len,
+                                  const mqtt_reply_t *reply)
+{
+    int64_t now = esp_timer_get_time();
+    for (uint8_t i = 0; i < entry->cmd_count; i++) {
+        const cmd_result_t *r = &entry->results[i];
+        if (reply) {
+            send_reply(reply, (app_event_kind_t)r->kind, r->code, r->values, r->value_count, now);
+        } else {
+            publish_cmd_replay(id, id_len, r, now);
+        }
+    }
+}
+
+// Optional "<id>@" prefix; returns the id length (0 if none, -1 if invalid)
+static int parse_cmd_id(const char *payload, int len)
+{
+    int scan = len < CMD_ID_MAX_LEN + 1 ? len : CMD_ID_MAX_LEN + 1;
+    const char *at = memchr(payload, '@', scan);
+    if (at == NULL) {
+        return 0;
+    }
+
+    int id_len = (int)(at - payload);
+    if (id_len == 0) {
+        return -1;
+    }
+    for (int i = 0; i < id_len; i++) {
+        char c = payload[i];
+        bool ok = (c >= '0' && c <= '9') || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+                  c == '-' || c == '_';
+        if (!ok) {
+            return -1;
+        }
+    }
+    return id_len;
+}
+
+void MaxComm_OnMqttCommand(const char *payload, int len, const mqtt_reply_t *reply)
+{
+    ESP_LOGD(TAG, "MQTT cmd: %.*s", len, payload);
+    wifi_note_activity(WIFI_POWER_EVT_COMMAND);
+
+    const char *id = payload;
+    int id_len = parse_cmd_id(payload, len);
+    if (id_len < 0) {
+        ESP_LOGW(TAG, "Invalid command id");
+        return;
+    }
+    if (id_len > 0) {
+        payload += id_len + 1;
+        len -= id_len + 1;
+    }
+
+    mqtt_cmd_parsed_t batch[MQTT_CMD_MAX_BATCH];
+    int count = 0;
+
+    const char *p = payload;
+    const char *end = payload + len;
+    while (p < end) {
+        const char *sep = memchr(p, ';', end - p);
+        const char *token_end = sep ? sep : end;
+
+        if (count == MQTT_CMD_MAX_BATCH) {
+            ESP_LOGW(TAG, "MQTT batch too long (max %d)", MQTT_CMD_MAX_BATCH);
+            return;
+        }
+        if (!parse_mqtt_cmd(p, (int)(token_end - p), &batch[count])) {
+            ESP_LOGW(TAG, "Unknown MQTT command: %.*s", (int)(token_end - p), p);
+            return;
+        }
+        count++;
+
+        p = sep ? sep + 1 : end;
+        if (sep && p == end) {
+            ESP_LOGW(TAG, "Empty command after ';'");
+            return;
+        }
+    }
+
+    if (count == 0) {
+        ESP_LOGW(TAG, "Empty MQTT command");
+        return;
+    }
+
+    cmd_target_t target;
+    cmd_target_init(&target, reply);
+
+    if (id_len > 0) {
+        int slot = -1;
+        uint16_t gen = 0;
+        dedup_entry_t cached;
+        switch (dedup_check(id, (uint8_t)id_len, (uint8_t)count, &slot, &gen, &cached)) {
+            case DEDUP_DONE:
+                ESP_LOGI(TAG, "Duplicate command id %.*s, replaying results", id_len, id);
+                replay_cached_results(&cached, id, id_len, reply);
+                return;
+            case DEDUP_IN_PROGRESS:
+                ESP_LOGI(TAG, "Duplicate command id %.*s still running, dropped", id_len, id);
+                return;
+            case DEDUP_NEW:
+                target.dedup_slot = (int8_t)slot;
+                target.dedup_gen = gen;
+                break;
+        }
+    }
+
+    uint8_t class_counts[CMD_CLASS_COUNT] = { 0 };
+    int queries = 0;
+    for (int i = 0; i < count; i++) {
+        if (batch[i].cmd != MQTT_CMD_ESTOP) {
+            class_counts[cmd_class_for(mqtt_cmd_ids[batch[i].cmd])]++;
+            queries++;
+        }
+    }
+    bool admitted = queries == 0 || cmd_admit(class_counts, queries);
+    if (!admitted && target.dedup_slot >= 0) {
+        dedup_forget(target.dedup_slot, target.dedup_gen);  // let a retry run
+        target.dedup_slot = -1;
+    }
+
+    for (int i = 0; i < count; i++) {
+        target.dedup_index = (uint8_t)i;
+        if (batch[i].cmd == MQTT_CMD_ESTOP) {
+            admission_stats.estop_bypass++;
+            execute_mqtt_cmd(&batch[i], &target);
+        } else if (admitted) {
+            execute_mqtt_cmd(&batch[i], &target);
+        } else {
+            reject_busy(mqtt_cmd_ids[batch[i].cmd], reply);
+        }
+    }
+}
+
+// === MQTT binary command passthrough ===
+// Payload: 1..MQTT_CMD_MAX_BATCH encoded cmd_request_t records
+// (PROTO_WIRE_SIZE_cmd_request bytes each, layout from protocol.h). Each
+// record is bounds-checked in place and handed to the UART TX path as-is,
+// so new commands only need the MAX32655 firmware and the schema.
+
+static void reply_binary_error(const mqtt_reply_t *reply, const uint8_t *records, int count,
+                               uint8_t status)
+{
+    int64_t now = esp_timer_get_time();
+    for (int i = 0; i < count; i++) {
+        send_reply(reply, APP_EVT_CMD_ERR, records[i * PROTO_WIRE_SIZE_cmd_request], &status, 1, now);
+    }
+}
+
+void MaxComm_OnMqttBinaryCommand(const char *topic, int topic_len, const char *payload, int len,
+                                 const mqtt_reply_t *reply, void *ctx)
+{
+    (void)topic;
+    (void)topic_len;
+    (void)ctx;
+
+    const uint8_t *records = (const uint8_t *)payload;
+    int count = len / PROTO_WIRE_SIZE_cmd_request;
+
+    wifi_note_activity(WIFI_POWER_EVT_COMMAND);
+
+    if (len <= 0 || len % PROTO_WIRE_SIZE_cmd_request != 0 || count > MQTT_CMD_MAX_BATCH) {
+        ESP_LOGW(TAG, "Binary cmd: bad length %d", len);
+        return;
+    }
+
+    uint8_t class_counts[CMD_CLASS_COUNT] = { 0 };
+    for (int i = 0; i < count; i++) {
+        const uint8_t *rec = &records[i * PROTO_WIRE_SIZE_cmd_request];
+        if (!proto_check_cmd_request(rec, PROTO_WIRE_SIZE_cmd_request)) {
+            ESP_LOGW(TAG, "Binary cmd: invalid record %d (cmd=%d)", i, rec[0]);
+            reply_binary_error(reply, records, count, CMD_ERR_INVALID);
+            return;
+        }
+        class_counts[cmd_class_for(rec[offsetof(cmd_request_t, cmd_id)])]++;
+    }
+
+    if (!cmd_admit(class_counts, count)) {
+        for (int i = 0; i < count; i++) {
+            reject_busy(records[i * PROTO_WIRE_SIZE_cmd_request], reply);
+        }
+        return;
+    }
+
+    int64_t now = esp_timer_get_time();
+    cmd_target_t target;
+    cmd_target_init(&target, reply);
+
+    for (int i = 0; i < count; i++) {
+        const uint8_t *rec = &records[i * PROTO_WIRE_SIZE_cmd_request];
+        uint8_t cmd_id = rec[offsetof(cmd_request_t, cmd_id)];
+
+        void *ctx = pending_reply_add(&target);
+        if (!protocol_send_cmd_wire(rec, PROTO_WIRE_SIZE_cmd_request, ctx)) {
+            uint8_t status = CMD_ERR_UNKNOWN;
+            pending_reply_take(ctx, NULL);
+            cmd_complete(&target, APP_EVT_CMD_ERR, cmd_id, &status, 1, now);
+        }
     }
 }
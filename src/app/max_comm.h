@@ -3,11 +3,39 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include "protocol.h"
+#include "comm/mqtt_util.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+// Cached elevator state (maintained from MAX32655 events + periodic CMD_GET_STATUS)
+typedef struct {
+    bool valid;               // floor/direction/dest known (cleared on link loss)
+    uint8_t floor;
+    uint8_t direction;        // 0 = stopped, 1 = up, 2 = down
+    uint8_t dest_bitmask;     // pending cabin destinations (bit per floor)
+    uint8_t call_bitmask;     // pending call buttons (bit per call_button_t)
+    bool estop;
+    int64_t updated_us;       // esp_timer time of last change
+    int64_t reconciled_us;    // esp_timer time of last CMD_GET_STATUS reply
+} elevator_state_t;
+
+// Command classes for MQTT command admission control
+typedef enum {
+    CMD_CLASS_QUERY,          // read-only (status)
+    CMD_CLASS_MOTION,         // moves the cabin
+    CMD_CLASS_ADMIN,          // reset
+    CMD_CLASS_COUNT
+} cmd_class_t;
+
+typedef struct {
+    uint32_t admitted[CMD_CLASS_COUNT];
+    uint32_t rejected_rate[CMD_CLASS_COUNT];  // class token bucket empty
+    uint32_t rejected_in_flight;              // UART query cap reached
+    uint32_t estop_bypass;                    // e-stops let through unconditionally
+} cmd_admission_stats_t;
+
 // Initialize MAX32655 communication (transport + protocol layers)
 void MaxComm_Init(void);
 
@@ -22,8 +50,23 @@ bool MaxComm_SendMoveToFloor(uint8_t floor);
 bool MaxComm_SendGetStatus(void);
 bool MaxComm_SendReset(void);
 
-// MQTT command callback (call this from MQTT handler)
-void MaxComm_OnMqttCommand(const char *payload, int len);
+// Snapshot of the cached elevator state
+void MaxComm_GetState(elevator_state_t *state);
+
+// Publish status from the cache if fresh, otherwise query the MAX32655
+bool MaxComm_RequestStatus(void);
+
+// Admission control counters for inbound MQTT commands
+void MaxComm_GetAdmissionStats(cmd_admission_stats_t *stats);
+
+// MQTT command callback (call this from MQTT handler). With an MQTT 5
+// reply target, each command's result is also published to it.
+void MaxComm_OnMqttCommand(const char *payload, int len, const mqtt_reply_t *reply);
+
+// Binary command topic handler (mqtt_topic_handler_t): payload is one or
+// more encoded cmd_request_t, forwarded to the MAX32655 after bounds checks
+void MaxComm_OnMqttBinaryCommand(const char *topic, int topic_len, const char *payload, int len,
+                                 const mqtt_reply_t *reply, void *ctx);
 
 #ifdef __cplusplus
 }
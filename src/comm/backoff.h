@@ -0,0 +1,25 @@
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Exponential backoff with equal jitter: min_ms doubled per attempt (0 =
+// first retry) up to max_ms, then half of that fixed and the rest random,
+// so devices dropped by the same outage don't retry in step. Shared by the
+// MQTT reconnect and the WiFi supervisor.
+static inline uint32_t backoff_delay_ms(uint32_t min_ms, uint32_t max_ms, uint8_t attempt,
+                                        uint32_t random)
+{
+    uint32_t delay_ms = min_ms < max_ms ? min_ms : max_ms;
+    for (uint8_t i = 0; i < attempt && delay_ms < max_ms; i++) {
+        delay_ms = (delay_ms > max_ms / 2) ? max_ms : delay_ms * 2;
+    }
+    return delay_ms / 2 + random % (delay_ms / 2 + 1);
+}
+
+#ifdef __cplusplus
+}
+#endif
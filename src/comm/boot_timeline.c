@@ -0,0 +1,217 @@
+// Start-up timeline recorder
+
+#include "comm/boot_timeline.h"
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_attr.h"
+#include "esp_system.h"
+#include "esp_timer.h"
+#include "esp_rom_crc.h"
+#include "esp_log.h"
+#include "nvs.h"
+
+static const char *TAG = "BOOT_TL";
+
+#define STORE_MAGIC     0x544C4E31u     // "TLN1"
+#define NVS_NAMESPACE   "boot_tl"
+
+#define BOOT_TL_GEN_KEY(name, key)      key,
+
+static const char *const point_keys[BOOT_TL_COUNT] = {
+    BOOT_TIMELINE_POINTS(BOOT_TL_GEN_KEY)
+};
+
+// Completed timelines, history[(head - 1) % N] is the newest
+typedef struct {
+    uint32_t magic;
+    uint32_t boot_count;
+    uint8_t head;
+    uint8_t count;
+    boot_timeline_t history[BOOT_TIMELINE_HISTORY];
+    uint32_t crc;
+} timeline_store_t;
+
+RTC_NOINIT_ATTR static timeline_store_t s_store;
+
+static portMUX_TYPE s_lock = portMUX_INITIALIZER_UNLOCKED;
+static boot_timeline_t s_current;
+static bool s_rtc_valid = false;
+static bool s_done = false;
+static esp_timer_handle_t s_timer = NULL;
+static boot_timeline_done_cb s_on_done = NULL;
+
+static uint32_t store_crc(const timeline_store_t *store)
+{
+    return esp_rom_crc32_le(0, (const uint8_t *)store, offsetof(timeline_store_t, crc));
+}
+
+static bool store_valid(const timeline_store_t *store)
+{
+    return store->magic == STORE_MAGIC && store->count <= BOOT_TIMELINE_HISTORY &&
+           store->head < BOOT_TIMELINE_HISTORY && store->crc == store_crc(store);
+}
+
+// After a power cycle RTC memory is garbage: fall back to the NVS copy
+static void store_load_nvs(void)
+{
+    nvs_handle_t nvs;
+    timeline_store_t loaded;
+    size_t len = sizeof(loaded);
+
+    if (nvs_open(NVS_NAMESPACE, NVS_READONLY, &nvs) != ESP_OK) {
+        return;
+    }
+    if (nvs_get_blob(nvs, "history", &loaded, &len) == ESP_OK && len == sizeof(loaded) &&
+        store_valid(&loaded)) {
+        s_store = loaded;
+    }
+    nvs_close(nvs);
+}
+
+static void store_save_nvs(void)
+{
+    nvs_handle_t nvs;
+    if (nvs_open(NVS_NAMESPACE, NVS_READWRITE, &nvs) != ESP_OK) {
+        return;
+    }
+    nvs_set_blob(nvs, "history", &s_store, sizeof(s_store));
+    nvs_commit(nvs);
+    nvs_close(nvs);
+}
+
+static void finish(void *arg)
+{
+    (void)arg;
+
+    boot_timeline_t timeline;
+    portENTER_CRITICAL(&s_lock);
+    if (s_done) {
+        portEXIT_CRITICAL(&s_lock);
+        return;
+    }
+    s_done = true;
+    timeline = s_current;
+    portEXIT_CRITICAL(&s_lock);
+
+    // NVS is up by now (or never will be this boot)
+    if (!s_rtc_valid) {
+        store_load_nvs();
+        if (!store_valid(&s_store)) {
+            memset(&s_store, 0, sizeof(s_store));
+            s_store.magic = STORE_MAGIC;
+        }
+    }
+    portENTER_CRITICAL(&s_lock);
+    timeline.boot_count = ++s_store.boot_count;
+    s_store.history[s_store.head] = timeline;
+    s_store.head = (uint8_t)((s_store.head + 1) % BOOT_TIMELINE_HISTORY);
+    if (s_store.count < BOOT_TIMELINE_HISTORY) {
+        s_store.count++;
+    }
+    s_store.crc = store_crc(&s_store);
+    portEXIT_CRITICAL(&s_lock);
+    store_save_nvs();
+
+    char summary[320];
+    if (boot_timeline_format(&timeline, summary, sizeof(summary)) > 0) {
+        ESP_LOGI(TAG, "%s", summary);
+    }
+
+    if (s_on_done) {
+        s_on_done(&timeline);
+    }
+}
+
+void boot_timeline_start(boot_timeline_done_cb on_done)
+{
+    s_on_done = on_done;
+    s_rtc_valid = store_valid(&s_store);
+    memset(&s_current, 0, sizeof(s_current));
+    s_current.reset_reason = (uint8_t)esp_reset_reason();
+
+    const esp_timer_create_args_t timer_args = {
+        .callback = finish,
+        .name = "boot_timeline",
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&timer_args, &s_timer));
+    ESP_ERROR_CHECK(esp_timer_start_once(s_timer, BOOT_TIMELINE_DEADLINE_MS * 1000ULL));
+
+    boot_timeline_mark(BOOT_TL_APP_MAIN);
+}
+
+void boot_timeline_mark(boot_tl_point_t point)
+{
+    // Cheap exit: most marks sit on paths that run for the whole uptime
+    if ((unsigned)point >= BOOT_TL_COUNT || s_done || s_current.ms[point] != 0) {
+        return;
+    }
+
+    uint32_t ms = (uint32_t)(esp_timer_get_time() / 1000);
+    if (ms == 0) {
+        ms = 1;     // 0 means not reached
+    }
+
+    bool complete = false;
+    portENTER_CRITICAL(&s_lock);
+    if (!s_done && s_current.ms[point] == 0) {
+        s_current.ms[point] = ms;
+        complete = s_current.ms[BOOT_TL_MQTT_CONNACK] != 0 && s_current.ms[BOOT_TL_MAX_HEARTBEAT] != 0;
+    }
+    portEXIT_CRITICAL(&s_lock);
+
+    // Finish from the timer task, not the caller's (MQTT / UART) context
+    if (complete && s_timer) {
+        esp_timer_stop(s_timer);
+        esp_timer_start_once(s_timer, 0);
+    }
+}
+
+int boot_timeline_history(boot_timeline_t *out, int max)
+{
+    int n = 0;
+
+    portENTER_CRITICAL(&s_lock);
+    if (store_valid(&s_store)) {
+        for (; n < max && n < s_store.count; n++) {
+            int idx = (s_store.head + BOOT_TIMELINE_HISTORY - 1 - n) % BOOT_TIMELINE_HISTORY;
+            out[n] = s_store.history[idx];
+        }
+    }
+    portEXIT_CRITICAL(&s_lock);
+
+    return n;
+}
+
+size_t boot_timeline_format(const boot_timeline_t *timeline, char *buf, size_t cap)
+{
+    size_t len = 0;
+    int n = snprintf(buf, cap, "{\"boot\":%lu,\"reset\":%d,\"ms\":{",
+                     (unsigned long)timeline->boot_count, timeline->reset_reason);
+    if (n < 0 || (size_t)n >= cap) {
+        return 0;
+    }
+    len = (size_t)n;
+
+    bool first = true;
+    for (int i = 0; i < BOOT_TL_COUNT; i++) {
+        if (timeline->ms[i] == 0) {
+            continue;
+        }
+        n = snprintf(&buf[len], cap - len, "%s\"%s\":%lu", first ? "" : ",",
+                     point_keys[i], (unsigned long)timeline->ms[i]);
+        if (n < 0 || (size_t)n >= cap - len) {
+            return 0;
+        }
+        len += (size_t)n;
+        first = false;
+    }
+
+    if (len + 3 > cap) {
+        return 0;
+    }
+    buf[len++] = '}';
+    buf[len++] = '}';
+    buf[len] = '\0';
+    return len;
+}
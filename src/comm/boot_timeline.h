@@ -0,0 +1,66 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Start-up timeline: esp_timer time (ms since reset) at which each named
+// point was first reached. A boot is complete once the broker accepted the
+// connection and the MAX32655 answered a heartbeat, or after
+// BOOT_TIMELINE_DEADLINE_MS. The last BOOT_TIMELINE_HISTORY completed
+// timelines are kept in RTC memory (survives resets) and NVS (survives
+// power cycles).
+
+// X(NAME, json_key)
+#define BOOT_TIMELINE_POINTS(X) \
+    X(APP_MAIN,         "app_main") \
+    X(NVS_READY,        "nvs") \
+    X(UART_READY,       "uart") \
+    X(UART_FIRST_RX,    "uart_rx")    /* first byte from the MAX32655 */ \
+    X(MAX_HEARTBEAT,    "max_hb")     /* first heartbeat reply */ \
+    X(WIFI_START,       "wifi_start") \
+    X(WIFI_ASSOC,       "wifi_assoc") \
+    X(WIFI_GOT_IP,      "wifi_ip") \
+    X(MQTT_START,       "mqtt_start") \
+    X(MQTT_CONNACK,     "mqtt_connack") \
+    X(FIRST_PUBLISH,    "first_pub") \
+    X(BOOT_GRAPH_DONE,  "graph_done")
+
+#define BOOT_TL_GEN_ENUM(name, key)     BOOT_TL_##name,
+
+typedef enum {
+    BOOT_TIMELINE_POINTS(BOOT_TL_GEN_ENUM)
+    BOOT_TL_COUNT
+} boot_tl_point_t;
+
+#define BOOT_TIMELINE_HISTORY       4
+#define BOOT_TIMELINE_DEADLINE_MS   60000
+
+typedef struct {
+    uint32_t boot_count;
+    uint8_t reset_reason;           // esp_reset_reason_t
+    uint32_t ms[BOOT_TL_COUNT];     // 0 = not reached
+} boot_timeline_t;
+
+typedef void (*boot_timeline_done_cb)(const boot_timeline_t *timeline);
+
+// Start recording (first thing in app_main); on_done runs once from the
+// esp_timer task when the boot is complete
+void boot_timeline_start(boot_timeline_done_cb on_done);
+
+// Record the first time point is reached (any task)
+void boot_timeline_mark(boot_tl_point_t point);
+
+// Completed timelines, newest first; returns the number written
+int boot_timeline_history(boot_timeline_t *out, int max);
+
+// Compact JSON: {"boot":N,"reset":R,"ms":{"app_main":312,...}}
+size_t boot_timeline_format(const boot_timeline_t *timeline, char *buf, size_t cap);
+
+#ifdef __cplusplus
+}
+#endif
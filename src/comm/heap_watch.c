@@ -0,0 +1,103 @@
+// Steady-state heap allocation counter (see heap_watch.h)
+
+#include "comm/heap_watch.h"
+#include <stddef.h>
+#include "sdkconfig.h"
+#include "esp_attr.h"
+#include "esp_log.h"
+
+static const char *TAG = "HEAP_WATCH";
+
+typedef struct {
+    TaskHandle_t task;
+    const char *name;
+    uint32_t allocs;
+    uint32_t bytes;
+    uint32_t reported;              // allocs at the last heap_watch_check()
+} watched_t;
+
+static watched_t watched[HEAP_WATCH_MAX_TASKS];
+static int watched_count = 0;
+static bool armed = false;
+static portMUX_TYPE watch_lock = portMUX_INITIALIZER_UNLOCKED;
+
+void heap_watch_task(TaskHandle_t task, const char *name)
+{
+    portENTER_CRITICAL(&watch_lock);
+    if (watched_count < HEAP_WATCH_MAX_TASKS) {
+        watched[watched_count].task = task;
+        watched[watched_count].name = name;
+        __atomic_store_n(&watched_count, watched_count + 1, __ATOMIC_RELEASE);
+    }
+    portEXIT_CRITICAL(&watch_lock);
+}
+
+void heap_watch_arm(void)
+{
+    portENTER_CRITICAL(&watch_lock);
+    for (int i = 0; i < watched_count; i++) {
+        watched[i].allocs = 0;
+        watched[i].bytes = 0;
+        watched[i].reported = 0;
+    }
+    __atomic_store_n(&armed, true, __ATOMIC_RELEASE);
+    portEXIT_CRITICAL(&watch_lock);
+}
+
+bool heap_watch_armed(void)
+{
+    return __atomic_load_n(&armed, __ATOMIC_ACQUIRE);
+}
+
+int heap_watch_get(heap_watch_entry_t *out, int max)
+{
+    int count = __atomic_load_n(&watched_count, __ATOMIC_ACQUIRE);
+    if (count > max) {
+        count = max;
+    }
+    for (int i = 0; i < count; i++) {
+        out[i].name = watched[i].name;
+        out[i].allocs = __atomic_load_n(&watched[i].allocs, __ATOMIC_RELAXED);
+        out[i].bytes = __atomic_load_n(&watched[i].bytes, __ATOMIC_RELAXED);
+    }
+    return count;
+}
+
+uint32_t heap_watch_check(void)
+{
+    uint32_t total = 0;
+    int count = __atomic_load_n(&watched_count, __ATOMIC_ACQUIRE);
+
+    for (int i = 0; i < count; i++) {
+        uint32_t allocs = __atomic_load_n(&watched[i].allocs, __ATOMIC_RELAXED);
+        total += allocs;
+        if (allocs != watched[i].reported) {
+            ESP_LOGW(TAG, "%s: %lu heap allocations (%lu bytes) since boot", watched[i].name,
+                     (unsigned long)allocs, (unsigned long)__atomic_load_n(&watched[i].bytes, __ATOMIC_RELAXED));
+            watched[i].reported = allocs;
+        }
+    }
+    return total;
+}
+
+#if CONFIG_HEAP_USE_HOOKS
+// Runs inside every heap allocation, possibly with the cache disabled: no
+// locks, no logging, no heap
+void IRAM_ATTR esp_heap_trace_alloc_hook(void *ptr, size_t size, uint32_t caps)
+{
+    (void)caps;
+    if (ptr == NULL || !__atomic_load_n(&armed, __ATOMIC_ACQUIRE) || xPortInIsrContext()) {
+        return;
+    }
+
+    TaskHandle_t self = xTaskGetCurrentTaskHandle();
+    int count = __atomic_load_n(&watched_count, __ATOMIC_ACQUIRE);
+    for (int i = 0; i < count; i++) {
+        if (watched[i].task == self) {
+            __atomic_fetch_add(&watched[i].allocs, 1, __ATOMIC_RELAXED);
+            __atomic_fetch_add(&watched[i].bytes, (uint32_t)size, __ATOMIC_RELAXED);
+            return;
+        }
+    }
+}
+#endif
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Heap allocation counter for the steady state. With CONFIG_HEAP_USE_HOOKS
+// ESP-IDF calls esp_heap_trace_alloc_hook() on every allocation; once
+// armed, allocations made by a watched task are counted per task. The app's
+// long-lived tasks are watched from task_create(), so with
+// STATIC_MEMORY_MODE the counters of the event path (UART frame -> MQTT
+// publish) are expected to stay at zero. Without the hooks they always are.
+
+#define HEAP_WATCH_MAX_TASKS    16
+
+typedef struct {
+    const char *name;
+    uint32_t allocs;
+    uint32_t bytes;
+} heap_watch_entry_t;
+
+// Count allocations made by this task (before heap_watch_arm)
+void heap_watch_task(TaskHandle_t task, const char *name);
+
+// Start counting, from zero (end of the boot)
+void heap_watch_arm(void);
+
+bool heap_watch_armed(void);
+
+// Counters of the watched tasks; returns the number written
+int heap_watch_get(heap_watch_entry_t *out, int max);
+
+// Warn once per task about allocations since the last check; returns
+// the total number of allocations since heap_watch_arm()
+uint32_t heap_watch_check(void);
+
+#ifdef __cplusplus
+}
+#endif
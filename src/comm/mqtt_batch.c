@@ -0,0 +1,130 @@
+// Time-window batching of outbound MQTT events
+
+#include "comm/mqtt_batch.h"
+#include "comm/mqtt_util.h"
+#include <string.h>
+#include "esp_log.h"
+
+static const char *TAG = "MQTT_BATCH";
+
+// Caller holds batch->lock
+static void flush_locked(mqtt_batch_t *batch)
+{
+    if (batch->count == 0) {
+        return;
+    }
+
+    esp_timer_stop(batch->window_timer);
+
+    const mqtt_batch_framing_t *framing = batch->config.framing;
+    framing->frame(batch->buf, batch->len, batch->count);
+    size_t total = batch->len + framing->footer_len;
+
+    if (mqtt_publish(batch->config.topic, batch->buf, (int)total,
+                     batch->config.qos, batch->config.retain)) {
+        batch->stats.messages++;
+    } else {
+        batch->stats.publish_failed++;
+    }
+
+    batch->len = 0;
+    batch->count = 0;
+}
+
+static void window_timer_cb(void *arg)
+{
+    mqtt_batch_t *batch = (mqtt_batch_t *)arg;
+
+    xSemaphoreTake(batch->lock, portMAX_DELAY);
+    if (batch->count > 0) {
+        batch->stats.flush_window++;
+        flush_locked(batch);
+    }
+    xSemaphoreGive(batch->lock);
+}
+
+void mqtt_batch_init(mqtt_batch_t *batch, const mqtt_batch_config_t *config)
+{
+    memset(batch, 0, sizeof(*batch));
+    batch->config = *config;
+
+    batch->lock = xSemaphoreCreateMutexStatic(&batch->lock_buf);
+
+    const esp_timer_create_args_t timer_args = {
+        .callback = window_timer_cb,
+        .arg = batch,
+        .name = "mqtt_batch",
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&timer_args, &batch->window_timer));
+
+    ESP_LOGI(TAG, "'%s': batching %s (window=%lums, max=%d)", config->topic,
+             config->window_ms ? "on" : "off",
+             (unsigned long)config->window_ms, config->max_events);
+}
+
+bool mqtt_batch_add(mqtt_batch_t *batch, const uint8_t *item, size_t len, bool urgent)
+{
+    const mqtt_batch_config_t *cfg = &batch->config;
+    const mqtt_batch_framing_t *framing = cfg->framing;
+
+    xSemaphoreTake(batch->lock, portMAX_DELAY);
+    batch->stats.events++;
+
+    if (cfg->window_ms == 0 || cfg->max_events <= 1) {
+        bool ok = mqtt_publish(cfg->topic, item, (int)len, cfg->qos, cfg->retain);
+        if (ok) {
+            batch->stats.messages++;
+        } else {
+            batch->stats.publish_failed++;
+        }
+        xSemaphoreGive(batch->lock);
+        return ok;
+    }
+
+    size_t lead = (batch->count == 0) ? framing->header_len : framing->separator_len;
+    if (batch->count > 0 && batch->len + lead + len + framing->footer_len > sizeof(batch->buf)) {
+        batch->stats.flush_full++;
+        flush_locked(batch);
+        lead = framing->header_len;
+    }
+    if (batch->len + lead + len + framing->footer_len > sizeof(batch->buf)) {
+        xSemaphoreGive(batch->lock);
+        return false;
+    }
+
+    if (batch->count == 0) {
+        batch->len = framing->header_len;   // filled in by frame()
+    } else if (framing->separator_len) {
+        batch->buf[batch->len++] = framing->separator;
+    }
+    memcpy(&batch->buf[batch->len], item, len);
+    batch->len += len;
+    batch->count++;
+
+    if (urgent) {
+        batch->stats.flush_urgent++;
+        flush_locked(batch);
+    } else if (batch->count >= cfg->max_events) {
+        batch->stats.flush_full++;
+        flush_locked(batch);
+    } else if (batch->count == 1) {
+        esp_timer_start_once(batch->window_timer, cfg->window_ms * 1000ULL);
+    }
+
+    xSemaphoreGive(batch->lock);
+    return true;
+}
+
+void mqtt_batch_flush(mqtt_batch_t *batch)
+{
+    xSemaphoreTake(batch->lock, portMAX_DELAY);
+    flush_locked(batch);
+    xSemaphoreGive(batch->lock);
+}
+
+void mqtt_batch_get_stats(mqtt_batch_t *batch, mqtt_batch_stats_t *stats)
+{
+    xSemaphoreTake(batch->lock, portMAX_DELAY);
+    *stats = batch->stats;
+    xSemaphoreGive(batch->lock);
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_timer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Time-window batching in front of mqtt_util: pre-encoded events are
+// collected for up to window_ms or max_events, then published to the
+// batch's topic as one message. The payload format is opaque here - the
+// framing (array header/footer, separator) comes from the encoder.
+// With batching disabled every item is published on its own, unframed.
+
+#define MQTT_BATCH_BUF_SIZE 512
+
+typedef struct {
+    uint8_t header_len;       // bytes reserved before the first item
+    uint8_t separator_len;    // 0 or 1
+    uint8_t separator;        // written between items
+    uint8_t footer_len;       // bytes reserved after the last item
+    // Fill header at buf[0] and footer at buf[len] once count is known
+    void (*frame)(uint8_t *buf, size_t len, uint8_t count);
+} mqtt_batch_framing_t;
+
+typedef struct {
+    const char *topic;
+    const mqtt_batch_framing_t *framing;
+    uint8_t qos;
+    bool retain;
+    uint32_t window_ms;       // max time an event waits (0 = batching off)
+    uint8_t max_events;       // flush once this many are queued
+} mqtt_batch_config_t;
+
+typedef struct {
+    uint32_t events;          // events accepted
+    uint32_t messages;        // MQTT messages published
+    uint32_t flush_window;    // flushes caused by window expiry
+    uint32_t flush_full;      // ... by max_events / buffer space
+    uint32_t flush_urgent;    // ... by an urgent event
+    uint32_t publish_failed;  // messages mqtt_publish rejected
+} mqtt_batch_stats_t;
+
+// One batch per topic; caller owns the storage
+typedef struct {
+    mqtt_batch_config_t config;
+    SemaphoreHandle_t lock;
+    StaticSemaphore_t lock_buf;
+    esp_timer_handle_t window_timer;
+    uint8_t buf[MQTT_BATCH_BUF_SIZE];
+    size_t len;
+    uint8_t count;
+    mqtt_batch_stats_t stats;
+} mqtt_batch_t;
+
+void mqtt_batch_init(mqtt_batch_t *batch, const mqtt_batch_config_t *config);
+
+// Queue one encoded event. Urgent events (e.g. e-stop) are published at
+// once together with anything queued.
+bool mqtt_batch_add(mqtt_batch_t *batch, const uint8_t *item, size_t len, bool urgent);
+
+// Publish whatever is queued now
+void mqtt_batch_flush(mqtt_batch_t *batch);
+
+void mqtt_batch_get_stats(mqtt_batch_t *batch, mqtt_batch_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,281 @@
+// Store-and-forward outbox for MQTT publishes while disconnected
+
+#include "comm/mqtt_outbox.h"
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/semphr.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+
+static const char *TAG = "OUTBOX";
+
+typedef struct {
+    bool used;
+    uint32_t seq;             // insertion order
+    uint16_t len;
+    uint8_t qos;
+    bool retain;
+    char topic[MQTT_OUTBOX_TOPIC_MAX];
+    uint8_t data[MQTT_OUTBOX_SLOT_DATA];
+} outbox_slot_t;
+
+static outbox_slot_t s_slots[MQTT_OUTBOX_SLOTS];
+static uint32_t s_next_seq = 0;
+static mqtt_outbox_config_t s_config;
+static mqtt_outbox_stats_t s_stats;
+static SemaphoreHandle_t s_lock = NULL;
+static StaticSemaphore_t s_lock_buf;
+static esp_timer_handle_t s_replay_timer = NULL;
+
+// === RAM pool (caller holds s_lock) ===
+
+static uint32_t slot_bytes(const outbox_slot_t *slot)
+{
+    return slot->len + (uint32_t)strlen(slot->topic);
+}
+
+static void remove_slot(outbox_slot_t *slot)
+{
+    s_stats.ram_bytes_used -= slot_bytes(slot);
+    s_stats.ram_entries--;
+    slot->used = false;
+}
+
+// Oldest entry, optionally restricted to one QoS (-1 = any)
+static outbox_slot_t *oldest_slot(int qos)
+{
+    outbox_slot_t *oldest = NULL;
+    for (int i = 0; i < MQTT_OUTBOX_SLOTS; i++) {
+        outbox_slot_t *slot = &s_slots[i];
+        if (slot->used && (qos < 0 || slot->qos == qos) &&
+            (oldest == NULL || (int32_t)(slot->seq - oldest->seq) < 0)) {
+            oldest = slot;
+        }
+    }
+    return oldest;
+}
+
+static outbox_slot_t *free_slot(void)
+{
+    for (int i = 0; i < MQTT_OUTBOX_SLOTS; i++) {
+        if (!s_slots[i].used) {
+            return &s_slots[i];
+        }
+    }
+    return NULL;
+}
+
+static size_t spill_bytes(void)
+{
+    return s_config.spill ? s_config.spill->bytes_used(s_config.spill->ctx) : 0;
+}
+
+// Move the oldest RAM entry to the spill backend. Everything spilled is
+// therefore older than everything still in RAM.
+static bool spill_oldest(void)
+{
+    outbox_slot_t *oldest = oldest_slot(-1);
+    if (!s_config.spill || !oldest) {
+        return false;
+    }
+
+    mqtt_outbox_msg_t msg = {
+        .topic = oldest->topic,
+        .data = oldest->data,
+        .len = oldest->len,
+        .qos = oldest->qos,
+        .retain = oldest->retain,
+    };
+    if (!s_config.spill->append(s_config.spill->ctx, &msg)) {
+        return false;
+    }
+
+    remove_slot(oldest);
+    s_stats.spilled++;
+    return true;
+}
+
+// Make room for one message of the given QoS; false = drop the new message
+static bool make_room(int qos)
+{
+    if (free_slot() || spill_oldest()) {
+        return true;
+    }
+
+    if (s_config.policy == OUTBOX_DROP_BY_CLASS) {
+        for (int q = 0; q <= 2; q++) {
+            outbox_slot_t *victim = oldest_slot(q);
+            if (victim == NULL) {
+                continue;
+            }
+            if (qos < q) {
+                return false;   // incoming message is the least important
+            }
+            remove_slot(victim);
+            s_stats.dropped_class++;
+            return true;
+        }
+        return false;
+    }
+
+    remove_slot(oldest_slot(-1));
+    s_stats.dropped_oldest++;
+    return true;
+}
+
+// === Replay ===
+
+static void stop_replay(void)
+{
+    esp_timer_stop(s_replay_timer);
+}
+
+// A replay publish was refused. Only a dropped connection stops replay
+// (the next connect restarts it); while connected the client is just
+// busy, so the same message is tried again on the next interval.
+static void replay_failed(void)
+{
+    if (s_config.connected && s_config.connected()) {
+        s_stats.replay_retries++;
+        return;
+    }
+    stop_replay();
+}
+
+static void replay_timer_cb(void *arg)
+{
+    (void)arg;
+
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+
+    for (int i = 0; i < s_config.replay_burst; i++) {
+        mqtt_outbox_msg_t msg;
+
+        if (s_config.spill && s_config.spill->peek(s_config.spill->ctx, &msg)) {
+            if (!s_config.publish(msg.topic, msg.data, msg.len, msg.qos, msg.retain)) {
+                replay_failed();
+                break;
+            }
+            s_config.spill->pop(s_config.spill->ctx);
+        } else {
+            outbox_slot_t *slot = oldest_slot(-1);
+            if (slot == NULL) {
+                stop_replay();
+                break;
+            }
+            if (!s_config.publish(slot->topic, slot->data, slot->len, slot->qos, slot->retain)) {
+                replay_failed();
+                break;
+            }
+            remove_slot(slot);
+        }
+        s_stats.replayed++;
+    }
+
+    if (s_stats.ram_entries == 0 && spill_bytes() == 0) {
+        ESP_LOGI(TAG, "Replay done (%lu messages)", (unsigned long)s_stats.replayed);
+        stop_replay();
+    }
+
+    xSemaphoreGive(s_lock);
+}
+
+// === Public API ===
+
+void mqtt_outbox_init(const mqtt_outbox_config_t *config)
+{
+    s_config = *config;
+    if (s_config.replay_burst == 0) {
+        s_config.replay_burst = 1;
+    }
+
+    memset(s_slots, 0, sizeof(s_slots));
+    memset(&s_stats, 0, sizeof(s_stats));
+    s_stats.ram_bytes_capacity = sizeof(s_slots);
+
+    s_lock = xSemaphoreCreateMutexStatic(&s_lock_buf);
+
+    const esp_timer_create_args_t timer_args = {
+        .callback = replay_timer_cb,
+        .name = "outbox_replay",
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&timer_args, &s_replay_timer));
+
+    ESP_LOGI(TAG, "Outbox init (%d slots, %lu bytes RAM, policy=%d, spill=%s)",
+             MQTT_OUTBOX_SLOTS, (unsigned long)s_stats.ram_bytes_capacity,
+             s_config.policy, s_config.spill ? "yes" : "no");
+}
+
+bool mqtt_outbox_put(const char *topic, const uint8_t *data, int len, int qos, bool retain)
+{
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+
+    if (len < 0 || len > MQTT_OUTBOX_SLOT_DATA || strlen(topic) >= MQTT_OUTBOX_TOPIC_MAX) {
+        s_stats.rejected++;
+        xSemaphoreGive(s_lock);
+        return false;
+    }
+
+    // Only the latest value of a retained topic matters to the broker
+    if (s_config.policy == OUTBOX_COMPACT_STATE && retain) {
+        for (int i = 0; i < MQTT_OUTBOX_SLOTS; i++) {
+            outbox_slot_t *slot = &s_slots[i];
+            if (slot->used && slot->retain && strcmp(slot->topic, topic) == 0) {
+                remove_slot(slot);
+                s_stats.compacted++;
+            }
+        }
+    }
+
+    if (!make_room(qos)) {
+        s_stats.dropped_class++;
+        xSemaphoreGive(s_lock);
+        return false;
+    }
+
+    outbox_slot_t *slot = free_slot();
+    slot->used = true;
+    slot->seq = s_next_seq++;
+    slot->len = (uint16_t)len;
+    slot->qos = (uint8_t)qos;
+    slot->retain = retain;
+    strcpy(slot->topic, topic);
+    memcpy(slot->data, data, len);
+
+    s_stats.queued++;
+    s_stats.ram_entries++;
+    s_stats.ram_bytes_used += slot_bytes(slot);
+    if (s_stats.ram_bytes_used > s_stats.ram_bytes_high_water) {
+        s_stats.ram_bytes_high_water = s_stats.ram_bytes_used;
+    }
+
+    xSemaphoreGive(s_lock);
+    return true;
+}
+
+bool mqtt_outbox_is_empty(void)
+{
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    bool empty = s_stats.ram_entries == 0 && spill_bytes() == 0;
+    xSemaphoreGive(s_lock);
+    return empty;
+}
+
+void mqtt_outbox_start_replay(void)
+{
+    if (mqtt_outbox_is_empty() || esp_timer_is_active(s_replay_timer)) {
+        return;
+    }
+
+    ESP_LOGI(TAG, "Replaying outbox (%d in RAM, %u bytes spilled)",
+             s_stats.ram_entries, (unsigned)spill_bytes());
+    esp_timer_start_periodic(s_replay_timer, s_config.replay_interval_ms * 1000ULL);
+}
+
+void mqtt_outbox_get_stats(mqtt_outbox_stats_t *stats)
+{
+    xSemaphoreTake(s_lock, portMAX_DELAY);
+    *stats = s_stats;
+    stats->spill_bytes_used = (uint32_t)spill_bytes();
+    xSemaphoreGive(s_lock);
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Store-and-forward outbox for publishes made while the broker is
+// unreachable. Messages are kept in a fixed RAM pool; when it is full the
+// oldest ones move to an optional spill backend (NVS or a file), otherwise
+// the overflow policy decides what is dropped. On reconnect everything is
+// replayed in order, a burst at a time.
+
+#define MQTT_OUTBOX_SLOTS         12
+#define MQTT_OUTBOX_SLOT_DATA     512
+#define MQTT_OUTBOX_TOPIC_MAX     64
+
+typedef enum {
+    OUTBOX_DROP_OLDEST,       // drop the oldest RAM entry
+    OUTBOX_DROP_BY_CLASS,     // drop the oldest entry of the lowest QoS first
+    OUTBOX_COMPACT_STATE,     // retained (state) topics keep only their latest value
+} mqtt_outbox_policy_t;
+
+typedef struct {
+    const char *topic;
+    const uint8_t *data;
+    uint16_t len;
+    uint8_t qos;
+    bool retain;
+} mqtt_outbox_msg_t;
+
+// Spill backend: FIFO of messages, oldest first
+typedef struct {
+    bool (*append)(void *ctx, const mqtt_outbox_msg_t *msg);
+    // Oldest message without removing it; topic/data point into backend storage
+    bool (*peek)(void *ctx, mqtt_outbox_msg_t *msg);
+    void (*pop)(void *ctx);
+    size_t (*bytes_used)(void *ctx);
+    void *ctx;
+} mqtt_outbox_spill_t;
+
+typedef bool (*mqtt_outbox_publish_fn)(const char *topic, const uint8_t *data, int len,
+                                       int qos, bool retain);
+typedef bool (*mqtt_outbox_connected_fn)(void);
+
+typedef struct {
+    mqtt_outbox_policy_t policy;
+    const mqtt_outbox_spill_t *spill;   // NULL = RAM only
+    mqtt_outbox_publish_fn publish;     // used for replay
+    // A failed replay publish while this reports the broker connected (the
+    // client's own queue is full) is retried on the next interval instead
+    // of stopping replay. NULL = every failure stops it.
+    mqtt_outbox_connected_fn connected;
+    uint32_t replay_interval_ms;
+    uint8_t replay_burst;               // messages per interval
+} mqtt_outbox_config_t;
+
+typedef struct {
+    uint32_t queued;
+    uint32_t replayed;
+    uint32_t replay_retries;      // replay publishes refused while connected
+    uint32_t spilled;
+    uint32_t dropped_oldest;
+    uint32_t dropped_class;
+    uint32_t compacted;
+    uint32_t rejected;            // too large for a slot
+    uint16_t ram_entries;
+    uint32_t ram_bytes_used;      // payload + topic bytes held in RAM
+    uint32_t ram_bytes_high_water;
+    uint32_t ram_bytes_capacity;  // static size of the RAM pool
+    uint32_t spill_bytes_used;
+} mqtt_outbox_stats_t;
+
+void mqtt_outbox_init(const mqtt_outbox_config_t *config);
+
+// Queue a message (copied)
+bool mqtt_outbox_put(const char *topic, const uint8_t *data, int len, int qos, bool retain);
+
+bool mqtt_outbox_is_empty(void);
+
+// Start rate-limited replay (call when the broker connection is up)
+void mqtt_outbox_start_replay(void);
+
+void mqtt_outbox_get_stats(mqtt_outbox_stats_t *stats);
+
+// === Spill backends ===
+
+// File-backed FIFO (any VFS path on the ESP32, or a plain file on Linux)
+const mqtt_outbox_spill_t *mqtt_outbox_spill_file_init(const char *path, size_t max_bytes);
+
+// NVS-backed FIFO, one blob per message
+const mqtt_outbox_spill_t *mqtt_outbox_spill_nvs_init(const char *nvs_namespace, uint16_t max_records);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,284 @@
+// Spill backends for the MQTT outbox: file (VFS / Linux) and NVS
+
+#include "comm/mqtt_outbox.h"
+#include <stdio.h>
+#include <string.h>
+#include "nvs.h"
+#include "esp_log.h"
+
+static const char *TAG = "OUTBOX_SPILL";
+
+// Record layout (both backends):
+//   | len (u16 LE) | qos | retain | topic_len | topic | data[len] |
+#define RECORD_HDR_LEN  5
+#define RECORD_MAX_LEN  (RECORD_HDR_LEN + MQTT_OUTBOX_TOPIC_MAX + MQTT_OUTBOX_SLOT_DATA)
+
+static size_t record_encode(const mqtt_outbox_msg_t *msg, uint8_t *buf)
+{
+    size_t topic_len = strlen(msg->topic);
+    if (topic_len >= MQTT_OUTBOX_TOPIC_MAX || msg->len > MQTT_OUTBOX_SLOT_DATA) {
+        return 0;
+    }
+    buf[0] = (uint8_t)msg->len;
+    buf[1] = (uint8_t)(msg->len >> 8);
+    buf[2] = msg->qos;
+    buf[3] = msg->retain;
+    buf[4] = (uint8_t)topic_len;
+    memcpy(&buf[RECORD_HDR_LEN], msg->topic, topic_len);
+    memcpy(&buf[RECORD_HDR_LEN + topic_len], msg->data, msg->len);
+    return RECORD_HDR_LEN + topic_len + msg->len;
+}
+
+// Decode in place: the topic is NUL-terminated by shifting it one byte left
+// over the header, so msg points into buf
+static size_t record_decode(uint8_t *buf, size_t avail, mqtt_outbox_msg_t *msg)
+{
+    if (avail < RECORD_HDR_LEN) {
+        return 0;
+    }
+    uint16_t len = (uint16_t)(buf[0] | (buf[1] << 8));
+    uint8_t topic_len = buf[4];
+    size_t total = RECORD_HDR_LEN + topic_len + len;
+    if (len > MQTT_OUTBOX_SLOT_DATA || topic_len >= MQTT_OUTBOX_TOPIC_MAX || total > avail) {
+        return 0;
+    }
+
+    msg->len = len;
+    msg->qos = buf[2];
+    msg->retain = buf[3] != 0;
+    memmove(&buf[RECORD_HDR_LEN - 1], &buf[RECORD_HDR_LEN], topic_len);
+    buf[RECORD_HDR_LEN - 1 + topic_len] = '\0';
+    msg->topic = (const char *)&buf[RECORD_HDR_LEN - 1];
+    msg->data = &buf[RECORD_HDR_LEN + topic_len];
+    return total;
+}
+
+// === File backend ===
+// Append-only file with a read offset; truncated whenever it drains.
+// Survives reboot: an existing file is replayed from the start.
+
+typedef struct {
+    FILE *f;
+    char path[64];
+    size_t max_bytes;
+    long read_off;
+    long write_off;
+    size_t peeked_len;      // size of the record returned by the last peek
+    uint8_t buf[RECORD_MAX_LEN];
+} file_spill_t;
+
+static file_spill_t s_file;
+
+static bool file_append(void *ctx, const mqtt_outbox_msg_t *msg)
+{
+    file_spill_t *fs = ctx;
+    uint8_t rec[RECORD_MAX_LEN];
+    size_t len = record_encode(msg, rec);
+    if (len == 0 || (size_t)fs->write_off + len > fs->max_bytes) {
+        return false;
+    }
+
+    if (fseek(fs->f, fs->write_off, SEEK_SET) != 0 || fwrite(rec, 1, len, fs->f) != len) {
+        return false;
+    }
+    fflush(fs->f);
+    fs->write_off += (long)len;
+    return true;
+}
+
+static bool file_peek(void *ctx, mqtt_outbox_msg_t *msg)
+{
+    file_spill_t *fs = ctx;
+    if (fs->read_off >= fs->write_off || fseek(fs->f, fs->read_off, SEEK_SET) != 0) {
+        return false;
+    }
+
+    size_t avail = (size_t)(fs->write_off - fs->read_off);
+    if (avail > sizeof(fs->buf)) {
+        avail = sizeof(fs->buf);
+    }
+    avail = fread(fs->buf, 1, avail, fs->f);
+
+    fs->peeked_len = record_decode(fs->buf, avail, msg);
+    if (fs->peeked_len == 0) {
+        // Corrupt tail (e.g. power loss mid-write) - discard the rest
+        ESP_LOGW(TAG, "Corrupt spill record at %ld, dropping %ld bytes",
+                 fs->read_off, fs->write_off - fs->read_off);
+        fs->read_off = fs->write_off;
+        return false;
+    }
+    return true;
+}
+
+static void file_pop(void *ctx)
+{
+    file_spill_t *fs = ctx;
+    fs->read_off += (long)fs->peeked_len;
+    fs->peeked_len = 0;
+
+    if (fs->read_off >= fs->write_off) {
+        fs->f = freopen(fs->path, "w+b", fs->f);
+        fs->read_off = 0;
+        fs->write_off = 0;
+    }
+}
+
+static size_t file_bytes_used(void *ctx)
+{
+    file_spill_t *fs = ctx;
+    return (size_t)(fs->write_off - fs->read_off);
+}
+
+const mqtt_outbox_spill_t *mqtt_outbox_spill_file_init(const char *path, size_t max_bytes)
+{
+    static mqtt_outbox_spill_t spill = {
+        .append = file_append,
+        .peek = file_peek,
+        .pop = file_pop,
+        .bytes_used = file_bytes_used,
+        .ctx = &s_file,
+    };
+
+    memset(&s_file, 0, sizeof(s_file));
+    strncpy(s_file.path, path, sizeof(s_file.path) - 1);
+    s_file.max_bytes = max_bytes;
+
+    s_file.f = fopen(path, "r+b");
+    if (s_file.f) {
+        fseek(s_file.f, 0, SEEK_END);
+        s_file.write_off = ftell(s_file.f);
+    } else {
+        s_file.f = fopen(path, "w+b");
+    }
+    if (s_file.f == NULL) {
+        ESP_LOGE(TAG, "Cannot open spill file %s", path);
+        return NULL;
+    }
+
+    ESP_LOGI(TAG, "File spill %s (%ld bytes pending, max %u)",
+             path, s_file.write_off, (unsigned)max_bytes);
+    return &spill;
+}
+
+// === NVS backend ===
+// One blob per record under keys "m<index>"; head/tail are persisted so the
+// backlog survives reboot.
+
+typedef struct {
+    nvs_handle_t handle;
+    uint16_t max_records;
+    uint32_t head;
+    uint32_t tail;
+    size_t bytes;
+    size_t peeked_len;
+    uint8_t buf[RECORD_MAX_LEN];
+} nvs_spill_t;
+
+static nvs_spill_t s_nvs;
+
+static void nvs_record_key(const nvs_spill_t *ns, uint32_t index, char *key)
+{
+    snprintf(key, 16, "m%u", (unsigned)(index % ns->max_records));
+}
+
+static bool nvs_append(void *ctx, const mqtt_outbox_msg_t *msg)
+{
+    nvs_spill_t *ns = ctx;
+    if (ns->tail - ns->head >= ns->max_records) {
+        return false;
+    }
+
+    size_t len = record_encode(msg, ns->buf);
+    if (len == 0) {
+        return false;
+    }
+
+    char key[16];
+    nvs_record_key(ns, ns->tail, key);
+    if (nvs_set_blob(ns->handle, key, ns->buf, len) != ESP_OK) {
+        return false;
+    }
+    ns->tail++;
+    nvs_set_u32(ns->handle, "tail", ns->tail);
+    nvs_commit(ns->handle);
+    ns->bytes += len;
+    return true;
+}
+
+static void nvs_pop(void *ctx)
+{
+    nvs_spill_t *ns = ctx;
+    if (ns->head == ns->tail) {
+        return;
+    }
+
+    char key[16];
+    nvs_record_key(ns, ns->head, key);
+    nvs_erase_key(ns->handle, key);
+    ns->head++;
+    nvs_set_u32(ns->handle, "head", ns->head);
+    nvs_commit(ns->handle);
+
+    ns->bytes = (ns->bytes > ns->peeked_len) ? ns->bytes - ns->peeked_len : 0;
+    if (ns->head == ns->tail) {
+        ns->bytes = 0;
+    }
+    ns->peeked_len = 0;
+}
+
+static bool nvs_peek(void *ctx, mqtt_outbox_msg_t *msg)
+{
+    nvs_spill_t *ns = ctx;
+
+    while (ns->head != ns->tail) {
+        char key[16];
+        nvs_record_key(ns, ns->head, key);
+        size_t len = sizeof(ns->buf);
+        if (nvs_get_blob(ns->handle, key, ns->buf, &len) != ESP_OK) {
+            len = 0;
+        }
+
+        ns->peeked_len = record_decode(ns->buf, len, msg);
+        if (ns->peeked_len > 0) {
+            return true;
+        }
+
+        // Missing or corrupt record - skip it so replay doesn't stall
+        ESP_LOGW(TAG, "Bad NVS spill record %s, skipping", key);
+        ns->peeked_len = len;
+        nvs_pop(ctx);
+    }
+    return false;
+}
+
+static size_t nvs_bytes_used(void *ctx)
+{
+    nvs_spill_t *ns = ctx;
+    // Never report 0 while records remain (sizes are unknown after reboot)
+    return (ns->head == ns->tail) ? 0 : (ns->bytes > 0 ? ns->bytes : 1);
+}
+
+const mqtt_outbox_spill_t *mqtt_outbox_spill_nvs_init(const char *nvs_namespace, uint16_t max_records)
+{
+    static mqtt_outbox_spill_t spill = {
+        .append = nvs_append,
+        .peek = nvs_peek,
+        .pop = nvs_pop,
+        .bytes_used = nvs_bytes_used,
+        .ctx = &s_nvs,
+    };
+
+    memset(&s_nvs, 0, sizeof(s_nvs));
+    s_nvs.max_records = max_records;
+
+    if (nvs_open(nvs_namespace, NVS_READWRITE, &s_nvs.handle) != ESP_OK) {
+        ESP_LOGE(TAG, "Cannot open NVS namespace %s", nvs_namespace);
+        return NULL;
+    }
+    nvs_get_u32(s_nvs.handle, "head", &s_nvs.head);
+    nvs_get_u32(s_nvs.handle, "tail", &s_nvs.tail);
+
+    ESP_LOGI(TAG, "NVS spill '%s' (%u records pending, max %u)",
+             nvs_namespace, (unsigned)(s_nvs.tail - s_nvs.head), max_records);
+    return &spill;
+}
@@ -0,0 +1,222 @@
+// Fixed-pool outbox for the esp-mqtt client (CONFIG_MQTT_CUSTOM_OUTBOX).
+// Implements esp-mqtt's outbox interface; called only with the client
+// lock held, so the pool itself needs no locking.
+
+#include "mqtt_outbox.h"            // esp-mqtt's outbox interface
+#include "comm/mqtt_pool/mqtt_pool.h"
+#include <string.h>
+#include "esp_log.h"
+#include "config.h"
+
+static const char *TAG = "MQTT_POOL";
+
+struct outbox_item {
+    uint32_t seq;                   // insertion order, 0 = free slot
+    int msg_id;
+    int msg_type;
+    int msg_qos;
+    outbox_tick_t tick;
+    pending_state_t pending;
+    size_t len;
+    uint8_t data[MQTT_POOL_SLOT_SIZE];
+};
+
+struct outbox_t {
+    struct outbox_item items[MQTT_POOL_SLOTS];
+    uint32_t next_seq;
+};
+
+static struct outbox_t s_pool;
+static mqtt_pool_stats_t s_stats;
+
+static void item_free(struct outbox_item *item)
+{
+    item->seq = 0;
+    s_stats.used--;
+}
+
+void mqtt_pool_get_stats(mqtt_pool_stats_t *stats)
+{
+    *stats = s_stats;
+}
+
+outbox_handle_t outbox_init(void)
+{
+    memset(&s_pool, 0, sizeof(s_pool));
+    s_stats.used = 0;
+    return &s_pool;
+}
+
+outbox_item_handle_t outbox_enqueue(outbox_handle_t outbox, outbox_message_handle_t message, outbox_tick_t tick)
+{
+    size_t len = (size_t)message->len + (size_t)message->remaining_len;
+    struct outbox_item *item = NULL;
+
+    if (len <= MQTT_POOL_SLOT_SIZE) {
+        for (int i = 0; i < MQTT_POOL_SLOTS; i++) {
+            if (outbox->items[i].seq == 0) {
+                item = &outbox->items[i];
+                break;
+            }
+        }
+    }
+    if (item == NULL) {
+        s_stats.rejected++;
+        ESP_LOGW(TAG, "Message %d (%u bytes) refused: %s", message->msg_id, (unsigned)len,
+                 len > MQTT_POOL_SLOT_SIZE ? "larger than a slot" : "pool full");
+        return NULL;
+    }
+
+    memcpy(item->data, message->data, message->len);
+    if (message->remaining_data && message->remaining_len > 0) {
+        memcpy(item->data + message->len, message->remaining_data, message->remaining_len);
+    }
+    item->len = len;
+    item->msg_id = message->msg_id;
+    item->msg_type = message->msg_type;
+    item->msg_qos = message->msg_qos;
+    item->tick = tick;
+    item->pending = QUEUED;
+    item->seq = ++outbox->next_seq;
+
+    if (++s_stats.used > s_stats.max_used) {
+        s_stats.max_used = s_stats.used;
+    }
+    return item;
+}
+
+// Oldest item with the given state
+outbox_item_handle_t outbox_dequeue(outbox_handle_t outbox, pending_state_t pending, outbox_tick_t *tick)
+{
+    struct outbox_item *oldest = NULL;
+    for (int i = 0; i < MQTT_POOL_SLOTS; i++) {
+        struct outbox_item *item = &outbox->items[i];
+        if (item->seq != 0 && item->pending == pending && (oldest == NULL || item->seq < oldest->seq)) {
+            oldest = item;
+        }
+    }
+    if (oldest && tick) {
+        *tick = oldest->tick;
+    }
+    return oldest;
+}
+
+outbox_item_handle_t outbox_get(outbox_handle_t outbox, int msg_id)
+{
+    for (int i = 0; i < MQTT_POOL_SLOTS; i++) {
+        if (outbox->items[i].seq != 0 && outbox->items[i].msg_id == msg_id) {
+            return &outbox->items[i];
+        }
+    }
+    return NULL;
+}
+
+uint8_t *outbox_item_get_data(outbox_item_handle_t item, size_t *len, uint16_t *msg_id, int *msg_type, int *qos)
+{
+    if (item == NULL) {
+        return NULL;
+    }
+    *len = item->len;
+    *msg_id = (uint16_t)item->msg_id;
+    *msg_type = item->msg_type;
+    *qos = item->msg_qos;
+    return item->data;
+}
+
+esp_err_t outbox_delete(outbox_handle_t outbox, int msg_id, int msg_type)
+{
+    for (int i = 0; i < MQTT_POOL_SLOTS; i++) {
+        struct outbox_item *item = &outbox->items[i];
+        if (item->seq != 0 && item->msg_id == msg_id && item->msg_type == msg_type) {
+            item_free(item);
+            return ESP_OK;
+        }
+    }
+    return ESP_FAIL;
+}
+
+esp_err_t outbox_delete_item(outbox_handle_t outbox, outbox_item_handle_t item)
+{
+    (void)outbox;
+    if (item == NULL || item->seq == 0) {
+        return ESP_FAIL;
+    }
+    item_free(item);
+    return ESP_OK;
+}
+
+int outbox_delete_single_expired(outbox_handle_t outbox, outbox_tick_t current_tick, outbox_tick_t timeout)
+{
+    for (int i = 0; i < MQTT_POOL_SLOTS; i++) {
+        struct outbox_item *item = &outbox->items[i];
+        if (item->seq != 0 && current_tick - item->tick > timeout) {
+            int msg_id = item->msg_id;
+            item_free(item);
+            return msg_id;
+        }
+    }
+    return -1;
+}
+
+int outbox_delete_expired(outbox_handle_t outbox, outbox_tick_t current_tick, outbox_tick_t timeout)
+{
+    int deleted = 0;
+    for (int i = 0; i < MQTT_POOL_SLOTS; i++) {
+        struct outbox_item *item = &outbox->items[i];
+        if (item->seq != 0 && current_tick - item->tick > timeout) {
+            item_free(item);
+            deleted++;
+        }
+    }
+    return deleted;
+}
+
+esp_err_t outbox_set_pending(outbox_handle_t outbox, int msg_id, pending_state_t pending)
+{
+    outbox_item_handle_t item = outbox_get(outbox, msg_id);
+    if (item == NULL) {
+        return ESP_FAIL;
+    }
+    item->pending = pending;
+    return ESP_OK;
+}
+
+pending_state_t outbox_item_get_pending(outbox_item_handle_t item)
+{
+    return item ? item->pending : QUEUED;
+}
+
+esp_err_t outbox_set_tick(outbox_handle_t outbox, int msg_id, outbox_tick_t tick)
+{
+    outbox_item_handle_t item = outbox_get(outbox, msg_id);
+    if (item == NULL) {
+        return ESP_FAIL;
+    }
+    item->tick = tick;
+    return ESP_OK;
+}
+
+uint64_t outbox_get_size(outbox_handle_t outbox)
+{
+    uint64_t size = 0;
+    for (int i = 0; i < MQTT_POOL_SLOTS; i++) {
+        if (outbox->items[i].seq != 0) {
+            size += outbox->items[i].len;
+        }
+    }
+    return size;
+}
+
+void outbox_delete_all_items(outbox_handle_t outbox)
+{
+    for (int i = 0; i < MQTT_POOL_SLOTS; i++) {
+        if (outbox->items[i].seq != 0) {
+            item_free(&outbox->items[i]);
+        }
+    }
+}
+
+void outbox_destroy(outbox_handle_t outbox)
+{
+    outbox_delete_all_items(outbox);
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Fixed-pool outbox for the esp-mqtt client. esp-mqtt keeps every QoS 1/2
+// publish, subscribe and unsubscribe until it is acknowledged; its default
+// outbox mallocs a copy of each. With CONFIG_MQTT_CUSTOM_OUTBOX this pool
+// of MQTT_POOL_SLOTS slots of MQTT_POOL_SLOT_SIZE bytes is used instead
+// (see config.h); a message that does not fit is refused and the publish
+// fails. mqtt_pool.c is built into the mqtt component (src/CMakeLists.txt).
+
+typedef struct {
+    uint32_t used;                  // slots holding a message now
+    uint32_t max_used;
+    uint32_t rejected;              // pool full or message too large
+} mqtt_pool_stats_t;
+
+void mqtt_pool_get_stats(mqtt_pool_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
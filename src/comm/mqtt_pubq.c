@@ -0,0 +1,159 @@
+// Lock-free MPSC publish queue and publisher task
+
+#include "comm/mqtt_pubq.h"
+#include "comm/task_table.h"
+#include <stdatomic.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_log.h"
+
+static const char *TAG = "MQTT_PUBQ";
+
+_Static_assert((MQTT_PUBQ_DEPTH & (MQTT_PUBQ_DEPTH - 1)) == 0, "MQTT_PUBQ_DEPTH must be a power of two");
+
+#define PUBQ_MASK (MQTT_PUBQ_DEPTH - 1)
+
+// Bounded ring with a sequence number per slot: a slot is free for the
+// producer holding ticket pos when seq == pos, and ready for the consumer
+// when seq == pos + 1. Producers claim tickets with a CAS on s_head.
+typedef struct {
+    atomic_uint seq;
+    uint16_t len;
+    uint8_t qos;
+    bool retain;
+    bool reply;
+    uint8_t corr_len;
+    uint8_t corr[MQTT_PUBQ_CORR_MAX];
+    char topic[MQTT_PUBQ_TOPIC_MAX];
+    uint8_t data[MQTT_PUBQ_SLOT_DATA];
+} pubq_slot_t;
+
+static pubq_slot_t s_slots[MQTT_PUBQ_DEPTH];
+static atomic_uint s_head;              // next ticket for producers
+static atomic_uint s_tail;              // next slot for the consumer (written by publisher task only)
+
+static mqtt_pubq_publish_fn s_publish = NULL;
+static TaskHandle_t s_task = NULL;
+
+static atomic_uint s_pushed;
+static atomic_uint s_dropped_full;
+static atomic_uint s_dropped_size;
+static atomic_uint s_depth_high_water;
+static uint32_t s_published;
+static uint32_t s_publish_failed;
+
+static void note_depth(unsigned depth)
+{
+    unsigned high = atomic_load_explicit(&s_depth_high_water, memory_order_relaxed);
+    while (depth > high &&
+           !atomic_compare_exchange_weak_explicit(&s_depth_high_water, &high, depth,
+                                                  memory_order_relaxed, memory_order_relaxed)) {
+    }
+}
+
+static void publisher_task(void *pvParameters)
+{
+    (void)pvParameters;
+
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+
+        unsigned tail = atomic_load_explicit(&s_tail, memory_order_relaxed);
+        while (true) {
+            pubq_slot_t *slot = &s_slots[tail & PUBQ_MASK];
+            if (atomic_load_explicit(&slot->seq, memory_order_acquire) != tail + 1) {
+                break;  // empty
+            }
+
+            if (s_publish(slot->topic, slot->data, slot->len, slot->qos, slot->retain,
+                          slot->reply ? slot->corr : NULL, slot->corr_len)) {
+                s_published++;
+            } else {
+                s_publish_failed++;
+            }
+
+            // Hand the slot back to producers for the next lap
+            atomic_store_explicit(&slot->seq, tail + MQTT_PUBQ_DEPTH, memory_order_release);
+            tail++;
+            atomic_store_explicit(&s_tail, tail, memory_order_relaxed);
+        }
+    }
+}
+
+void mqtt_pubq_init(mqtt_pubq_publish_fn publish)
+{
+    s_publish = publish;
+
+    for (unsigned i = 0; i < MQTT_PUBQ_DEPTH; i++) {
+        atomic_init(&s_slots[i].seq, i);
+    }
+    atomic_init(&s_head, 0);
+    atomic_init(&s_tail, 0);
+
+    task_create(TASK_MQTT_PUB, NULL, publisher_task, NULL, &s_task);
+
+    ESP_LOGI(TAG, "Publish queue init (%d slots, %u bytes)",
+             MQTT_PUBQ_DEPTH, (unsigned)sizeof(s_slots));
+}
+
+bool mqtt_pubq_push(const char *topic, const uint8_t *data, int len, int qos, bool retain,
+                    const uint8_t *correlation, int correlation_len)
+{
+    size_t topic_len = strlen(topic);
+    if (len < 0 || len > MQTT_PUBQ_SLOT_DATA || topic_len >= MQTT_PUBQ_TOPIC_MAX ||
+        correlation_len < 0 || correlation_len > MQTT_PUBQ_CORR_MAX) {
+        atomic_fetch_add_explicit(&s_dropped_size, 1, memory_order_relaxed);
+        return false;
+    }
+
+    unsigned pos = atomic_load_explicit(&s_head, memory_order_relaxed);
+    pubq_slot_t *slot;
+    while (true) {
+        slot = &s_slots[pos & PUBQ_MASK];
+        int diff = (int)(atomic_load_explicit(&slot->seq, memory_order_acquire) - pos);
+        if (diff == 0) {
+            if (atomic_compare_exchange_weak_explicit(&s_head, &pos, pos + 1,
+                                                      memory_order_relaxed, memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            // Consumer hasn't freed this slot yet - full
+            atomic_fetch_add_explicit(&s_dropped_full, 1, memory_order_relaxed);
+            return false;
+        } else {
+            pos = atomic_load_explicit(&s_head, memory_order_relaxed);
+        }
+    }
+
+    memcpy(slot->topic, topic, topic_len + 1);
+    memcpy(slot->data, data, (size_t)len);
+    slot->len = (uint16_t)len;
+    slot->qos = (uint8_t)qos;
+    slot->retain = retain;
+    slot->reply = correlation != NULL;
+    slot->corr_len = (uint8_t)correlation_len;
+    if (correlation_len > 0) {
+        memcpy(slot->corr, correlation, (size_t)correlation_len);
+    }
+    atomic_store_explicit(&slot->seq, pos + 1, memory_order_release);
+
+    atomic_fetch_add_explicit(&s_pushed, 1, memory_order_relaxed);
+    note_depth(pos + 1 - atomic_load_explicit(&s_tail, memory_order_relaxed));
+
+    xTaskNotifyGive(s_task);
+    return true;
+}
+
+void mqtt_pubq_get_stats(mqtt_pubq_stats_t *stats)
+{
+    unsigned head = atomic_load_explicit(&s_head, memory_order_relaxed);
+
+    stats->pushed = atomic_load_explicit(&s_pushed, memory_order_relaxed);
+    stats->dropped_full = atomic_load_explicit(&s_dropped_full, memory_order_relaxed);
+    stats->dropped_size = atomic_load_explicit(&s_dropped_size, memory_order_relaxed);
+    stats->published = s_published;
+    stats->publish_failed = s_publish_failed;
+    stats->depth = (uint16_t)(head - atomic_load_explicit(&s_tail, memory_order_relaxed));
+    stats->depth_high_water = (uint16_t)atomic_load_explicit(&s_depth_high_water, memory_order_relaxed);
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Asynchronous publish queue: producers (UART RX, timers, MQTT task) copy
+// the message into a preallocated slot and return immediately; a dedicated
+// publisher task hands it to the MQTT client. The queue is a bounded
+// lock-free MPSC ring - push never blocks, it drops and counts when full.
+
+#define MQTT_PUBQ_DEPTH       16      // power of two
+#define MQTT_PUBQ_SLOT_DATA   512
+#define MQTT_PUBQ_TOPIC_MAX   64
+#define MQTT_PUBQ_CORR_MAX    32      // MQTT 5 correlation data
+
+// correlation is NULL for ordinary publishes, non-NULL (possibly empty)
+// for replies to an MQTT 5 request
+typedef bool (*mqtt_pubq_publish_fn)(const char *topic, const uint8_t *data, int len,
+                                     int qos, bool retain,
+                                     const uint8_t *correlation, int correlation_len);
+
+typedef struct {
+    uint32_t pushed;
+    uint32_t dropped_full;      // queue full
+    uint32_t dropped_size;      // topic, payload or correlation too large for a slot
+    uint32_t published;
+    uint32_t publish_failed;
+    uint16_t depth;             // messages currently queued
+    uint16_t depth_high_water;
+} mqtt_pubq_stats_t;
+
+// Start the publisher task; publish is called from it for every message
+void mqtt_pubq_init(mqtt_pubq_publish_fn publish);
+
+// Copy a message into the queue (never blocks)
+bool mqtt_pubq_push(const char *topic, const uint8_t *data, int len, int qos, bool retain,
+                    const uint8_t *correlation, int correlation_len);
+
+void mqtt_pubq_get_stats(mqtt_pubq_stats_t *stats);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,298 @@
+// MQTT subscription router: hashed exact topics + wildcard trie
+
+#include "comm/mqtt_router.h"
+#include <string.h>
+#include "esp_log.h"
+
+static const char *TAG = "MQTT_ROUTER";
+
+typedef uint16_t route_mask_t;      // bit per route id
+
+_Static_assert(MQTT_ROUTER_MAX_ROUTES <= 16, "route_mask_t too narrow");
+
+typedef struct {
+    char filter[MQTT_ROUTER_FILTER_MAX];
+    uint8_t qos;
+    mqtt_topic_handler_t handler;
+    void *ctx;
+} route_t;
+
+static route_t routes[MQTT_ROUTER_MAX_ROUTES];
+static int route_count = 0;
+
+// === Exact filters: open addressing over FNV-1a ===
+
+#define EXACT_TABLE_SIZE 32     // power of two, >= 2x MQTT_ROUTER_MAX_ROUTES
+
+typedef struct {
+    uint32_t hash;
+    const char *topic;          // points into routes[].filter
+    uint8_t topic_len;
+    route_mask_t routes;        // 0 = empty bucket
+} exact_entry_t;
+
+static exact_entry_t exact_table[EXACT_TABLE_SIZE];
+
+static uint32_t topic_hash(const char *topic, int len)
+{
+    uint32_t h = 2166136261u;
+    for (int i = 0; i < len; i++) {
+        h = (h ^ (uint8_t)topic[i]) * 16777619u;
+    }
+    return h;
+}
+
+static void exact_add(const char *topic, int len, int id)
+{
+    uint32_t h = topic_hash(topic, len);
+    for (uint32_t i = 0; i < EXACT_TABLE_SIZE; i++) {
+        exact_entry_t *e = &exact_table[(h + i) & (EXACT_TABLE_SIZE - 1)];
+        if (e->routes == 0) {
+            e->hash = h;
+            e->topic = topic;
+            e->topic_len = (uint8_t)len;
+            e->routes = (route_mask_t)(1u << id);
+            return;
+        }
+        if (e->hash == h && e->topic_len == len && memcmp(e->topic, topic, len) == 0) {
+            e->routes |= (route_mask_t)(1u << id);  // same filter registered twice
+            return;
+        }
+    }
+}
+
+static route_mask_t exact_match(const char *topic, int len)
+{
+    uint32_t h = topic_hash(topic, len);
+    for (uint32_t i = 0; i < EXACT_TABLE_SIZE; i++) {
+        const exact_entry_t *e = &exact_table[(h + i) & (EXACT_TABLE_SIZE - 1)];
+        if (e->routes == 0) {
+            return 0;
+        }
+        if (e->hash == h && e->topic_len == len && memcmp(e->topic, topic, len) == 0) {
+            return e->routes;
+        }
+    }
+    return 0;
+}
+
+// === Wildcard filters: trie of topic levels ===
+// Each node is one level. '+' children are kept apart from literal ones;
+// '#' is not a node, it marks the routes that match everything below.
+
+#define NO_NODE 0xFF
+
+typedef struct {
+    const char *level;          // points into routes[].filter
+    uint8_t level_len;
+    uint8_t first_child;        // literal children
+    uint8_t next_sibling;
+    uint8_t plus_child;
+    route_mask_t routes;        // filters ending at this level
+    route_mask_t hash_routes;   // filters ending in '/#' below this level
+} trie_node_t;
+
+static trie_node_t nodes[MQTT_ROUTER_MAX_NODES] = {
+    [0] = { .first_child = NO_NODE, .next_sibling = NO_NODE, .plus_child = NO_NODE },
+};
+static int node_count = 1;      // node 0 is the root
+
+static int new_node(const char *level, int len)
+{
+    if (node_count >= MQTT_ROUTER_MAX_NODES) {
+        return -1;
+    }
+    trie_node_t *n = &nodes[node_count];
+    n->level = level;
+    n->level_len = (uint8_t)len;
+    n->first_child = NO_NODE;
+    n->next_sibling = NO_NODE;
+    n->plus_child = NO_NODE;
+    return node_count++;
+}
+
+static int child_for(int parent, const char *level, int len)
+{
+    trie_node_t *p = &nodes[parent];
+
+    if (len == 1 && level[0] == '+') {
+        if (p->plus_child == NO_NODE) {
+            int n = new_node(level, len);
+            if (n < 0) {
+                return -1;
+            }
+            p->plus_child = (uint8_t)n;
+        }
+        return p->plus_child;
+    }
+
+    for (uint8_t c = p->first_child; c != NO_NODE; c = nodes[c].next_sibling) {
+        if (nodes[c].level_len == len && memcmp(nodes[c].level, level, len) == 0) {
+            return c;
+        }
+    }
+
+    int n = new_node(level, len);
+    if (n < 0) {
+        return -1;
+    }
+    nodes[n].next_sibling = p->first_child;
+    p->first_child = (uint8_t)n;
+    return n;
+}
+
+static bool trie_add(const char *filter, int id)
+{
+    int node = 0;
+    const char *p = filter;
+
+    while (true) {
+        const char *slash = strchr(p, '/');
+        int len = slash ? (int)(slash - p) : (int)strlen(p);
+
+        if (len == 1 && p[0] == '#') {
+            nodes[node].hash_routes |= (route_mask_t)(1u << id);
+            return true;
+        }
+
+        node = child_for(node, p, len);
+        if (node < 0) {
+            return false;
+        }
+        if (!slash) {
+            nodes[node].routes |= (route_mask_t)(1u << id);
+            return true;
+        }
+        p = slash + 1;
+    }
+}
+
+// topic[pos..len) is what is left to match below node; pos > len once the
+// last level has been consumed
+static route_mask_t trie_match(int node, const char *topic, int pos, int len)
+{
+    const trie_node_t *n = &nodes[node];
+
+    // '#' also matches the parent level itself ("a/#" matches "a")
+    route_mask_t mask = n->hash_routes;
+    if (pos > len) {
+        return mask | n->routes;
+    }
+
+    // Wildcards at the first level don't match $-topics ($SYS/...)
+    bool wildcards = !(node == 0 && topic[0] == '$');
+    if (!wildcards) {
+        mask = 0;
+    }
+
+    const char *slash = memchr(&topic[pos], '/', len - pos);
+    int level_len = slash ? (int)(slash - &topic[pos]) : len - pos;
+    int next = pos + level_len + 1;
+
+    for (uint8_t c = n->first_child; c != NO_NODE; c = nodes[c].next_sibling) {
+        if (nodes[c].level_len == level_len && memcmp(nodes[c].level, &topic[pos], level_len) == 0) {
+            mask |= trie_match(c, topic, next, len);
+            break;
+        }
+    }
+    if (wildcards && n->plus_child != NO_NODE) {
+        mask |= trie_match(n->plus_child, topic, next, len);
+    }
+    return mask;
+}
+
+// '+' and '#' must fill a whole level, '#' only as the last one
+static bool filter_valid(const char *filter, bool *wildcard)
+{
+    *wildcard = false;
+    size_t len = strlen(filter);
+    if (len == 0 || len >= MQTT_ROUTER_FILTER_MAX) {
+        return false;
+    }
+
+    for (size_t i = 0; i < len; i++) {
+        if (filter[i] != '+' && filter[i] != '#') {
+            continue;
+        }
+        bool starts_level = (i == 0 || filter[i - 1] == '/');
+        bool ends_level = (i + 1 == len || filter[i + 1] == '/');
+        if (!starts_level || !ends_level || (filter[i] == '#' && i + 1 != len)) {
+            return false;
+        }
+        *wildcard = true;
+    }
+    return true;
+}
+
+// === Public API ===
+
+int mqtt_router_add(const char *filter, int qos, mqtt_topic_handler_t handler, void *ctx)
+{
+    bool wildcard;
+    if (!filter || !handler || !filter_valid(filter, &wildcard)) {
+        ESP_LOGE(TAG, "Invalid topic filter '%s'", filter ? filter : "");
+        return -1;
+    }
+    if (route_count >= MQTT_ROUTER_MAX_ROUTES) {
+        ESP_LOGE(TAG, "Route table full");
+        return -1;
+    }
+
+    int id = route_count;
+    route_t *r = &routes[id];
+    strcpy(r->filter, filter);
+    r->qos = (uint8_t)qos;
+    r->handler = handler;
+    r->ctx = ctx;
+
+    if (wildcard) {
+        if (!trie_add(r->filter, id)) {
+            ESP_LOGE(TAG, "Trie full, cannot add '%s'", filter);
+            return -1;
+        }
+    } else {
+        exact_add(r->filter, (int)strlen(r->filter), id);
+    }
+
+    route_count++;
+    ESP_LOGI(TAG, "Route %d: '%s' (QoS %d, %s)", id, filter, qos, wildcard ? "wildcard" : "exact");
+    return id;
+}
+
+int mqtt_router_dispatch(const char *topic, int topic_len,
+                         const char *data, int data_len, const mqtt_reply_t *reply)
+{
+    if (topic == NULL || topic_len <= 0) {
+        return 0;
+    }
+
+    route_mask_t mask = exact_match(topic, topic_len);
+    if (node_count > 1 || nodes[0].hash_routes) {
+        mask |= trie_match(0, topic, 0, topic_len);
+    }
+
+    int delivered = 0;
+    for (int id = 0; mask != 0; id++, mask >>= 1) {
+        if (mask & 1) {
+            routes[id].handler(topic, topic_len, data, data_len, reply, routes[id].ctx);
+            delivered++;
+        }
+    }
+    return delivered;
+}
+
+int mqtt_router_count(void)
+{
+    return route_count;
+}
+
+const char *mqtt_router_filter(int id, int *qos)
+{
+    if (id < 0 || id >= route_count) {
+        return NULL;
+    }
+    if (qos) {
+        *qos = routes[id].qos;
+    }
+    return routes[id].filter;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "comm/mqtt_util.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Subscription router for incoming MQTT messages. Exact topic filters are
+// found through a precomputed hash table, filters with '+' / '#' through a
+// trie of topic levels, so dispatch cost depends on the topic's length and
+// depth, not on how many filters are registered. A message is delivered to
+// every route whose filter matches it.
+//
+// Routes are added during init; dispatch runs on the MQTT task.
+
+#define MQTT_ROUTER_MAX_ROUTES   16
+#define MQTT_ROUTER_MAX_NODES    32     // trie nodes for wildcard filters
+#define MQTT_ROUTER_FILTER_MAX   64
+
+// Add a route, returns its id or -1 (invalid filter or tables full)
+int mqtt_router_add(const char *filter, int qos, mqtt_topic_handler_t handler, void *ctx);
+
+// Call the handler of every route matching topic, returns how many ran
+int mqtt_router_dispatch(const char *topic, int topic_len,
+                         const char *data, int data_len, const mqtt_reply_t *reply);
+
+int mqtt_router_count(void);
+
+// Filter and QoS of route id (for subscribing)
+const char *mqtt_router_filter(int id, int *qos);
+
+#ifdef __cplusplus
+}
+#endif
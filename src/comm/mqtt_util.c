@@ -1,19 +1,253 @@
 // ESP-IDF MQTT client utility
 
 #include "comm/mqtt_util.h"
+#include "comm/mqtt_outbox.h"
+#include "comm/mqtt_pubq.h"
+#include "comm/mqtt_router.h"
+#include "comm/boot_timeline.h"
+#include "comm/backoff.h"
+#define TRACE_TAG "MQTT"
+#include "comm/trace.h"
 #include <string.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "sdkconfig.h"
+#include "config.h"
 #include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_random.h"
+#include "esp_mac.h"
 #include "mqtt_client.h"
 
+#if STATIC_MEMORY_MODE && !defined(CONFIG_MQTT_CUSTOM_OUTBOX)
+#warning "STATIC_MEMORY_MODE: esp-mqtt still copies QoS 1/2 messages to the heap, enable CONFIG_MQTT_CUSTOM_OUTBOX"
+#endif
+
 static const char *TAG = "MQTT";
 
 static esp_mqtt_client_handle_t s_mqtt_client = NULL;
-static const char *s_topic_events = NULL;
-static const char *s_topic_cmd = NULL;
 static mqtt_cmd_handler_t s_cmd_handler = NULL;
 static bool s_connected = false;
+static bool s_outbox_enabled = false;
+static bool s_pubq_started = false;
+
+// Session profile (all zero = esp-mqtt defaults)
+static mqtt_session_config_t s_session;
+static char s_client_id[32];
+static int s_subscriptions_acked = 0;       // SUBACKs since the last full subscribe
+
+// Reconnect backoff and recovery timing
+static esp_timer_handle_t s_reconnect_timer = NULL;
+static uint8_t s_backoff_attempt = 0;
+static int64_t s_disconnect_us = 0;         // 0 = not recovering
+static mqtt_reconnect_stats_t s_reconnect_stats;
+
+// Latency probe (mqtt_start_latency_probe)
+#define PROBE_PAYLOAD_LEN   8           // esp_timer time of sending, little endian
+#define PROBE_STALE_US      10000000    // older answers were stuck somewhere, not slow
+
+static esp_timer_handle_t s_probe_timer = NULL;
+static const char *s_probe_topic = NULL;
+static mqtt_probe_cb_t s_probe_cb = NULL;
+
+// === MQTT 5 ===
+// Needs CONFIG_MQTT_PROTOCOL_5 in sdkconfig; mqtt5 in the session profile
+// selects it at runtime.
+#ifdef CONFIG_MQTT_PROTOCOL_5
+static bool s_mqtt5 = false;
+
+// Outgoing topic aliases, valid for the current connection only. The first
+// publish on a topic carries the name plus its alias, later QoS 0 ones
+// only the alias. QoS > 0 publishes keep the full name: esp-mqtt may
+// retransmit them after a reconnect, where the alias is no longer defined.
+typedef struct {
+    char topic[MQTT_PUBQ_TOPIC_MAX];
+    bool established;
+} topic_alias_t;
+
+static topic_alias_t s_aliases[MQTT5_TOPIC_ALIAS_MAX];
+static uint8_t s_alias_count = 0;
+static uint8_t s_alias_limit = 0;
+
+// Bumped by the event handler on every CONNACK; the publish path resets the
+// table under s_publish_lock when it sees a new value. The handler can't take
+// that lock itself: it runs in the esp-mqtt task with the client API lock
+// held, which a publisher holding s_publish_lock may be waiting for.
+static volatile uint32_t s_connect_gen = 0;
+static uint32_t s_alias_gen = 0;
+
+// Publish properties apply to the next publish only, so property + publish
+// must not interleave between the publisher task and outbox replay
+static SemaphoreHandle_t s_publish_lock = NULL;
+static StaticSemaphore_t s_publish_lock_buf;
+
+// Caller holds s_publish_lock
+static void topic_aliases_sync(void)
+{
+    uint32_t gen = s_connect_gen;
+    if (gen == s_alias_gen) {
+        return;
+    }
+    memset(s_aliases, 0, sizeof(s_aliases));
+    s_alias_count = 0;
+    s_alias_limit = s_session.topic_alias_max < MQTT5_TOPIC_ALIAS_MAX ? s_session.topic_alias_max : MQTT5_TOPIC_ALIAS_MAX;
+    s_alias_gen = gen;
+}
+
+// Alias index for topic (assigning a new one if there is room), -1 if none
+static int topic_alias_lookup(const char *topic)
+{
+    for (int i = 0; i < s_alias_count; i++) {
+        if (strcmp(s_aliases[i].topic, topic) == 0) {
+            return i;
+        }
+    }
+
+    if (s_alias_count >= s_alias_limit || strlen(topic) >= MQTT_PUBQ_TOPIC_MAX) {
+        return -1;
+    }
+    strcpy(s_aliases[s_alias_count].topic, topic);
+    s_aliases[s_alias_count].established = false;
+    return s_alias_count++;
+}
+
+// correlation != NULL marks a reply; replies go to one-off requester topics
+// and don't get aliases
+static int publish_v5(const char *topic, const uint8_t *data, int len, int qos, bool retain,
+                      const uint8_t *correlation, int correlation_len)
+{
+    xSemaphoreTake(s_publish_lock, portMAX_DELAY);
+    topic_aliases_sync();
+
+    int alias = (correlation == NULL) ? topic_alias_lookup(topic) : -1;
+    esp_mqtt5_publish_property_config_t props = {
+        .topic_alias = (uint16_t)(alias + 1),
+        .correlation_data = (const char *)correlation,
+        .correlation_data_len = (uint16_t)correlation_len,
+    };
+    esp_err_t err = esp_mqtt5_client_set_publish_property(s_mqtt_client, &props);
+
+    if (err != ESP_OK && alias >= 0) {
+        // esp-mqtt checks the alias against the CONNACK Topic Alias Maximum
+        // (which it doesn't expose), so a rejected alias is the broker's
+        // limit. Aliases are assigned in order: cap the table below this
+        // one and send the topic in full.
+        ESP_LOGW(TAG, "Topic alias %d rejected by broker limit", alias + 1);
+        s_alias_limit = (uint8_t)alias;
+        s_alias_count = (uint8_t)alias;
+        alias = -1;
+        props.topic_alias = 0;
+        err = esp_mqtt5_client_set_publish_property(s_mqtt_client, &props);
+    }
+    if (err != ESP_OK) {
+        ESP_LOGE(TAG, "Publish properties rejected: %s", esp_err_to_name(err));
+        xSemaphoreGive(s_publish_lock);
+        return -1;
+    }
+
+    const char *wire_topic = topic;
+    if (alias >= 0 && s_aliases[alias].established && qos == 0) {
+        wire_topic = "";
+    }
+    int msg_id = esp_mqtt_client_publish(s_mqtt_client, wire_topic, (const char *)data, len, qos, retain);
+    if (alias >= 0 && msg_id >= 0) {
+        s_aliases[alias].established = true;
+    }
+
+    xSemaphoreGive(s_publish_lock);
+    return msg_id;
+}
+
+// Response Topic / Correlation Data of an incoming command, false if absent
+static bool read_reply_props(const esp_mqtt_event_t *event, mqtt_reply_t *reply)
+{
+    const esp_mqtt5_event_property_t *prop = event->property;
+    if (!s_mqtt5 || prop == NULL || prop->response_topic == NULL || prop->response_topic_len <= 0) {
+        return false;
+    }
+    if (prop->response_topic_len >= MQTT_REPLY_TOPIC_MAX || prop->correlation_data_len > MQTT_REPLY_CORR_MAX) {
+        ESP_LOGW(TAG, "Response topic / correlation data too long, not replying");
+        return false;
+    }
+
+    memcpy(reply->topic, prop->response_topic, prop->response_topic_len);
+    reply->topic[prop->response_topic_len] = '\0';
+    reply->correlation_len = (uint8_t)prop->correlation_data_len;
+    if (prop->correlation_data_len > 0) {
+        memcpy(reply->correlation, prop->correlation_data, prop->correlation_data_len);
+    }
+    return true;
+}
+#endif // CONFIG_MQTT_PROTOCOL_5
+
+// Jittered so devices dropped by the same broker restart don't reconnect in step
+static uint32_t next_backoff_ms(void)
+{
+    uint32_t delay_ms = backoff_delay_ms(s_session.backoff_min_ms, s_session.backoff_max_ms,
+                                         s_backoff_attempt, esp_random());
+    if (s_backoff_attempt < UINT8_MAX) {
+        s_backoff_attempt++;
+    }
+    return delay_ms;
+}
+
+static void reconnect_timer_cb(void *arg)
+{
+    (void)arg;
+    s_reconnect_stats.reconnect_attempts++;
+    esp_mqtt_client_reconnect(s_mqtt_client);
+}
+
+static void schedule_reconnect(void)
+{
+    if (s_reconnect_timer == NULL) {
+        return;  // esp-mqtt auto reconnect is in charge
+    }
+
+    uint32_t delay_ms = next_backoff_ms();
+    s_reconnect_stats.last_backoff_ms = delay_ms;
+    esp_timer_stop(s_reconnect_timer);
+    esp_timer_start_once(s_reconnect_timer, (uint64_t)delay_ms * 1000);
+    ESP_LOGI(TAG, "Reconnecting in %lu ms (attempt %d)", (unsigned long)delay_ms, s_backoff_attempt);
+}
+
+static void subscribe_route(int id)
+{
+    int qos;
+    const char *filter = mqtt_router_filter(id, &qos);
+    int msg_id = esp_mqtt_client_subscribe(s_mqtt_client, filter, qos);
+    ESP_LOGI(TAG, "Subscribed to '%s' (msg_id=%d)", filter, msg_id);
+}
+
+static void subscribe_all(bool session_present)
+{
+    int count = mqtt_router_count();
+
+    // A resumed persistent session still holds the subscriptions
+    if (s_session.skip_resubscribe && s_session.persistent_session && session_present &&
+        s_subscriptions_acked >= count) {
+        ESP_LOGI(TAG, "Session resumed, keeping %d subscriptions", count);
+        return;
+    }
+
+    s_subscriptions_acked = 0;
+    for (int id = 0; id < count; id++) {
+        subscribe_route(id);
+    }
+}
+
+// Route for the command topic given to mqtt_init
+static void cmd_topic_handler(const char *topic, int topic_len, const char *payload, int len,
+                              const mqtt_reply_t *reply, void *ctx)
+{
+    (void)topic;
+    (void)topic_len;
+    (void)ctx;
+    if (s_cmd_handler) {
+        s_cmd_handler(payload, len, reply);
+    }
+}
 
 static void mqtt_event_handler(void *handler_args, esp_event_base_t base,
                                int32_t event_id, void *event_data)
@@ -22,31 +256,51 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base,
 
     switch (event_id) {
         case MQTT_EVENT_CONNECTED:
-            ESP_LOGI(TAG, "Connected to broker");
+            ESP_LOGI(TAG, "Connected to broker (session_present=%d)", event->session_present);
             s_connected = true;
-            // Subscribe to command topic
-            if (s_topic_cmd) {
-                int msg_id = esp_mqtt_client_subscribe(s_mqtt_client, s_topic_cmd, 2);
-                ESP_LOGI(TAG, "Subscribed to '%s' (msg_id=%d)", s_topic_cmd, msg_id);
+            s_backoff_attempt = 0;
+            boot_timeline_mark(BOOT_TL_MQTT_CONNACK);
+#ifdef CONFIG_MQTT_PROTOCOL_5
+            s_connect_gen++;
+#endif
+            subscribe_all(event->session_present);
+            if (s_outbox_enabled) {
+                mqtt_outbox_start_replay();
             }
             break;
 
         case MQTT_EVENT_DISCONNECTED:
             ESP_LOGW(TAG, "Disconnected from broker");
+            if (s_connected) {
+                s_reconnect_stats.disconnects++;
+                s_disconnect_us = esp_timer_get_time();
+            }
             s_connected = false;
+            schedule_reconnect();
             break;
 
         case MQTT_EVENT_SUBSCRIBED:
             ESP_LOGI(TAG, "Subscribed (msg_id=%d)", event->msg_id);
+            s_subscriptions_acked++;
             break;
 
         case MQTT_EVENT_DATA:
-            ESP_LOGI(TAG, "Message on topic '%.*s'", event->topic_len, event->topic);
-            // Check if this is our command topic
-            if (s_cmd_handler && s_topic_cmd &&
-                event->topic_len == (int)strlen(s_topic_cmd) &&
-                strncmp(event->topic, s_topic_cmd, event->topic_len) == 0) {
-                s_cmd_handler(event->data, event->data_len);
+            TRACE_I("Message: topic %d bytes, payload %d bytes", event->topic_len, event->data_len);
+            ESP_LOGD(TAG, "Message on topic '%.*s'", event->topic_len, event->topic);
+            {
+                mqtt_reply_t reply;
+                const mqtt_reply_t *reply_to = NULL;
+#ifdef CONFIG_MQTT_PROTOCOL_5
+                if (read_reply_props(event, &reply)) {
+                    reply_to = &reply;
+                }
+#else
+                (void)reply;
+#endif
+                if (mqtt_router_dispatch(event->topic, event->topic_len,
+                                         event->data, event->data_len, reply_to) == 0) {
+                    ESP_LOGW(TAG, "No route for '%.*s'", event->topic_len, event->topic);
+                }
             }
             break;
 
@@ -59,13 +313,84 @@ static void mqtt_event_handler(void *handler_args, esp_event_base_t base,
     }
 }
 
+static bool publish_now_ex(const char *topic, const uint8_t *data, int len, int qos, bool retain,
+                           const uint8_t *correlation, int correlation_len)
+{
+    if (!s_connected || !s_mqtt_client || !topic) {
+        return false;
+    }
+
+    int msg_id;
+#ifdef CONFIG_MQTT_PROTOCOL_5
+    if (s_mqtt5) {
+        msg_id = publish_v5(topic, data, len, qos, retain, correlation, correlation_len);
+    } else
+#endif
+    {
+        msg_id = esp_mqtt_client_publish(s_mqtt_client, topic, (const char *)data, len, qos, retain);
+    }
+    if (msg_id < 0) {
+        ESP_LOGE(TAG, "Publish failed");
+        return false;
+    }
+
+    TRACE_I("Published %d bytes (msg_id=%d, qos=%d)", len, msg_id, qos);
+    ESP_LOGD(TAG, "Published to '%s'", topic);
+    boot_timeline_mark(BOOT_TL_FIRST_PUBLISH);
+
+    if (s_disconnect_us != 0) {
+        uint32_t recovery_ms = (uint32_t)((esp_timer_get_time() - s_disconnect_us) / 1000);
+        s_disconnect_us = 0;
+        s_reconnect_stats.last_recovery_ms = recovery_ms;
+        if (recovery_ms > s_reconnect_stats.max_recovery_ms) {
+            s_reconnect_stats.max_recovery_ms = recovery_ms;
+        }
+        ESP_LOGI(TAG, "First publish %lu ms after disconnect", (unsigned long)recovery_ms);
+    }
+    return true;
+}
+
+static bool publish_now(const char *topic, const uint8_t *data, int len, int qos, bool retain)
+{
+    return publish_now_ex(topic, data, len, qos, retain, NULL, 0);
+}
+
+// Runs on the publisher task (or the caller before mqtt_init)
+static bool publish_sync(const char *topic, const uint8_t *data, int len, int qos, bool retain)
+{
+    // While offline or still replaying, queue behind older messages to keep order
+    if (s_outbox_enabled && (!s_connected || !mqtt_outbox_is_empty())) {
+        return mqtt_outbox_put(topic, data, len, qos, retain);
+    }
+
+    if (!s_connected) {
+        ESP_LOGW(TAG, "Cannot publish - not connected");
+        return false;
+    }
+    return publish_now(topic, data, len, qos, retain);
+}
+
+// Publisher task entry point: replies are only useful while the requester
+// is waiting, so they skip the outbox
+static bool publish_queued(const char *topic, const uint8_t *data, int len, int qos, bool retain,
+                           const uint8_t *correlation, int correlation_len)
+{
+    if (correlation != NULL) {
+        return publish_now_ex(topic, data, len, qos, retain, correlation, correlation_len);
+    }
+    return publish_sync(topic, data, len, qos, retain);
+}
+
 void mqtt_init(const char *host, uint16_t port,
-               const char *topic_events, const char *topic_cmd,
-               mqtt_cmd_handler_t cmd_handler)
+               const char *topic_cmd, int cmd_qos, mqtt_cmd_handler_t cmd_handler)
 {
-    s_topic_events = topic_events;
-    s_topic_cmd = topic_cmd;
     s_cmd_handler = cmd_handler;
+    if (topic_cmd) {
+        mqtt_router_add(topic_cmd, cmd_qos, cmd_topic_handler, NULL);
+    }
+
+    mqtt_pubq_init(publish_queued);
+    s_pubq_started = true;
 
     // Build broker URI
     char uri[128];
@@ -73,37 +398,205 @@ void mqtt_init(const char *host, uint16_t port,
 
     esp_mqtt_client_config_t mqtt_cfg = {
         .broker.address.uri = uri,
+        .session.disable_clean_session = s_session.persistent_session,
+        .session.keepalive = s_session.keepalive_s,     // 0 = esp-mqtt default
     };
 
+    if (s_session.client_id_prefix) {
+        // Persistent sessions are keyed by client id - derive it from the MAC
+        uint8_t mac[6] = {0};
+        esp_read_mac(mac, ESP_MAC_WIFI_STA);
+        snprintf(s_client_id, sizeof(s_client_id), "%s-%02x%02x%02x",
+                 s_session.client_id_prefix, mac[3], mac[4], mac[5]);
+        mqtt_cfg.credentials.client_id = s_client_id;
+    }
+
+    if (s_session.backoff_max_ms > 0) {
+        mqtt_cfg.network.disable_auto_reconnect = true;
+
+        const esp_timer_create_args_t timer_args = {
+            .callback = reconnect_timer_cb,
+            .name = "mqtt_reconnect",
+        };
+        ESP_ERROR_CHECK(esp_timer_create(&timer_args, &s_reconnect_timer));
+    }
+
+#ifdef CONFIG_MQTT_PROTOCOL_5
+    s_mqtt5 = s_session.mqtt5;
+    if (s_mqtt5) {
+        mqtt_cfg.session.protocol_ver = MQTT_PROTOCOL_V_5;
+        s_publish_lock = xSemaphoreCreateMutexStatic(&s_publish_lock_buf);
+    }
+#else
+    if (s_session.mqtt5) {
+        ESP_LOGW(TAG, "MQTT 5 requested but CONFIG_MQTT_PROTOCOL_5 is off, using 3.1.1");
+    }
+#endif
+
     s_mqtt_client = esp_mqtt_client_init(&mqtt_cfg);
     if (s_mqtt_client == NULL) {
         ESP_LOGE(TAG, "Failed to init MQTT client");
         return;
     }
 
+#ifdef CONFIG_MQTT_PROTOCOL_5
+    if (s_mqtt5) {
+        // In MQTT 5 a session ends at disconnect unless it has an expiry interval
+        esp_mqtt5_connection_property_config_t connect_props = {
+            .session_expiry_interval = s_session.persistent_session ? s_session.session_expiry_s : 0,
+        };
+        esp_mqtt5_client_set_connect_property(s_mqtt_client, &connect_props);
+    }
+#endif
+
     esp_mqtt_client_register_event(s_mqtt_client, ESP_EVENT_ANY_ID, mqtt_event_handler, NULL);
     esp_mqtt_client_start(s_mqtt_client);
+    boot_timeline_mark(BOOT_TL_MQTT_START);
 
-    ESP_LOGI(TAG, "Connecting to %s", uri);
+    ESP_LOGI(TAG, "Connecting to %s as '%s' (MQTT %s, %s session)", uri,
+             s_session.client_id_prefix ? s_client_id : "default",
+             mqtt_cfg.session.protocol_ver == MQTT_PROTOCOL_V_5 ? "5" : "3.1.1",
+             s_session.persistent_session ? "persistent" : "clean");
 }
 
-bool mqtt_publish_event(const char *payload)
+void mqtt_network_changed(bool up)
 {
-    if (!s_connected || !s_mqtt_client || !s_topic_events) {
-        ESP_LOGW(TAG, "Cannot publish - not connected or topic not set");
+    if (!up || s_mqtt_client == NULL || s_connected) {
+        return;
+    }
+
+    // Don't sit out the rest of a backoff that grew while WiFi was down:
+    // connect now so the outbox drains right away
+    ESP_LOGI(TAG, "Network up, reconnecting now");
+    s_backoff_attempt = 0;
+    if (s_reconnect_timer) {
+        esp_timer_stop(s_reconnect_timer);
+    }
+    s_reconnect_stats.reconnect_attempts++;
+    esp_mqtt_client_reconnect(s_mqtt_client);
+}
+
+// === Latency probe ===
+// The device publishes a timestamp to a topic it subscribes to. The uplink
+// leg leaves at once, but the broker's copy comes back through the AP's
+// power-save buffering like any command, so the round trip follows the
+// command arrival latency of the current power-save mode.
+
+static void probe_timer_cb(void *arg)
+{
+    (void)arg;
+    if (!s_connected) {
+        return;
+    }
+    uint64_t sent_us = (uint64_t)esp_timer_get_time();
+    uint8_t payload[PROBE_PAYLOAD_LEN];
+    for (int i = 0; i < PROBE_PAYLOAD_LEN; i++) {
+        payload[i] = (uint8_t)(sent_us >> (8 * i));
+    }
+    mqtt_publish(s_probe_topic, payload, sizeof(payload), 0, false);
+}
+
+static void probe_topic_handler(const char *topic, int topic_len, const char *payload, int len,
+                                const mqtt_reply_t *reply, void *ctx)
+{
+    (void)topic;
+    (void)topic_len;
+    (void)reply;
+    (void)ctx;
+    if (len != PROBE_PAYLOAD_LEN) {
+        return;
+    }
+    uint64_t sent_us = 0;
+    for (int i = 0; i < PROBE_PAYLOAD_LEN; i++) {
+        sent_us |= (uint64_t)(uint8_t)payload[i] << (8 * i);
+    }
+    int64_t age_us = esp_timer_get_time() - (int64_t)sent_us;
+    if (age_us < 0 || age_us > PROBE_STALE_US) {
+        return;  // from before a reboot, or replayed late
+    }
+    s_probe_cb((int64_t)sent_us);
+}
+
+bool mqtt_start_latency_probe(const char *topic, uint32_t interval_ms, mqtt_probe_cb_t on_sample)
+{
+    if (s_probe_timer != NULL || !mqtt_subscribe(topic, 0, probe_topic_handler, NULL)) {
         return false;
     }
+    s_probe_topic = topic;
+    s_probe_cb = on_sample;
 
-    int msg_id = esp_mqtt_client_publish(s_mqtt_client, s_topic_events, payload, 0, 2, 0);
-    if (msg_id < 0) {
-        ESP_LOGE(TAG, "Publish failed");
+    const esp_timer_create_args_t timer_args = {
+        .callback = probe_timer_cb,
+        .name = "mqtt_probe",
+    };
+    if (esp_timer_create(&timer_args, &s_probe_timer) != ESP_OK) {
         return false;
     }
+    esp_timer_start_periodic(s_probe_timer, (uint64_t)interval_ms * 1000);
+    return true;
+}
+
+void mqtt_set_session(const mqtt_session_config_t *config)
+{
+    s_session = *config;
+    if (s_session.backoff_min_ms == 0) {
+        s_session.backoff_min_ms = 1;
+    }
+}
 
-    ESP_LOGI(TAG, "Published event (msg_id=%d): %s", msg_id, payload);
+void mqtt_get_reconnect_stats(mqtt_reconnect_stats_t *stats)
+{
+    *stats = s_reconnect_stats;
+}
+
+bool mqtt_subscribe(const char *filter, int qos, mqtt_topic_handler_t handler, void *ctx)
+{
+    int id = mqtt_router_add(filter, qos, handler, ctx);
+    if (id < 0) {
+        return false;
+    }
+    if (s_connected) {
+        subscribe_route(id);
+    }
     return true;
 }
 
+bool mqtt_publish(const char *topic, const uint8_t *data, int len, int qos, bool retain)
+{
+    if (!topic) {
+        return false;
+    }
+
+    // Never touch the network from the caller's context (e.g. UART RX)
+    if (s_pubq_started) {
+        return mqtt_pubq_push(topic, data, len, qos, retain, NULL, 0);
+    }
+    return publish_sync(topic, data, len, qos, retain);
+}
+
+bool mqtt_publish_reply(const mqtt_reply_t *reply, const uint8_t *data, int len)
+{
+    if (!reply) {
+        return false;
+    }
+
+    if (s_pubq_started) {
+        return mqtt_pubq_push(reply->topic, data, len, 1, false,
+                              reply->correlation, reply->correlation_len);
+    }
+    return publish_now_ex(reply->topic, data, len, 1, false,
+                          reply->correlation, reply->correlation_len);
+}
+
+void mqtt_enable_outbox(const mqtt_outbox_config_t *config)
+{
+    mqtt_outbox_config_t cfg = *config;
+    cfg.publish = publish_now;
+    cfg.connected = mqtt_is_connected;
+    mqtt_outbox_init(&cfg);
+    s_outbox_enabled = true;
+}
+
 bool mqtt_is_connected(void)
 {
     return s_connected;
@@ -2,21 +2,91 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include "comm/mqtt_outbox.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
-// Callback type for receiving MQTT commands
-typedef void (*mqtt_cmd_handler_t)(const char *payload, int len);
+#define MQTT_REPLY_TOPIC_MAX  64
+#define MQTT_REPLY_CORR_MAX   32
+
+// Where to send the result of a command (MQTT 5 Response Topic + Correlation Data)
+typedef struct {
+    char topic[MQTT_REPLY_TOPIC_MAX];
+    uint8_t correlation[MQTT_REPLY_CORR_MAX];
+    uint8_t correlation_len;
+} mqtt_reply_t;
+
+// Callback type for receiving MQTT commands. reply is NULL unless the
+// command came in over MQTT 5 with a response topic; it is only valid
+// during the call.
+typedef void (*mqtt_cmd_handler_t)(const char *payload, int len, const mqtt_reply_t *reply);
+
+// Handler for a subscribed topic filter (topic is not NUL-terminated)
+typedef void (*mqtt_topic_handler_t)(const char *topic, int topic_len,
+                                     const char *payload, int len,
+                                     const mqtt_reply_t *reply, void *ctx);
+
+// Session / reconnect profile, set before mqtt_init (default: clean
+// session, esp-mqtt keepalive and fixed reconnect interval)
+typedef struct {
+    bool persistent_session;        // clean_session = 0, broker keeps subscriptions and QoS>0 messages
+    const char *client_id_prefix;   // client id "<prefix>-<MAC>", NULL = esp-mqtt default
+    int keepalive_s;                // 0 = esp-mqtt default
+    uint32_t backoff_min_ms;        // first reconnect delay
+    uint32_t backoff_max_ms;        // delay cap, 0 = esp-mqtt auto reconnect
+    bool skip_resubscribe;          // don't resubscribe when session_present is set
+    bool mqtt5;                     // MQTT 5 (needs CONFIG_MQTT_PROTOCOL_5)
+    uint8_t topic_alias_max;        // MQTT 5 outgoing topic aliases, 0 = off
+    uint32_t session_expiry_s;      // MQTT 5 persistent session lifetime
+} mqtt_session_config_t;
+
+typedef struct {
+    uint32_t disconnects;
+    uint32_t reconnect_attempts;
+    uint32_t last_backoff_ms;
+    uint32_t last_recovery_ms;      // disconnect -> first successful publish
+    uint32_t max_recovery_ms;
+} mqtt_reconnect_stats_t;
+
+void mqtt_set_session(const mqtt_session_config_t *config);
 
 // Initialize MQTT client and connect to broker
 void mqtt_init(const char *host, uint16_t port,
-               const char *topic_events, const char *topic_cmd,
-               mqtt_cmd_handler_t cmd_handler);
+               const char *topic_cmd, int cmd_qos, mqtt_cmd_handler_t cmd_handler);
+
+// Subscribe to a topic filter ('+' / '#' allowed) with its own handler and
+// QoS. Call during init; filters are (re)subscribed on every connect.
+bool mqtt_subscribe(const char *filter, int qos, mqtt_topic_handler_t handler, void *ctx);
+
+// Latency probe result: a probe sent at sent_us (esp_timer time) came back
+typedef void (*mqtt_probe_cb_t)(int64_t sent_us);
+
+// Every interval_ms while connected, publish a timestamp (QoS 0) to topic
+// and report it to on_sample when the broker echoes it back (the topic is
+// subscribed here). The round trip covers the same downlink path as
+// commands. Call during init.
+bool mqtt_start_latency_probe(const char *topic, uint32_t interval_ms, mqtt_probe_cb_t on_sample);
+
+// Publish raw payload (text or binary) to any topic. Once mqtt_init has run
+// the message is copied to the publish queue and sent from the publisher
+// task; returns false only if it could not be queued.
+bool mqtt_publish(const char *topic, const uint8_t *data, int len, int qos, bool retain);
+
+// Queue publishes in the outbox while disconnected and replay them on
+// reconnect (call before mqtt_init; config->publish is filled in here)
+void mqtt_enable_outbox(const mqtt_outbox_config_t *config);
+
+void mqtt_get_reconnect_stats(mqtt_reconnect_stats_t *stats);
+
+// Network link up/down (WiFi supervisor): on up, reconnect at once instead
+// of waiting out the backoff
+void mqtt_network_changed(bool up);
 
-// Publish an event message
-bool mqtt_publish_event(const char *payload);
+// Publish a command result to the requester's response topic, echoing its
+// correlation data (QoS 1, queued like mqtt_publish)
+bool mqtt_publish_reply(const mqtt_reply_t *reply, const uint8_t *data, int len);
 
 // Check if MQTT is connected
 bool mqtt_is_connected(void);
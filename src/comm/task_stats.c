@@ -0,0 +1,325 @@
+// Runtime task statistics and scheduling latency sampling
+
+#include "comm/task_stats.h"
+#include "comm/task_table.h"
+#include "comm/heap_watch.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include "sdkconfig.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+#ifdef CONFIG_MQTT_CUSTOM_OUTBOX
+#include "comm/mqtt_pool/mqtt_pool.h"
+#endif
+
+static const char *TAG = "TASK_STATS";
+
+#define REPORT_MAX_LEN  TASK_STATS_REPORT_MAX
+
+static const uint32_t latency_bucket_limits[TASK_LATENCY_BUCKETS - 1] = TASK_LATENCY_BUCKET_LIMITS;
+
+typedef struct {
+    const char *name;
+    task_id_t task;
+    TaskHandle_t handle;
+    int64_t woken_us;               // 0 = sampler idle
+    task_latency_t window;          // since the last report
+    task_latency_t total;
+} sampler_t;
+
+static sampler_t samplers[TASK_SAMPLER_COUNT] = {
+    [TASK_SAMPLER_UART] = { .name = "uart", .task = TASK_LAT_UART },
+    [TASK_SAMPLER_NET]  = { .name = "net",  .task = TASK_LAT_NET },
+};
+static portMUX_TYPE sampler_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static esp_timer_handle_t sample_timer = NULL;
+static uint32_t report_interval_ms = 0;
+static task_stats_report_cb report_cb = NULL;
+
+// === Latency samplers ===
+
+static void latency_add(task_latency_t *lat, uint32_t us)
+{
+    lat->samples++;
+    lat->sum_us += us;
+    if (us > lat->max_us) {
+        lat->max_us = us;
+    }
+    int bucket = 0;
+    while (bucket < TASK_LATENCY_BUCKETS - 1 && us > latency_bucket_limits[bucket]) {
+        bucket++;
+    }
+    lat->hist[bucket]++;
+}
+
+static void sampler_task(void *arg)
+{
+    sampler_t *sampler = arg;
+
+    while (true) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+        int64_t now = esp_timer_get_time();
+
+        portENTER_CRITICAL(&sampler_lock);
+        uint32_t us = (uint32_t)(now - sampler->woken_us);
+        sampler->woken_us = 0;
+        latency_add(&sampler->window, us);
+        latency_add(&sampler->total, us);
+        portEXIT_CRITICAL(&sampler_lock);
+    }
+}
+
+// esp_timer task: wake every sampler that has caught up
+static void sample_timer_cb(void *arg)
+{
+    (void)arg;
+    int64_t now = esp_timer_get_time();
+
+    for (int i = 0; i < TASK_SAMPLER_COUNT; i++) {
+        sampler_t *sampler = &samplers[i];
+        bool wake = false;
+
+        portENTER_CRITICAL(&sampler_lock);
+        if (sampler->woken_us == 0) {
+            sampler->woken_us = now;
+            wake = true;
+        } else {
+            sampler->window.missed++;
+            sampler->total.missed++;
+        }
+        portEXIT_CRITICAL(&sampler_lock);
+
+        if (wake) {
+            xTaskNotifyGive(sampler->handle);
+        }
+    }
+}
+
+void task_stats_get_latency(task_sampler_t sampler, task_latency_t *latency)
+{
+    portENTER_CRITICAL(&sampler_lock);
+    *latency = samplers[sampler].total;
+    portEXIT_CRITICAL(&sampler_lock);
+}
+
+// === Report ===
+
+#define TASK_ENTRY_MAX  128
+
+static char report[REPORT_MAX_LEN];
+static size_t report_len;
+static unsigned long report_t;
+
+static void append(char *buf, size_t cap, size_t *len, const char *fmt, ...)
+{
+    if (*len >= cap) {
+        return;
+    }
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(buf + *len, cap - *len, fmt, ap);
+    va_end(ap);
+    *len += n > 0 ? (size_t)n : 0;
+}
+
+#define report_append(...)  append(report, REPORT_MAX_LEN, &report_len, __VA_ARGS__)
+
+static void report_begin(void)
+{
+    report_len = 0;
+    report_append("{\"t\":%lu", report_t);
+}
+
+static void report_send(void)
+{
+    report_append("}");
+    if (report_len >= REPORT_MAX_LEN) {
+        ESP_LOGW(TAG, "Report part truncated");
+        return;
+    }
+    if (report_cb) {
+        report_cb(report, report_len);
+    }
+}
+
+#if CONFIG_FREERTOS_USE_TRACE_FACILITY
+static TaskStatus_t task_status[TASK_STATS_MAX_TASKS];
+
+// Run time counters of the previous report, matched by handle
+static struct {
+    TaskHandle_t handle;
+    uint32_t run_time;
+} last_run_time[TASK_STATS_MAX_TASKS];
+static uint32_t last_total_run_time = 0;
+
+static uint32_t previous_run_time(TaskHandle_t handle)
+{
+    for (int i = 0; i < TASK_STATS_MAX_TASKS; i++) {
+        if (last_run_time[i].handle == handle) {
+            return last_run_time[i].run_time;
+        }
+    }
+    return 0;
+}
+
+// The task list, split into parts of at most REPORT_MAX_LEN
+static void send_tasks(void)
+{
+    uint32_t total_run_time = 0;
+    UBaseType_t count = uxTaskGetSystemState(task_status, TASK_STATS_MAX_TASKS, &total_run_time);
+    if (count == 0) {
+        ESP_LOGW(TAG, "More than %d tasks, not listed", TASK_STATS_MAX_TASKS);
+    }
+#if CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+    uint32_t elapsed = total_run_time - last_total_run_time;
+#endif
+
+    report_begin();
+    report_append(",\"tasks\":[");
+    size_t list_start = report_len;
+    for (UBaseType_t i = 0; i < count; i++) {
+        const TaskStatus_t *task = &task_status[i];
+        char entry[TASK_ENTRY_MAX];
+        size_t entry_len = 0;
+        append(entry, sizeof(entry), &entry_len, "{\"n\":\"%s\"", task->pcTaskName);
+#if CONFIG_FREERTOS_VTASKLIST_INCLUDE_COREID
+        append(entry, sizeof(entry), &entry_len, ",\"core\":%d",
+               task->xCoreID == tskNO_AFFINITY ? -1 : (int)task->xCoreID);
+#endif
+        append(entry, sizeof(entry), &entry_len, ",\"prio\":%u", (unsigned)task->uxCurrentPriority);
+#if CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+        uint32_t ran = task->ulRunTimeCounter - previous_run_time(task->xHandle);
+        append(entry, sizeof(entry), &entry_len, ",\"cpu_pm\":%lu",
+               (unsigned long)(elapsed ? (uint64_t)ran * 1000 / elapsed : 0));
+#endif
+        append(entry, sizeof(entry), &entry_len, ",\"stack_free\":%lu}",
+               (unsigned long)task->usStackHighWaterMark);
+
+        // Separator, entry and the closing "]}" must still fit
+        if (report_len > list_start && report_len + 1 + entry_len + 2 >= REPORT_MAX_LEN) {
+            report_append("]");
+            report_send();
+            report_begin();
+            report_append(",\"tasks\":[");
+        }
+        report_append("%s%s", report_len > list_start ? "," : "", entry);
+    }
+    report_append("]");
+    report_send();
+
+    memset(last_run_time, 0, sizeof(last_run_time));
+    for (UBaseType_t i = 0; i < count; i++) {
+        last_run_time[i].handle = task_status[i].xHandle;
+        last_run_time[i].run_time = task_status[i].ulRunTimeCounter;
+    }
+    last_total_run_time = total_run_time;
+}
+#endif // CONFIG_FREERTOS_USE_TRACE_FACILITY
+
+static void append_latency(void)
+{
+    task_latency_t window[TASK_SAMPLER_COUNT];
+
+    portENTER_CRITICAL(&sampler_lock);
+    for (int i = 0; i < TASK_SAMPLER_COUNT; i++) {
+        window[i] = samplers[i].window;
+        memset(&samplers[i].window, 0, sizeof(samplers[i].window));
+    }
+    portEXIT_CRITICAL(&sampler_lock);
+
+    report_append(",\"lat\":{");
+    for (int i = 0; i < TASK_SAMPLER_COUNT; i++) {
+        const task_latency_t *lat = &window[i];
+        uint32_t over_1ms = 0;
+        for (int b = 1; b < TASK_LATENCY_BUCKETS; b++) {
+            if (latency_bucket_limits[b - 1] >= 1000) {
+                over_1ms += lat->hist[b];
+            }
+        }
+        report_append("%s\"%s\":{\"n\":%lu,\"avg\":%lu,\"max\":%lu,\"over_1ms\":%lu,\"missed\":%lu}",
+                      i ? "," : "", samplers[i].name, (unsigned long)lat->samples,
+                      (unsigned long)(lat->samples ? lat->sum_us / lat->samples : 0),
+                      (unsigned long)lat->max_us, (unsigned long)over_1ms, (unsigned long)lat->missed);
+    }
+    report_append("}");
+}
+
+static void append_heap(void)
+{
+    report_append(",\"heap\":{\"free\":%lu,\"min_free\":%lu,\"largest\":%lu",
+                  (unsigned long)heap_caps_get_free_size(MALLOC_CAP_8BIT),
+                  (unsigned long)heap_caps_get_minimum_free_size(MALLOC_CAP_8BIT),
+                  (unsigned long)heap_caps_get_largest_free_block(MALLOC_CAP_8BIT));
+
+    if (heap_watch_armed()) {
+        heap_watch_entry_t entries[HEAP_WATCH_MAX_TASKS];
+        int count = heap_watch_get(entries, HEAP_WATCH_MAX_TASKS);
+        uint32_t total = heap_watch_check();
+
+        // Only the tasks that allocated: normally none
+        report_append(",\"allocs\":%lu,\"by\":{", (unsigned long)total);
+        bool first = true;
+        for (int i = 0; i < count; i++) {
+            if (entries[i].allocs > 0) {
+                report_append("%s\"%s\":%lu", first ? "" : ",", entries[i].name,
+                              (unsigned long)entries[i].allocs);
+                first = false;
+            }
+        }
+        report_append("}");
+    }
+
+#ifdef CONFIG_MQTT_CUSTOM_OUTBOX
+    mqtt_pool_stats_t pool;
+    mqtt_pool_get_stats(&pool);
+    report_append(",\"mqtt_pool\":{\"used\":%lu,\"max\":%lu,\"rejected\":%lu}",
+                  (unsigned long)pool.used, (unsigned long)pool.max_used, (unsigned long)pool.rejected);
+#endif
+    report_append("}");
+}
+
+static void stats_task(void *arg)
+{
+    (void)arg;
+    TickType_t last_wake = xTaskGetTickCount();
+
+    while (true) {
+        vTaskDelayUntil(&last_wake, pdMS_TO_TICKS(report_interval_ms));
+
+        report_t = (unsigned long)(esp_timer_get_time() / 1000000);
+#if CONFIG_FREERTOS_USE_TRACE_FACILITY
+        send_tasks();
+#endif
+        report_begin();
+        append_heap();
+        append_latency();
+        report_send();
+    }
+}
+
+void task_stats_start(uint32_t interval_ms, task_stats_report_cb on_report)
+{
+    if (sample_timer != NULL || interval_ms == 0) {
+        return;
+    }
+    report_interval_ms = interval_ms;
+    report_cb = on_report;
+
+    for (int i = 0; i < TASK_SAMPLER_COUNT; i++) {
+        task_create(samplers[i].task, NULL, sampler_task, &samplers[i], &samplers[i].handle);
+    }
+
+    const esp_timer_create_args_t timer_args = {
+        .callback = sample_timer_cb,
+        .name = "task_stats",
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&timer_args, &sample_timer));
+    ESP_ERROR_CHECK(esp_timer_start_periodic(sample_timer, TASK_STATS_SAMPLE_MS * 1000));
+
+    task_create(TASK_TASK_STATS, NULL, stats_task, NULL, NULL);
+}
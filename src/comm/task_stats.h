@@ -0,0 +1,64 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Runtime task statistics, reported every interval:
+// - CPU share and stack high-water mark of every task in the system (ours
+//   and ESP-IDF's: WiFi, lwIP, esp-mqtt). Needs CONFIG_FREERTOS_USE_TRACE_FACILITY
+//   and CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS.
+// - Scheduling latency per core: a sampler task at tf_transport's priority
+//   on the UART core, and one on the network core, are woken every
+//   TASK_STATS_SAMPLE_MS. The time from the wake-up to the sampler running
+//   is what a UART frame waits before tf_transport can parse it.
+// - Heap: free, low-water mark and largest block, and once the boot is done
+//   the heap allocations made by the app's tasks (see heap_watch.h).
+
+#define TASK_STATS_SAMPLE_MS    50
+#define TASK_STATS_MAX_TASKS    32
+
+// Scheduling latency histogram, upper bounds in us (last bucket is open)
+#define TASK_LATENCY_BUCKET_LIMITS  { 50, 100, 200, 500, 1000, 2000, 5000 }
+#define TASK_LATENCY_BUCKETS        8
+
+typedef struct {
+    uint32_t samples;
+    uint32_t missed;                // sampler still not run at the next wake-up
+    uint32_t max_us;
+    uint64_t sum_us;
+    uint32_t hist[TASK_LATENCY_BUCKETS];
+} task_latency_t;
+
+typedef enum {
+    TASK_SAMPLER_UART,
+    TASK_SAMPLER_NET,
+    TASK_SAMPLER_COUNT
+} task_sampler_t;
+
+// Largest report message; the report is split so every part fits one
+// publish queue slot
+#define TASK_STATS_REPORT_MAX   512
+
+// Called from the stats task once per report part, as compact JSON. The
+// task list comes first, in as many parts as it needs, then the summary;
+// all parts of one report carry the same t:
+// {"t":S,"tasks":[{"n":"tf_transport","core":1,"prio":5,"cpu_pm":12,"stack_free":2100},...]}
+// {"t":S,"heap":{"free":N,"min_free":N,"largest":N,"allocs":0,"by":{},"mqtt_pool":{"used":0,"max":3,"rejected":0}},
+//  "lat":{"uart":{"n":600,"avg":18,"max":95,"over_1ms":0,"missed":0},"net":{...}}}
+// cpu_pm is per mille of one core over the interval.
+typedef void (*task_stats_report_cb)(const char *json, size_t len);
+
+// Start the samplers and the stats task
+void task_stats_start(uint32_t interval_ms, task_stats_report_cb on_report);
+
+// Latency since start (the report covers one interval)
+void task_stats_get_latency(task_sampler_t sampler, task_latency_t *latency);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,81 @@
+// Task table: core affinity, priority and stack of every app task
+
+#include "comm/task_table.h"
+#include "comm/heap_watch.h"
+#include "esp_log.h"
+
+static const char *TAG = "TASKS";
+
+#define TASK_TABLE_GEN_SPEC(id, task_name, task_core, prio, stack_bytes, alloc) \
+    [TASK_##id] = { .name = task_name, .core = task_core, .priority = prio, .stack = stack_bytes, .storage = alloc },
+
+static const task_spec_t task_specs[TASK_COUNT] = {
+    TASK_TABLE(TASK_TABLE_GEN_SPEC)
+};
+
+#if STATIC_MEMORY_MODE
+// Stack and TCB per static task (zero-sized for heap tasks). ESP-IDF
+// counts stack depth in bytes, StackType_t is one byte.
+#define TASK_TABLE_GEN_STORAGE(id, task_name, task_core, prio, stack_bytes, alloc) \
+    static StackType_t task_stack_##id[(alloc) == TASK_ALLOC_STATIC ? (stack_bytes) / sizeof(StackType_t) : 0]; \
+    static StaticTask_t task_tcb_##id[(alloc) == TASK_ALLOC_STATIC ? 1 : 0];
+
+TASK_TABLE(TASK_TABLE_GEN_STORAGE)
+
+#define TASK_TABLE_GEN_BUFFERS(id, task_name, task_core, prio, stack_bytes, alloc) \
+    [TASK_##id] = { task_stack_##id, task_tcb_##id },
+
+static const struct {
+    StackType_t *stack;
+    StaticTask_t *tcb;
+} task_buffers[TASK_COUNT] = {
+    TASK_TABLE(TASK_TABLE_GEN_BUFFERS)
+};
+
+static bool task_created[TASK_COUNT];
+#endif
+
+const task_spec_t *task_spec(task_id_t id)
+{
+    return (unsigned)id < TASK_COUNT ? &task_specs[id] : NULL;
+}
+
+bool task_create(task_id_t id, const char *name, TaskFunction_t fn, void *arg, TaskHandle_t *handle)
+{
+    const task_spec_t *spec = task_spec(id);
+    if (spec == NULL) {
+        return false;
+    }
+    if (name == NULL) {
+        name = spec->name;
+    }
+
+    TaskHandle_t task = NULL;
+#if STATIC_MEMORY_MODE
+    if (spec->storage == TASK_ALLOC_STATIC) {
+        if (task_created[id]) {
+            ESP_LOGE(TAG, "%s already running, static stack in use", name);
+            return false;
+        }
+        task_created[id] = true;
+        task = xTaskCreateStaticPinnedToCore(fn, name, spec->stack, arg, spec->priority,
+                                             task_buffers[id].stack, task_buffers[id].tcb, spec->core);
+    } else
+#endif
+    if (xTaskCreatePinnedToCore(fn, name, spec->stack, arg, spec->priority, &task, spec->core) != pdPASS) {
+        task = NULL;
+    }
+
+    if (task == NULL) {
+        ESP_LOGE(TAG, "Cannot create %s", name);
+        return false;
+    }
+    // Long-lived tasks are expected not to allocate once the boot is done
+    if (spec->storage == TASK_ALLOC_STATIC) {
+        heap_watch_task(task, name);
+    }
+    if (handle) {
+        *handle = task;
+    }
+    return true;
+}
@@ -0,0 +1,64 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "config.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Every task the application creates, with its core, priority and stack.
+// Core 0 runs the network: the WiFi driver (CONFIG_ESP_WIFI_TASK_PINNED_TO_CORE_0),
+// lwIP and the esp-mqtt client are pinned there in sdkconfig, as is the
+// esp_timer task. Core 1 is kept for the UART link to the MAX32655, so WiFi
+// bursts never compete with frame parsing.
+#define TASK_CORE_NET       0
+#define TASK_CORE_UART      1
+#define TASK_CORE_ANY       tskNO_AFFINITY
+
+// Stack and TCB storage. With STATIC_MEMORY_MODE, TASK_ALLOC_STATIC tasks
+// get a stack and TCB in .bss (one instance each, created once); otherwise
+// every task is allocated from the heap. TASK_ALLOC_HEAP is for start-up
+// tasks that run several at once and exit before the steady state.
+#define TASK_ALLOC_HEAP     0
+#define TASK_ALLOC_STATIC   1
+
+// X(ID, name, core, priority, stack bytes, storage)
+#define TASK_TABLE(X) \
+    X(TF_TRANSPORT, "tf_transport", TASK_CORE_UART, 5, 4096, TASK_ALLOC_STATIC)  /* UART RX + TinyFrame */ \
+    X(PROTOCOL,     "protocol",     TASK_CORE_UART, 4, 4096, TASK_ALLOC_STATIC)  /* heartbeat, command retries */ \
+    X(LAT_UART,     "lat_uart",     TASK_CORE_UART, 5, 2048, TASK_ALLOC_STATIC)  /* latency sampler, tf_transport's slot */ \
+    X(MQTT_PUB,     "mqtt_pub",     TASK_CORE_NET,  3, 4096, TASK_ALLOC_STATIC)  /* publish queue */ \
+    X(LAT_NET,      "lat_net",      TASK_CORE_NET,  5, 2048, TASK_ALLOC_STATIC)  /* same sampler on the network core */ \
+    X(TRACE,        "trace",        TASK_CORE_NET,  1, 3072, TASK_ALLOC_STATIC)  /* deferred log formatting */ \
+    X(TASK_STATS,   "task_stats",   TASK_CORE_NET,  1, 3072, TASK_ALLOC_STATIC) \
+    X(BOOT_STAGE,   "boot_stage",   TASK_CORE_ANY,  1, 4096, TASK_ALLOC_HEAP)    /* start-up stages (named per stage) */
+
+#define TASK_TABLE_GEN_ENUM(id, name, core, prio, stack, storage)   TASK_##id,
+
+typedef enum {
+    TASK_TABLE(TASK_TABLE_GEN_ENUM)
+    TASK_COUNT
+} task_id_t;
+
+typedef struct {
+    const char *name;
+    BaseType_t core;
+    UBaseType_t priority;
+    uint32_t stack;
+    uint8_t storage;                // TASK_ALLOC_x
+} task_spec_t;
+
+const task_spec_t *task_spec(task_id_t id);
+
+// Create a task as planned; name NULL = the table's name. A static task
+// can only be created once. *handle is set after creation, when the task
+// may already be running on the other core.
+bool task_create(task_id_t id, const char *name, TaskFunction_t fn, void *arg, TaskHandle_t *handle);
+
+#ifdef __cplusplus
+}
+#endif
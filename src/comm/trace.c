@@ -0,0 +1,178 @@
+// Deferred trace log
+
+#include "comm/trace.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+#include "esp_timer.h"
+#include "comm/task_table.h"
+
+#define TRACE_DRAIN_MS          100
+
+_Static_assert((TRACE_RING_RECORDS & (TRACE_RING_RECORDS - 1)) == 0,
+               "TRACE_RING_RECORDS must be a power of two");
+
+typedef struct {
+    uint32_t seq;                   // index + 1 once the record is complete
+    const trace_site_t *site;
+    int64_t timestamp_us;
+    uint32_t args[TRACE_MAX_ARGS];
+} trace_record_t;
+
+// Multi-producer, single-consumer. A writer claims a slot by advancing head
+// with a CAS (the record is dropped if the consumer is a full ring behind),
+// fills it in and publishes it by storing seq last. One ring per core keeps
+// the CAS uncontended; a task that migrates between reading the core id and
+// claiming a slot is still safe, only slower.
+typedef struct {
+    uint32_t head;                  // next slot to claim
+    uint32_t tail;                  // next slot to format
+    uint32_t dropped;
+    uint32_t dropped_reported;
+    trace_record_t records[TRACE_RING_RECORDS];
+} trace_ring_t;
+
+static trace_ring_t rings[portNUM_PROCESSORS];
+static uint32_t written = 0;
+static uint32_t max_pending = 0;
+static SemaphoreHandle_t drain_lock = NULL;
+static StaticSemaphore_t drain_lock_buf;
+
+static const char level_chars[] = { 'N', 'E', 'W', 'I', 'D' };
+
+void trace_write(const trace_site_t *site, ...)
+{
+    int64_t now = esp_timer_get_time();
+    trace_ring_t *ring = &rings[xPortGetCoreID()];
+
+    uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+    uint32_t pending;
+    do {
+        pending = head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+        if (pending >= TRACE_RING_RECORDS) {
+            __atomic_fetch_add(&ring->dropped, 1, __ATOMIC_RELAXED);
+            return;
+        }
+    } while (!__atomic_compare_exchange_n(&ring->head, &head, head + 1, true,
+                                          __ATOMIC_ACQUIRE, __ATOMIC_RELAXED));
+
+    trace_record_t *rec = &ring->records[head & (TRACE_RING_RECORDS - 1)];
+    rec->site = site;
+    rec->timestamp_us = now;
+
+    va_list ap;
+    va_start(ap, site);
+    for (uint8_t i = 0; i < site->nargs; i++) {
+        rec->args[i] = va_arg(ap, uint32_t);
+    }
+    va_end(ap);
+
+    __atomic_store_n(&rec->seq, head + 1, __ATOMIC_RELEASE);
+
+    // Stats only, races between cores just lose a count
+    written++;
+    if (pending + 1 > max_pending) {
+        max_pending = pending + 1;
+    }
+}
+
+// Oldest complete record of a ring, NULL if none is ready
+static trace_record_t *ring_peek(trace_ring_t *ring)
+{
+    uint32_t tail = ring->tail;
+    trace_record_t *rec = &ring->records[tail & (TRACE_RING_RECORDS - 1)];
+    if (tail == __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) ||
+        __atomic_load_n(&rec->seq, __ATOMIC_ACQUIRE) != tail + 1) {
+        return NULL;
+    }
+    return rec;
+}
+
+static void format_record(const trace_record_t *rec)
+{
+    const trace_site_t *site = rec->site;
+    const uint32_t *a = rec->args;
+
+    // Same layout as ESP_LOG: "I (1234) TAG: message"
+    printf("%c (%lu) %s: ", level_chars[site->level], (unsigned long)(rec->timestamp_us / 1000), site->tag);
+    printf(site->fmt, a[0], a[1], a[2], a[3]);
+    putchar('\n');
+}
+
+static void report_dropped(trace_ring_t *ring, int core)
+{
+    uint32_t dropped = __atomic_load_n(&ring->dropped, __ATOMIC_RELAXED);
+    if (dropped != ring->dropped_reported) {
+        printf("W TRACE: %lu records dropped on core %d\n",
+               (unsigned long)(dropped - ring->dropped_reported), core);
+        ring->dropped_reported = dropped;
+    }
+}
+
+// Format pending records of all cores in timestamp order
+static void drain(void)
+{
+    for (;;) {
+        int oldest = -1;
+        trace_record_t *rec = NULL;
+        for (int core = 0; core < portNUM_PROCESSORS; core++) {
+            trace_record_t *candidate = ring_peek(&rings[core]);
+            if (candidate && (rec == NULL || candidate->timestamp_us < rec->timestamp_us)) {
+                rec = candidate;
+                oldest = core;
+            }
+        }
+        if (rec == NULL) {
+            break;
+        }
+
+        format_record(rec);
+        __atomic_store_n(&rings[oldest].tail, rings[oldest].tail + 1, __ATOMIC_RELEASE);
+    }
+
+    for (int core = 0; core < portNUM_PROCESSORS; core++) {
+        report_dropped(&rings[core], core);
+    }
+}
+
+void trace_flush(void)
+{
+    if (drain_lock == NULL) {
+        drain();  // before trace_init: single task
+        return;
+    }
+    xSemaphoreTake(drain_lock, portMAX_DELAY);
+    drain();
+    xSemaphoreGive(drain_lock);
+}
+
+static void trace_task(void *arg)
+{
+    (void)arg;
+    for (;;) {
+        vTaskDelay(pdMS_TO_TICKS(TRACE_DRAIN_MS));
+        trace_flush();
+    }
+}
+
+void trace_init(void)
+{
+    if (drain_lock != NULL) {
+        return;
+    }
+    drain_lock = xSemaphoreCreateMutexStatic(&drain_lock_buf);
+    task_create(TASK_TRACE, NULL, trace_task, NULL, NULL);
+}
+
+void trace_get_stats(trace_stats_t *stats)
+{
+    stats->written = written;
+    stats->dropped = 0;
+    for (int core = 0; core < portNUM_PROCESSORS; core++) {
+        stats->dropped += __atomic_load_n(&rings[core].dropped, __ATOMIC_RELAXED);
+    }
+    stats->max_pending = max_pending;
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "config.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Deferred trace log for hot paths (UART frames, MQTT publishes). A call
+// site stores a pointer to its static descriptor (tag, level, format), a
+// timestamp and up to TRACE_MAX_ARGS raw integer arguments in a lock-free
+// ring per core. A low-priority task formats the records later, or the
+// caller can force it with trace_flush(). Sites above TRACE_LEVEL are
+// removed by the preprocessor.
+//
+// Arguments are copied as 32-bit integers, so formats may only use int
+// sized conversions (%d %u %x %c); a string pointer would be formatted
+// after its buffer is gone. Use ESP_LOG for anything with text.
+//
+// Each file defines TRACE_TAG before including this header.
+
+#define TRACE_LEVEL_NONE    0
+#define TRACE_LEVEL_ERROR   1
+#define TRACE_LEVEL_WARN    2
+#define TRACE_LEVEL_INFO    3
+#define TRACE_LEVEL_DEBUG   4
+
+#ifndef TRACE_LEVEL
+#define TRACE_LEVEL         TRACE_LEVEL_INFO
+#endif
+
+#ifndef TRACE_RING_RECORDS
+#define TRACE_RING_RECORDS  64      // per core, power of two
+#endif
+
+#ifndef TRACE_TAG
+#define TRACE_TAG           "APP"
+#endif
+
+#define TRACE_MAX_ARGS      4
+
+typedef struct {
+    uint8_t level;
+    uint8_t nargs;
+    const char *tag;
+    const char *fmt;
+} trace_site_t;
+
+typedef struct {
+    uint32_t written;
+    uint32_t dropped;               // ring full, record lost
+    uint32_t max_pending;           // high-water mark of unformatted records
+} trace_stats_t;
+
+// Start the formatting task (records written before this are kept)
+void trace_init(void);
+
+// Format every pending record now, from the caller's task
+void trace_flush(void);
+
+void trace_get_stats(trace_stats_t *stats);
+
+// Called through the TRACE_x macros; arguments are site->nargs ints
+void trace_write(const trace_site_t *site, ...);
+
+// Never called: lets the compiler check arguments against the format
+static inline __attribute__((format(printf, 1, 2))) void trace_check_format(const char *fmt, ...)
+{
+    (void)fmt;
+}
+
+#define TRACE_NARGS(...)    TRACE_NARGS_(0, ##__VA_ARGS__, 6, 5, 4, 3, 2, 1, 0)
+#define TRACE_NARGS_(_0, _1, _2, _3, _4, _5, _6, n, ...) n
+
+#define TRACE_AT(lvl, format, ...) do { \
+        _Static_assert(TRACE_NARGS(__VA_ARGS__) <= TRACE_MAX_ARGS, "too many trace arguments"); \
+        static const trace_site_t trace_site_ = { \
+            .level = (lvl), .nargs = TRACE_NARGS(__VA_ARGS__), .tag = TRACE_TAG, .fmt = (format), \
+        }; \
+        if (0) { \
+            trace_check_format(format, ##__VA_ARGS__); \
+        } \
+        trace_write(&trace_site_, ##__VA_ARGS__); \
+    } while (0)
+
+#define TRACE_DISCARD(...)  do { } while (0)
+
+#if TRACE_LEVEL >= TRACE_LEVEL_ERROR
+#define TRACE_E(format, ...) TRACE_AT(TRACE_LEVEL_ERROR, format, ##__VA_ARGS__)
+#else
+#define TRACE_E(...)        TRACE_DISCARD()
+#endif
+
+#if TRACE_LEVEL >= TRACE_LEVEL_WARN
+#define TRACE_W(format, ...) TRACE_AT(TRACE_LEVEL_WARN, format, ##__VA_ARGS__)
+#else
+#define TRACE_W(...)        TRACE_DISCARD()
+#endif
+
+#if TRACE_LEVEL >= TRACE_LEVEL_INFO
+#define TRACE_I(format, ...) TRACE_AT(TRACE_LEVEL_INFO, format, ##__VA_ARGS__)
+#else
+#define TRACE_I(...)        TRACE_DISCARD()
+#endif
+
+#if TRACE_LEVEL >= TRACE_LEVEL_DEBUG
+#define TRACE_D(format, ...) TRACE_AT(TRACE_LEVEL_DEBUG, format, ##__VA_ARGS__)
+#else
+#define TRACE_D(...)        TRACE_DISCARD()
+#endif
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,81 @@
+#ifndef CAPTURE_FORMAT_H
+#define CAPTURE_FORMAT_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Binary trace of the raw UART byte stream, written by the tf_transport
+// capture and read by tools/uart_replay. Integers are little-endian.
+//
+//   header   "UCAP"  u8 version  u8 flags  u16 reserved  u32 baud  u32 records_len
+//   record   varint  time since the previous record (us)
+//            varint  len << 2 | kind
+//            len bytes
+//
+// RX records hold one UART read, TX records one write to the driver. A
+// TIME record holds the 8-byte esp_timer time (us) the following deltas
+// count from; a trace starts with one.
+
+#define CAPTURE_MAGIC           "UCAP"
+#define CAPTURE_VERSION         1
+#define CAPTURE_HEADER_SIZE     16
+#define CAPTURE_VARINT_MAX      10
+
+// Header flags
+#define CAPTURE_FLAG_WRAPPED    0x01    // older traffic was dropped to make room
+
+typedef enum {
+    CAPTURE_RX = 0,
+    CAPTURE_TX = 1,
+    CAPTURE_TIME = 2,
+} capture_kind_t;
+
+static inline size_t capture_put_varint(uint8_t *out, uint64_t value)
+{
+    size_t n = 0;
+    while (value >= 0x80) {
+        out[n++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    out[n++] = (uint8_t)value;
+    return n;
+}
+
+// Returns the bytes used, 0 if truncated or too long
+static inline size_t capture_get_varint(const uint8_t *in, size_t avail, uint64_t *value)
+{
+    uint64_t v = 0;
+    for (size_t n = 0; n < avail && n < CAPTURE_VARINT_MAX; n++) {
+        v |= (uint64_t)(in[n] & 0x7f) << (7 * n);
+        if (!(in[n] & 0x80)) {
+            *value = v;
+            return n + 1;
+        }
+    }
+    return 0;
+}
+
+static inline void capture_put_u32(uint8_t *out, uint32_t value)
+{
+    for (int i = 0; i < 4; i++) {
+        out[i] = (uint8_t)(value >> (8 * i));
+    }
+}
+
+static inline uint32_t capture_get_u32(const uint8_t *in)
+{
+    return (uint32_t)in[0] | (uint32_t)in[1] << 8 | (uint32_t)in[2] << 16 | (uint32_t)in[3] << 24;
+}
+
+static inline void capture_put_header(uint8_t *out, uint8_t flags, uint32_t baud, uint32_t records_len)
+{
+    out[0] = 'U'; out[1] = 'C'; out[2] = 'A'; out[3] = 'P';
+    out[4] = CAPTURE_VERSION;
+    out[5] = flags;
+    out[6] = 0;
+    out[7] = 0;
+    capture_put_u32(out + 8, baud);
+    capture_put_u32(out + 12, records_len);
+}
+
+#endif // CAPTURE_FORMAT_H
@@ -0,0 +1,85 @@
+#include "clock_sync.h"
+#include <stdio.h>
+#include <string.h>
+
+// Samples with a round trip above 2x the best recent one were queued
+// somewhere and would skew the offset, so they are ignored
+#define RTT_REJECT_FACTOR   2
+#define RTT_REJECT_SLACK_US 500
+
+// Drift is only re-estimated over spans long enough to see it
+#define DRIFT_MIN_SPAN_US   1000000LL
+#define DRIFT_MAX_PPM       1000
+
+// Past this gap the 32-bit MAX delta may have wrapped - start over
+#define MAX_REF_AGE_US      (30LL * 60 * 1000000)
+
+static bool valid = false;
+static int64_t local_ref = 0;    // esp_timer us at reference point
+static uint32_t max_ref = 0;     // MAX us at the same instant
+static clock_sync_stats_t stats;
+
+void clock_sync_reset(void)
+{
+    valid = false;
+    memset(&stats, 0, sizeof(stats));
+}
+
+void clock_sync_update(int64_t t1, uint32_t t2, uint32_t t3, int64_t t4)
+{
+    int64_t rtt = (t4 - t1) - (int64_t)(uint32_t)(t3 - t2);
+    if (rtt < 0) {
+        rtt = 0;
+    }
+
+    // Let the filter reference creep up so a slower link is re-learned
+    if (stats.samples == 0 || (uint32_t)rtt < stats.min_rtt_us) {
+        stats.min_rtt_us = (uint32_t)rtt;
+    } else {
+        stats.min_rtt_us += stats.min_rtt_us / 8 + 1;
+    }
+
+    if (valid && rtt > (int64_t)stats.min_rtt_us * RTT_REJECT_FACTOR + RTT_REJECT_SLACK_US) {
+        stats.rejected++;
+        return;
+    }
+
+    // Midpoints of both sides are taken to be the same instant
+    int64_t local_mid = t1 + (t4 - t1) / 2;
+    uint32_t max_mid = t2 + (uint32_t)(t3 - t2) / 2;
+
+    int64_t span = local_mid - local_ref;
+    if (valid && span > MAX_REF_AGE_US) {
+        valid = false;
+    }
+
+    if (valid && span >= DRIFT_MIN_SPAN_US) {
+        int64_t max_span = (int32_t)(max_mid - max_ref);
+        int32_t ppm = (int32_t)((max_span - span) * 1000000 / span);
+        if (ppm > DRIFT_MAX_PPM) ppm = DRIFT_MAX_PPM;
+        if (ppm < -DRIFT_MAX_PPM) ppm = -DRIFT_MAX_PPM;
+        stats.drift_ppm += (ppm - stats.drift_ppm) / 4;
+    }
+
+    local_ref = local_mid;
+    max_ref = max_mid;
+    valid = true;
+    stats.last_rtt_us = (uint32_t)rtt;
+    stats.samples++;
+}
+
+bool clock_sync_is_valid(void)
+{
+    return valid;
+}
+
+int64_t clock_sync_to_local(uint32_t max_time_us)
+{
+    int64_t delta = (int32_t)(max_time_us - max_ref);
+    return local_ref + delta - delta * stats.drift_ppm / 1000000;
+}
+
+void clock_sync_get_stats(clock_sync_stats_t *out)
+{
+    *out = stats;
+}
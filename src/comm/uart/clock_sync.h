@@ -0,0 +1,33 @@
+#ifndef CLOCK_SYNC_H
+#define CLOCK_SYNC_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Estimates the MAX32655 clock relative to esp_timer from NTP-style
+// exchanges (see time_sync_msg_t). Not thread safe: call from the
+// TinyFrame task only (listeners run there).
+
+typedef struct {
+    int32_t  drift_ppm;       // MAX clock rate minus ESP clock rate
+    uint32_t last_rtt_us;     // round trip of last accepted exchange
+    uint32_t min_rtt_us;      // filter reference
+    uint32_t samples;         // accepted exchanges
+    uint32_t rejected;        // exchanges dropped as queued/delayed
+} clock_sync_stats_t;
+
+// Forget the current estimate (e.g. after MAX32655 reset)
+void clock_sync_reset(void);
+
+// Feed one completed exchange: t1/t4 are esp_timer us, t2/t3 MAX us
+void clock_sync_update(int64_t t1, uint32_t t2, uint32_t t3, int64_t t4);
+
+// True once at least one exchange has been accepted
+bool clock_sync_is_valid(void);
+
+// Convert a MAX timestamp to esp_timer us (only meaningful when valid)
+int64_t clock_sync_to_local(uint32_t max_time_us);
+
+void clock_sync_get_stats(clock_sync_stats_t *stats);
+
+#endif // CLOCK_SYNC_H
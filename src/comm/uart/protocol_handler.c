@@ -1,5 +1,11 @@
 #include "protocol_handler.h"
 #include "tf_transport.h"
+#include "clock_sync.h"
+#include "esp_timer.h"
+#include "comm/boot_timeline.h"
+#include "comm/task_table.h"
+#define TRACE_TAG "PROTO"
+#include "comm/trace.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include <stdio.h>
@@ -11,16 +17,39 @@ static protocol_config_t proto_config;
 // Heartbeat counter
 static uint32_t heartbeat_counter = 0;
 
+// Capabilities we support, and what has been agreed with the MAX32655
+#define LOCAL_CAPS  (PROTO_CAP_COMPACT_CMD | PROTO_CAP_TIMESTAMPS | PROTO_CAP_CMD_SEQ)
+static volatile uint8_t peer_caps = 0;
+static volatile bool caps_known = false;
+
 // Task handle
 static TaskHandle_t protocol_task_handle = NULL;
 
+// === Typed listeners ===
+// DEFINE_TYPED_LISTENER(name, type, on_invalid) generates name##_listener(),
+// which decodes the frame with the schema codec proto_decode_<name>() and
+// hands the result to handle_<name>(const type *, TF_Msg *).
+
+#define DEFINE_TYPED_LISTENER(name, type, on_invalid) \
+    static TF_Result name##_listener(TinyFrame *tf, TF_Msg *msg) \
+    { \
+        (void)tf; \
+        type decoded; \
+        if (!proto_decode_##name(msg->data, msg->len, &decoded)) { \
+            TRACE_W("Invalid " #name " len=%d", msg->len); \
+            return on_invalid; \
+        } \
+        return handle_##name(&decoded, msg); \
+    }
+
 // === Heartbeat handling ===
 
 static TF_Result heartbeat_response_listener(TinyFrame *tf, TF_Msg *msg)
 {
     (void)tf;
 
-    printf("[PROTO] RX HB response: %.*s\n", msg->len, (const char *)msg->data);
+    TRACE_I("RX HB response len=%d", msg->len);
+    boot_timeline_mark(BOOT_TL_MAX_HEARTBEAT);
 
     if (proto_config.on_heartbeat && msg->data) {
         proto_config.on_heartbeat(msg->data, msg->len);
@@ -33,7 +62,12 @@ static TF_Result heartbeat_timeout_listener(TinyFrame *tf)
 {
     (void)tf;
 
-    printf("[PROTO] HB timeout!\n");
+    TRACE_W("HB timeout!");
+
+    // Peer may come back with different firmware - renegotiate
+    caps_known = false;
+    peer_caps = 0;
+    clock_sync_reset();
 
     if (proto_config.on_heartbeat_timeout) {
         proto_config.on_heartbeat_timeout();
@@ -44,10 +78,11 @@ static TF_Result heartbeat_timeout_listener(TinyFrame *tf)
 
 static void send_heartbeat(void)
 {
+    uint32_t counter = heartbeat_counter++;
     char msg[32];
-    int len = snprintf(msg, sizeof(msg), "HB %lu", (unsigned long)heartbeat_counter++);
+    int len = snprintf(msg, sizeof(msg), "HB %lu", (unsigned long)counter);
 
-    printf("[PROTO] TX HB: %s\n", msg);
+    TRACE_I("TX HB %u", (unsigned)counter);
 
     tf_transport_query(MSG_TYPE_HEARTBEAT, (const uint8_t *)msg, len,
                        heartbeat_response_listener,
@@ -55,81 +90,495 @@ static void send_heartbeat(void)
                        proto_config.heartbeat_timeout_ticks);
 }
 
-// === Command response handling ===
+// === Capability handshake ===
+
+static TF_Result handle_caps(const caps_msg_t *caps, TF_Msg *msg)
+{
+    (void)msg;
+
+    peer_caps = caps->caps & LOCAL_CAPS;
+    caps_known = true;
+
+    TRACE_I("RX CAPS version=%d caps=0x%02X (using 0x%02X)", caps->version, caps->caps, peer_caps);
+
+    return TF_CLOSE;
+}
+
+DEFINE_TYPED_LISTENER(caps, caps_msg_t, TF_CLOSE)
 
-static TF_Result cmd_response_listener(TinyFrame *tf, TF_Msg *msg)
+static TF_Result caps_timeout_listener(TinyFrame *tf)
 {
     (void)tf;
 
-    if (msg->len < sizeof(cmd_response_t) || !msg->data) {
-        printf("[PROTO] Invalid CMD response len=%d\n", msg->len);
+    // Older MAX32655 firmware ignores MSG_TYPE_CAPS - stay on legacy format
+    TRACE_W("CAPS timeout, using legacy format");
+    return TF_CLOSE;
+}
+
+static void send_caps_query(void)
+{
+    caps_msg_t caps = {
+        .version = PROTO_VERSION,
+        .caps = LOCAL_CAPS,
+    };
+    uint8_t buf[PROTO_WIRE_SIZE_caps];
+    uint16_t len = proto_encode_caps(&caps, buf);
+
+    tf_transport_query(MSG_TYPE_CAPS, buf, len,
+                       caps_listener,
+                       caps_timeout_listener,
+                       proto_config.heartbeat_timeout_ticks);
+}
+
+// === Clock sync ===
+
+#define TIME_SYNC_FAST_INTERVAL_MS 1000
+
+// Full esp_timer value of the exchange in flight (only low 32 bits go on the wire)
+static int64_t time_sync_t1 = 0;
+
+static TF_Result handle_time_sync(const time_sync_msg_t *sync, TF_Msg *msg)
+{
+    (void)msg;
+
+    int64_t t4 = tf_transport_rx_time();
+
+    if (sync->t1 != (uint32_t)time_sync_t1) {
+        TRACE_W("Stale TIME_SYNC response");
         return TF_CLOSE;
     }
 
-    const cmd_response_t *resp = (const cmd_response_t *)msg->data;
+    clock_sync_update(time_sync_t1, sync->t2, sync->t3, t4);
+    return TF_CLOSE;
+}
 
-    printf("[PROTO] RX CMD response status=%d\n", resp->status);
+DEFINE_TYPED_LISTENER(time_sync, time_sync_msg_t, TF_CLOSE)
 
-    if (proto_config.on_cmd_response) {
-        proto_config.on_cmd_response(resp);
+static TF_Result time_sync_timeout_listener(TinyFrame *tf)
+{
+    (void)tf;
+    TRACE_W("TIME_SYNC timeout");
+    return TF_CLOSE;
+}
+
+static void send_time_sync(void)
+{
+    time_sync_t1 = esp_timer_get_time();
+
+    time_sync_msg_t sync = {
+        .t1 = (uint32_t)time_sync_t1,
+    };
+    uint8_t buf[PROTO_WIRE_SIZE_time_sync];
+    uint16_t len = proto_encode_time_sync(&sync, buf);
+
+    tf_transport_query(MSG_TYPE_TIME_SYNC, buf, len,
+                       time_sync_listener,
+                       time_sync_timeout_listener,
+                       proto_config.heartbeat_timeout_ticks);
+}
+
+// Timestamp for a received message: the MAX-side time if it sent one and the
+// clocks are synced, otherwise the local arrival time
+static int64_t message_timestamp(const TF_Msg *msg, uint16_t payload_len)
+{
+    uint32_t max_time;
+    if ((peer_caps & PROTO_CAP_TIMESTAMPS) && clock_sync_is_valid() &&
+        proto_read_timestamp(msg->data, msg->len, payload_len, &max_time)) {
+        return clock_sync_to_local(max_time);
     }
+    return tf_transport_rx_time();
+}
 
-    return TF_CLOSE;  // One-shot listener
+// === Command queries and retransmission ===
+// Each command owns a slot from the first send until it is answered or
+// given up on. A timed-out attempt is resent after a backoff, within the
+// command's attempt limit and deadline; the slot stays counted as in
+// flight meanwhile, so retries never push past the app layer's in-flight
+// cap. Commands that are not idempotent are only resent when the peer
+// de-duplicates by seq (PROTO_CAP_CMD_SEQ), otherwise a lost response
+// could make them execute twice.
+
+#define CMD_SLOTS       5   // TF_MAX_ID_LST minus heartbeat, caps and time sync
+#define CMD_WIRE_MAX    (CMD_REQUEST_COMPACT_MAX_LEN + PROTO_CMD_SEQ_LEN)
+
+// A retransmit must still be in the peer's seq cache
+_Static_assert(CMD_SLOTS <= PROTO_CMD_SEQ_WINDOW, "more commands in flight than the peer de-duplicates");
+
+typedef struct {
+    uint8_t max_attempts;
+    uint16_t backoff_ms;      // before the first retry, doubled for each further one
+    uint32_t deadline_ms;     // no retry starts later than this after the first send
+    bool idempotent;          // safe to resend without seq de-duplication
+} cmd_retry_policy_t;
+
+static const cmd_retry_policy_t retry_policies[] = {
+    [CMD_NOP]           = { .max_attempts = 1 },
+    [CMD_GET_STATUS]    = { .max_attempts = 3, .backoff_ms = 100, .deadline_ms = 5000, .idempotent = true },
+    [CMD_MOVE_TO_FLOOR] = { .max_attempts = 3, .backoff_ms = 200, .deadline_ms = 5000 },
+    [CMD_RESET]         = { .max_attempts = 2, .backoff_ms = 500, .deadline_ms = 8000 },
+};
+
+static const cmd_retry_policy_t no_retry_policy = { .max_attempts = 1 };
+
+typedef enum {
+    CMD_SLOT_FREE,
+    CMD_SLOT_WAITING,         // attempt sent, TinyFrame ID listener registered
+    CMD_SLOT_BACKOFF,         // attempt timed out, resend at retry_us
+} cmd_slot_state_t;
+
+typedef struct {
+    cmd_slot_state_t state;
+    uint8_t msg_type;         // MSG_TYPE_CMD or MSG_TYPE_CMD_COMPACT
+    uint8_t cmd_id;
+    uint8_t wire[CMD_WIRE_MAX];
+    uint16_t len;
+    bool has_seq;
+    uint8_t seq;
+    uint8_t attempts;
+    int64_t first_us;
+    int64_t retry_us;
+    void *ctx;                // handed back with the response or timeout
+} cmd_slot_t;
+
+static portMUX_TYPE cmd_lock = portMUX_INITIALIZER_UNLOCKED;
+static cmd_slot_t cmd_slots[CMD_SLOTS];
+static uint8_t cmds_in_flight = 0;
+static uint8_t next_cmd_seq = 0;
+static protocol_cmd_stats_t cmd_stats;
+
+static const cmd_retry_policy_t *retry_policy(uint8_t cmd_id)
+{
+    if (cmd_id < sizeof(retry_policies) / sizeof(retry_policies[0]) &&
+        retry_policies[cmd_id].max_attempts > 0) {
+        return &retry_policies[cmd_id];
+    }
+    return &no_retry_policy;
 }
 
-static TF_Result cmd_timeout_listener(TinyFrame *tf)
+static cmd_slot_t *cmd_slot_claim(void)
 {
-    (void)tf;
+    cmd_slot_t *slot = NULL;
+
+    portENTER_CRITICAL(&cmd_lock);
+    for (int i = 0; i < CMD_SLOTS; i++) {
+        if (cmd_slots[i].state == CMD_SLOT_FREE) {
+            slot = &cmd_slots[i];
+            slot->state = CMD_SLOT_WAITING;
+            cmds_in_flight++;
+            break;
+        }
+    }
+    portEXIT_CRITICAL(&cmd_lock);
+
+    return slot;
+}
 
-    printf("[PROTO] CMD timeout!\n");
+static void cmd_slot_release(cmd_slot_t *slot)
+{
+    portENTER_CRITICAL(&cmd_lock);
+    slot->state = CMD_SLOT_FREE;
+    cmds_in_flight--;
+    portEXIT_CRITICAL(&cmd_lock);
+}
+
+static TF_Result cmd_reply_listener(TinyFrame *tf, TF_Msg *msg);
+
+// Send (or resend) the slot's request; the reply may be handled before
+// this returns, so the attempt is counted up front. A local send failure
+// (no free TinyFrame listener) gives it back: it doesn't use up the
+// policy's attempts or grow the backoff.
+static bool cmd_attempt(cmd_slot_t *slot)
+{
+    slot->attempts++;
+    if (!tf_transport_query_ctx(slot->msg_type, slot->wire, slot->len,
+                                cmd_reply_listener, slot, proto_config.cmd_timeout_ticks)) {
+        slot->attempts--;
+        return false;
+    }
+    return true;
+}
+
+// Put the slot in backoff if the policy allows another attempt
+static bool cmd_schedule_retry(cmd_slot_t *slot)
+{
+    const cmd_retry_policy_t *policy = retry_policy(slot->cmd_id);
+    if (slot->attempts >= policy->max_attempts || (!policy->idempotent && !slot->has_seq)) {
+        return false;
+    }
+
+    uint32_t backoff_ms = (uint32_t)policy->backoff_ms << (slot->attempts - 1);
+    int64_t retry_us = esp_timer_get_time() + backoff_ms * 1000LL;
+    if (retry_us - slot->first_us > policy->deadline_ms * 1000LL) {
+        return false;
+    }
+
+    portENTER_CRITICAL(&cmd_lock);
+    slot->retry_us = retry_us;
+    slot->state = CMD_SLOT_BACKOFF;
+    portEXIT_CRITICAL(&cmd_lock);
+
+    if (protocol_task_handle) {
+        xTaskNotifyGive(protocol_task_handle);
+    }
+    return true;
+}
+
+static void cmd_give_up(cmd_slot_t *slot)
+{
+    uint8_t cmd_id = slot->cmd_id;
+    void *ctx = slot->ctx;
+
+    TRACE_W("CMD timeout! id=%d after %d attempt(s)", cmd_id, slot->attempts);
+
+    portENTER_CRITICAL(&cmd_lock);
+    cmd_stats.timeouts++;
+    portEXIT_CRITICAL(&cmd_lock);
+    cmd_slot_release(slot);
 
     if (proto_config.on_cmd_timeout) {
-        proto_config.on_cmd_timeout();
+        proto_config.on_cmd_timeout(cmd_id, ctx);
     }
+}
 
-    return TF_CLOSE;
+// Resend commands whose backoff has expired (protocol task); returns the
+// ticks until the next one is due, at most max_wait_ms
+static TickType_t cmd_run_retries(uint32_t max_wait_ms)
+{
+    int64_t now = esp_timer_get_time();
+    int64_t next_us = now + max_wait_ms * 1000LL;
+
+    for (int i = 0; i < CMD_SLOTS; i++) {
+        cmd_slot_t *slot = &cmd_slots[i];
+        bool due = false;
+
+        portENTER_CRITICAL(&cmd_lock);
+        if (slot->state == CMD_SLOT_BACKOFF) {
+            if (now >= slot->retry_us) {
+                slot->state = CMD_SLOT_WAITING;
+                cmd_stats.retries++;
+                due = true;
+            } else if (slot->retry_us < next_us) {
+                next_us = slot->retry_us;
+            }
+        }
+        portEXIT_CRITICAL(&cmd_lock);
+
+        if (!due) {
+            continue;
+        }
+
+        TRACE_I("Retry CMD id=%d attempt %d", slot->cmd_id, slot->attempts + 1);
+        if (!cmd_attempt(slot) && !cmd_schedule_retry(slot)) {
+            cmd_give_up(slot);
+        }
+    }
+
+    TickType_t wait = pdMS_TO_TICKS((next_us - now) / 1000);
+    return wait > 0 ? wait : 1;
 }
 
-// === Event handling ===
+typedef enum {
+    CMD_REPLY_OK,
+    CMD_REPLY_INVALID,
+    CMD_REPLY_OTHER_SEQ,      // answers another command, not this slot's
+} cmd_reply_t;
+
+static cmd_reply_t decode_cmd_reply(const cmd_slot_t *slot, const TF_Msg *msg,
+                                    cmd_response_t *resp, int64_t *timestamp_us)
+{
+    if (slot->msg_type == MSG_TYPE_CMD) {
+        if (!proto_decode_cmd_response(msg->data, msg->len, resp)) {
+            return CMD_REPLY_INVALID;
+        }
+        *timestamp_us = message_timestamp(msg, PROTO_WIRE_SIZE_cmd_response);
+        return CMD_REPLY_OK;
+    }
+
+    if (!proto_decode_resp_compact(msg->data, msg->len, resp)) {
+        return CMD_REPLY_INVALID;
+    }
+    uint16_t payload_len = (uint16_t)(CMD_RESPONSE_COMPACT_HDR_LEN + resp->data_len);
+    if (slot->has_seq) {
+        uint8_t seq;
+        if (!proto_read_resp_seq(msg->data, msg->len, &seq)) {
+            return CMD_REPLY_INVALID;
+        }
+        if (seq != slot->seq) {
+            TRACE_W("CMD response seq %d, want %d: dropped", seq, slot->seq);
+            return CMD_REPLY_OTHER_SEQ;
+        }
+        payload_len += PROTO_CMD_SEQ_LEN;
+    }
+    *timestamp_us = message_timestamp(msg, payload_len);
+    return CMD_REPLY_OK;
+}
 
-static TF_Result event_listener(TinyFrame *tf, TF_Msg *msg)
+// ID listener of every command attempt (userdata = slot)
+static TF_Result cmd_reply_listener(TinyFrame *tf, TF_Msg *msg)
 {
     (void)tf;
 
-    if (msg->len < sizeof(state_event_t) || !msg->data) {
-        printf("[PROTO] Invalid EVENT len=%d\n", msg->len);
+    cmd_slot_t *slot = msg->userdata;
+    msg->userdata = NULL;
+
+    // Attempt timed out (TinyFrame listener cleanup)
+    if (msg->data == NULL) {
+        TRACE_W("CMD attempt %d timed out (id=%d)", slot->attempts, slot->cmd_id);
+        if (!cmd_schedule_retry(slot)) {
+            cmd_give_up(slot);
+        }
+        return TF_CLOSE;
+    }
+
+    cmd_response_t resp;
+    int64_t timestamp_us = 0;
+    cmd_reply_t reply = decode_cmd_reply(slot, msg, &resp, &timestamp_us);
+
+    // Not ours: keep waiting for the matching seq until the attempt times out
+    if (reply == CMD_REPLY_OTHER_SEQ) {
+        msg->userdata = slot;
         return TF_STAY;
     }
 
-    const state_event_t *evt = (const state_event_t *)msg->data;
+    uint8_t cmd_id = slot->cmd_id;
+    void *ctx = slot->ctx;
+
+    portENTER_CRITICAL(&cmd_lock);
+    if (slot->attempts > 1) {
+        cmd_stats.recovered++;
+    }
+    portEXIT_CRITICAL(&cmd_lock);
+    cmd_slot_release(slot);  // answered, even if malformed
+
+    if (reply == CMD_REPLY_INVALID) {
+        TRACE_W("Invalid CMD response len=%d", msg->len);
+        if (proto_config.on_cmd_timeout) {
+            proto_config.on_cmd_timeout(cmd_id, ctx);
+        }
+        return TF_CLOSE;
+    }
+
+    TRACE_I("RX CMD response status=%d", resp.status);
+
+    if (proto_config.on_cmd_response) {
+        proto_config.on_cmd_response(&resp, timestamp_us, ctx);
+    }
+
+    return TF_CLOSE;
+}
+
+// Command responses without an ID listener: the answer to an attempt that
+// already timed out (and was possibly retransmitted)
+static TF_Result cmd_late_response_listener(TinyFrame *tf, TF_Msg *msg)
+{
+    (void)tf;
+
+    TRACE_W("Late CMD response type=%d id=%d", msg->type, msg->frame_id);
+
+    portENTER_CRITICAL(&cmd_lock);
+    cmd_stats.late_responses++;
+    portEXIT_CRITICAL(&cmd_lock);
+
+    return TF_STAY;
+}
+
+// Claim a slot, store the request for retransmission and send it
+static bool send_cmd_query(uint8_t msg_type, uint8_t cmd_id, const uint8_t *buf, uint16_t len, bool has_seq,
+                           void *ctx)
+{
+    cmd_slot_t *slot = cmd_slot_claim();
+    if (slot == NULL) {
+        TRACE_W("No free CMD slot");
+        return false;
+    }
+
+    slot->msg_type = msg_type;
+    slot->cmd_id = cmd_id;
+    memcpy(slot->wire, buf, len);
+    slot->len = len;
+    slot->has_seq = has_seq;
+    slot->seq = has_seq ? buf[len - PROTO_CMD_SEQ_LEN] : 0;
+    slot->attempts = 0;
+    slot->first_us = esp_timer_get_time();
+    slot->ctx = ctx;
+
+    if (!cmd_attempt(slot)) {
+        cmd_slot_release(slot);
+        return false;
+    }
+
+    portENTER_CRITICAL(&cmd_lock);
+    cmd_stats.sent++;
+    portEXIT_CRITICAL(&cmd_lock);
+    return true;
+}
 
-    printf("[PROTO] RX EVENT type=%d data=%d\n", evt->event_type, evt->data);
+// === Event handling ===
+
+static TF_Result handle_state_event(const state_event_t *evt, TF_Msg *msg)
+{
+    TRACE_I("RX EVENT type=%d data=%d", evt->event_type, evt->data);
 
     if (proto_config.on_state_event) {
-        proto_config.on_state_event(evt);
+        proto_config.on_state_event(evt, message_timestamp(msg, PROTO_WIRE_SIZE_state_event));
     }
 
     return TF_STAY;  // Keep listening
 }
 
-// === Protocol task (heartbeat timing) ===
+DEFINE_TYPED_LISTENER(state_event, state_event_t, TF_STAY)
+
+// Unsolicited message types and their listeners
+static const struct {
+    uint8_t msg_type;
+    tf_transport_listener_cb listener;
+} type_listeners[] = {
+    { MSG_TYPE_EVENT, state_event_listener },
+    { MSG_TYPE_CMD, cmd_late_response_listener },
+    { MSG_TYPE_CMD_COMPACT, cmd_late_response_listener },
+};
+
+// === Protocol task (heartbeat timing, command retries) ===
 
 static void protocol_task(void *pvParameters)
 {
     (void)pvParameters;
 
     TickType_t last_heartbeat_time = xTaskGetTickCount();
+    TickType_t last_sync_time = last_heartbeat_time;
+
+    send_caps_query();
+
+    TickType_t wait = pdMS_TO_TICKS(100);
 
     while (true) {
-        vTaskDelay(pdMS_TO_TICKS(100));  // Check every 100ms
+        // Check every 100ms, or earlier when a command retry is due
+        ulTaskNotifyTake(pdTRUE, wait);
+        wait = cmd_run_retries(100);
 
         if (proto_config.heartbeat_interval_ms > 0) {
             TickType_t now = xTaskGetTickCount();
             if ((now - last_heartbeat_time) >= pdMS_TO_TICKS(proto_config.heartbeat_interval_ms)) {
+                if (!caps_known) {
+                    send_caps_query();
+                }
                 send_heartbeat();
                 last_heartbeat_time = now;
             }
         }
+
+        if (proto_config.time_sync_interval_ms > 0 && (peer_caps & PROTO_CAP_TIMESTAMPS)) {
+            // Sync faster until the first estimate is in
+            uint32_t interval_ms = proto_config.time_sync_interval_ms;
+            if (!clock_sync_is_valid() && interval_ms > TIME_SYNC_FAST_INTERVAL_MS) {
+                interval_ms = TIME_SYNC_FAST_INTERVAL_MS;
+            }
+            TickType_t now = xTaskGetTickCount();
+            if ((now - last_sync_time) >= pdMS_TO_TICKS(interval_ms)) {
+                send_time_sync();
+                last_sync_time = now;
+            }
+        }
     }
 }
 
@@ -140,28 +589,79 @@ void protocol_init(const protocol_config_t *config)
     }
 
     // Register listeners with transport layer
-    tf_transport_add_listener(MSG_TYPE_EVENT, event_listener);
+    for (size_t i = 0; i < sizeof(type_listeners) / sizeof(type_listeners[0]); i++) {
+        tf_transport_add_listener(type_listeners[i].msg_type, type_listeners[i].listener);
+    }
 
     printf("[PROTO] Protocol handler init (HB interval=%lums, timeout=%d ticks)\n",
            (unsigned long)proto_config.heartbeat_interval_ms,
            proto_config.heartbeat_timeout_ticks);
 
     // Create protocol task for heartbeat timing
-    xTaskCreate(protocol_task, "protocol", 4096, NULL, 4, &protocol_task_handle);
+    task_create(TASK_PROTOCOL, NULL, protocol_task, NULL, &protocol_task_handle);
 }
 
-bool protocol_send_cmd(const cmd_request_t *cmd)
+bool protocol_send_cmd(const cmd_request_t *cmd, void *ctx)
 {
-    printf("[PROTO] TX CMD id=%d params_len=%d\n", cmd->cmd_id, cmd->params_len);
+    TRACE_I("TX CMD id=%d params_len=%d", cmd->cmd_id, cmd->params_len);
+
+    uint8_t caps = peer_caps;
+    if (caps & PROTO_CAP_COMPACT_CMD) {
+        uint8_t buf[CMD_WIRE_MAX];
+        uint16_t len = proto_encode_cmd_compact(cmd, buf);
+        if (len == 0) {
+            return false;
+        }
+        bool has_seq = (caps & PROTO_CAP_CMD_SEQ) != 0;
+        if (has_seq) {
+            // Called from the MQTT task, timers and the protocol task: two
+            // commands with one seq would get the same cached response
+            portENTER_CRITICAL(&cmd_lock);
+            uint8_t seq = next_cmd_seq++;
+            portEXIT_CRITICAL(&cmd_lock);
+            buf[len++] = seq;
+        }
+        return send_cmd_query(MSG_TYPE_CMD_COMPACT, cmd->cmd_id, buf, len, has_seq, ctx);
+    }
+
+    uint8_t buf[PROTO_WIRE_SIZE_cmd_request];
+    uint16_t len = proto_encode_cmd_request(cmd, buf);
+
+    return send_cmd_query(MSG_TYPE_CMD, cmd->cmd_id, buf, len, false, ctx);
+}
+
+bool protocol_send_cmd_wire(const uint8_t *wire, uint16_t len, void *ctx)
+{
+    if (len != PROTO_WIRE_SIZE_cmd_request || !proto_check_cmd_request(wire, len)) {
+        return false;
+    }
+
+    TRACE_I("TX CMD id=%d (passthrough)", wire[0]);
 
-    return tf_transport_query(MSG_TYPE_CMD, (const uint8_t *)cmd, sizeof(cmd_request_t),
-                              cmd_response_listener,
-                              cmd_timeout_listener,
-                              proto_config.cmd_timeout_ticks);
+    // Legacy format is always understood, so no re-encoding for compact
+    // peers (and no seq: only idempotent commands are retried)
+    return send_cmd_query(MSG_TYPE_CMD, wire[0], wire, len, false, ctx);
+}
+
+uint8_t protocol_cmds_in_flight(void)
+{
+    return cmds_in_flight;
+}
+
+void protocol_get_cmd_stats(protocol_cmd_stats_t *stats)
+{
+    portENTER_CRITICAL(&cmd_lock);
+    *stats = cmd_stats;
+    portEXIT_CRITICAL(&cmd_lock);
+}
+
+uint8_t protocol_get_peer_caps(void)
+{
+    return peer_caps;
 }
 
 bool protocol_send_estop(const uint8_t *data, uint16_t len)
 {
-    printf("[PROTO] TX E-STOP\n");
+    TRACE_I("TX E-STOP");
     return tf_transport_send(MSG_TYPE_ESTOP, data, len);
 }
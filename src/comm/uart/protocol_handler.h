@@ -7,13 +7,18 @@
 #include "TinyFrame.h"
 
 // === Callbacks (app layer implements) ===
+// timestamp_us is in the esp_timer_get_time() domain: the MAX32655 time of
+// the event converted through clock sync when available, otherwise the
+// local arrival time.
 
-// Command response received from MAX32655
-typedef void (*protocol_cmd_response_cb)(const cmd_response_t *resp);
-typedef void (*protocol_cmd_timeout_cb)(void);
+// Command response received from MAX32655; ctx is what the command was sent with
+typedef void (*protocol_cmd_response_cb)(const cmd_response_t *resp, int64_t timestamp_us, void *ctx);
+// Command given up on after its last retry (see protocol_cmd_stats_t), or
+// answered with a malformed response
+typedef void (*protocol_cmd_timeout_cb)(uint8_t cmd_id, void *ctx);
 
 // State event received from MAX32655
-typedef void (*protocol_state_event_cb)(const state_event_t *evt);
+typedef void (*protocol_state_event_cb)(const state_event_t *evt, int64_t timestamp_us);
 
 // Heartbeat events
 typedef void (*protocol_heartbeat_cb)(const uint8_t *data, uint16_t len);
@@ -28,18 +33,41 @@ typedef struct {
     protocol_heartbeat_timeout_cb on_heartbeat_timeout;
     uint32_t heartbeat_interval_ms;   // How often to send heartbeats
     uint16_t heartbeat_timeout_ticks; // TinyFrame ticks to wait for response
-    uint16_t cmd_timeout_ticks;       // TinyFrame ticks to wait for cmd response
+    uint16_t cmd_timeout_ticks;       // TinyFrame ticks to wait for cmd response (per attempt)
+    uint32_t time_sync_interval_ms;   // Clock sync period (0 = disabled)
 } protocol_config_t;
 
+// Command query counters
+typedef struct {
+    uint32_t sent;                    // commands sent (first attempts)
+    uint32_t retries;                 // retransmissions
+    uint32_t recovered;               // answered after at least one retry
+    uint32_t timeouts;                // given up: attempts or deadline exhausted
+    uint32_t late_responses;          // responses arriving after their attempt timed out
+} protocol_cmd_stats_t;
+
 // === Init ===
 void protocol_init(const protocol_config_t *config);
 
 // === Sending (called by app layer) ===
 
-// Send command to MAX32655 (response comes via on_cmd_response callback)
-bool protocol_send_cmd(const cmd_request_t *cmd);
+// Send command to MAX32655. Exactly one of on_cmd_response / on_cmd_timeout
+// follows, with ctx, unless this returns false.
+bool protocol_send_cmd(const cmd_request_t *cmd, void *ctx);
+
+// Forward an already encoded cmd_request_t (PROTO_WIRE_SIZE_cmd_request bytes,
+// checked with proto_check_cmd_request) as-is; response as for protocol_send_cmd
+bool protocol_send_cmd_wire(const uint8_t *wire, uint16_t len, void *ctx);
 
 // Send e-stop to MAX32655
 bool protocol_send_estop(const uint8_t *data, uint16_t len);
 
+// Command queries sent and not yet answered or given up on (retries included)
+uint8_t protocol_cmds_in_flight(void);
+
+void protocol_get_cmd_stats(protocol_cmd_stats_t *stats);
+
+// Capabilities agreed with MAX32655 (PROTO_CAP_* bitmask, 0 until handshake completes)
+uint8_t protocol_get_peer_caps(void);
+
 #endif // PROTOCOL_HANDLER_H
@@ -1,11 +1,19 @@
 #include "tf_transport.h"
+#include "capture_format.h"
 #include "TinyFrame.h"
 #include "driver/uart.h"
 #include "driver/gpio.h"
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/semphr.h"
+#include "esp_timer.h"
+#include "comm/boot_timeline.h"
+#include "comm/task_table.h"
+#include "config.h"
+#define TRACE_TAG "TF"
+#include "comm/trace.h"
 #include <stdio.h>
+#include <string.h>
 
 // UART configuration
 #define UART_NUM_MAX        UART_NUM_2
@@ -14,9 +22,8 @@
 #define UART_BAUD           115200
 #define UART_BUF_SIZE       256
 
-// Task configuration
-#define TF_TASK_STACK_SIZE  4096
-#define TF_TASK_PRIORITY    5
+// TinyFrame timeouts are counted in ticks of this period
+#define TF_TICK_US          10000
 
 // TinyFrame instance
 static TinyFrame tf_instance;
@@ -24,14 +31,79 @@ static TinyFrame *tf = &tf_instance;
 
 // Mutex for TinyFrame access
 static SemaphoreHandle_t tf_mutex;
+static StaticSemaphore_t tf_mutex_buf;
 
 // Task handle
 static TaskHandle_t tf_task_handle = NULL;
 
+// Arrival time of the chunk currently being parsed
+static int64_t rx_time_us = 0;
+
+// === UART capture ===
+// Flight recorder in two halves: records go to the active half, and when it
+// is full the other half is cleared and takes over, so between one half and
+// the whole buffer of the latest traffic is kept. Each half starts with a
+// TIME record. Written under tf_mutex: RX from tf_task, TX from
+// TF_WriteImpl, which TinyFrame only calls with the mutex held.
+#if UART_CAPTURE_BYTES > 0
+#define CAPTURE_HALF    (UART_CAPTURE_BYTES / 2)
+
+_Static_assert(CAPTURE_HALF >= 2 * TF_SENDBUF_LEN + 32, "UART_CAPTURE_BYTES too small");
+
+static struct {
+    uint8_t buf[2][CAPTURE_HALF];
+    uint32_t used[2];
+    uint8_t active;
+    bool running;
+    bool wrapped;
+    int64_t last_us;
+} capture;
+
+static void capture_append(uint8_t kind, const uint8_t *data, uint32_t len, int64_t now)
+{
+    uint8_t head[2 * CAPTURE_VARINT_MAX];
+    size_t head_len = capture_put_varint(head, (uint64_t)(now - capture.last_us));
+    head_len += capture_put_varint(head + head_len, ((uint64_t)len << 2) | kind);
+
+    uint8_t *out = capture.buf[capture.active] + capture.used[capture.active];
+    memcpy(out, head, head_len);
+    memcpy(out + head_len, data, len);
+    capture.used[capture.active] += head_len + len;
+    capture.last_us = now;
+}
+
+static void capture_new_half(int64_t now)
+{
+    uint8_t time[8];
+    for (int i = 0; i < 8; i++) {
+        time[i] = (uint8_t)((uint64_t)now >> (8 * i));
+    }
+    capture.used[capture.active] = 0;
+    capture.last_us = now;
+    capture_append(CAPTURE_TIME, time, sizeof(time), now);
+}
+
+static void capture_record(capture_kind_t kind, const uint8_t *data, uint32_t len, int64_t now)
+{
+    if (!capture.running) {
+        return;
+    }
+    if (capture.used[capture.active] + 2 * CAPTURE_VARINT_MAX + len > CAPTURE_HALF) {
+        capture.active ^= 1;
+        capture.wrapped |= capture.used[capture.active] > 0;
+        capture_new_half(now);
+    }
+    capture_append(kind, data, len, now);
+}
+#else
+#define capture_record(kind, data, len, now)    do { } while (0)
+#endif
+
 // UART write implementation for TinyFrame
 void TF_WriteImpl(TinyFrame *tf, const uint8_t *buff, uint32_t len)
 {
     (void)tf;
+    capture_record(CAPTURE_TX, buff, len, esp_timer_get_time());
     uart_write_bytes(UART_NUM_MAX, buff, len);
 }
 
@@ -39,7 +111,7 @@ void TF_WriteImpl(TinyFrame *tf, const uint8_t *buff, uint32_t len)
 static TF_Result generic_listener(TinyFrame *tf, TF_Msg *msg)
 {
     (void)tf;
-    printf("[TF] Unhandled type=%d id=%d len=%d\n", msg->type, msg->frame_id, msg->len);
+    TRACE_W("Unhandled type=%d id=%d len=%d", msg->type, msg->frame_id, msg->len);
     return TF_STAY;
 }
 
@@ -62,21 +134,50 @@ static void uart_init_internal(void)
 // FreeRTOS task for TinyFrame communication
 static void tf_task(void *pvParameters)
 {
-    (void)pvParameters;
+    TaskHandle_t creator = pvParameters;
+
+    // The UART interrupt is allocated on the core that installs the
+    // driver: do it here, on the UART core
+    uart_init_internal();
+    xTaskNotifyGive(creator);
+
+    int64_t next_tick_us = esp_timer_get_time() + TF_TICK_US;
 
     while (true) {
-        // Read available UART data
+        // Wait for the first byte, then take whatever else is buffered, so a
+        // short frame is not held back until the read timeout expires
         uint8_t rx_buf[32];
-        int len = uart_read_bytes(UART_NUM_MAX, rx_buf, sizeof(rx_buf), pdMS_TO_TICKS(10));
+        int len = uart_read_bytes(UART_NUM_MAX, rx_buf, 1, pdMS_TO_TICKS(10));
+        if (len > 0) {
+            size_t avail = 0;
+            uart_get_buffered_data_len(UART_NUM_MAX, &avail);
+            if (avail > sizeof(rx_buf) - 1) {
+                avail = sizeof(rx_buf) - 1;
+            }
+            if (avail > 0) {
+                int more = uart_read_bytes(UART_NUM_MAX, rx_buf + 1, avail, 0);
+                if (more > 0) {
+                    len += more;
+                }
+            }
+        }
 
         xSemaphoreTakeRecursive(tf_mutex, portMAX_DELAY);
 
         if (len > 0) {
+            rx_time_us = esp_timer_get_time();
+            capture_record(CAPTURE_RX, rx_buf, len, rx_time_us);
+            boot_timeline_mark(BOOT_TL_UART_FIRST_RX);
             TF_Accept(tf, rx_buf, len);
         }
 
-        // TinyFrame housekeeping
-        TF_Tick(tf);
+        // TinyFrame housekeeping: one tick per TF_TICK_US elapsed, however
+        // often RX traffic wakes the loop
+        int64_t now = esp_timer_get_time();
+        while (now >= next_tick_us) {
+            TF_Tick(tf);
+            next_tick_us += TF_TICK_US;
+        }
 
         xSemaphoreGiveRecursive(tf_mutex);
     }
@@ -86,18 +187,19 @@ void tf_transport_init(void)
 {
     // Create recursive mutex - allows listeners to call tf_transport_respond
     // without deadlocking (listener is called while mutex is held)
-    tf_mutex = xSemaphoreCreateRecursiveMutex();
-    configASSERT(tf_mutex);
-
-    uart_init_internal();
+    tf_mutex = xSemaphoreCreateRecursiveMutexStatic(&tf_mutex_buf);
 
     TF_InitStatic(tf, TF_MASTER);
     TF_AddGenericListener(tf, generic_listener);
+    tf_transport_capture_start();
 
-    printf("[TF] Transport init (GPIO%d RX, GPIO%d TX @ %d baud)\n", MAX_RX_PIN, MAX_TX_PIN, UART_BAUD);
+    // Create communication task (on the UART core, see task_table.h) and
+    // wait until it has brought up the UART
+    if (task_create(TASK_TF_TRANSPORT, NULL, tf_task, xTaskGetCurrentTaskHandle(), &tf_task_handle)) {
+        ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    }
 
-    // Create communication task
-    xTaskCreate(tf_task, "tf_transport", TF_TASK_STACK_SIZE, NULL, TF_TASK_PRIORITY, &tf_task_handle);
+    printf("[TF] Transport init (GPIO%d RX, GPIO%d TX @ %d baud)\n", MAX_RX_PIN, MAX_TX_PIN, UART_BAUD);
 }
 
 bool tf_transport_add_listener(uint8_t msg_type, tf_transport_listener_cb callback)
@@ -128,6 +230,23 @@ bool tf_transport_query(uint8_t msg_type, const uint8_t *data, uint16_t len,
     return result;
 }
 
+bool tf_transport_query_ctx(uint8_t msg_type, const uint8_t *data, uint16_t len,
+                            tf_transport_listener_cb on_response, void *userdata,
+                            uint16_t timeout_ticks)
+{
+    TF_Msg msg;
+    TF_ClearMsg(&msg);
+    msg.type = msg_type;
+    msg.data = data;
+    msg.len = (TF_LEN)len;
+    msg.userdata = userdata;
+
+    xSemaphoreTakeRecursive(tf_mutex, portMAX_DELAY);
+    bool result = TF_Query(tf, &msg, on_response, NULL, timeout_ticks);
+    xSemaphoreGiveRecursive(tf_mutex);
+    return result;
+}
+
 bool tf_transport_respond(TF_Msg *original_msg, const uint8_t *data, uint16_t len)
 {
     original_msg->data = data;
@@ -138,3 +257,85 @@ bool tf_transport_respond(TF_Msg *original_msg, const uint8_t *data, uint16_t le
     xSemaphoreGiveRecursive(tf_mutex);
     return result;
 }
+
+int64_t tf_transport_rx_time(void)
+{
+    return rx_time_us;
+}
+
+void tf_transport_capture_start(void)
+{
+#if UART_CAPTURE_BYTES > 0
+    xSemaphoreTakeRecursive(tf_mutex, portMAX_DELAY);
+    capture.active = 0;
+    capture.used[1] = 0;
+    capture.wrapped = false;
+    capture_new_half(esp_timer_get_time());
+    capture.running = true;
+    xSemaphoreGiveRecursive(tf_mutex);
+#endif
+}
+
+void tf_transport_capture_stop(void)
+{
+#if UART_CAPTURE_BYTES > 0
+    xSemaphoreTakeRecursive(tf_mutex, portMAX_DELAY);
+    capture.running = false;
+    xSemaphoreGiveRecursive(tf_mutex);
+#endif
+}
+
+uint32_t tf_transport_capture_size(void)
+{
+#if UART_CAPTURE_BYTES > 0
+    xSemaphoreTakeRecursive(tf_mutex, portMAX_DELAY);
+    uint32_t size = CAPTURE_HEADER_SIZE + capture.used[0] + capture.used[1];
+    xSemaphoreGiveRecursive(tf_mutex);
+    return size;
+#else
+    return 0;
+#endif
+}
+
+uint32_t tf_transport_capture_read(uint32_t offset, uint8_t *buf, uint32_t len)
+{
+#if UART_CAPTURE_BYTES > 0
+    xSemaphoreTakeRecursive(tf_mutex, portMAX_DELAY);
+
+    // Header, then the older half, then the active one
+    uint8_t header[CAPTURE_HEADER_SIZE];
+    capture_put_header(header, capture.wrapped ? CAPTURE_FLAG_WRAPPED : 0, UART_BAUD,
+                       capture.used[0] + capture.used[1]);
+    const struct {
+        const uint8_t *data;
+        uint32_t len;
+    } parts[] = {
+        { header, sizeof(header) },
+        { capture.buf[capture.active ^ 1], capture.used[capture.active ^ 1] },
+        { capture.buf[capture.active], capture.used[capture.active] },
+    };
+
+    uint32_t copied = 0;
+    for (size_t i = 0; i < sizeof(parts) / sizeof(parts[0]) && copied < len; i++) {
+        if (offset >= parts[i].len) {
+            offset -= parts[i].len;
+            continue;
+        }
+        uint32_t n = parts[i].len - offset;
+        if (n > len - copied) {
+            n = len - copied;
+        }
+        memcpy(buf + copied, parts[i].data + offset, n);
+        copied += n;
+        offset = 0;
+    }
+
+    xSemaphoreGiveRecursive(tf_mutex);
+    return copied;
+#else
+    (void)offset;
+    (void)buf;
+    (void)len;
+    return 0;
+#endif
+}
@@ -6,11 +6,8 @@
 #include "TinyFrame.h"
 #include "freertos/FreeRTOS.h"
 
-// Message types (must match both sides)
-#define MSG_TYPE_HEARTBEAT   0x01
-#define MSG_TYPE_ESTOP       0x02
-#define MSG_TYPE_CMD         0x03
-#define MSG_TYPE_EVENT       0x04
+// Message types (MSG_TYPE_*) come from the shared protocol schema
+#include "protocol.h"
 
 // Callback types
 typedef TF_Result (*tf_transport_listener_cb)(TinyFrame *tf, TF_Msg *msg);
@@ -31,7 +28,35 @@ bool tf_transport_query(uint8_t msg_type, const uint8_t *data, uint16_t len,
                         tf_transport_timeout_cb on_timeout,
                         uint16_t timeout_ticks);
 
+// Query whose listener gets userdata in msg->userdata. On timeout the
+// listener is called once more with msg->data == NULL instead of a timeout
+// callback (TinyFrame ID listener cleanup), so it can tell which query expired.
+bool tf_transport_query_ctx(uint8_t msg_type, const uint8_t *data, uint16_t len,
+                            tf_transport_listener_cb on_response, void *userdata,
+                            uint16_t timeout_ticks);
+
 // Respond to an incoming query (preserves frame_id)
 bool tf_transport_respond(TF_Msg *original_msg, const uint8_t *data, uint16_t len);
 
+// esp_timer time (us) at which the UART chunk being parsed arrived.
+// Valid inside listeners; closer to the real arrival than calling esp_timer_get_time().
+int64_t tf_transport_rx_time(void);
+
+// === UART capture ===
+// Timestamped RX/TX chunks of the raw byte stream in a RAM ring of
+// UART_CAPTURE_BYTES (config.h), format in capture_format.h. Recording
+// starts with tf_transport_init(); stop it to read a consistent trace.
+
+// Clear the ring and (re)start recording
+void tf_transport_capture_start(void);
+
+// Freeze the ring until the next start
+void tf_transport_capture_stop(void);
+
+// Trace length in bytes, header included (0 if capture is compiled out)
+uint32_t tf_transport_capture_size(void);
+
+// Copy len bytes of the trace from offset; returns the number copied
+uint32_t tf_transport_capture_read(uint32_t offset, uint8_t *buf, uint32_t len);
+
 #endif // TF_TRANSPORT_H
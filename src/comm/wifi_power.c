@@ -0,0 +1,146 @@
+// WiFi power-save policy
+
+#include "comm/wifi_power.h"
+#include <string.h>
+
+static const uint32_t latency_bucket_limits[WIFI_LATENCY_BUCKETS - 1] = WIFI_LATENCY_BUCKET_LIMITS;
+
+static const char *const mode_names[WIFI_POWER_MODE_COUNT] = {
+    [WIFI_POWER_NONE]      = "none",
+    [WIFI_POWER_MIN_MODEM] = "min_modem",
+    [WIFI_POWER_MAX_MODEM] = "max_modem",
+};
+
+// Time until a hold that started at since_us runs out (0 = expired or none)
+static int64_t hold_left_us(int64_t since_us, uint32_t hold_ms, int64_t now_us)
+{
+    if (since_us == 0) {
+        return 0;
+    }
+    int64_t left_us = since_us + (int64_t)hold_ms * 1000 - now_us;
+    return left_us > 0 ? left_us : 0;
+}
+
+// Wanted mode now, and when that answer can next change (INT64_MAX = not
+// before the next event)
+static wifi_power_mode_t wanted_mode(const wifi_power_policy_t *policy, int64_t now_us,
+                                     int64_t *recheck_us)
+{
+    *recheck_us = INT64_MAX;
+    if (policy->estop) {
+        return WIFI_POWER_NONE;
+    }
+
+    int64_t command_left = hold_left_us(policy->last_command_us, policy->config.command_hold_ms, now_us);
+    int64_t activity_left = hold_left_us(policy->last_activity_us, policy->config.activity_hold_ms, now_us);
+
+    if (command_left > 0) {
+        *recheck_us = now_us + command_left;
+        return WIFI_POWER_NONE;
+    }
+    if (activity_left > 0 && policy->config.idle_mode > WIFI_POWER_MIN_MODEM) {
+        *recheck_us = now_us + activity_left;
+        return WIFI_POWER_MIN_MODEM;
+    }
+    return policy->config.idle_mode;
+}
+
+static void set_mode(wifi_power_policy_t *policy, wifi_power_mode_t mode, int64_t now_us)
+{
+    if (mode == policy->mode) {
+        return;
+    }
+    policy->stats.modes[policy->mode].residency_ms += (uint64_t)(now_us - policy->mode_since_us) / 1000;
+    policy->stats.modes[mode].entered++;
+    policy->mode = mode;
+    policy->mode_since_us = now_us;
+    policy->ops.apply(policy->ops.ctx, mode);
+}
+
+static void evaluate(wifi_power_policy_t *policy, int64_t now_us)
+{
+    int64_t recheck_us;
+    set_mode(policy, wanted_mode(policy, now_us, &recheck_us), now_us);
+
+    if (recheck_us == policy->timer_due_us) {
+        return;
+    }
+    policy->timer_due_us = recheck_us;
+    if (recheck_us == INT64_MAX) {
+        policy->ops.arm_timer(policy->ops.ctx, 0);
+    } else {
+        // Round up so the timer never fires just before the hold ends
+        policy->ops.arm_timer(policy->ops.ctx, (uint32_t)((recheck_us - now_us + 999) / 1000));
+    }
+}
+
+void wifi_power_init(wifi_power_policy_t *policy, const wifi_power_config_t *config,
+                     const wifi_power_ops_t *ops, int64_t now_us)
+{
+    memset(policy, 0, sizeof(*policy));
+    policy->config = *config;
+    policy->ops = *ops;
+    policy->mode = config->idle_mode;
+    policy->mode_since_us = now_us;
+    policy->timer_due_us = INT64_MAX;
+    policy->stats.modes[policy->mode].entered = 1;
+    policy->ops.apply(policy->ops.ctx, policy->mode);
+}
+
+void wifi_power_handle(wifi_power_policy_t *policy, wifi_power_event_t event, int64_t now_us)
+{
+    switch (event) {
+        case WIFI_POWER_EVT_COMMAND:
+            policy->last_command_us = now_us;
+            break;
+        case WIFI_POWER_EVT_ACTIVITY:
+            policy->last_activity_us = now_us;
+            break;
+        case WIFI_POWER_EVT_ESTOP_ON:
+            policy->estop = true;
+            break;
+        case WIFI_POWER_EVT_ESTOP_OFF:
+            // Stay awake for the follow-up commands after a release
+            policy->estop = false;
+            policy->last_command_us = now_us;
+            break;
+        case WIFI_POWER_EVT_TIMER:
+            policy->timer_due_us = INT64_MAX;
+            break;
+    }
+    evaluate(policy, now_us);
+}
+
+void wifi_power_record_latency(wifi_power_policy_t *policy, int64_t sent_us, int64_t now_us)
+{
+    if (sent_us < policy->mode_since_us) {
+        policy->stats.mixed_samples++;
+        return;
+    }
+
+    uint32_t latency_ms = (uint32_t)((now_us - sent_us) / 1000);
+    wifi_power_mode_stats_t *mode = &policy->stats.modes[policy->mode];
+    mode->samples++;
+    mode->latency_sum_ms += latency_ms;
+    if (latency_ms > mode->latency_max_ms) {
+        mode->latency_max_ms = latency_ms;
+    }
+
+    int bucket = 0;
+    while (bucket < WIFI_LATENCY_BUCKETS - 1 && latency_ms > latency_bucket_limits[bucket]) {
+        bucket++;
+    }
+    mode->latency_hist[bucket]++;
+}
+
+void wifi_power_get_stats(const wifi_power_policy_t *policy, wifi_power_stats_t *stats,
+                          int64_t now_us)
+{
+    *stats = policy->stats;
+    stats->modes[policy->mode].residency_ms += (uint64_t)(now_us - policy->mode_since_us) / 1000;
+}
+
+const char *wifi_power_mode_name(wifi_power_mode_t mode)
+{
+    return (unsigned)mode < WIFI_POWER_MODE_COUNT ? mode_names[mode] : "unknown";
+}
@@ -0,0 +1,97 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// WiFi power-save policy. In modem sleep, the AP buffers downlink frames
+// until the station's next DTIM (min) or listen interval (max) wake-up,
+// so a command can wait that long before the ESP sees it. The policy keeps
+// the modem awake while commands are arriving or an e-stop is active. It
+// drops to min modem sleep while the elevator is in use, and to the idle
+// mode once everything has been quiet for a while.
+//
+// Platform free like wifi_supervisor: the driver and timer are reached
+// through wifi_power_ops_t, and time is passed in. Not thread safe: deliver
+// all events from one task.
+
+// Ordered from most awake to most power saving
+typedef enum {
+    WIFI_POWER_NONE,            // WIFI_PS_NONE
+    WIFI_POWER_MIN_MODEM,       // WIFI_PS_MIN_MODEM, wakes every DTIM
+    WIFI_POWER_MAX_MODEM,       // WIFI_PS_MAX_MODEM, wakes every listen interval
+    WIFI_POWER_MODE_COUNT,
+} wifi_power_mode_t;
+
+typedef enum {
+    WIFI_POWER_EVT_COMMAND,     // downlink command received
+    WIFI_POWER_EVT_ACTIVITY,    // elevator event (buttons, motion)
+    WIFI_POWER_EVT_ESTOP_ON,
+    WIFI_POWER_EVT_ESTOP_OFF,
+    WIFI_POWER_EVT_TIMER,       // timer armed through ops.arm_timer expired
+} wifi_power_event_t;
+
+typedef struct {
+    void (*apply)(void *ctx, wifi_power_mode_t mode);
+    void (*arm_timer)(void *ctx, uint32_t ms);  // one-shot WIFI_POWER_EVT_TIMER, 0 = cancel
+    void *ctx;
+} wifi_power_ops_t;
+
+typedef struct {
+    uint32_t command_hold_ms;   // modem stays awake this long after a command
+    uint32_t activity_hold_ms;  // at most min modem sleep this long after activity
+    wifi_power_mode_t idle_mode;
+} wifi_power_config_t;
+
+// Command arrival latency histogram, upper bounds in ms (last bucket is open)
+#define WIFI_LATENCY_BUCKET_LIMITS  { 10, 20, 50, 100, 200, 500, 1000 }
+#define WIFI_LATENCY_BUCKETS        8
+
+typedef struct {
+    uint32_t entered;               // switches into this mode
+    uint64_t residency_ms;          // total time spent in it
+    uint32_t samples;               // latency samples taken entirely in this mode
+    uint32_t latency_max_ms;
+    uint64_t latency_sum_ms;
+    uint32_t latency_hist[WIFI_LATENCY_BUCKETS];
+} wifi_power_mode_stats_t;
+
+typedef struct {
+    wifi_power_mode_stats_t modes[WIFI_POWER_MODE_COUNT];
+    uint32_t mixed_samples;         // mode changed while the sample was in flight
+} wifi_power_stats_t;
+
+typedef struct {
+    wifi_power_config_t config;
+    wifi_power_ops_t ops;
+    wifi_power_mode_t mode;
+    bool estop;
+    int64_t last_command_us;        // 0 = none yet
+    int64_t last_activity_us;
+    int64_t mode_since_us;
+    int64_t timer_due_us;           // INT64_MAX = no timer armed
+    wifi_power_stats_t stats;
+} wifi_power_policy_t;
+
+// Applies the starting mode (the idle mode) through ops.apply
+void wifi_power_init(wifi_power_policy_t *policy, const wifi_power_config_t *config,
+                     const wifi_power_ops_t *ops, int64_t now_us);
+
+void wifi_power_handle(wifi_power_policy_t *policy, wifi_power_event_t event, int64_t now_us);
+
+// One downlink latency measurement: sent at sent_us, received at now_us.
+// Counted against the mode that was in effect for the whole flight.
+void wifi_power_record_latency(wifi_power_policy_t *policy, int64_t sent_us, int64_t now_us);
+
+// Stats with the current mode's residency brought up to now_us
+void wifi_power_get_stats(const wifi_power_policy_t *policy, wifi_power_stats_t *stats,
+                          int64_t now_us);
+
+const char *wifi_power_mode_name(wifi_power_mode_t mode);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,156 @@
+// WiFi reconnect state machine
+
+#include "comm/wifi_supervisor.h"
+#include "comm/backoff.h"
+#include <string.h>
+
+#define TIMER_SLACK_US  1000
+
+static const uint32_t offline_bucket_limits[WIFI_OFFLINE_BUCKETS - 1] = WIFI_OFFLINE_BUCKET_LIMITS;
+
+static void arm_timer(wifi_supervisor_t *sup, uint32_t ms, int64_t now_us)
+{
+    sup->timer_due_us = ms ? now_us + (int64_t)ms * 1000 : INT64_MAX;
+    sup->ops.arm_timer(sup->ops.ctx, ms);
+}
+
+static uint32_t backoff_ms(wifi_supervisor_t *sup)
+{
+    uint8_t attempt = sup->failures > 0 ? sup->failures - 1 : 0;
+    return backoff_delay_ms(sup->config.backoff_min_ms, sup->config.backoff_max_ms, attempt,
+                            sup->ops.random(sup->ops.ctx));
+}
+
+static void start_attempt(wifi_supervisor_t *sup, bool use_cached_ap, int64_t now_us)
+{
+    sup->state = WIFI_SUP_CONNECTING;
+    sup->stats.attempts++;
+    arm_timer(sup, sup->config.attempt_timeout_ms, now_us);
+    sup->ops.connect(sup->ops.ctx, use_cached_ap);
+}
+
+// Time left before the watchdog restarts the driver (INT64_MAX if off)
+static int64_t watchdog_left_us(const wifi_supervisor_t *sup, int64_t now_us)
+{
+    if (sup->config.watchdog_ms == 0) {
+        return INT64_MAX;
+    }
+    return sup->watchdog_ref_us + (int64_t)sup->config.watchdog_ms * 1000 - now_us;
+}
+
+static void restart_driver(wifi_supervisor_t *sup, int64_t now_us)
+{
+    sup->stats.watchdog_restarts++;
+    sup->watchdog_ref_us = now_us;
+    sup->failures = 0;
+    sup->state = WIFI_SUP_RESTARTING;
+    arm_timer(sup, sup->config.attempt_timeout_ms, now_us);
+    sup->ops.restart(sup->ops.ctx);
+}
+
+static void attempt_failed(wifi_supervisor_t *sup, int64_t now_us)
+{
+    if (sup->failures < UINT8_MAX) {
+        sup->failures++;
+    }
+
+    int64_t left_us = watchdog_left_us(sup, now_us);
+    if (left_us <= 0) {
+        restart_driver(sup, now_us);
+        return;
+    }
+
+    // Never back off past the watchdog: reconnect latency stays bounded
+    uint32_t delay_ms = backoff_ms(sup);
+    if ((int64_t)delay_ms * 1000 > left_us) {
+        delay_ms = (uint32_t)(left_us / 1000) + 1;
+    }
+    sup->stats.last_backoff_ms = delay_ms;
+    sup->state = WIFI_SUP_BACKOFF;
+    arm_timer(sup, delay_ms, now_us);
+}
+
+static void record_offline(wifi_supervisor_t *sup, int64_t now_us)
+{
+    uint32_t offline_ms = (uint32_t)((now_us - sup->offline_since_us) / 1000);
+    int bucket = 0;
+    while (bucket < WIFI_OFFLINE_BUCKETS - 1 && offline_ms >= offline_bucket_limits[bucket]) {
+        bucket++;
+    }
+
+    sup->stats.offline_hist[bucket]++;
+    sup->stats.reconnects++;
+    sup->stats.last_offline_ms = offline_ms;
+    if (offline_ms > sup->stats.max_offline_ms) {
+        sup->stats.max_offline_ms = offline_ms;
+    }
+}
+
+void wifi_supervisor_init(wifi_supervisor_t *sup, const wifi_supervisor_config_t *config,
+                          const wifi_supervisor_ops_t *ops)
+{
+    memset(sup, 0, sizeof(*sup));
+    sup->config = *config;
+    sup->ops = *ops;
+    sup->state = WIFI_SUP_IDLE;
+    sup->timer_due_us = INT64_MAX;
+}
+
+void wifi_supervisor_handle(wifi_supervisor_t *sup, wifi_sup_event_t event, int64_t now_us)
+{
+    switch (event) {
+        case WIFI_SUP_EVT_STARTED:
+            if (sup->state == WIFI_SUP_IDLE) {
+                sup->watchdog_ref_us = now_us;
+                start_attempt(sup, true, now_us);
+            } else if (sup->state == WIFI_SUP_RESTARTING) {
+                start_attempt(sup, false, now_us);
+            }
+            break;
+
+        case WIFI_SUP_EVT_DISCONNECTED:
+            if (sup->state == WIFI_SUP_ONLINE) {
+                // Usually a blip: retry at once on the AP we just lost
+                sup->stats.disconnects++;
+                sup->offline_since_us = now_us;
+                sup->watchdog_ref_us = now_us;
+                sup->failures = 0;
+                sup->ops.link_changed(sup->ops.ctx, false);
+                start_attempt(sup, true, now_us);
+            } else if (sup->state == WIFI_SUP_CONNECTING) {
+                attempt_failed(sup, now_us);
+            }
+            // BACKOFF / RESTARTING: echo of our own disconnect or stop
+            break;
+
+        case WIFI_SUP_EVT_GOT_IP:
+            if (sup->offline_since_us != 0) {
+                record_offline(sup, now_us);
+            }
+            sup->offline_since_us = 0;
+            sup->failures = 0;
+            sup->state = WIFI_SUP_ONLINE;
+            arm_timer(sup, 0, now_us);
+            sup->ops.link_changed(sup->ops.ctx, true);
+            break;
+
+        case WIFI_SUP_EVT_TIMER:
+            if (sup->timer_due_us - now_us > TIMER_SLACK_US) {
+                break;  // stale: re-armed or cancelled since
+            }
+            sup->timer_due_us = INT64_MAX;
+            if (sup->state == WIFI_SUP_CONNECTING) {
+                sup->ops.disconnect(sup->ops.ctx);
+                attempt_failed(sup, now_us);
+            } else if (sup->state == WIFI_SUP_BACKOFF) {
+                if (watchdog_left_us(sup, now_us) <= 0) {
+                    restart_driver(sup, now_us);
+                } else {
+                    start_attempt(sup, false, now_us);
+                }
+            } else if (sup->state == WIFI_SUP_RESTARTING) {
+                attempt_failed(sup, now_us);
+            }
+            break;
+    }
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// WiFi reconnect state machine. Platform free: the driver, the timer and
+// randomness are reached through wifi_supervisor_ops_t and time is passed
+// in, so it can be driven by mocked events. Not thread safe: deliver all
+// events from one task.
+//
+// A link drop gets one immediate retry on the cached AP/channel, then
+// jittered exponential backoff between attempts. Each attempt has a
+// timeout, and once the link has been down for watchdog_ms the driver is
+// restarted, so an outage is retried from scratch within watchdog_ms plus
+// one attempt timeout. It never gives up.
+
+typedef enum {
+    WIFI_SUP_EVT_STARTED,       // driver started (boot or watchdog restart)
+    WIFI_SUP_EVT_DISCONNECTED,  // association lost or attempt failed
+    WIFI_SUP_EVT_GOT_IP,
+    WIFI_SUP_EVT_TIMER,         // timer armed through ops.arm_timer expired
+} wifi_sup_event_t;
+
+typedef enum {
+    WIFI_SUP_IDLE,              // waiting for the driver to start
+    WIFI_SUP_CONNECTING,
+    WIFI_SUP_ONLINE,
+    WIFI_SUP_BACKOFF,
+    WIFI_SUP_RESTARTING,        // watchdog restarted the driver
+} wifi_sup_state_t;
+
+typedef struct {
+    void (*connect)(void *ctx, bool use_cached_ap);
+    void (*disconnect)(void *ctx);          // abort a timed-out attempt
+    void (*restart)(void *ctx);             // stop + start the driver
+    void (*arm_timer)(void *ctx, uint32_t ms);  // one-shot WIFI_SUP_EVT_TIMER, 0 = cancel
+    void (*link_changed)(void *ctx, bool up);
+    uint32_t (*random)(void *ctx);
+    void *ctx;
+} wifi_supervisor_ops_t;
+
+typedef struct {
+    uint32_t backoff_min_ms;
+    uint32_t backoff_max_ms;
+    uint32_t attempt_timeout_ms;    // no IP within this = failed attempt
+    uint32_t watchdog_ms;           // offline this long = restart the driver, 0 = off
+} wifi_supervisor_config_t;
+
+// Offline time histogram, upper bounds in ms (last bucket is open)
+#define WIFI_OFFLINE_BUCKET_LIMITS  { 1000, 2000, 5000, 10000, 30000, 60000, 300000 }
+#define WIFI_OFFLINE_BUCKETS        8
+
+typedef struct {
+    uint32_t disconnects;           // link drops while online
+    uint32_t reconnects;            // back online after a drop
+    uint32_t attempts;              // connect attempts
+    uint32_t watchdog_restarts;
+    uint32_t last_backoff_ms;
+    uint32_t last_offline_ms;
+    uint32_t max_offline_ms;
+    uint32_t offline_hist[WIFI_OFFLINE_BUCKETS];
+} wifi_supervisor_stats_t;
+
+typedef struct {
+    wifi_supervisor_config_t config;
+    wifi_supervisor_ops_t ops;
+    wifi_sup_state_t state;
+    uint8_t failures;               // consecutive failed attempts (backoff exponent)
+    int64_t offline_since_us;       // 0 = online, or never connected yet
+    int64_t watchdog_ref_us;        // start of the current outage or last restart
+    int64_t timer_due_us;           // INT64_MAX = no timer armed
+    wifi_supervisor_stats_t stats;
+} wifi_supervisor_t;
+
+void wifi_supervisor_init(wifi_supervisor_t *sup, const wifi_supervisor_config_t *config,
+                          const wifi_supervisor_ops_t *ops);
+
+void wifi_supervisor_handle(wifi_supervisor_t *sup, wifi_sup_event_t event, int64_t now_us);
+
+#ifdef __cplusplus
+}
+#endif
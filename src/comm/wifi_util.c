@@ -1,59 +1,325 @@
 // ESP-IDF WiFi station mode utility
 
 #include "comm/wifi_util.h"
+#include "comm/wifi_supervisor.h"
+#include "comm/wifi_power.h"
+#include "comm/boot_timeline.h"
 #include <string.h>
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "freertos/event_groups.h"
 #include "esp_wifi.h"
 #include "esp_event.h"
+#include "esp_netif.h"
+#include "esp_timer.h"
+#include "esp_random.h"
 #include "esp_log.h"
+#include "nvs.h"
 
 static const char *TAG = "WIFI";
 
 // Event group for WiFi connection status
 static EventGroupHandle_t s_wifi_event_group;
+static StaticEventGroup_t s_wifi_event_group_buf;
 #define WIFI_CONNECTED_BIT BIT0
 #define WIFI_FAIL_BIT      BIT1
 
+// Failed attempts before the first connection after which
+// wifi_wait_connected() gives up (the supervisor keeps trying)
 static int s_retry_num = 0;
 #define MAX_RETRY 10
 
+// Reconnect supervisor (comm/wifi_supervisor.c). Its timer expiries are
+// posted to the default event loop so every supervisor event runs on the
+// event task.
+#define WIFI_BACKOFF_MIN_MS         500
+#define WIFI_BACKOFF_MAX_MS         60000
+#define WIFI_ATTEMPT_TIMEOUT_MS     15000
+#define WIFI_WATCHDOG_MS            120000
+
+ESP_EVENT_DEFINE_BASE(WIFI_SUP_EVENT);
+
+static wifi_supervisor_t s_supervisor;
+static esp_timer_handle_t s_sup_timer = NULL;
+static void (*s_on_link_change)(bool up) = NULL;
+
+// Power-save policy (comm/wifi_power.c). Activity notes, latency samples
+// and timer expiries are posted to the default event loop like the
+// supervisor's, so the policy only ever runs on the event task.
+#define POWER_EVT_LATENCY   0x100   // event id after the wifi_power_event_t ids
+
+ESP_EVENT_DEFINE_BASE(WIFI_POWER_EVENT);
+
+typedef struct {
+    int64_t sent_us;
+    int64_t received_us;
+} latency_sample_t;
+
+// Latest probe sample; posted without event data, which esp_event would
+// copy to the heap. Samples are seconds apart, a newer one may replace it.
+static latency_sample_t s_latency_sample;
+static portMUX_TYPE s_latency_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static wifi_power_policy_t s_power;
+static bool s_power_enabled = false;
+static esp_timer_handle_t s_power_timer = NULL;
+
+// Fast connect: BSSID + channel of the last successful connection, kept in
+// NVS per SSID (and in RAM for the current session). Connecting to a known
+// AP on a known channel skips the full scan of all channels. Used for the
+// first connection after boot (if enabled) and the first retry after a
+// link drop; later attempts scan normally in case the AP moved.
+#define FAST_CONNECT_NVS_NS "wifi_fast"
+
+typedef struct {
+    char ssid[33];
+    uint8_t bssid[6];
+    uint8_t channel;
+} fast_connect_hint_t;
+
+static wifi_config_t s_wifi_config;
+static fast_connect_hint_t s_hint;
+static bool s_hint_valid = false;
+
+static bool hint_load(const char *ssid, fast_connect_hint_t *hint)
+{
+    nvs_handle_t nvs;
+    if (nvs_open(FAST_CONNECT_NVS_NS, NVS_READONLY, &nvs) != ESP_OK) {
+        return false;
+    }
+    size_t len = sizeof(*hint);
+    esp_err_t err = nvs_get_blob(nvs, "hint", hint, &len);
+    nvs_close(nvs);
+
+    return err == ESP_OK && len == sizeof(*hint) && hint->channel != 0 &&
+           strncmp(hint->ssid, ssid, sizeof(hint->ssid)) == 0;
+}
+
+static void hint_save(void)
+{
+    wifi_ap_record_t ap;
+    if (esp_wifi_sta_get_ap_info(&ap) != ESP_OK) {
+        return;
+    }
+
+    fast_connect_hint_t hint = { 0 };
+    strncpy(hint.ssid, (const char *)s_wifi_config.sta.ssid, sizeof(hint.ssid) - 1);
+    memcpy(hint.bssid, ap.bssid, sizeof(hint.bssid));
+    hint.channel = ap.primary;
+    s_hint = hint;
+    s_hint_valid = true;
+
+    fast_connect_hint_t old;
+    if (hint_load(hint.ssid, &old) && memcmp(&old, &hint, sizeof(hint)) == 0) {
+        return;     // unchanged, spare the flash
+    }
+
+    nvs_handle_t nvs;
+    if (nvs_open(FAST_CONNECT_NVS_NS, NVS_READWRITE, &nvs) == ESP_OK) {
+        nvs_set_blob(nvs, "hint", &hint, sizeof(hint));
+        nvs_commit(nvs);
+        nvs_close(nvs);
+    }
+}
+
+// Point the next attempt at the cached AP, or back to a full scan
+static void hint_apply(bool use)
+{
+    if (use && s_hint_valid) {
+        s_wifi_config.sta.bssid_set = true;
+        memcpy(s_wifi_config.sta.bssid, s_hint.bssid, sizeof(s_hint.bssid));
+        s_wifi_config.sta.channel = s_hint.channel;
+        s_wifi_config.sta.scan_method = WIFI_FAST_SCAN;
+    } else {
+        s_wifi_config.sta.bssid_set = false;
+        s_wifi_config.sta.channel = 0;
+        s_wifi_config.sta.scan_method = WIFI_ALL_CHANNEL_SCAN;
+    }
+    esp_wifi_set_config(WIFI_IF_STA, &s_wifi_config);
+}
+
+// === Supervisor ops ===
+
+static void sup_connect(void *ctx, bool use_cached_ap)
+{
+    (void)ctx;
+    hint_apply(use_cached_ap);
+    ESP_LOGI(TAG, "Connecting%s", s_wifi_config.sta.bssid_set ? " (cached channel)" : "");
+    esp_wifi_connect();
+}
+
+static void sup_disconnect(void *ctx)
+{
+    (void)ctx;
+    esp_wifi_disconnect();
+}
+
+static void sup_restart(void *ctx)
+{
+    (void)ctx;
+    ESP_LOGW(TAG, "Offline too long, restarting WiFi driver");
+    esp_wifi_stop();
+    esp_wifi_start();
+}
+
+static void sup_arm_timer(void *ctx, uint32_t ms)
+{
+    (void)ctx;
+    esp_timer_stop(s_sup_timer);
+    if (ms > 0) {
+        esp_timer_start_once(s_sup_timer, (uint64_t)ms * 1000);
+    }
+}
+
+static void sup_link_changed(void *ctx, bool up)
+{
+    (void)ctx;
+    if (up) {
+        xEventGroupClearBits(s_wifi_event_group, WIFI_FAIL_BIT);
+        xEventGroupSetBits(s_wifi_event_group, WIFI_CONNECTED_BIT);
+    } else {
+        xEventGroupClearBits(s_wifi_event_group, WIFI_CONNECTED_BIT);
+    }
+    if (s_on_link_change) {
+        s_on_link_change(up);
+    }
+}
+
+static uint32_t sup_random(void *ctx)
+{
+    (void)ctx;
+    return esp_random();
+}
+
+static void sup_timer_cb(void *arg)
+{
+    (void)arg;
+    esp_event_post(WIFI_SUP_EVENT, 0, NULL, 0, 0);
+}
+
+// === Power-save policy ops ===
+
+static const wifi_ps_type_t power_ps_types[WIFI_POWER_MODE_COUNT] = {
+    [WIFI_POWER_NONE]      = WIFI_PS_NONE,
+    [WIFI_POWER_MIN_MODEM] = WIFI_PS_MIN_MODEM,
+    [WIFI_POWER_MAX_MODEM] = WIFI_PS_MAX_MODEM,
+};
+
+static void power_apply(void *ctx, wifi_power_mode_t mode)
+{
+    (void)ctx;
+    ESP_LOGI(TAG, "Power save: %s", wifi_power_mode_name(mode));
+    esp_wifi_set_ps(power_ps_types[mode]);
+}
+
+static void power_arm_timer(void *ctx, uint32_t ms)
+{
+    (void)ctx;
+    esp_timer_stop(s_power_timer);
+    if (ms > 0) {
+        esp_timer_start_once(s_power_timer, (uint64_t)ms * 1000);
+    }
+}
+
+static void power_timer_cb(void *arg)
+{
+    (void)arg;
+    esp_event_post(WIFI_POWER_EVENT, WIFI_POWER_EVT_TIMER, NULL, 0, 0);
+}
+
+static void power_start(const wifi_power_config_t *config)
+{
+    const esp_timer_create_args_t timer_args = {
+        .callback = power_timer_cb,
+        .name = "wifi_power",
+    };
+    ESP_ERROR_CHECK(esp_timer_create(&timer_args, &s_power_timer));
+
+    const wifi_power_ops_t ops = {
+        .apply = power_apply,
+        .arm_timer = power_arm_timer,
+    };
+    wifi_power_init(&s_power, config, &ops, esp_timer_get_time());
+    s_power_enabled = true;
+}
+
+static void set_static_ip(esp_netif_t *netif, const wifi_options_t *options)
+{
+    esp_netif_ip_info_t ip_info = { 0 };
+    ip_info.ip.addr = esp_ip4addr_aton(options->static_ip);
+    ip_info.gw.addr = options->gateway ? esp_ip4addr_aton(options->gateway) : 0;
+    ip_info.netmask.addr = esp_ip4addr_aton(options->netmask ? options->netmask : "255.255.255.0");
+
+    ESP_ERROR_CHECK(esp_netif_dhcpc_stop(netif));
+    ESP_ERROR_CHECK(esp_netif_set_ip_info(netif, &ip_info));
+
+    esp_netif_dns_info_t dns = { 0 };
+    dns.ip.type = ESP_IPADDR_TYPE_V4;
+    dns.ip.u_addr.ip4.addr = options->dns ? esp_ip4addr_aton(options->dns) : ip_info.gw.addr;
+    esp_netif_set_dns_info(netif, ESP_NETIF_DNS_MAIN, &dns);
+
+    ESP_LOGI(TAG, "Static IP %s", options->static_ip);
+}
+
 static void wifi_event_handler(void *arg, esp_event_base_t event_base,
                                int32_t event_id, void *event_data)
 {
-    if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_START) {
-        esp_wifi_connect();
+    int64_t now = esp_timer_get_time();
+
+    if (event_base == WIFI_SUP_EVENT) {
+        wifi_supervisor_handle(&s_supervisor, WIFI_SUP_EVT_TIMER, now);
+    } else if (event_base == WIFI_POWER_EVENT && event_id == POWER_EVT_LATENCY) {
+        portENTER_CRITICAL(&s_latency_lock);
+        latency_sample_t sample = s_latency_sample;
+        portEXIT_CRITICAL(&s_latency_lock);
+        wifi_power_record_latency(&s_power, sample.sent_us, sample.received_us);
+    } else if (event_base == WIFI_POWER_EVENT) {
+        wifi_power_handle(&s_power, (wifi_power_event_t)event_id, now);
+    } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_START) {
+        wifi_supervisor_handle(&s_supervisor, WIFI_SUP_EVT_STARTED, now);
+    } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_CONNECTED) {
+        boot_timeline_mark(BOOT_TL_WIFI_ASSOC);
     } else if (event_base == WIFI_EVENT && event_id == WIFI_EVENT_STA_DISCONNECTED) {
-        if (s_retry_num < MAX_RETRY) {
-            esp_wifi_connect();
-            s_retry_num++;
-            ESP_LOGI(TAG, "Retry connection (%d/%d)", s_retry_num, MAX_RETRY);
-        } else {
+        ESP_LOGW(TAG, "Disconnected from AP");
+        if (!(xEventGroupGetBits(s_wifi_event_group) & WIFI_CONNECTED_BIT) && ++s_retry_num == MAX_RETRY) {
             xEventGroupSetBits(s_wifi_event_group, WIFI_FAIL_BIT);
         }
-        ESP_LOGW(TAG, "Disconnected from AP");
+        wifi_supervisor_handle(&s_supervisor, WIFI_SUP_EVT_DISCONNECTED, now);
+        if (s_supervisor.state == WIFI_SUP_BACKOFF) {
+            ESP_LOGI(TAG, "Retry in %lu ms", (unsigned long)s_supervisor.stats.last_backoff_ms);
+        }
     } else if (event_base == IP_EVENT && event_id == IP_EVENT_STA_GOT_IP) {
         ip_event_got_ip_t *event = (ip_event_got_ip_t *)event_data;
         ESP_LOGI(TAG, "Got IP: " IPSTR, IP2STR(&event->ip_info.ip));
         s_retry_num = 0;
-        xEventGroupSetBits(s_wifi_event_group, WIFI_CONNECTED_BIT);
+        boot_timeline_mark(BOOT_TL_WIFI_GOT_IP);
+        hint_save();
+        wifi_supervisor_handle(&s_supervisor, WIFI_SUP_EVT_GOT_IP, now);
+        if (s_supervisor.stats.reconnects > 0) {
+            ESP_LOGI(TAG, "Back online after %lu ms", (unsigned long)s_supervisor.stats.last_offline_ms);
+        }
     }
 }
 
-void wifi_init(const char *ssid, const char *password)
+void wifi_start(const char *ssid, const char *password, const wifi_options_t *options)
 {
-    s_wifi_event_group = xEventGroupCreate();
+    s_wifi_event_group = xEventGroupCreateStatic(&s_wifi_event_group_buf);
 
     ESP_ERROR_CHECK(esp_netif_init());
     ESP_ERROR_CHECK(esp_event_loop_create_default());
-    esp_netif_create_default_wifi_sta();
+    esp_netif_t *netif = esp_netif_create_default_wifi_sta();
+
+    if (options && options->static_ip && options->static_ip[0]) {
+        set_static_ip(netif, options);
+    }
 
     wifi_init_config_t cfg = WIFI_INIT_CONFIG_DEFAULT();
     ESP_ERROR_CHECK(esp_wifi_init(&cfg));
 
     esp_event_handler_instance_t instance_any_id;
     esp_event_handler_instance_t instance_got_ip;
+    esp_event_handler_instance_t instance_sup;
+    esp_event_handler_instance_t instance_power;
     ESP_ERROR_CHECK(esp_event_handler_instance_register(WIFI_EVENT,
                                                         ESP_EVENT_ANY_ID,
                                                         &wifi_event_handler,
@@ -64,37 +330,121 @@ void wifi_init(const char *ssid, const char *password)
                                                         &wifi_event_handler,
                                                         NULL,
                                                         &instance_got_ip));
+    ESP_ERROR_CHECK(esp_event_handler_instance_register(WIFI_SUP_EVENT,
+                                                        ESP_EVENT_ANY_ID,
+                                                        &wifi_event_handler,
+                                                        NULL,
+                                                        &instance_sup));
+    ESP_ERROR_CHECK(esp_event_handler_instance_register(WIFI_POWER_EVENT,
+                                                        ESP_EVENT_ANY_ID,
+                                                        &wifi_event_handler,
+                                                        NULL,
+                                                        &instance_power));
 
-    wifi_config_t wifi_config = {
-        .sta = {
-            .threshold.authmode = WIFI_AUTH_WPA2_PSK,
-        },
+    const esp_timer_create_args_t timer_args = {
+        .callback = sup_timer_cb,
+        .name = "wifi_supervisor",
     };
-    strncpy((char *)wifi_config.sta.ssid, ssid, sizeof(wifi_config.sta.ssid) - 1);
-    strncpy((char *)wifi_config.sta.password, password, sizeof(wifi_config.sta.password) - 1);
+    ESP_ERROR_CHECK(esp_timer_create(&timer_args, &s_sup_timer));
+
+    wifi_supervisor_config_t sup_cfg = {
+        .backoff_min_ms = (options && options->backoff_min_ms) ? options->backoff_min_ms : WIFI_BACKOFF_MIN_MS,
+        .backoff_max_ms = (options && options->backoff_max_ms) ? options->backoff_max_ms : WIFI_BACKOFF_MAX_MS,
+        .attempt_timeout_ms = WIFI_ATTEMPT_TIMEOUT_MS,
+        .watchdog_ms = (options && options->watchdog_ms) ? options->watchdog_ms : WIFI_WATCHDOG_MS,
+    };
+    const wifi_supervisor_ops_t sup_ops = {
+        .connect = sup_connect,
+        .disconnect = sup_disconnect,
+        .restart = sup_restart,
+        .arm_timer = sup_arm_timer,
+        .link_changed = sup_link_changed,
+        .random = sup_random,
+    };
+    wifi_supervisor_init(&s_supervisor, &sup_cfg, &sup_ops);
+    s_on_link_change = options ? options->on_link_change : NULL;
+
+    memset(&s_wifi_config, 0, sizeof(s_wifi_config));
+    s_wifi_config.sta.threshold.authmode = WIFI_AUTH_WPA2_PSK;
+    strncpy((char *)s_wifi_config.sta.ssid, ssid, sizeof(s_wifi_config.sta.ssid) - 1);
+    strncpy((char *)s_wifi_config.sta.password, password, sizeof(s_wifi_config.sta.password) - 1);
+
+    // The supervisor's first attempt uses the cached AP
+    if (options && options->fast_connect && hint_load(ssid, &s_hint)) {
+        s_hint_valid = true;
+        ESP_LOGI(TAG, "Fast connect: channel %d", s_hint.channel);
+    }
+
+    if (options && options->power_policy) {
+        power_start(options->power_policy);
+    }
 
     ESP_ERROR_CHECK(esp_wifi_set_mode(WIFI_MODE_STA));
-    ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &wifi_config));
+    ESP_ERROR_CHECK(esp_wifi_set_config(WIFI_IF_STA, &s_wifi_config));
     ESP_ERROR_CHECK(esp_wifi_start());
+    boot_timeline_mark(BOOT_TL_WIFI_START);
 
     ESP_LOGI(TAG, "Connecting to %s...", ssid);
+}
 
-    // Wait for connection
+bool wifi_wait_connected(uint32_t timeout_ms)
+{
     EventBits_t bits = xEventGroupWaitBits(s_wifi_event_group,
                                            WIFI_CONNECTED_BIT | WIFI_FAIL_BIT,
                                            pdFALSE,
                                            pdFALSE,
-                                           portMAX_DELAY);
+                                           timeout_ms == UINT32_MAX ? portMAX_DELAY : pdMS_TO_TICKS(timeout_ms));
+    return (bits & WIFI_CONNECTED_BIT) != 0;
+}
 
-    if (bits & WIFI_CONNECTED_BIT) {
+void wifi_init(const char *ssid, const char *password)
+{
+    wifi_start(ssid, password, NULL);
+
+    if (wifi_wait_connected(UINT32_MAX)) {
         ESP_LOGI(TAG, "Connected to %s", ssid);
-    } else if (bits & WIFI_FAIL_BIT) {
+    } else {
         ESP_LOGE(TAG, "Failed to connect to %s", ssid);
     }
 }
 
+void wifi_get_stats(wifi_supervisor_stats_t *stats)
+{
+    *stats = s_supervisor.stats;
+}
+
+void wifi_note_activity(wifi_power_event_t event)
+{
+    if (s_power_enabled) {
+        esp_event_post(WIFI_POWER_EVENT, event, NULL, 0, 0);
+    }
+}
+
+void wifi_note_latency(int64_t sent_us)
+{
+    if (s_power_enabled) {
+        portENTER_CRITICAL(&s_latency_lock);
+        s_latency_sample.sent_us = sent_us;
+        s_latency_sample.received_us = esp_timer_get_time();
+        portEXIT_CRITICAL(&s_latency_lock);
+        esp_event_post(WIFI_POWER_EVENT, POWER_EVT_LATENCY, NULL, 0, 0);
+    }
+}
+
+void wifi_get_power_stats(wifi_power_stats_t *stats)
+{
+    if (!s_power_enabled) {
+        memset(stats, 0, sizeof(*stats));
+        return;
+    }
+    wifi_power_get_stats(&s_power, stats, esp_timer_get_time());
+}
+
 bool wifi_is_connected(void)
 {
+    if (s_wifi_event_group == NULL) {
+        return false;
+    }
     EventBits_t bits = xEventGroupGetBits(s_wifi_event_group);
     return (bits & WIFI_CONNECTED_BIT) != 0;
 }
@@ -1,17 +1,54 @@
 #pragma once
 
 #include <stdbool.h>
+#include <stdint.h>
+#include "comm/wifi_supervisor.h"
+#include "comm/wifi_power.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+typedef struct {
+    bool fast_connect;        // reuse BSSID + channel of the last connection (NVS), no full scan
+    const char *static_ip;    // dotted quad, NULL or "" = DHCP
+    const char *gateway;
+    const char *netmask;
+    const char *dns;          // NULL = gateway
+    uint32_t backoff_min_ms;  // reconnect backoff, 0 = defaults
+    uint32_t backoff_max_ms;
+    uint32_t watchdog_ms;     // restart the driver after this long offline
+    void (*on_link_change)(bool up);    // called from the event task
+    const wifi_power_config_t *power_policy;    // NULL = driver default power save
+} wifi_options_t;
+
 // Initialize WiFi in station mode and connect (blocking until connected)
 void wifi_init(const char *ssid, const char *password);
 
+// Initialize WiFi in station mode and start connecting in the background;
+// the link is kept up (reconnects never give up). Needs NVS; options may
+// be NULL (DHCP, full scan, default backoff).
+void wifi_start(const char *ssid, const char *password, const wifi_options_t *options);
+
+// Wait until connected or MAX_RETRY attempts failed, true if connected
+bool wifi_wait_connected(uint32_t timeout_ms);
+
 // Check if WiFi is connected
 bool wifi_is_connected(void);
 
+// Reconnect counters and offline time histogram
+void wifi_get_stats(wifi_supervisor_stats_t *stats);
+
+// Feed the power-save policy (any task; no-op without options->power_policy)
+void wifi_note_activity(wifi_power_event_t event);
+
+// Downlink latency sample for the power-save policy: a message sent at
+// sent_us (esp_timer time) has just arrived
+void wifi_note_latency(int64_t sent_us);
+
+// Time spent and command arrival latency per power-save mode
+void wifi_get_power_stats(wifi_power_stats_t *stats);
+
 #ifdef __cplusplus
 }
 #endif
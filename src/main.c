@@ -1,5 +1,5 @@
 // ESP-IDF main for UpAndDownESP
-// Connects WiFi, MQTT, and TinyFrame communication with MAX32655
+// Starts TinyFrame communication with MAX32655, WiFi and MQTT
 
 #include <stdio.h>
 #include "freertos/FreeRTOS.h"
@@ -10,32 +10,188 @@
 #include "config.h"
 #include "comm/wifi_util.h"
 #include "comm/mqtt_util.h"
+#include "comm/mqtt_pubq.h"
 #include "app/max_comm.h"
+#include "app/boot.h"
+#include "app/capture_dump.h"
+#include "comm/boot_timeline.h"
+#include "comm/trace.h"
+#include "comm/task_stats.h"
+#include "comm/heap_watch.h"
 
 static const char *TAG = "MAIN";
 
-void app_main(void)
+// === Start-up stages ===
+// The UART link comes up without waiting for the network, and events
+// published before the broker is reachable wait in the outbox. WiFi and
+// MQTT start in parallel with it; MQTT connects once WiFi has an IP.
+//
+//   nvs -+-> outbox -+-> uart
+//        |           |
+//        +-> wifi ---+-> mqtt
+
+enum {
+    STAGE_NVS,
+    STAGE_OUTBOX,
+    STAGE_UART,
+    STAGE_WIFI,
+    STAGE_MQTT,
+    STAGE_COUNT
+};
+
+static bool start_nvs(void *ctx)
 {
-    // Initialize NVS (required for WiFi)
+    (void)ctx;
+
     esp_err_t ret = nvs_flash_init();
     if (ret == ESP_ERR_NVS_NO_FREE_PAGES || ret == ESP_ERR_NVS_NEW_VERSION_FOUND) {
         ESP_ERROR_CHECK(nvs_flash_erase());
         ret = nvs_flash_init();
     }
-    ESP_ERROR_CHECK(ret);
+    if (ret != ESP_OK) {
+        ESP_LOGE(TAG, "NVS init failed: %s", esp_err_to_name(ret));
+        return false;
+    }
+    boot_timeline_mark(BOOT_TL_NVS_READY);
+    return true;
+}
 
-    ESP_LOGI(TAG, "Starting UpAndDownESP...");
+// Buffer publishes while the broker is unreachable (and until it is first up)
+static bool start_outbox(void *ctx)
+{
+    (void)ctx;
+
+    mqtt_outbox_config_t outbox_cfg = {
+        .policy = MQTT_OUTBOX_POLICY,
+        .spill = (MQTT_OUTBOX_NVS_RECORDS > 0) ? mqtt_outbox_spill_nvs_init("mqtt_outbox", MQTT_OUTBOX_NVS_RECORDS) : NULL,
+        .replay_interval_ms = MQTT_OUTBOX_REPLAY_INTERVAL_MS,
+        .replay_burst = MQTT_OUTBOX_REPLAY_BURST,
+    };
+    mqtt_enable_outbox(&outbox_cfg);
+    return true;
+}
 
-    // Connect to WiFi (blocking)
-    wifi_init(WIFI_SSID, WIFI_PASSWORD);
+// MAX32655 communication (transport + protocol layers)
+static bool start_uart(void *ctx)
+{
+    (void)ctx;
 
-    // Initialize MAX32655 communication (transport + protocol layers)
     MaxComm_Init();
+    boot_timeline_mark(BOOT_TL_UART_READY);
+    return true;
+}
+
+// Connects in the background
+static bool start_wifi(void *ctx)
+{
+    (void)ctx;
+
+#if WIFI_PS_POLICY
+    static const wifi_power_config_t power_cfg = {
+        .command_hold_ms = WIFI_PS_COMMAND_HOLD_MS,
+        .activity_hold_ms = WIFI_PS_ACTIVITY_HOLD_MS,
+        .idle_mode = WIFI_PS_IDLE_MODE,
+    };
+#endif
+
+    wifi_options_t wifi_opts = {
+        .fast_connect = WIFI_FAST_CONNECT,
+        .static_ip = WIFI_STATIC_IP,
+        .gateway = WIFI_GATEWAY,
+        .netmask = WIFI_NETMASK,
+        .backoff_min_ms = WIFI_RECONNECT_MIN_MS,
+        .backoff_max_ms = WIFI_RECONNECT_MAX_MS,
+        .watchdog_ms = WIFI_RECONNECT_WATCHDOG_MS,
+        .on_link_change = mqtt_network_changed,
+#if WIFI_PS_POLICY
+        .power_policy = &power_cfg,
+#endif
+    };
+    wifi_start(WIFI_SSID, WIFI_PASSWORD, &wifi_opts);
+    return true;
+}
+
+static bool start_mqtt(void *ctx)
+{
+    (void)ctx;
+
+    mqtt_session_config_t session_cfg = {
+        .persistent_session = MQTT_PERSISTENT_SESSION,
+        .client_id_prefix = MQTT_CLIENT_ID_PREFIX,
+        .keepalive_s = MQTT_KEEPALIVE_S,
+        .backoff_min_ms = MQTT_RECONNECT_MIN_MS,
+        .backoff_max_ms = MQTT_RECONNECT_MAX_MS,
+        .skip_resubscribe = MQTT_SKIP_RESUBSCRIBE,
+        .mqtt5 = MQTT_USE_V5,
+        .topic_alias_max = MQTT5_TOPIC_ALIAS_MAX,
+        .session_expiry_s = MQTT5_SESSION_EXPIRY_S,
+    };
+    mqtt_set_session(&session_cfg);
 
-    // Initialize MQTT (uses MaxComm_OnMqttCommand callback)
-    mqtt_init(MQTT_HOST, MQTT_PORT, MQTT_TOPIC_EVENTS, MQTT_TOPIC_CMD, MaxComm_OnMqttCommand);
+    // Binary command passthrough (subscribed along with the command topic)
+    mqtt_subscribe(MQTT_TOPIC_CMD_BINARY, MQTT_CMD_QOS, MaxComm_OnMqttBinaryCommand, NULL);
 
-    ESP_LOGI(TAG, "Setup complete");
+#if UART_CAPTURE_BYTES > 0
+    // Raw UART traffic for replay on a PC (tools/uart_replay)
+    capture_dump_init(MQTT_TOPIC_CAPTURE, MQTT_TOPIC_CAPTURE_DUMP);
+#endif
+
+#if WIFI_PS_POLICY
+    // Command arrival latency per power-save mode
+    mqtt_start_latency_probe(MQTT_TOPIC_PROBE, WIFI_PS_PROBE_INTERVAL_MS, wifi_note_latency);
+#endif
+
+    // Connects (and retries) in the background, uses MaxComm_OnMqttCommand callback
+    mqtt_init(MQTT_HOST, MQTT_PORT, MQTT_TOPIC_CMD, MQTT_CMD_QOS, MaxComm_OnMqttCommand);
+    return true;
+}
+
+static const boot_stage_t boot_stages[STAGE_COUNT] = {
+    [STAGE_NVS]    = { "nvs",    start_nvs },
+    [STAGE_OUTBOX] = { "outbox", start_outbox, .deps = BOOT_DEP(STAGE_NVS) },
+    [STAGE_UART]   = { "uart",   start_uart,   .deps = BOOT_DEP(STAGE_OUTBOX) },
+    [STAGE_WIFI]   = { "wifi",   start_wifi,   .deps = BOOT_DEP(STAGE_NVS) },
+    [STAGE_MQTT]   = { "mqtt",   start_mqtt,   .deps = BOOT_DEP(STAGE_OUTBOX) | BOOT_DEP(STAGE_WIFI) },
+};
+
+// One summary per boot, retained so the latest is always visible. The
+// steady state starts here: app tasks should no longer allocate.
+static void publish_boot_timeline(const boot_timeline_t *timeline)
+{
+    char summary[320];
+    size_t len = boot_timeline_format(timeline, summary, sizeof(summary));
+    if (len > 0) {
+        mqtt_publish(MQTT_TOPIC_BOOT, (const uint8_t *)summary, (int)len, 1, true);
+    }
+    heap_watch_arm();
+}
+
+_Static_assert(TASK_STATS_REPORT_MAX <= MQTT_PUBQ_SLOT_DATA,
+               "task report parts must fit a publish queue slot");
+
+// Periodic task report, one message per part; dropped while offline
+// rather than queued
+static void publish_task_stats(const char *json, size_t len)
+{
+    if (mqtt_is_connected()) {
+        mqtt_publish(MQTT_TOPIC_TASKS, (const uint8_t *)json, (int)len, 0, false);
+    }
+}
+
+void app_main(void)
+{
+    boot_timeline_start(publish_boot_timeline);
+    trace_init();
+    task_stats_start(TASK_STATS_INTERVAL_MS, publish_task_stats);
+    ESP_LOGI(TAG, "Starting UpAndDownESP...");
+
+    bool ok = boot_run(boot_stages, STAGE_COUNT, NULL);
+    boot_timeline_mark(BOOT_TL_BOOT_GRAPH_DONE);
+    if (ok) {
+        ESP_LOGI(TAG, "Setup complete");
+    } else {
+        ESP_LOGE(TAG, "Setup incomplete");
+    }
 
     // Main task can exit - all work happens in FreeRTOS tasks
 }
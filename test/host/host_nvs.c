@@ -0,0 +1,124 @@
+// In-memory NVS for the host tests (see stubs/nvs.h)
+
+#include "nvs.h"
+#include <stdbool.h>
+#include <string.h>
+
+#define NVS_MAX_KEYS    64
+#define NVS_KEY_MAX     16      // NVS_KEY_NAME_MAX_SIZE
+#define NVS_VALUE_MAX   640
+
+typedef struct {
+    bool used;
+    char key[NVS_KEY_MAX];
+    size_t len;
+    uint8_t value[NVS_VALUE_MAX];
+} nvs_entry_t;
+
+static nvs_entry_t entries[NVS_MAX_KEYS];
+
+static nvs_entry_t *find(const char *key)
+{
+    for (int i = 0; i < NVS_MAX_KEYS; i++) {
+        if (entries[i].used && strcmp(entries[i].key, key) == 0) {
+            return &entries[i];
+        }
+    }
+    return NULL;
+}
+
+static esp_err_t set(const char *key, const void *value, size_t len)
+{
+    if (strlen(key) >= NVS_KEY_MAX || len > NVS_VALUE_MAX) {
+        return ESP_ERR_INVALID_ARG;
+    }
+    nvs_entry_t *entry = find(key);
+    for (int i = 0; entry == NULL && i < NVS_MAX_KEYS; i++) {
+        if (!entries[i].used) {
+            entry = &entries[i];
+        }
+    }
+    if (entry == NULL) {
+        return ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+    }
+    entry->used = true;
+    strcpy(entry->key, key);
+    memcpy(entry->value, value, len);
+    entry->len = len;
+    return ESP_OK;
+}
+
+esp_err_t nvs_open(const char *name, nvs_open_mode_t mode, nvs_handle_t *out)
+{
+    *out = 1;
+    return ESP_OK;
+}
+
+void nvs_close(nvs_handle_t handle)
+{
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char *key, void *out, size_t *len)
+{
+    nvs_entry_t *entry = find(key);
+    if (entry == NULL) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    if (out != NULL) {
+        if (*len < entry->len) {
+            return ESP_FAIL;
+        }
+        memcpy(out, entry->value, entry->len);
+    }
+    *len = entry->len;
+    return ESP_OK;
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char *key, const void *value, size_t len)
+{
+    return set(key, value, len);
+}
+
+esp_err_t nvs_get_u32(nvs_handle_t handle, const char *key, uint32_t *out)
+{
+    nvs_entry_t *entry = find(key);
+    if (entry == NULL || entry->len != sizeof(uint32_t)) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    memcpy(out, entry->value, sizeof(uint32_t));
+    return ESP_OK;
+}
+
+esp_err_t nvs_set_u32(nvs_handle_t handle, const char *key, uint32_t value)
+{
+    return set(key, &value, sizeof(value));
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char *key)
+{
+    nvs_entry_t *entry = find(key);
+    if (entry == NULL) {
+        return ESP_ERR_NVS_NOT_FOUND;
+    }
+    entry->used = false;
+    return ESP_OK;
+}
+
+esp_err_t nvs_commit(nvs_handle_t handle)
+{
+    return ESP_OK;
+}
+
+void host_nvs_erase_all(void)
+{
+    memset(entries, 0, sizeof(entries));
+}
+
+int host_nvs_key_count(void)
+{
+    int count = 0;
+    for (int i = 0; i < NVS_MAX_KEYS; i++) {
+        count += entries[i].used;
+    }
+    return count;
+}
@@ -0,0 +1,239 @@
+// FreeRTOS tasks and event groups for the host tests: every task is a real
+// thread, so modules that hand work between tasks run concurrently here.
+// Timeouts are in real time (one tick = 10 ms), unlike esp_timer's
+// virtual clock.
+
+#include "comm/task_table.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/event_groups.h"
+#include <errno.h>
+#include <pthread.h>
+#include <time.h>
+
+// === Tasks ===
+
+#define MAX_TASKS   16
+
+struct vtask {
+    bool used;
+    TaskFunction_t fn;
+    void *arg;
+    pthread_mutex_t lock;
+    pthread_cond_t notified;
+    uint32_t notify;
+};
+
+static struct vtask tasks[MAX_TASKS];
+static pthread_mutex_t tasks_lock = PTHREAD_MUTEX_INITIALIZER;
+static __thread struct vtask *current = NULL;
+
+static void deadline_after(TickType_t ticks, struct timespec *ts)
+{
+    clock_gettime(CLOCK_REALTIME, ts);
+    uint64_t ns = (uint64_t)ticks * (1000000000u / configTICK_RATE_HZ) + (uint64_t)ts->tv_nsec;
+    ts->tv_sec += (time_t)(ns / 1000000000u);
+    ts->tv_nsec = (long)(ns % 1000000000u);
+}
+
+static void task_exit(struct vtask *task)
+{
+    pthread_mutex_lock(&tasks_lock);
+    task->used = false;
+    pthread_mutex_unlock(&tasks_lock);
+}
+
+static void *task_thread(void *arg)
+{
+    struct vtask *task = arg;
+    current = task;
+    task->fn(task->arg);
+    task_exit(task);
+    return NULL;
+}
+
+bool task_create(task_id_t id, const char *name, TaskFunction_t fn, void *arg, TaskHandle_t *handle)
+{
+    if ((unsigned)id >= TASK_COUNT) {
+        return false;
+    }
+
+    struct vtask *task = NULL;
+    pthread_mutex_lock(&tasks_lock);
+    for (int i = 0; i < MAX_TASKS && task == NULL; i++) {
+        if (!tasks[i].used) {
+            task = &tasks[i];
+            task->used = true;
+        }
+    }
+    pthread_mutex_unlock(&tasks_lock);
+    if (task == NULL) {
+        return false;
+    }
+
+    task->fn = fn;
+    task->arg = arg;
+    task->notify = 0;
+    pthread_mutex_init(&task->lock, NULL);
+    pthread_cond_init(&task->notified, NULL);
+    // Set before the thread runs: the task may notify itself through it
+    if (handle) {
+        *handle = task;
+    }
+
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, task_thread, task) != 0) {
+        task_exit(task);
+        return false;
+    }
+    pthread_detach(thread);
+    return true;
+}
+
+void vTaskDelete(TaskHandle_t task)
+{
+    if (task == NULL && current != NULL) {
+        task_exit(current);
+        pthread_exit(NULL);
+    }
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    return current;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks_to_wait)
+{
+    struct vtask *self = current;
+    if (self == NULL) {
+        return 0;
+    }
+
+    struct timespec deadline;
+    if (ticks_to_wait != portMAX_DELAY) {
+        deadline_after(ticks_to_wait, &deadline);
+    }
+
+    pthread_mutex_lock(&self->lock);
+    while (self->notify == 0 && ticks_to_wait > 0) {
+        if (ticks_to_wait == portMAX_DELAY) {
+            pthread_cond_wait(&self->notified, &self->lock);
+        } else if (pthread_cond_timedwait(&self->notified, &self->lock, &deadline) == ETIMEDOUT) {
+            break;
+        }
+    }
+    uint32_t value = self->notify;
+    if (value > 0) {
+        self->notify = clear_on_exit ? 0 : value - 1;
+    }
+    pthread_mutex_unlock(&self->lock);
+    return value;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task)
+{
+    pthread_mutex_lock(&task->lock);
+    task->notify++;
+    pthread_cond_signal(&task->notified);
+    pthread_mutex_unlock(&task->lock);
+    return pdPASS;
+}
+
+// === Event groups ===
+
+#define MAX_EVENT_GROUPS    8
+
+struct host_event_group {
+    bool used;
+    EventBits_t bits;
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+};
+
+static struct host_event_group groups[MAX_EVENT_GROUPS];
+static pthread_mutex_t groups_lock = PTHREAD_MUTEX_INITIALIZER;
+
+EventGroupHandle_t xEventGroupCreateStatic(StaticEventGroup_t *buf)
+{
+    (void)buf;
+    pthread_mutex_lock(&groups_lock);
+    for (int i = 0; i < MAX_EVENT_GROUPS; i++) {
+        if (!groups[i].used) {
+            struct host_event_group *group = &groups[i];
+            group->used = true;
+            group->bits = 0;
+            pthread_mutex_init(&group->lock, NULL);
+            pthread_cond_init(&group->changed, NULL);
+            pthread_mutex_unlock(&groups_lock);
+            return group;
+        }
+    }
+    pthread_mutex_unlock(&groups_lock);
+    return NULL;
+}
+
+void vEventGroupDelete(EventGroupHandle_t group)
+{
+    pthread_mutex_lock(&groups_lock);
+    pthread_cond_destroy(&group->changed);
+    pthread_mutex_destroy(&group->lock);
+    group->used = false;
+    pthread_mutex_unlock(&groups_lock);
+}
+
+EventBits_t xEventGroupSetBits(EventGroupHandle_t group, EventBits_t bits)
+{
+    pthread_mutex_lock(&group->lock);
+    group->bits |= bits;
+    EventBits_t now = group->bits;
+    pthread_cond_broadcast(&group->changed);
+    pthread_mutex_unlock(&group->lock);
+    return now;
+}
+
+EventBits_t xEventGroupClearBits(EventGroupHandle_t group, EventBits_t bits)
+{
+    pthread_mutex_lock(&group->lock);
+    EventBits_t before = group->bits;
+    group->bits &= ~bits;
+    pthread_mutex_unlock(&group->lock);
+    return before;
+}
+
+EventBits_t xEventGroupGetBits(EventGroupHandle_t group)
+{
+    pthread_mutex_lock(&group->lock);
+    EventBits_t now = group->bits;
+    pthread_mutex_unlock(&group->lock);
+    return now;
+}
+
+EventBits_t xEventGroupWaitBits(EventGroupHandle_t group, EventBits_t bits, BaseType_t clear_on_exit,
+                                BaseType_t wait_for_all, TickType_t ticks_to_wait)
+{
+    struct timespec deadline;
+    if (ticks_to_wait != portMAX_DELAY) {
+        deadline_after(ticks_to_wait, &deadline);
+    }
+
+    pthread_mutex_lock(&group->lock);
+    for (;;) {
+        EventBits_t have = group->bits & bits;
+        if (wait_for_all ? have == bits : have != 0) {
+            break;
+        }
+        if (ticks_to_wait == portMAX_DELAY) {
+            pthread_cond_wait(&group->changed, &group->lock);
+        } else if (pthread_cond_timedwait(&group->changed, &group->lock, &deadline) == ETIMEDOUT) {
+            break;
+        }
+    }
+    EventBits_t now = group->bits;
+    EventBits_t have = now & bits;
+    if (clear_on_exit && (wait_for_all ? have == bits : have != 0)) {
+        group->bits &= ~bits;
+    }
+    pthread_mutex_unlock(&group->lock);
+    return now;
+}
@@ -0,0 +1,91 @@
+// Reconnect backoff (MQTT session and WiFi supervisor): exponential growth
+// from the minimum, the cap, equal-jitter bounds, and no overflow however
+// long the outage lasts
+
+#include "test_host.h"
+#include "comm/backoff.h"
+#include <stdlib.h>
+
+static void test_doubles_from_min_to_max(void)
+{
+    // random 0 gives the bottom of the jitter range, delay/2 the top
+    static const uint32_t expected[] = { 250, 500, 1000, 2000, 4000, 8000, 16000, 30000, 30000 };
+
+    for (uint8_t attempt = 0; attempt < sizeof(expected) / sizeof(expected[0]); attempt++) {
+        uint32_t delay = expected[attempt];
+        TEST_ASSERT_EQUAL(delay / 2, backoff_delay_ms(250, 30000, attempt, 0));
+        TEST_ASSERT_EQUAL(delay, backoff_delay_ms(250, 30000, attempt, delay / 2));
+    }
+}
+
+static void test_jitter_stays_within_half_to_full_delay(void)
+{
+    srand(1);
+    for (uint8_t attempt = 0; attempt < 10; attempt++) {
+        uint32_t full = 250u << attempt;
+        if (full > 30000) {
+            full = 30000;
+        }
+        for (int i = 0; i < 1000; i++) {
+            uint32_t delay = backoff_delay_ms(250, 30000, attempt, (uint32_t)rand());
+            TEST_ASSERT_TRUE(delay >= full / 2 && delay <= full);
+        }
+    }
+}
+
+static void test_long_outage_does_not_overflow(void)
+{
+    TEST_ASSERT_EQUAL(30000, backoff_delay_ms(250, 30000, 40, 15000));
+    TEST_ASSERT_EQUAL(30000, backoff_delay_ms(250, 30000, UINT8_MAX, 15000));
+
+    // A shift would wrap here: 100000 << 16 > UINT32_MAX
+    TEST_ASSERT_EQUAL(4000000000u, backoff_delay_ms(100000, 4000000000u, 16, 2000000000u));
+    TEST_ASSERT_EQUAL(UINT32_MAX / 2, backoff_delay_ms(3000000000u, UINT32_MAX, 1, 0));
+}
+
+static void test_min_above_max_uses_max(void)
+{
+    TEST_ASSERT_EQUAL(1000, backoff_delay_ms(5000, 1000, 0, 500));
+}
+
+static void test_zero_delay(void)
+{
+    TEST_ASSERT_EQUAL(0, backoff_delay_ms(0, 0, 3, 12345));
+    TEST_ASSERT_EQUAL(2, backoff_delay_ms(2, 2, 0, 1));
+}
+
+// A broker restart drops every client at once: with jitter their retries
+// spread over the second half of each backoff step instead of landing in
+// the same millisecond
+static void test_clients_dropped_together_spread_out(void)
+{
+    enum { CLIENTS = 200 };
+    srand(7);
+
+    for (uint8_t attempt = 0; attempt < 6; attempt++) {
+        uint32_t lo = UINT32_MAX, hi = 0;
+        int same_ms[64] = { 0 };
+        for (int c = 0; c < CLIENTS; c++) {
+            uint32_t delay = backoff_delay_ms(250, 30000, attempt, (uint32_t)rand());
+            lo = delay < lo ? delay : lo;
+            hi = delay > hi ? delay : hi;
+            same_ms[delay % 64]++;
+        }
+        uint32_t full = 250u << attempt;
+        TEST_ASSERT_TRUE(hi - lo > full / 4);
+        for (int i = 0; i < 64; i++) {
+            TEST_ASSERT_TRUE(same_ms[i] < CLIENTS / 4);
+        }
+    }
+}
+
+int main(void)
+{
+    RUN_TEST(test_doubles_from_min_to_max);
+    RUN_TEST(test_jitter_stays_within_half_to_full_delay);
+    RUN_TEST(test_long_outage_does_not_overflow);
+    RUN_TEST(test_min_above_max_uses_max);
+    RUN_TEST(test_zero_delay);
+    RUN_TEST(test_clients_dropped_together_spread_out);
+    return test_report();
+}
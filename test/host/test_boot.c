@@ -0,0 +1,194 @@
+// Start-up graph against mocked services: dependency order, independent
+// stages running concurrently, skips after a failure, and graphs that can
+// never finish
+
+#include "test_host.h"
+#include "app/boot.h"
+#include <pthread.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// Mock service: records when it started and finished (global order) and
+// can wait for other stages to be running at the same time
+typedef struct {
+    bool ok;
+    int sleep_ms;
+    int rendezvous;                 // wait until this many stages are inside
+    int started;                    // order numbers, 1-based
+    int finished;
+} mock_t;
+
+static atomic_int order;
+static pthread_mutex_t meet_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t meet_cond = PTHREAD_COND_INITIALIZER;
+static int meet_count;
+
+static bool mock_start(void *ctx)
+{
+    mock_t *mock = ctx;
+    mock->started = atomic_fetch_add(&order, 1) + 1;
+
+    bool ok = mock->ok;
+    if (mock->rendezvous > 0) {
+        // Only returns in time if the other stages really run concurrently
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += 2;
+
+        pthread_mutex_lock(&meet_lock);
+        meet_count++;
+        pthread_cond_broadcast(&meet_cond);
+        while (meet_count < mock->rendezvous) {
+            if (pthread_cond_timedwait(&meet_cond, &meet_lock, &deadline) != 0) {
+                ok = false;
+                break;
+            }
+        }
+        pthread_mutex_unlock(&meet_lock);
+    }
+    if (mock->sleep_ms > 0) {
+        usleep(mock->sleep_ms * 1000);
+    }
+
+    mock->finished = atomic_fetch_add(&order, 1) + 1;
+    return ok;
+}
+
+static void reset(mock_t *mocks, int count)
+{
+    atomic_store(&order, 0);
+    meet_count = 0;
+    for (int i = 0; i < count; i++) {
+        memset(&mocks[i], 0, sizeof(mocks[i]));
+        mocks[i].ok = true;
+    }
+}
+
+// Same shape as app_main's graph:
+//   nvs -+-> outbox -+-> uart
+//        |           +-------+
+//        +-> wifi -----------+-> mqtt
+enum { NVS, OUTBOX, UART, WIFI, MQTT, APP_STAGES };
+
+static mock_t app[APP_STAGES];
+
+static const boot_stage_t app_graph[APP_STAGES] = {
+    [NVS]    = { "nvs",    mock_start, &app[NVS],    0 },
+    [OUTBOX] = { "outbox", mock_start, &app[OUTBOX], BOOT_DEP(NVS) },
+    [UART]   = { "uart",   mock_start, &app[UART],   BOOT_DEP(OUTBOX) },
+    [WIFI]   = { "wifi",   mock_start, &app[WIFI],   BOOT_DEP(NVS) },
+    [MQTT]   = { "mqtt",   mock_start, &app[MQTT],   BOOT_DEP(OUTBOX) | BOOT_DEP(WIFI) },
+};
+
+static void test_stages_start_after_their_dependencies(void)
+{
+    reset(app, APP_STAGES);
+    boot_stage_result_t results[APP_STAGES];
+
+    TEST_ASSERT_TRUE(boot_run(app_graph, APP_STAGES, results));
+
+    TEST_ASSERT_EQUAL(1, app[NVS].started);
+    TEST_ASSERT_TRUE(app[OUTBOX].started > app[NVS].finished);
+    TEST_ASSERT_TRUE(app[WIFI].started > app[NVS].finished);
+    TEST_ASSERT_TRUE(app[UART].started > app[OUTBOX].finished);
+    TEST_ASSERT_TRUE(app[MQTT].started > app[OUTBOX].finished);
+    TEST_ASSERT_TRUE(app[MQTT].started > app[WIFI].finished);
+    for (int i = 0; i < APP_STAGES; i++) {
+        TEST_ASSERT_TRUE(results[i].ok);
+    }
+}
+
+// The point of the graph: a slow WiFi start doesn't hold up the UART link
+static void test_uart_is_not_held_up_by_wifi(void)
+{
+    reset(app, APP_STAGES);
+    app[WIFI].sleep_ms = 200;
+
+    TEST_ASSERT_TRUE(boot_run(app_graph, APP_STAGES, NULL));
+    TEST_ASSERT_TRUE(app[UART].finished < app[WIFI].finished);
+    TEST_ASSERT_TRUE(app[MQTT].started > app[WIFI].finished);
+}
+
+static void test_independent_stages_run_concurrently(void)
+{
+    enum { STAGES = 3 };
+    mock_t mocks[STAGES];
+    reset(mocks, STAGES);
+    for (int i = 0; i < STAGES; i++) {
+        mocks[i].rendezvous = STAGES;
+    }
+    const boot_stage_t graph[STAGES] = {
+        { "a", mock_start, &mocks[0], 0 },
+        { "b", mock_start, &mocks[1], 0 },
+        { "c", mock_start, &mocks[2], 0 },
+    };
+
+    TEST_ASSERT_TRUE(boot_run(graph, STAGES, NULL));
+}
+
+static void test_failure_skips_dependents_only(void)
+{
+    reset(app, APP_STAGES);
+    app[WIFI].ok = false;
+    boot_stage_result_t results[APP_STAGES];
+
+    TEST_ASSERT_FALSE(boot_run(app_graph, APP_STAGES, results));
+
+    TEST_ASSERT_TRUE(results[UART].ok);         // the UART link still comes up
+    TEST_ASSERT_TRUE(results[OUTBOX].ok);
+    TEST_ASSERT_FALSE(results[WIFI].ok);
+    TEST_ASSERT_FALSE(results[MQTT].ok);
+    TEST_ASSERT_EQUAL(0, app[MQTT].started);    // skipped, never called
+    TEST_ASSERT_EQUAL(0, results[MQTT].start_us);
+}
+
+static void test_failure_skips_transitively(void)
+{
+    reset(app, APP_STAGES);
+    app[NVS].ok = false;
+    boot_stage_result_t results[APP_STAGES];
+
+    TEST_ASSERT_FALSE(boot_run(app_graph, APP_STAGES, results));
+    TEST_ASSERT_EQUAL(2, atomic_load(&order));  // only nvs ran
+    for (int i = 0; i < APP_STAGES; i++) {
+        TEST_ASSERT_FALSE(results[i].ok);
+    }
+}
+
+static void test_unresolvable_graph_returns(void)
+{
+    enum { STAGES = 3 };
+    mock_t mocks[STAGES];
+    reset(mocks, STAGES);
+    const boot_stage_t graph[STAGES] = {
+        { "a", mock_start, &mocks[0], 0 },
+        { "b", mock_start, &mocks[1], BOOT_DEP(2) },
+        { "c", mock_start, &mocks[2], BOOT_DEP(1) },    // cycle with b
+    };
+    boot_stage_result_t results[STAGES];
+
+    TEST_ASSERT_FALSE(boot_run(graph, STAGES, results));
+    TEST_ASSERT_TRUE(results[0].ok);
+    TEST_ASSERT_EQUAL(0, mocks[1].started);
+    TEST_ASSERT_EQUAL(0, mocks[2].started);
+}
+
+static void test_stage_count_is_checked(void)
+{
+    TEST_ASSERT_FALSE(boot_run(app_graph, 0, NULL));
+    TEST_ASSERT_FALSE(boot_run(app_graph, BOOT_MAX_STAGES + 1, NULL));
+}
+
+int main(void)
+{
+    RUN_TEST(test_stages_start_after_their_dependencies);
+    RUN_TEST(test_uart_is_not_held_up_by_wifi);
+    RUN_TEST(test_independent_stages_run_concurrently);
+    RUN_TEST(test_failure_skips_dependents_only);
+    RUN_TEST(test_failure_skips_transitively);
+    RUN_TEST(test_unresolvable_graph_returns);
+    RUN_TEST(test_stage_count_is_checked);
+    return test_report();
+}
@@ -0,0 +1,136 @@
+// Event payload encoders: legacy text strings, JSON, CBOR, MessagePack and
+// fixed binary, plus the batch framing of each format
+
+#include "test_host.h"
+#include "app/event_codec.h"
+#include "protocol.h"
+#include <string.h>
+
+static app_event_t state_event(uint8_t type, uint8_t data, int64_t t)
+{
+    app_event_t evt = {
+        .kind = APP_EVT_STATE,
+        .code = type,
+        .value_count = 1,
+        .values = { data },
+        .timestamp_us = t,
+    };
+    return evt;
+}
+
+static const char *encode_str(event_format_t fmt, const app_event_t *evt)
+{
+    static char buf[EVENT_ITEM_MAX_LEN + 1];
+    size_t len = event_encode(fmt, evt, (uint8_t *)buf, EVENT_ITEM_MAX_LEN);
+    buf[len] = '\0';
+    return buf;
+}
+
+static void test_text_matches_legacy_strings(void)
+{
+    app_event_t evt = state_event(PROTO_EVT_STOPPED_AT_FLOOR, 2, 1000);
+    TEST_ASSERT_EQUAL_STRING("stopped_at_floor_2", encode_str(EVENT_FMT_TEXT, &evt));
+
+    evt = state_event(PROTO_EVT_ESTOP_ACTIVATED, 0, 1000);
+    TEST_ASSERT_EQUAL_STRING("estop_activated", encode_str(EVENT_FMT_TEXT, &evt));
+
+    evt = state_event(0x7F, 0, 1000);
+    evt.value_count = 0;
+    TEST_ASSERT_EQUAL_STRING("unknown_event_127", encode_str(EVENT_FMT_TEXT, &evt));
+
+    app_event_t status = {
+        .kind = APP_EVT_STATUS,
+        .value_count = 3,
+        .values = { 3, 1, 0x0A },
+    };
+    TEST_ASSERT_EQUAL_STRING("status:floor=3,dir=up,dest=0x0A", encode_str(EVENT_FMT_TEXT, &status));
+
+    app_event_t err = { .kind = APP_EVT_CMD_ERR, .value_count = 1, .values = { 4 } };
+    TEST_ASSERT_EQUAL_STRING("cmd_err_4", encode_str(EVENT_FMT_TEXT, &err));
+
+    app_event_t link = { .kind = APP_EVT_LINK_UP };
+    TEST_ASSERT_EQUAL_STRING("max32655_connected", encode_str(EVENT_FMT_TEXT, &link));
+}
+
+static void test_json_wraps_text_with_timestamp(void)
+{
+    app_event_t evt = state_event(PROTO_EVT_CABIN_BUTTON, 5, 1700000000123456LL);
+    TEST_ASSERT_EQUAL_STRING("{\"e\":\"cabin_button_5\",\"t\":1700000000123456}",
+                             encode_str(EVENT_FMT_JSON, &evt));
+}
+
+static void test_cbor(void)
+{
+    app_event_t evt = state_event(PROTO_EVT_STOPPED_AT_FLOOR, 2, 1000);
+    uint8_t buf[EVENT_ITEM_MAX_LEN];
+    static const uint8_t expected[] = {
+        0x83,                                   // array(3)
+        0x70, 's', 't', 'o', 'p', 'p', 'e', 'd', '_', 'a', 't', '_', 'f', 'l', 'o', 'o', 'r',
+        0x19, 0x03, 0xE8,                       // 1000
+        0x02,
+    };
+
+    TEST_ASSERT_EQUAL(sizeof(expected), event_encode(EVENT_FMT_CBOR, &evt, buf, sizeof(buf)));
+    TEST_ASSERT_EQUAL_MEMORY(expected, buf, sizeof(expected));
+}
+
+static void test_msgpack(void)
+{
+    app_event_t evt = state_event(PROTO_EVT_STOPPED_AT_FLOOR, 2, 1000);
+    uint8_t buf[EVENT_ITEM_MAX_LEN];
+    static const uint8_t expected[] = {
+        0x93,                                   // fixarray(3)
+        0xB0, 's', 't', 'o', 'p', 'p', 'e', 'd', '_', 'a', 't', '_', 'f', 'l', 'o', 'o', 'r',
+        0xCD, 0x03, 0xE8,                       // uint16 1000
+        0x02,
+    };
+
+    TEST_ASSERT_EQUAL(sizeof(expected), event_encode(EVENT_FMT_MSGPACK, &evt, buf, sizeof(buf)));
+    TEST_ASSERT_EQUAL_MEMORY(expected, buf, sizeof(expected));
+}
+
+static void test_binary_is_fixed_size(void)
+{
+    app_event_t evt = state_event(PROTO_EVT_STOPPED_AT_FLOOR, 2, 1000);
+    uint8_t buf[EVENT_ITEM_MAX_LEN];
+    static const uint8_t expected[EVENT_BINARY_LEN] = {
+        APP_EVT_STATE, PROTO_EVT_STOPPED_AT_FLOOR,
+        2, 0, 0, 0, 0,
+        0xE8, 0x03, 0, 0, 0, 0, 0, 0,
+    };
+
+    TEST_ASSERT_EQUAL(EVENT_BINARY_LEN, event_encode(EVENT_FMT_BINARY, &evt, buf, sizeof(buf)));
+    TEST_ASSERT_EQUAL_MEMORY(expected, buf, sizeof(expected));
+}
+
+static void test_too_small_buffer_encodes_nothing(void)
+{
+    app_event_t evt = state_event(PROTO_EVT_STOPPED_AT_FLOOR, 2, 1000);
+    uint8_t buf[8];
+
+    TEST_ASSERT_EQUAL(0, event_encode(EVENT_FMT_TEXT, &evt, buf, sizeof(buf)));
+    TEST_ASSERT_EQUAL(0, event_encode(EVENT_FMT_JSON, &evt, buf, sizeof(buf)));
+    TEST_ASSERT_EQUAL(0, event_encode(EVENT_FMT_CBOR, &evt, buf, sizeof(buf)));
+    TEST_ASSERT_EQUAL(0, event_encode(EVENT_FMT_BINARY, &evt, buf, sizeof(buf)));
+}
+
+static void test_text_has_no_batch_framing(void)
+{
+    TEST_ASSERT_TRUE(event_batch_framing(EVENT_FMT_TEXT) == NULL);
+    TEST_ASSERT_TRUE(event_batch_framing(EVENT_FMT_JSON) != NULL);
+    TEST_ASSERT_TRUE(event_batch_framing(EVENT_FMT_CBOR) != NULL);
+    TEST_ASSERT_TRUE(event_batch_framing(EVENT_FMT_MSGPACK) != NULL);
+    TEST_ASSERT_TRUE(event_batch_framing(EVENT_FMT_BINARY) != NULL);
+}
+
+int main(void)
+{
+    RUN_TEST(test_text_matches_legacy_strings);
+    RUN_TEST(test_json_wraps_text_with_timestamp);
+    RUN_TEST(test_cbor);
+    RUN_TEST(test_msgpack);
+    RUN_TEST(test_binary_is_fixed_size);
+    RUN_TEST(test_too_small_buffer_encodes_nothing);
+    RUN_TEST(test_text_has_no_batch_framing);
+    return test_report();
+}
@@ -0,0 +1,204 @@
+// Runner and host stand-ins for the unit tests (see test_host.h)
+
+#include "test_host.h"
+#include "esp_timer.h"
+#include "esp_log.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// === Runner ===
+
+jmp_buf test_abort;
+
+static int tests_run = 0;
+static int tests_failed = 0;
+
+void test_fail(const char *file, int line, const char *format, ...)
+{
+    va_list args;
+    fprintf(stderr, "%s:%d: ", file, line);
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+    fputc('\n', stderr);
+    longjmp(test_abort, 1);
+}
+
+void test_run(void (*fn)(void), const char *name)
+{
+    tests_run++;
+    if (setjmp(test_abort) == 0) {
+        fn();
+        printf("PASS %s\n", name);
+    } else {
+        tests_failed++;
+        printf("FAIL %s\n", name);
+    }
+}
+
+int test_report(void)
+{
+    printf("%d tests, %d failures\n", tests_run, tests_failed);
+    return tests_failed ? 1 : 0;
+}
+
+void test_assert_string(const char *file, int line, const char *what,
+                        const char *expected, const char *actual)
+{
+    if (actual == NULL || strcmp(expected, actual) != 0) {
+        test_fail(file, line, "%s: expected \"%s\", got \"%s\"", what, expected,
+                  actual ? actual : "(null)");
+    }
+}
+
+void test_assert_memory(const char *file, int line, const char *what,
+                        const void *expected, const void *actual, size_t len)
+{
+    const uint8_t *e = expected;
+    const uint8_t *a = actual;
+    for (size_t i = 0; i < len; i++) {
+        if (e[i] != a[i]) {
+            test_fail(file, line, "%s: byte %zu expected 0x%02x, got 0x%02x", what, i, e[i], a[i]);
+        }
+    }
+}
+
+// === Logging ===
+
+// Quiet unless TEST_VERBOSE is set in the environment
+void replay_log(char level, const char *tag, const char *format, ...)
+{
+    static int verbose = -1;
+    if (verbose < 0) {
+        verbose = getenv("TEST_VERBOSE") != NULL;
+    }
+    if (!verbose) {
+        return;
+    }
+
+    va_list args;
+    fprintf(stderr, "%c (%s) ", level, tag);
+    va_start(args, format);
+    vfprintf(stderr, format, args);
+    va_end(args);
+    fputc('\n', stderr);
+}
+
+// === Virtual clock and esp_timer ===
+
+#define MAX_TIMERS  16
+
+struct esp_timer {
+    esp_timer_cb_t callback;
+    void *arg;
+    int64_t due_us;
+    uint64_t period_us;             // 0 = one-shot
+    bool active;
+};
+
+static struct esp_timer timers[MAX_TIMERS];
+static int timer_count = 0;
+static int64_t now_us = 0;
+
+void host_set_time(int64_t t)
+{
+    now_us = t;
+}
+
+void host_reset_timers(void)
+{
+    memset(timers, 0, sizeof(timers));
+    timer_count = 0;
+}
+
+static struct esp_timer *next_timer(void)
+{
+    struct esp_timer *next = NULL;
+    for (int i = 0; i < timer_count; i++) {
+        if (timers[i].active && (next == NULL || timers[i].due_us < next->due_us)) {
+            next = &timers[i];
+        }
+    }
+    return next;
+}
+
+void host_advance_us(int64_t us)
+{
+    int64_t end_us = now_us + us;
+    struct esp_timer *timer;
+
+    while ((timer = next_timer()) != NULL && timer->due_us <= end_us) {
+        if (timer->due_us > now_us) {
+            now_us = timer->due_us;
+        }
+        if (timer->period_us) {
+            timer->due_us += (int64_t)timer->period_us;
+        } else {
+            timer->active = false;
+        }
+        timer->callback(timer->arg);
+    }
+    now_us = end_us;
+}
+
+int64_t esp_timer_get_time(void)
+{
+    return now_us;
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *args, esp_timer_handle_t *out)
+{
+    if (timer_count == MAX_TIMERS) {
+        return ESP_FAIL;
+    }
+    struct esp_timer *timer = &timers[timer_count++];
+    timer->callback = args->callback;
+    timer->arg = args->arg;
+    *out = timer;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us)
+{
+    if (timer->active) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    timer->due_us = now_us + (int64_t)timeout_us;
+    timer->period_us = 0;
+    timer->active = true;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period_us)
+{
+    if (timer->active) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    timer->due_us = now_us + (int64_t)period_us;
+    timer->period_us = period_us;
+    timer->active = true;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer)
+{
+    if (!timer->active) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    timer->active = false;
+    return ESP_OK;
+}
+
+bool esp_timer_is_active(esp_timer_handle_t timer)
+{
+    return timer->active;
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    return (TickType_t)(now_us / (1000000 / configTICK_RATE_HZ));
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+// Host unit tests (see Makefile): a small Unity-style runner plus the
+// stand-ins the modules under test need - esp_timer on a virtual clock that
+// only moves when a test advances it, FreeRTOS tasks as threads, logging.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <setjmp.h>
+
+// === Runner ===
+
+extern jmp_buf test_abort;
+
+void test_fail(const char *file, int line, const char *format, ...)
+    __attribute__((format(printf, 3, 4), noreturn));
+void test_run(void (*fn)(void), const char *name);
+// Summary line; returns the exit code for main
+int test_report(void);
+
+#define RUN_TEST(fn)    test_run(fn, #fn)
+
+#define TEST_ASSERT_TRUE(cond) do { \
+        if (!(cond)) { \
+            test_fail(__FILE__, __LINE__, "expected true: %s", #cond); \
+        } \
+    } while (0)
+
+#define TEST_ASSERT_FALSE(cond) do { \
+        if (cond) { \
+            test_fail(__FILE__, __LINE__, "expected false: %s", #cond); \
+        } \
+    } while (0)
+
+#define TEST_ASSERT_EQUAL(expected, actual) do { \
+        long long e_ = (long long)(expected); \
+        long long a_ = (long long)(actual); \
+        if (e_ != a_) { \
+            test_fail(__FILE__, __LINE__, "%s: expected %lld, got %lld", #actual, e_, a_); \
+        } \
+    } while (0)
+
+#define TEST_ASSERT_INT_WITHIN(delta, expected, actual) do { \
+        long long e_ = (long long)(expected); \
+        long long a_ = (long long)(actual); \
+        if (a_ < e_ - (long long)(delta) || a_ > e_ + (long long)(delta)) { \
+            test_fail(__FILE__, __LINE__, "%s: expected %lld +/- %lld, got %lld", \
+                      #actual, e_, (long long)(delta), a_); \
+        } \
+    } while (0)
+
+#define TEST_ASSERT_EQUAL_STRING(expected, actual) \
+    test_assert_string(__FILE__, __LINE__, #actual, (expected), (actual))
+
+#define TEST_ASSERT_EQUAL_MEMORY(expected, actual, len) \
+    test_assert_memory(__FILE__, __LINE__, #actual, (expected), (actual), (len))
+
+void test_assert_string(const char *file, int line, const char *what,
+                        const char *expected, const char *actual);
+void test_assert_memory(const char *file, int line, const char *what,
+                        const void *expected, const void *actual, size_t len);
+
+// === Virtual clock ===
+
+// esp_timer_get_time() / xTaskGetTickCount() time; timers only fire from
+// host_advance_us, in due order, on the calling thread
+void host_set_time(int64_t now_us);
+void host_advance_us(int64_t us);
+
+#define host_advance_ms(ms)     host_advance_us((int64_t)(ms) * 1000)
+
+// Forget every esp_timer (between tests of modules that create them in init)
+void host_reset_timers(void);
@@ -0,0 +1,265 @@
+// Time-window batching: flush on window expiry, max_events, buffer space and
+// urgent events; unbatched pass-through; and a batching on/off comparison of
+// broker messages and added latency for a steady event stream
+
+#include "test_host.h"
+#include "comm/mqtt_batch.h"
+#include "comm/mqtt_util.h"
+#include "app/event_codec.h"
+#include <stdio.h>
+#include <string.h>
+
+#define MAX_PUBLISHED   64
+
+typedef struct {
+    char topic[64];
+    uint8_t data[MQTT_BATCH_BUF_SIZE + 1];
+    int len;
+    int qos;
+    int64_t t_us;
+} published_t;
+
+static published_t published[MAX_PUBLISHED];
+static int published_count;
+static int publish_total;
+static bool publish_ok = true;
+
+// Latency accounting for the benchmark: each item is the 8-byte time it
+// was queued, so the publish can see how long every event waited
+static bool bench_mode;
+static int64_t bench_wait_sum_us;
+static int64_t bench_wait_max_us;
+static int bench_events;
+
+bool mqtt_publish(const char *topic, const uint8_t *data, int len, int qos, bool retain)
+{
+    publish_total++;
+    if (bench_mode) {
+        const mqtt_batch_framing_t *framing = event_batch_framing(EVENT_FMT_BINARY);
+        int off = len > (int)sizeof(int64_t) ? framing->header_len : 0;
+        for (; off + (int)sizeof(int64_t) <= len; off += sizeof(int64_t)) {
+            int64_t queued_us;
+            memcpy(&queued_us, &data[off], sizeof(queued_us));
+            int64_t wait_us = esp_timer_get_time() - queued_us;
+            bench_wait_sum_us += wait_us;
+            if (wait_us > bench_wait_max_us) {
+                bench_wait_max_us = wait_us;
+            }
+            bench_events++;
+        }
+        return true;
+    }
+
+    if (published_count < MAX_PUBLISHED) {
+        published_t *p = &published[published_count++];
+        snprintf(p->topic, sizeof(p->topic), "%s", topic);
+        memcpy(p->data, data, len);
+        p->data[len] = '\0';
+        p->len = len;
+        p->qos = qos;
+        p->t_us = esp_timer_get_time();
+    }
+    return publish_ok;
+}
+
+static mqtt_batch_t batch;
+
+static void setup(event_format_t fmt, uint32_t window_ms, uint8_t max_events)
+{
+    host_reset_timers();
+    host_set_time(0);
+    published_count = 0;
+    publish_total = 0;
+    publish_ok = true;
+
+    mqtt_batch_config_t cfg = {
+        .topic = "events",
+        .framing = event_batch_framing(fmt),
+        .qos = 1,
+        .window_ms = window_ms,
+        .max_events = max_events,
+    };
+    mqtt_batch_init(&batch, &cfg);
+}
+
+static void add_str(const char *item, bool urgent)
+{
+    TEST_ASSERT_TRUE(mqtt_batch_add(&batch, (const uint8_t *)item, strlen(item), urgent));
+}
+
+static void test_window_expiry_flushes_in_order(void)
+{
+    setup(EVENT_FMT_JSON, 50, 8);
+
+    add_str("{\"e\":\"a\"}", false);
+    host_advance_ms(20);
+    add_str("{\"e\":\"b\"}", false);
+    host_advance_ms(29);
+    TEST_ASSERT_EQUAL(0, published_count);
+
+    host_advance_ms(1);
+    TEST_ASSERT_EQUAL(1, published_count);
+    TEST_ASSERT_EQUAL_STRING("[{\"e\":\"a\"},{\"e\":\"b\"}]", (const char *)published[0].data);
+    TEST_ASSERT_EQUAL(50000, published[0].t_us);    // window starts at the first event
+    TEST_ASSERT_EQUAL(1, published[0].qos);
+
+    mqtt_batch_stats_t stats;
+    mqtt_batch_get_stats(&batch, &stats);
+    TEST_ASSERT_EQUAL(2, stats.events);
+    TEST_ASSERT_EQUAL(1, stats.messages);
+    TEST_ASSERT_EQUAL(1, stats.flush_window);
+}
+
+static void test_max_events_flushes_at_once(void)
+{
+    setup(EVENT_FMT_JSON, 50, 3);
+
+    add_str("1", false);
+    add_str("2", false);
+    TEST_ASSERT_EQUAL(0, published_count);
+    add_str("3", false);
+    TEST_ASSERT_EQUAL(1, published_count);
+    TEST_ASSERT_EQUAL_STRING("[1,2,3]", (const char *)published[0].data);
+
+    // The window timer of the flushed batch must not flush an empty one
+    host_advance_ms(100);
+    TEST_ASSERT_EQUAL(1, published_count);
+
+    mqtt_batch_stats_t stats;
+    mqtt_batch_get_stats(&batch, &stats);
+    TEST_ASSERT_EQUAL(1, stats.flush_full);
+    TEST_ASSERT_EQUAL(0, stats.flush_window);
+}
+
+static void test_urgent_event_flushes_queued_ones(void)
+{
+    setup(EVENT_FMT_JSON, 50, 8);
+
+    add_str("\"stopped\"", false);
+    add_str("\"estop_activated\"", true);
+    TEST_ASSERT_EQUAL(1, published_count);
+    TEST_ASSERT_EQUAL_STRING("[\"stopped\",\"estop_activated\"]", (const char *)published[0].data);
+    TEST_ASSERT_EQUAL(0, published[0].t_us);
+}
+
+static void test_full_buffer_flushes_before_adding(void)
+{
+    setup(EVENT_FMT_JSON, 50, 100);
+
+    char item[200];
+    memset(item, 'x', sizeof(item) - 1);
+    item[sizeof(item) - 1] = '\0';
+
+    add_str(item, false);
+    add_str(item, false);
+    TEST_ASSERT_EQUAL(0, published_count);
+    add_str(item, false);   // 3 * 200 > MQTT_BATCH_BUF_SIZE
+    TEST_ASSERT_EQUAL(1, published_count);
+    TEST_ASSERT_EQUAL(1 + 2 * 199 + 1 + 1, published[0].len);
+
+    host_advance_ms(50);
+    TEST_ASSERT_EQUAL(2, published_count);
+    TEST_ASSERT_EQUAL(1 + 199 + 1, published[1].len);
+}
+
+static void test_window_zero_publishes_each_event_unframed(void)
+{
+    setup(EVENT_FMT_TEXT, 0, 8);
+
+    add_str("stopped_at_floor_1", false);
+    add_str("stopped_at_floor_2", false);
+    TEST_ASSERT_EQUAL(2, published_count);
+    TEST_ASSERT_EQUAL_STRING("stopped_at_floor_1", (const char *)published[0].data);
+    TEST_ASSERT_EQUAL_STRING("stopped_at_floor_2", (const char *)published[1].data);
+}
+
+static void test_cbor_and_msgpack_framing(void)
+{
+    static const uint8_t item[] = { 0x01 };
+
+    setup(EVENT_FMT_CBOR, 50, 2);
+    mqtt_batch_add(&batch, item, sizeof(item), false);
+    mqtt_batch_add(&batch, item, sizeof(item), false);
+    static const uint8_t cbor[] = { 0x9F, 0x01, 0x01, 0xFF };
+    TEST_ASSERT_EQUAL(sizeof(cbor), published[0].len);
+    TEST_ASSERT_EQUAL_MEMORY(cbor, published[0].data, sizeof(cbor));
+
+    setup(EVENT_FMT_MSGPACK, 50, 2);
+    mqtt_batch_add(&batch, item, sizeof(item), false);
+    mqtt_batch_add(&batch, item, sizeof(item), false);
+    static const uint8_t msgpack[] = { 0xDC, 0x00, 0x02, 0x01, 0x01 };
+    TEST_ASSERT_EQUAL(sizeof(msgpack), published[0].len);
+    TEST_ASSERT_EQUAL_MEMORY(msgpack, published[0].data, sizeof(msgpack));
+}
+
+static void test_failed_publish_is_counted(void)
+{
+    setup(EVENT_FMT_JSON, 50, 8);
+    publish_ok = false;
+
+    add_str("1", false);
+    host_advance_ms(50);
+
+    mqtt_batch_stats_t stats;
+    mqtt_batch_get_stats(&batch, &stats);
+    TEST_ASSERT_EQUAL(0, stats.messages);
+    TEST_ASSERT_EQUAL(1, stats.publish_failed);
+}
+
+// Steady stream of events every interval_ms for 10 s: broker messages and
+// the time events wait in the batch
+static void run_stream(uint32_t window_ms, uint32_t interval_ms, int *messages,
+                       int64_t *wait_avg_us, int64_t *wait_max_us)
+{
+    setup(EVENT_FMT_BINARY, window_ms, 8);
+    bench_mode = true;
+    bench_wait_sum_us = 0;
+    bench_wait_max_us = 0;
+    bench_events = 0;
+
+    for (int64_t t = 0; t < 10000; t += interval_ms) {
+        int64_t now_us = esp_timer_get_time();
+        mqtt_batch_add(&batch, (const uint8_t *)&now_us, sizeof(now_us), false);
+        host_advance_ms(interval_ms);
+    }
+    host_advance_ms(window_ms);
+    bench_mode = false;
+
+    *messages = publish_total;
+    *wait_avg_us = bench_events ? bench_wait_sum_us / bench_events : 0;
+    *wait_max_us = bench_wait_max_us;
+    TEST_ASSERT_EQUAL(10000 / interval_ms, bench_events);
+}
+
+static void test_batching_cuts_broker_messages(void)
+{
+    int off_messages, on_messages;
+    int64_t off_avg, off_max, on_avg, on_max;
+
+    run_stream(0, 5, &off_messages, &off_avg, &off_max);
+    run_stream(50, 5, &on_messages, &on_avg, &on_max);
+
+    printf("  200 events/s for 10 s: batching off %d msgs (%d/s, wait avg %lld max %lld us), "
+           "on %d msgs (%d/s, wait avg %lld max %lld us)\n",
+           off_messages, off_messages / 10, (long long)off_avg, (long long)off_max,
+           on_messages, on_messages / 10, (long long)on_avg, (long long)on_max);
+
+    TEST_ASSERT_EQUAL(2000, off_messages);
+    TEST_ASSERT_EQUAL(0, off_max);
+    // 8 events per 40 ms: max_events is reached before the 50 ms window
+    TEST_ASSERT_EQUAL(250, on_messages);
+    TEST_ASSERT_EQUAL(35000, on_max);
+}
+
+int main(void)
+{
+    RUN_TEST(test_window_expiry_flushes_in_order);
+    RUN_TEST(test_max_events_flushes_at_once);
+    RUN_TEST(test_urgent_event_flushes_queued_ones);
+    RUN_TEST(test_full_buffer_flushes_before_adding);
+    RUN_TEST(test_window_zero_publishes_each_event_unframed);
+    RUN_TEST(test_cbor_and_msgpack_framing);
+    RUN_TEST(test_failed_publish_is_counted);
+    RUN_TEST(test_batching_cuts_broker_messages);
+    return test_report();
+}
@@ -0,0 +1,391 @@
+// Store-and-forward outbox: the three overflow policies, spill to the file
+// and NVS backends (and finding the backlog again after a reboot), in-order
+// rate-limited replay, memory accounting, and file-backed replay throughput
+
+#include "test_host.h"
+#include "comm/mqtt_outbox.h"
+#include "nvs.h"
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_PUBLISHED   256
+
+typedef struct {
+    char topic[MQTT_OUTBOX_TOPIC_MAX];
+    char data[64];
+    int qos;
+    bool retain;
+} published_t;
+
+static published_t published[MAX_PUBLISHED];
+static int published_count;
+static bool broker_up;
+static bool client_busy;            // connected, but the client refuses publishes
+static bool count_only;
+
+static bool publish(const char *topic, const uint8_t *data, int len, int qos, bool retain)
+{
+    if (!broker_up || client_busy) {
+        return false;
+    }
+    if (!count_only && published_count < MAX_PUBLISHED) {
+        published_t *p = &published[published_count];
+        snprintf(p->topic, sizeof(p->topic), "%s", topic);
+        snprintf(p->data, sizeof(p->data), "%.*s", len, (const char *)data);
+        p->qos = qos;
+        p->retain = retain;
+    }
+    published_count++;
+    return true;
+}
+
+static char spill_path[64];
+
+static bool connected(void)
+{
+    return broker_up;
+}
+
+static void setup(mqtt_outbox_policy_t policy, const mqtt_outbox_spill_t *spill, uint8_t burst)
+{
+    host_reset_timers();
+    host_set_time(0);
+    published_count = 0;
+    broker_up = false;
+    client_busy = false;
+    count_only = false;
+
+    mqtt_outbox_config_t cfg = {
+        .policy = policy,
+        .spill = spill,
+        .publish = publish,
+        .connected = connected,
+        .replay_interval_ms = 100,
+        .replay_burst = burst,
+    };
+    mqtt_outbox_init(&cfg);
+}
+
+static const mqtt_outbox_spill_t *new_file_spill(size_t max_bytes)
+{
+    snprintf(spill_path, sizeof(spill_path), "/tmp/outbox_test_%d.bin", (int)getpid());
+    remove(spill_path);
+    return mqtt_outbox_spill_file_init(spill_path, max_bytes);
+}
+
+static void put(const char *topic, int n, int qos, bool retain)
+{
+    char data[16];
+    int len = snprintf(data, sizeof(data), "m%d", n);
+    mqtt_outbox_put(topic, (const uint8_t *)data, len, qos, retain);
+}
+
+// Connect and replay until the outbox is empty (bounded)
+static void replay_all(void)
+{
+    broker_up = true;
+    mqtt_outbox_start_replay();
+    for (int i = 0; i < 1000 && !mqtt_outbox_is_empty(); i++) {
+        host_advance_ms(100);
+    }
+    TEST_ASSERT_TRUE(mqtt_outbox_is_empty());
+}
+
+static void assert_published(int index, const char *topic, const char *data)
+{
+    TEST_ASSERT_TRUE(index < published_count);
+    TEST_ASSERT_EQUAL_STRING(topic, published[index].topic);
+    TEST_ASSERT_EQUAL_STRING(data, published[index].data);
+}
+
+static void test_drop_oldest_keeps_newest_in_order(void)
+{
+    setup(OUTBOX_DROP_OLDEST, NULL, 4);
+
+    for (int i = 0; i < MQTT_OUTBOX_SLOTS + 2; i++) {
+        put("ev", i, 1, false);
+    }
+    mqtt_outbox_stats_t stats;
+    mqtt_outbox_get_stats(&stats);
+    TEST_ASSERT_EQUAL(2, stats.dropped_oldest);
+    TEST_ASSERT_EQUAL(MQTT_OUTBOX_SLOTS, stats.ram_entries);
+
+    replay_all();
+    TEST_ASSERT_EQUAL(MQTT_OUTBOX_SLOTS, published_count);
+    assert_published(0, "ev", "m2");
+    assert_published(MQTT_OUTBOX_SLOTS - 1, "ev", "m13");
+}
+
+static void test_drop_by_class_sheds_lowest_qos_first(void)
+{
+    setup(OUTBOX_DROP_BY_CLASS, NULL, 4);
+
+    put("buttons", 0, 0, false);
+    put("buttons", 1, 0, false);
+    for (int i = 2; i < MQTT_OUTBOX_SLOTS; i++) {
+        put("ev", i, 1, false);
+    }
+
+    // Full: QoS 1 pushes out the oldest QoS 0 message
+    TEST_ASSERT_TRUE(mqtt_outbox_put("estop", (const uint8_t *)"e", 1, 2, false));
+    mqtt_outbox_stats_t stats;
+    mqtt_outbox_get_stats(&stats);
+    TEST_ASSERT_EQUAL(1, stats.dropped_class);
+
+    // Once no QoS 0 is left, a QoS 0 newcomer is the one dropped
+    TEST_ASSERT_TRUE(mqtt_outbox_put("ev", (const uint8_t *)"x", 1, 1, false));
+    TEST_ASSERT_FALSE(mqtt_outbox_put("buttons", (const uint8_t *)"y", 1, 0, false));
+
+    replay_all();
+    TEST_ASSERT_EQUAL(MQTT_OUTBOX_SLOTS, published_count);
+    assert_published(0, "ev", "m2");
+    for (int i = 0; i < published_count; i++) {
+        TEST_ASSERT_TRUE(published[i].qos > 0);
+    }
+    assert_published(published_count - 2, "estop", "e");
+}
+
+static void test_compact_state_keeps_latest_retained_value(void)
+{
+    setup(OUTBOX_COMPACT_STATE, NULL, 4);
+
+    put("state", 1, 1, true);
+    put("ev", 2, 1, false);
+    put("state", 3, 1, true);
+    put("link", 4, 1, true);
+    put("state", 5, 1, true);
+
+    mqtt_outbox_stats_t stats;
+    mqtt_outbox_get_stats(&stats);
+    TEST_ASSERT_EQUAL(2, stats.compacted);
+    TEST_ASSERT_EQUAL(3, stats.ram_entries);
+
+    replay_all();
+    TEST_ASSERT_EQUAL(3, published_count);
+    assert_published(0, "ev", "m2");
+    assert_published(1, "link", "m4");
+    assert_published(2, "state", "m5");
+    TEST_ASSERT_TRUE(published[2].retain);
+}
+
+static void test_replay_is_rate_limited(void)
+{
+    setup(OUTBOX_DROP_OLDEST, NULL, 2);
+    for (int i = 0; i < 6; i++) {
+        put("ev", i, 1, false);
+    }
+
+    broker_up = true;
+    mqtt_outbox_start_replay();
+    TEST_ASSERT_EQUAL(0, published_count);
+    host_advance_ms(100);
+    TEST_ASSERT_EQUAL(2, published_count);
+    host_advance_ms(99);
+    TEST_ASSERT_EQUAL(2, published_count);
+    host_advance_ms(1);
+    TEST_ASSERT_EQUAL(4, published_count);
+    host_advance_ms(100);
+    TEST_ASSERT_EQUAL(6, published_count);
+    TEST_ASSERT_TRUE(mqtt_outbox_is_empty());
+}
+
+static void test_replay_stops_on_failure_without_loss(void)
+{
+    setup(OUTBOX_DROP_OLDEST, NULL, 2);
+    for (int i = 0; i < 4; i++) {
+        put("ev", i, 1, false);
+    }
+
+    broker_up = true;
+    mqtt_outbox_start_replay();
+    host_advance_ms(100);
+    broker_up = false;              // dropped again mid-replay
+    host_advance_ms(500);
+    TEST_ASSERT_EQUAL(2, published_count);
+
+    replay_all();
+    TEST_ASSERT_EQUAL(4, published_count);
+    assert_published(2, "ev", "m2");
+    assert_published(3, "ev", "m3");
+}
+
+static void test_replay_retries_while_connected(void)
+{
+    setup(OUTBOX_DROP_OLDEST, NULL, 2);
+    for (int i = 0; i < 6; i++) {
+        put("ev", i, 1, false);
+    }
+
+    broker_up = true;
+    mqtt_outbox_start_replay();
+    host_advance_ms(100);
+    client_busy = true;             // e.g. esp-mqtt's own outbox is full
+    host_advance_ms(300);
+    TEST_ASSERT_EQUAL(2, published_count);
+    TEST_ASSERT_FALSE(mqtt_outbox_is_empty());
+
+    // Recovers on its own, without another connect
+    client_busy = false;
+    host_advance_ms(200);
+    TEST_ASSERT_TRUE(mqtt_outbox_is_empty());
+    TEST_ASSERT_EQUAL(6, published_count);
+    for (int i = 0; i < 6; i++) {
+        char data[16];
+        snprintf(data, sizeof(data), "m%d", i);
+        assert_published(i, "ev", data);
+    }
+
+    mqtt_outbox_stats_t stats;
+    mqtt_outbox_get_stats(&stats);
+    TEST_ASSERT_EQUAL(3, stats.replay_retries);
+    TEST_ASSERT_EQUAL(6, stats.replayed);
+}
+
+static void test_overflow_spills_to_file_in_order(void)
+{
+    setup(OUTBOX_DROP_OLDEST, new_file_spill(8192), 5);
+
+    for (int i = 0; i < 30; i++) {
+        put("ev", i, 1, false);
+    }
+    mqtt_outbox_stats_t stats;
+    mqtt_outbox_get_stats(&stats);
+    TEST_ASSERT_EQUAL(30 - MQTT_OUTBOX_SLOTS, stats.spilled);
+    TEST_ASSERT_EQUAL(0, stats.dropped_oldest);
+    TEST_ASSERT_TRUE(stats.spill_bytes_used > 0);
+
+    replay_all();
+    TEST_ASSERT_EQUAL(30, published_count);
+    for (int i = 0; i < 30; i++) {
+        char data[16];
+        snprintf(data, sizeof(data), "m%d", i);
+        assert_published(i, "ev", data);
+    }
+    mqtt_outbox_get_stats(&stats);
+    TEST_ASSERT_EQUAL(0, stats.spill_bytes_used);
+    remove(spill_path);
+}
+
+static void test_full_spill_falls_back_to_policy(void)
+{
+    // Room for about two records
+    setup(OUTBOX_DROP_OLDEST, new_file_spill(20), 5);
+
+    for (int i = 0; i < MQTT_OUTBOX_SLOTS + 4; i++) {
+        put("ev", i, 1, false);
+    }
+    mqtt_outbox_stats_t stats;
+    mqtt_outbox_get_stats(&stats);
+    TEST_ASSERT_EQUAL(2, stats.spilled);
+    TEST_ASSERT_EQUAL(2, stats.dropped_oldest);
+
+    replay_all();
+    TEST_ASSERT_EQUAL(MQTT_OUTBOX_SLOTS + 2, published_count);
+    assert_published(0, "ev", "m0");
+    assert_published(1, "ev", "m1");
+    assert_published(2, "ev", "m4");
+    remove(spill_path);
+}
+
+static void test_file_spill_survives_reboot(void)
+{
+    setup(OUTBOX_DROP_OLDEST, new_file_spill(8192), 5);
+    for (int i = 0; i < MQTT_OUTBOX_SLOTS + 3; i++) {
+        put("ev", i, 1, false);
+    }
+
+    // Reboot: the RAM entries are gone, the spilled ones come back
+    setup(OUTBOX_DROP_OLDEST, mqtt_outbox_spill_file_init(spill_path, 8192), 5);
+    TEST_ASSERT_FALSE(mqtt_outbox_is_empty());
+    replay_all();
+    TEST_ASSERT_EQUAL(3, published_count);
+    assert_published(0, "ev", "m0");
+    assert_published(2, "ev", "m2");
+    remove(spill_path);
+}
+
+static void test_nvs_spill_and_reboot(void)
+{
+    host_nvs_erase_all();
+    setup(OUTBOX_DROP_OLDEST, mqtt_outbox_spill_nvs_init("outbox", 8), 5);
+
+    for (int i = 0; i < MQTT_OUTBOX_SLOTS + 10; i++) {
+        put("ev", i, 1, false);
+    }
+    mqtt_outbox_stats_t stats;
+    mqtt_outbox_get_stats(&stats);
+    TEST_ASSERT_EQUAL(8, stats.spilled);            // max_records
+    TEST_ASSERT_EQUAL(2, stats.dropped_oldest);
+
+    setup(OUTBOX_DROP_OLDEST, mqtt_outbox_spill_nvs_init("outbox", 8), 5);
+    replay_all();
+    TEST_ASSERT_EQUAL(8, published_count);
+    assert_published(0, "ev", "m0");
+    assert_published(7, "ev", "m7");
+    TEST_ASSERT_EQUAL(2, host_nvs_key_count());     // only head and tail left
+}
+
+static void test_memory_is_capped_and_measured(void)
+{
+    setup(OUTBOX_DROP_OLDEST, NULL, 4);
+
+    mqtt_outbox_stats_t stats;
+    mqtt_outbox_get_stats(&stats);
+    TEST_ASSERT_TRUE(stats.ram_bytes_capacity >= MQTT_OUTBOX_SLOTS * (MQTT_OUTBOX_SLOT_DATA + MQTT_OUTBOX_TOPIC_MAX));
+
+    uint8_t big[MQTT_OUTBOX_SLOT_DATA + 1] = { 0 };
+    TEST_ASSERT_FALSE(mqtt_outbox_put("ev", big, sizeof(big), 1, false));
+    TEST_ASSERT_TRUE(mqtt_outbox_put("ev", big, MQTT_OUTBOX_SLOT_DATA, 1, false));
+    put("ev", 1, 1, false);
+
+    mqtt_outbox_get_stats(&stats);
+    TEST_ASSERT_EQUAL(1, stats.rejected);
+    TEST_ASSERT_EQUAL((MQTT_OUTBOX_SLOT_DATA + 2) + (2 + 2), stats.ram_bytes_used);
+
+    replay_all();
+    mqtt_outbox_get_stats(&stats);
+    TEST_ASSERT_EQUAL(0, stats.ram_bytes_used);
+    TEST_ASSERT_EQUAL((MQTT_OUTBOX_SLOT_DATA + 2) + (2 + 2), stats.ram_bytes_high_water);
+}
+
+static void test_file_replay_throughput(void)
+{
+    const int messages = 2000;
+    setup(OUTBOX_DROP_OLDEST, new_file_spill(1 << 20), 50);
+    count_only = true;
+
+    uint8_t payload[100] = { 0 };
+    for (int i = 0; i < messages; i++) {
+        mqtt_outbox_put("computor/esp32/events", payload, sizeof(payload), 1, false);
+    }
+
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    replay_all();
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+
+    double s = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+    printf("  file spill replay: %d x %zu byte messages in %.1f ms (%.0f msgs/s)\n",
+           messages, sizeof(payload), s * 1000, messages / s);
+    TEST_ASSERT_EQUAL(messages, published_count);
+    remove(spill_path);
+}
+
+int main(void)
+{
+    RUN_TEST(test_drop_oldest_keeps_newest_in_order);
+    RUN_TEST(test_drop_by_class_sheds_lowest_qos_first);
+    RUN_TEST(test_compact_state_keeps_latest_retained_value);
+    RUN_TEST(test_replay_is_rate_limited);
+    RUN_TEST(test_replay_stops_on_failure_without_loss);
+    RUN_TEST(test_replay_retries_while_connected);
+    RUN_TEST(test_overflow_spills_to_file_in_order);
+    RUN_TEST(test_full_spill_falls_back_to_policy);
+    RUN_TEST(test_file_spill_survives_reboot);
+    RUN_TEST(test_nvs_spill_and_reboot);
+    RUN_TEST(test_memory_is_capped_and_measured);
+    RUN_TEST(test_file_replay_throughput);
+    return test_report();
+}
@@ -0,0 +1,159 @@
+// Fixed-pool outbox behind esp-mqtt's outbox interface: copies, oldest-first
+// dequeue by state, size and capacity limits, expiry, deletion and stats
+
+#include "test_host.h"
+#include "mqtt_outbox.h"
+#include "comm/mqtt_pool/mqtt_pool.h"
+#include "config.h"
+#include <string.h>
+
+#define MSG_PUBLISH 3
+
+static outbox_handle_t outbox;
+static uint8_t header[4] = { 0x32, 0x10, 0x00, 0x05 };
+static uint8_t payload[MQTT_POOL_SLOT_SIZE];
+
+static outbox_item_handle_t enqueue(int msg_id, int payload_len, outbox_tick_t tick)
+{
+    outbox_message_t msg = {
+        .data = header,
+        .len = sizeof(header),
+        .msg_id = msg_id,
+        .msg_qos = 1,
+        .msg_type = MSG_PUBLISH,
+        .remaining_data = payload,
+        .remaining_len = payload_len,
+    };
+    return outbox_enqueue(outbox, &msg, tick);
+}
+
+static void setup(void)
+{
+    outbox = outbox_init();
+    for (size_t i = 0; i < sizeof(payload); i++) {
+        payload[i] = (uint8_t)i;
+    }
+}
+
+static void test_enqueue_copies_header_and_payload(void)
+{
+    setup();
+    outbox_item_handle_t item = enqueue(7, 100, 1000);
+    TEST_ASSERT_TRUE(item != NULL);
+
+    memset(payload, 0xee, sizeof(payload));             // caller's buffers are reused
+    size_t len;
+    uint16_t msg_id;
+    int type, qos;
+    uint8_t *data = outbox_item_get_data(item, &len, &msg_id, &type, &qos);
+    TEST_ASSERT_EQUAL(sizeof(header) + 100, len);
+    TEST_ASSERT_EQUAL(7, msg_id);
+    TEST_ASSERT_EQUAL(MSG_PUBLISH, type);
+    TEST_ASSERT_EQUAL(1, qos);
+    TEST_ASSERT_EQUAL_MEMORY(header, data, sizeof(header));
+    TEST_ASSERT_EQUAL(99, data[sizeof(header) + 99]);
+    TEST_ASSERT_EQUAL(QUEUED, outbox_item_get_pending(item));
+    TEST_ASSERT_TRUE(outbox_get(outbox, 7) == item);
+    TEST_ASSERT_TRUE(outbox_get(outbox, 8) == NULL);
+}
+
+static void test_dequeue_oldest_by_state(void)
+{
+    setup();
+    enqueue(1, 10, 100);
+    enqueue(2, 10, 200);
+    enqueue(3, 10, 300);
+    outbox_delete(outbox, 1, MSG_PUBLISH);
+    enqueue(4, 10, 400);                                // reuses slot 0, still newest
+
+    outbox_tick_t tick;
+    size_t len;
+    uint16_t msg_id;
+    int type, qos;
+    outbox_item_get_data(outbox_dequeue(outbox, QUEUED, &tick), &len, &msg_id, &type, &qos);
+    TEST_ASSERT_EQUAL(2, msg_id);
+    TEST_ASSERT_EQUAL(200, tick);
+
+    TEST_ASSERT_EQUAL(ESP_OK, outbox_set_pending(outbox, 2, TRANSMITTED));
+    TEST_ASSERT_EQUAL(ESP_OK, outbox_set_tick(outbox, 2, 250));
+    outbox_item_get_data(outbox_dequeue(outbox, QUEUED, &tick), &len, &msg_id, &type, &qos);
+    TEST_ASSERT_EQUAL(3, msg_id);
+    outbox_item_get_data(outbox_dequeue(outbox, TRANSMITTED, &tick), &len, &msg_id, &type, &qos);
+    TEST_ASSERT_EQUAL(2, msg_id);
+    TEST_ASSERT_EQUAL(250, tick);
+    TEST_ASSERT_TRUE(outbox_dequeue(outbox, ACKNOWLEDGED, NULL) == NULL);
+    TEST_ASSERT_EQUAL(ESP_FAIL, outbox_set_pending(outbox, 99, TRANSMITTED));
+}
+
+static void test_refuses_oversize_and_full(void)
+{
+    setup();
+    mqtt_pool_stats_t before, after;
+    mqtt_pool_get_stats(&before);
+
+    TEST_ASSERT_TRUE(enqueue(1, MQTT_POOL_SLOT_SIZE - sizeof(header), 0) != NULL);
+    TEST_ASSERT_TRUE(enqueue(2, MQTT_POOL_SLOT_SIZE - sizeof(header) + 1, 0) == NULL);
+    for (int i = 1; i < MQTT_POOL_SLOTS; i++) {
+        TEST_ASSERT_TRUE(enqueue(10 + i, 10, 0) != NULL);
+    }
+    TEST_ASSERT_TRUE(enqueue(100, 10, 0) == NULL);
+
+    mqtt_pool_get_stats(&after);
+    TEST_ASSERT_EQUAL(MQTT_POOL_SLOTS, after.used);
+    TEST_ASSERT_EQUAL(MQTT_POOL_SLOTS, after.max_used);
+    TEST_ASSERT_EQUAL(2, after.rejected - before.rejected);
+
+    // A freed slot is taken again
+    TEST_ASSERT_EQUAL(ESP_OK, outbox_delete_item(outbox, outbox_get(outbox, 11)));
+    TEST_ASSERT_TRUE(enqueue(100, 10, 0) != NULL);
+}
+
+static void test_delete_matches_id_and_type(void)
+{
+    setup();
+    enqueue(5, 10, 0);
+    TEST_ASSERT_EQUAL(ESP_FAIL, outbox_delete(outbox, 5, MSG_PUBLISH + 1));
+    TEST_ASSERT_EQUAL(ESP_OK, outbox_delete(outbox, 5, MSG_PUBLISH));
+    TEST_ASSERT_EQUAL(ESP_FAIL, outbox_delete(outbox, 5, MSG_PUBLISH));
+    TEST_ASSERT_EQUAL(ESP_FAIL, outbox_delete_item(outbox, NULL));
+}
+
+static void test_expiry(void)
+{
+    setup();
+    enqueue(1, 10, 100);
+    enqueue(2, 10, 200);
+    enqueue(3, 10, 300);
+
+    TEST_ASSERT_EQUAL(-1, outbox_delete_single_expired(outbox, 200, 100));
+    TEST_ASSERT_EQUAL(1, outbox_delete_single_expired(outbox, 250, 120));
+    TEST_ASSERT_EQUAL(1, outbox_delete_expired(outbox, 350, 120));
+    TEST_ASSERT_TRUE(outbox_get(outbox, 3) != NULL);
+    TEST_ASSERT_EQUAL(1, outbox_delete_expired(outbox, 1000, 0));
+}
+
+static void test_size_and_delete_all(void)
+{
+    setup();
+    enqueue(1, 10, 0);
+    enqueue(2, 100, 0);
+    TEST_ASSERT_EQUAL(2 * sizeof(header) + 110, outbox_get_size(outbox));
+
+    outbox_delete_all_items(outbox);
+    mqtt_pool_stats_t stats;
+    mqtt_pool_get_stats(&stats);
+    TEST_ASSERT_EQUAL(0, stats.used);
+    TEST_ASSERT_EQUAL(0, outbox_get_size(outbox));
+    TEST_ASSERT_TRUE(outbox_dequeue(outbox, QUEUED, NULL) == NULL);
+}
+
+int main(void)
+{
+    RUN_TEST(test_enqueue_copies_header_and_payload);
+    RUN_TEST(test_dequeue_oldest_by_state);
+    RUN_TEST(test_refuses_oversize_and_full);
+    RUN_TEST(test_delete_matches_id_and_type);
+    RUN_TEST(test_expiry);
+    RUN_TEST(test_size_and_delete_all);
+    return test_report();
+}
@@ -0,0 +1,229 @@
+// Lock-free publish queue with real threads: message fields and
+// correlation data, size drops, full-queue drops while the publisher is
+// stalled, and several producers racing the publisher task without loss
+// or reordering
+
+#include "test_host.h"
+#include "comm/mqtt_pubq.h"
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <unistd.h>
+
+#define PRODUCERS           4
+#define PER_PRODUCER        20000
+
+// What the publisher task handed to the client (written on its thread)
+static char last_topic[MQTT_PUBQ_TOPIC_MAX];
+static uint8_t last_data[MQTT_PUBQ_SLOT_DATA];
+static int last_len;
+static int last_qos;
+static bool last_retain;
+static bool last_reply;
+static uint8_t last_corr[MQTT_PUBQ_CORR_MAX];
+static int last_corr_len;
+
+static atomic_int publish_calls;
+
+// Stall: the publisher blocks inside publish until released
+static pthread_mutex_t gate_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t gate_cond = PTHREAD_COND_INITIALIZER;
+static bool gate_closed;
+static atomic_bool publisher_waiting;
+
+// Concurrent run: next sequence number expected from each producer
+static bool checking_order;
+static uint32_t next_seq[PRODUCERS];
+static atomic_int order_errors;
+
+static bool publish(const char *topic, const uint8_t *data, int len, int qos, bool retain,
+                    const uint8_t *correlation, int correlation_len)
+{
+    if (checking_order) {
+        uint32_t seq;
+        memcpy(&seq, &data[1], sizeof(seq));
+        if (data[0] >= PRODUCERS || seq != next_seq[data[0]]) {
+            atomic_fetch_add(&order_errors, 1);
+        } else {
+            next_seq[data[0]]++;
+        }
+    } else {
+        snprintf(last_topic, sizeof(last_topic), "%s", topic);
+        memcpy(last_data, data, (size_t)len);
+        last_len = len;
+        last_qos = qos;
+        last_retain = retain;
+        last_reply = correlation != NULL;
+        last_corr_len = correlation_len;
+        if (correlation_len > 0) {
+            memcpy(last_corr, correlation, (size_t)correlation_len);
+        }
+    }
+
+    pthread_mutex_lock(&gate_lock);
+    while (gate_closed) {
+        atomic_store(&publisher_waiting, true);
+        pthread_cond_wait(&gate_cond, &gate_lock);
+    }
+    pthread_mutex_unlock(&gate_lock);
+
+    atomic_fetch_add(&publish_calls, 1);
+    return true;
+}
+
+static void open_gate(void)
+{
+    pthread_mutex_lock(&gate_lock);
+    gate_closed = false;
+    pthread_cond_broadcast(&gate_cond);
+    pthread_mutex_unlock(&gate_lock);
+}
+
+// Wait (in real time) for the publisher task to catch up
+static void drain(int calls)
+{
+    for (int i = 0; i < 5000 && atomic_load(&publish_calls) < calls; i++) {
+        usleep(1000);
+    }
+    TEST_ASSERT_EQUAL(calls, atomic_load(&publish_calls));
+}
+
+static void test_fields_and_correlation(void)
+{
+    int calls = atomic_load(&publish_calls);
+    static const uint8_t corr[] = { 0xde, 0xad, 0xbe, 0xef };
+
+    TEST_ASSERT_TRUE(mqtt_pubq_push("computor/reply", (const uint8_t *)"ok", 2, 1, true, corr, sizeof(corr)));
+    drain(calls + 1);
+    TEST_ASSERT_EQUAL_STRING("computor/reply", last_topic);
+    TEST_ASSERT_EQUAL(2, last_len);
+    TEST_ASSERT_EQUAL_MEMORY("ok", last_data, 2);
+    TEST_ASSERT_EQUAL(1, last_qos);
+    TEST_ASSERT_TRUE(last_retain);
+    TEST_ASSERT_TRUE(last_reply);
+    TEST_ASSERT_EQUAL(sizeof(corr), last_corr_len);
+    TEST_ASSERT_EQUAL_MEMORY(corr, last_corr, sizeof(corr));
+
+    // A reply without correlation data stays a reply; a plain publish doesn't
+    TEST_ASSERT_TRUE(mqtt_pubq_push("t", (const uint8_t *)"x", 1, 0, false, (const uint8_t *)"", 0));
+    drain(calls + 2);
+    TEST_ASSERT_TRUE(last_reply);
+    TEST_ASSERT_EQUAL(0, last_corr_len);
+    TEST_ASSERT_TRUE(mqtt_pubq_push("t", (const uint8_t *)"y", 1, 0, false, NULL, 0));
+    drain(calls + 3);
+    TEST_ASSERT_FALSE(last_reply);
+}
+
+static void test_oversize_dropped(void)
+{
+    static uint8_t big[MQTT_PUBQ_SLOT_DATA + 1];
+    char long_topic[MQTT_PUBQ_TOPIC_MAX + 1];
+    memset(long_topic, 'a', MQTT_PUBQ_TOPIC_MAX);
+    long_topic[MQTT_PUBQ_TOPIC_MAX] = '\0';
+
+    int calls = atomic_load(&publish_calls);
+    mqtt_pubq_stats_t before, after;
+    mqtt_pubq_get_stats(&before);
+    TEST_ASSERT_FALSE(mqtt_pubq_push("t", big, sizeof(big), 0, false, NULL, 0));
+    TEST_ASSERT_FALSE(mqtt_pubq_push(long_topic, big, 1, 0, false, NULL, 0));
+    TEST_ASSERT_FALSE(mqtt_pubq_push("t", big, 1, 0, false, big, MQTT_PUBQ_CORR_MAX + 1));
+    TEST_ASSERT_TRUE(mqtt_pubq_push("t", big, MQTT_PUBQ_SLOT_DATA, 0, false, big, MQTT_PUBQ_CORR_MAX));
+    drain(calls + 1);
+    mqtt_pubq_get_stats(&after);
+    TEST_ASSERT_EQUAL(3, after.dropped_size - before.dropped_size);
+    TEST_ASSERT_EQUAL(1, after.pushed - before.pushed);
+}
+
+static void test_full_queue_drops_without_blocking(void)
+{
+    int calls = atomic_load(&publish_calls);
+    mqtt_pubq_stats_t before, stats;
+    mqtt_pubq_get_stats(&before);
+
+    gate_closed = true;
+    atomic_store(&publisher_waiting, false);
+    TEST_ASSERT_TRUE(mqtt_pubq_push("t", (const uint8_t *)"0", 1, 0, false, NULL, 0));
+    for (int i = 0; i < 5000 && !atomic_load(&publisher_waiting); i++) {
+        usleep(1000);
+    }
+    TEST_ASSERT_TRUE(atomic_load(&publisher_waiting));
+
+    // The slot being published stays taken until the publish returns
+    for (int i = 1; i < MQTT_PUBQ_DEPTH; i++) {
+        TEST_ASSERT_TRUE(mqtt_pubq_push("t", (const uint8_t *)"n", 1, 0, false, NULL, 0));
+    }
+    TEST_ASSERT_FALSE(mqtt_pubq_push("t", (const uint8_t *)"x", 1, 0, false, NULL, 0));
+    mqtt_pubq_get_stats(&stats);
+    TEST_ASSERT_EQUAL(1, stats.dropped_full - before.dropped_full);
+    TEST_ASSERT_EQUAL(MQTT_PUBQ_DEPTH, stats.depth);
+    TEST_ASSERT_EQUAL(MQTT_PUBQ_DEPTH, stats.depth_high_water);
+
+    open_gate();
+    drain(calls + MQTT_PUBQ_DEPTH);
+    mqtt_pubq_get_stats(&stats);
+    TEST_ASSERT_EQUAL(0, stats.depth);
+    TEST_ASSERT_EQUAL(MQTT_PUBQ_DEPTH, stats.published - before.published);
+}
+
+static atomic_int full_retries;
+
+// Payload: producer index, then a little-endian sequence number
+static void *producer(void *arg)
+{
+    uint8_t msg[1 + sizeof(uint32_t)];
+    msg[0] = (uint8_t)(intptr_t)arg;
+    for (uint32_t seq = 0; seq < PER_PRODUCER;) {
+        memcpy(&msg[1], &seq, sizeof(seq));
+        if (mqtt_pubq_push("computor/esp32/events", msg, sizeof(msg), 0, false, NULL, 0)) {
+            seq++;
+        } else {
+            atomic_fetch_add(&full_retries, 1);
+            sched_yield();
+        }
+    }
+    return NULL;
+}
+
+static void test_concurrent_producers(void)
+{
+    int calls = atomic_load(&publish_calls);
+    mqtt_pubq_stats_t before, after;
+    mqtt_pubq_get_stats(&before);
+    memset(next_seq, 0, sizeof(next_seq));
+    checking_order = true;
+
+    pthread_t threads[PRODUCERS];
+    for (intptr_t i = 0; i < PRODUCERS; i++) {
+        pthread_create(&threads[i], NULL, producer, (void *)i);
+    }
+    for (int i = 0; i < PRODUCERS; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    drain(calls + PRODUCERS * PER_PRODUCER);
+    checking_order = false;
+
+    mqtt_pubq_get_stats(&after);
+    TEST_ASSERT_EQUAL(0, atomic_load(&order_errors));
+    for (int i = 0; i < PRODUCERS; i++) {
+        TEST_ASSERT_EQUAL(PER_PRODUCER, next_seq[i]);
+    }
+    TEST_ASSERT_EQUAL(PRODUCERS * PER_PRODUCER, after.pushed - before.pushed);
+    TEST_ASSERT_EQUAL(PRODUCERS * PER_PRODUCER, after.published - before.published);
+    TEST_ASSERT_EQUAL(atomic_load(&full_retries), after.dropped_full - before.dropped_full);
+    TEST_ASSERT_EQUAL(0, after.publish_failed);
+    TEST_ASSERT_EQUAL(0, after.depth);
+    TEST_ASSERT_TRUE(after.depth_high_water <= MQTT_PUBQ_DEPTH);
+}
+
+int main(void)
+{
+    mqtt_pubq_init(publish);
+
+    RUN_TEST(test_fields_and_correlation);
+    RUN_TEST(test_oversize_dropped);
+    RUN_TEST(test_full_queue_drops_without_blocking);
+    RUN_TEST(test_concurrent_producers);
+    return test_report();
+}
@@ -0,0 +1,205 @@
+// Steady-state heap use of the event path with the static memory mode
+// modules: every malloc/calloc/realloc made by the code under test is
+// counted (the binary is linked with --wrap, see the Makefile), and
+// encoding, batching, the publish queue and the pool outbox must make
+// none once initialised
+
+#include "test_host.h"
+#include "app/event_codec.h"
+#include "comm/mqtt_batch.h"
+#include "comm/mqtt_pubq.h"
+#include "comm/mqtt_util.h"
+#include "comm/mqtt_pool/mqtt_pool.h"
+#include "mqtt_outbox.h"
+#include <stdatomic.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define MSG_PUBLISH     3
+#define IN_FLIGHT       4       // publishes awaiting PUBACK at any time
+
+// === Allocation counter ===
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t count, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+static atomic_bool counting;
+static atomic_int allocations;
+
+static void count_allocation(void)
+{
+    if (atomic_load(&counting)) {
+        atomic_fetch_add(&allocations, 1);
+    }
+}
+
+void *__wrap_malloc(size_t size)
+{
+    count_allocation();
+    return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t count, size_t size)
+{
+    count_allocation();
+    return __real_calloc(count, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+    count_allocation();
+    return __real_realloc(ptr, size);
+}
+
+// === MQTT client stand-in ===
+
+// The batch publishes through mqtt_util, which queues on the publish queue
+bool mqtt_publish(const char *topic, const uint8_t *data, int len, int qos, bool retain)
+{
+    return mqtt_pubq_push(topic, data, len, qos, retain, NULL, 0);
+}
+
+static outbox_handle_t outbox;
+static atomic_int client_publishes;
+static int next_msg_id = 1;
+
+// Publisher task: store the QoS 1 message in the outbox like esp-mqtt does,
+// and acknowledge the one sent IN_FLIGHT publishes ago
+static bool client_publish(const char *topic, const uint8_t *data, int len, int qos, bool retain,
+                           const uint8_t *correlation, int correlation_len)
+{
+    uint8_t header[2 + 2 + MQTT_PUBQ_TOPIC_MAX];
+    size_t topic_len = strlen(topic);
+    header[0] = 0x32;
+    header[1] = 0;
+    header[2] = (uint8_t)(topic_len >> 8);
+    header[3] = (uint8_t)topic_len;
+    memcpy(&header[4], topic, topic_len);
+
+    int msg_id = next_msg_id++;
+    outbox_message_t msg = {
+        .data = header,
+        .len = (int)(4 + topic_len),
+        .msg_id = msg_id,
+        .msg_qos = qos,
+        .msg_type = MSG_PUBLISH,
+        .remaining_data = (uint8_t *)data,
+        .remaining_len = len,
+    };
+    bool ok = outbox_enqueue(outbox, &msg, esp_timer_get_time() / 1000) != NULL;
+    if (msg_id > IN_FLIGHT) {
+        outbox_delete(outbox, msg_id - IN_FLIGHT, MSG_PUBLISH);
+    }
+    atomic_fetch_add(&client_publishes, 1);
+    return ok;
+}
+
+static void wait_published(int count)
+{
+    for (int i = 0; i < 5000 && atomic_load(&client_publishes) < count; i++) {
+        usleep(1000);
+    }
+    TEST_ASSERT_EQUAL(count, atomic_load(&client_publishes));
+}
+
+// === Tests ===
+
+static void test_counter_sees_allocations(void)
+{
+    atomic_store(&allocations, 0);
+    atomic_store(&counting, true);
+    void *volatile p = malloc(16);
+    p = realloc(p, 32);
+    free(p);
+    p = calloc(4, 4);
+    free(p);
+    atomic_store(&counting, false);
+    TEST_ASSERT_EQUAL(3, atomic_load(&allocations));
+}
+
+static mqtt_batch_t batch;
+
+// Trips of status updates and state changes ending in an urgent snapshot.
+// The virtual clock outruns the publisher thread, so each trip waits for
+// the queue to drain as the real publisher would keep up.
+static void run_events(int trips)
+{
+    uint8_t item[EVENT_ITEM_MAX_LEN];
+    mqtt_batch_stats_t stats;
+    for (int trip = 0; trip < trips; trip++) {
+        for (int i = 0; i < 10; i++) {
+            app_event_t evt = {
+                .kind = i % 3 ? APP_EVT_STATUS : APP_EVT_STATE,
+                .code = (uint8_t)i,
+                .value_count = 3,
+                .values = { (uint8_t)(i % 8), 1, 0x0f },
+                .timestamp_us = esp_timer_get_time(),
+            };
+            size_t len = event_encode(EVENT_FMT_JSON, &evt, item, sizeof(item));
+            TEST_ASSERT_TRUE(len > 0);
+            TEST_ASSERT_TRUE(mqtt_batch_add(&batch, item, len, false));
+            host_advance_ms(15);
+        }
+        app_event_t estop = { .kind = APP_EVT_SNAPSHOT, .value_count = 5, .values = { 2, 0, 0, 0, 1 } };
+        size_t len = event_encode(EVENT_FMT_JSON, &estop, item, sizeof(item));
+        TEST_ASSERT_TRUE(mqtt_batch_add(&batch, item, len, true));
+        host_advance_ms(200);
+
+        mqtt_batch_get_stats(&batch, &stats);
+        wait_published((int)stats.messages);
+    }
+    mqtt_batch_flush(&batch);
+    mqtt_batch_get_stats(&batch, &stats);
+    wait_published((int)stats.messages);
+    TEST_ASSERT_EQUAL(0, stats.publish_failed);
+}
+
+static void test_event_path_does_not_allocate(void)
+{
+    mqtt_batch_stats_t batch_stats;
+    mqtt_pool_stats_t pool_before, pool_after;
+
+    // Warm-up: lets the host libc set up whatever it allocates lazily
+    run_events(1);
+    mqtt_pool_get_stats(&pool_before);
+
+    atomic_store(&allocations, 0);
+    atomic_store(&counting, true);
+    run_events(200);
+    atomic_store(&counting, false);
+
+    TEST_ASSERT_EQUAL(0, atomic_load(&allocations));
+
+    mqtt_pool_get_stats(&pool_after);
+    mqtt_pubq_stats_t pubq_stats;
+    mqtt_pubq_get_stats(&pubq_stats);
+    mqtt_batch_get_stats(&batch, &batch_stats);
+    TEST_ASSERT_TRUE(batch_stats.messages >= 200 * 2);
+    TEST_ASSERT_EQUAL(batch_stats.messages, pubq_stats.published);
+    TEST_ASSERT_EQUAL(0, pubq_stats.dropped_full + pubq_stats.dropped_size);
+    TEST_ASSERT_EQUAL(pool_before.rejected, pool_after.rejected);
+    TEST_ASSERT_EQUAL(IN_FLIGHT, pool_after.used);
+}
+
+int main(void)
+{
+    host_reset_timers();
+    host_set_time(0);
+    outbox = outbox_init();
+    mqtt_pubq_init(client_publish);
+
+    mqtt_batch_config_t cfg = {
+        .topic = "computor/esp32/v2/events",
+        .framing = event_batch_framing(EVENT_FMT_JSON),
+        .qos = 1,
+        .window_ms = 50,
+        .max_events = 8,
+    };
+    mqtt_batch_init(&batch, &cfg);
+
+    RUN_TEST(test_counter_sees_allocations);
+    RUN_TEST(test_event_path_does_not_allocate);
+    return test_report();
+}
@@ -0,0 +1,279 @@
+// WiFi power-save policy driven by a simulated elevator activity trace:
+// mode transitions and holds, the e-stop override, timer arming, latency
+// attribution per mode and residency accounting
+
+#include "test_host.h"
+#include "comm/wifi_power.h"
+#include <string.h>
+
+#define COMMAND_HOLD_MS  2000
+#define ACTIVITY_HOLD_MS 10000
+
+// Mock driver: records applied modes and the armed timer
+typedef struct {
+    wifi_power_mode_t applied;
+    int applies;
+    uint32_t armed_ms;
+    int64_t timer_due_us;           // INT64_MAX = not armed
+} mock_power_t;
+
+static mock_power_t radio;
+static wifi_power_policy_t policy;
+static int64_t now_us;
+
+static void mock_apply(void *ctx, wifi_power_mode_t mode)
+{
+    radio.applied = mode;
+    radio.applies++;
+}
+
+static void mock_arm_timer(void *ctx, uint32_t ms)
+{
+    radio.armed_ms = ms;
+    radio.timer_due_us = ms ? now_us + (int64_t)ms * 1000 : INT64_MAX;
+}
+
+static void setup(wifi_power_mode_t idle_mode)
+{
+    memset(&radio, 0, sizeof(radio));
+    radio.timer_due_us = INT64_MAX;
+    now_us = 5000000;
+
+    static const wifi_power_ops_t ops = {
+        .apply = mock_apply,
+        .arm_timer = mock_arm_timer,
+    };
+    wifi_power_config_t cfg = {
+        .command_hold_ms = COMMAND_HOLD_MS,
+        .activity_hold_ms = ACTIVITY_HOLD_MS,
+        .idle_mode = idle_mode,
+    };
+    wifi_power_init(&policy, &cfg, &ops, now_us);
+}
+
+static void event(wifi_power_event_t evt)
+{
+    wifi_power_handle(&policy, evt, now_us);
+}
+
+// Advance the clock, delivering timer expiries on the way
+static void advance_ms(int64_t ms)
+{
+    int64_t end_us = now_us + ms * 1000;
+    while (radio.timer_due_us <= end_us) {
+        now_us = radio.timer_due_us;
+        radio.timer_due_us = INT64_MAX;
+        event(WIFI_POWER_EVT_TIMER);
+    }
+    now_us = end_us;
+}
+
+static void test_init_applies_idle_mode(void)
+{
+    setup(WIFI_POWER_MAX_MODEM);
+    TEST_ASSERT_EQUAL(1, radio.applies);
+    TEST_ASSERT_EQUAL(WIFI_POWER_MAX_MODEM, radio.applied);
+    TEST_ASSERT_EQUAL(1, policy.stats.modes[WIFI_POWER_MAX_MODEM].entered);
+    TEST_ASSERT_EQUAL(INT64_MAX, radio.timer_due_us);
+}
+
+static void test_command_holds_awake_then_steps_down(void)
+{
+    setup(WIFI_POWER_MAX_MODEM);
+
+    event(WIFI_POWER_EVT_ACTIVITY);
+    TEST_ASSERT_EQUAL(WIFI_POWER_MIN_MODEM, radio.applied);
+    event(WIFI_POWER_EVT_COMMAND);
+    TEST_ASSERT_EQUAL(WIFI_POWER_NONE, radio.applied);
+    TEST_ASSERT_EQUAL(COMMAND_HOLD_MS, radio.armed_ms);
+
+    advance_ms(COMMAND_HOLD_MS - 1);
+    TEST_ASSERT_EQUAL(WIFI_POWER_NONE, radio.applied);
+    advance_ms(1);
+    TEST_ASSERT_EQUAL(WIFI_POWER_MIN_MODEM, radio.applied);        // activity hold still running
+    TEST_ASSERT_EQUAL(ACTIVITY_HOLD_MS - COMMAND_HOLD_MS, radio.armed_ms);
+
+    advance_ms(ACTIVITY_HOLD_MS - COMMAND_HOLD_MS);
+    TEST_ASSERT_EQUAL(WIFI_POWER_MAX_MODEM, radio.applied);
+    TEST_ASSERT_EQUAL(INT64_MAX, radio.timer_due_us);
+    TEST_ASSERT_EQUAL(5, radio.applies);
+}
+
+static void test_new_command_extends_hold(void)
+{
+    setup(WIFI_POWER_MAX_MODEM);
+    event(WIFI_POWER_EVT_COMMAND);
+    advance_ms(1500);
+    event(WIFI_POWER_EVT_COMMAND);
+    advance_ms(1500);
+    TEST_ASSERT_EQUAL(WIFI_POWER_NONE, radio.applied);
+    TEST_ASSERT_EQUAL(2, radio.applies);                            // no flapping
+    advance_ms(500);
+    TEST_ASSERT_EQUAL(WIFI_POWER_MAX_MODEM, radio.applied);
+}
+
+static void test_min_modem_idle_skips_activity_step(void)
+{
+    setup(WIFI_POWER_MIN_MODEM);
+    event(WIFI_POWER_EVT_ACTIVITY);
+    TEST_ASSERT_EQUAL(1, radio.applies);
+    TEST_ASSERT_EQUAL(INT64_MAX, radio.timer_due_us);
+
+    setup(WIFI_POWER_NONE);
+    event(WIFI_POWER_EVT_COMMAND);
+    advance_ms(COMMAND_HOLD_MS);
+    TEST_ASSERT_EQUAL(1, radio.applies);
+    TEST_ASSERT_EQUAL(WIFI_POWER_NONE, radio.applied);
+}
+
+static void test_estop_forces_awake_until_release_hold(void)
+{
+    setup(WIFI_POWER_MAX_MODEM);
+    event(WIFI_POWER_EVT_ESTOP_ON);
+    TEST_ASSERT_EQUAL(WIFI_POWER_NONE, radio.applied);
+    TEST_ASSERT_EQUAL(INT64_MAX, radio.timer_due_us);              // no hold while active
+
+    advance_ms(60000);
+    TEST_ASSERT_EQUAL(WIFI_POWER_NONE, radio.applied);
+
+    event(WIFI_POWER_EVT_ESTOP_OFF);
+    TEST_ASSERT_EQUAL(WIFI_POWER_NONE, radio.applied);
+    TEST_ASSERT_EQUAL(COMMAND_HOLD_MS, radio.armed_ms);
+    advance_ms(COMMAND_HOLD_MS);
+    TEST_ASSERT_EQUAL(WIFI_POWER_MAX_MODEM, radio.applied);
+}
+
+static void test_estop_cancels_pending_timer(void)
+{
+    setup(WIFI_POWER_MAX_MODEM);
+    event(WIFI_POWER_EVT_COMMAND);
+    TEST_ASSERT_TRUE(radio.timer_due_us != INT64_MAX);
+    event(WIFI_POWER_EVT_ESTOP_ON);
+    TEST_ASSERT_EQUAL(0, radio.armed_ms);
+    TEST_ASSERT_EQUAL(INT64_MAX, radio.timer_due_us);
+}
+
+static void test_timer_rounds_up(void)
+{
+    setup(WIFI_POWER_MAX_MODEM);
+    event(WIFI_POWER_EVT_COMMAND);
+
+    // An early timer re-arms for the sub-millisecond remainder
+    now_us += (COMMAND_HOLD_MS - 1) * 1000 + 1;
+    event(WIFI_POWER_EVT_TIMER);
+    TEST_ASSERT_EQUAL(WIFI_POWER_NONE, radio.applied);
+    TEST_ASSERT_EQUAL(1, radio.armed_ms);
+}
+
+static void test_latency_attributed_per_mode(void)
+{
+    setup(WIFI_POWER_MAX_MODEM);
+
+    // Idle: command sent, buffered until the listen interval wake-up
+    int64_t sent_us = now_us;
+    advance_ms(280);
+    wifi_power_record_latency(&policy, sent_us, now_us);
+    event(WIFI_POWER_EVT_COMMAND);
+
+    // Awake: follow-ups arrive quickly
+    for (int i = 0; i < 3; i++) {
+        advance_ms(100);
+        sent_us = now_us;
+        advance_ms(8);
+        wifi_power_record_latency(&policy, sent_us, now_us);
+        event(WIFI_POWER_EVT_COMMAND);
+    }
+
+    // Sent while awake, delivered after the drop to idle
+    advance_ms(COMMAND_HOLD_MS - 5);
+    sent_us = now_us;
+    advance_ms(50);
+    TEST_ASSERT_EQUAL(WIFI_POWER_MAX_MODEM, radio.applied);
+    wifi_power_record_latency(&policy, sent_us, now_us);
+
+    const wifi_power_mode_stats_t *none = &policy.stats.modes[WIFI_POWER_NONE];
+    const wifi_power_mode_stats_t *max = &policy.stats.modes[WIFI_POWER_MAX_MODEM];
+    TEST_ASSERT_EQUAL(1, max->samples);
+    TEST_ASSERT_EQUAL(280, max->latency_max_ms);
+    TEST_ASSERT_EQUAL(1, max->latency_hist[5]);                     // (200, 500]
+    TEST_ASSERT_EQUAL(3, none->samples);
+    TEST_ASSERT_EQUAL(24, none->latency_sum_ms);
+    TEST_ASSERT_EQUAL(3, none->latency_hist[0]);                    // <= 10
+    TEST_ASSERT_EQUAL(1, policy.stats.mixed_samples);
+}
+
+static void test_latency_bucket_bounds(void)
+{
+    setup(WIFI_POWER_NONE);
+    static const int latencies_ms[] = { 10, 11, 1000, 1001, 5000 };
+    for (size_t i = 0; i < sizeof(latencies_ms) / sizeof(latencies_ms[0]); i++) {
+        advance_ms(latencies_ms[i]);
+        wifi_power_record_latency(&policy, now_us - latencies_ms[i] * 1000, now_us);
+    }
+    const wifi_power_mode_stats_t *none = &policy.stats.modes[WIFI_POWER_NONE];
+    TEST_ASSERT_EQUAL(1, none->latency_hist[0]);
+    TEST_ASSERT_EQUAL(1, none->latency_hist[1]);
+    TEST_ASSERT_EQUAL(1, none->latency_hist[6]);
+    TEST_ASSERT_EQUAL(2, none->latency_hist[7]);
+    TEST_ASSERT_EQUAL(5000, none->latency_max_ms);
+}
+
+// An hour of simulated use: a trip every few minutes with a burst of
+// commands, otherwise idle. Residency must add up and mostly be idle.
+static void test_activity_trace_residency(void)
+{
+    setup(WIFI_POWER_MAX_MODEM);
+    int64_t start_us = now_us;
+
+    for (int trip = 0; trip < 12; trip++) {
+        event(WIFI_POWER_EVT_ACTIVITY);                             // call button
+        advance_ms(1500);
+        for (int i = 0; i < 4; i++) {
+            event(WIFI_POWER_EVT_COMMAND);
+            advance_ms(300);
+        }
+        event(WIFI_POWER_EVT_ACTIVITY);                             // arrival
+        advance_ms(300000 - 1500 - 4 * 300);
+    }
+
+    wifi_power_stats_t stats;
+    wifi_power_get_stats(&policy, &stats, now_us);
+    uint64_t total_ms = 0;
+    for (int mode = 0; mode < WIFI_POWER_MODE_COUNT; mode++) {
+        total_ms += stats.modes[mode].residency_ms;
+    }
+    TEST_ASSERT_INT_WITHIN(WIFI_POWER_MODE_COUNT, (now_us - start_us) / 1000, total_ms);
+
+    // Each trip: awake through the burst plus the command hold
+    TEST_ASSERT_EQUAL(12, stats.modes[WIFI_POWER_NONE].entered);
+    TEST_ASSERT_INT_WITHIN(12, 12 * (3 * 300 + COMMAND_HOLD_MS), stats.modes[WIFI_POWER_NONE].residency_ms);
+    TEST_ASSERT_EQUAL(24, stats.modes[WIFI_POWER_MIN_MODEM].entered);
+    TEST_ASSERT_TRUE(stats.modes[WIFI_POWER_MAX_MODEM].residency_ms > total_ms * 9 / 10);
+
+    // The live stats only change when a mode is left
+    TEST_ASSERT_TRUE(policy.stats.modes[WIFI_POWER_MAX_MODEM].residency_ms <
+                     stats.modes[WIFI_POWER_MAX_MODEM].residency_ms);
+}
+
+static void test_mode_names(void)
+{
+    TEST_ASSERT_EQUAL_STRING("none", wifi_power_mode_name(WIFI_POWER_NONE));
+    TEST_ASSERT_EQUAL_STRING("max_modem", wifi_power_mode_name(WIFI_POWER_MAX_MODEM));
+    TEST_ASSERT_EQUAL_STRING("unknown", wifi_power_mode_name(WIFI_POWER_MODE_COUNT));
+}
+
+int main(void)
+{
+    RUN_TEST(test_init_applies_idle_mode);
+    RUN_TEST(test_command_holds_awake_then_steps_down);
+    RUN_TEST(test_new_command_extends_hold);
+    RUN_TEST(test_min_modem_idle_skips_activity_step);
+    RUN_TEST(test_estop_forces_awake_until_release_hold);
+    RUN_TEST(test_estop_cancels_pending_timer);
+    RUN_TEST(test_timer_rounds_up);
+    RUN_TEST(test_latency_attributed_per_mode);
+    RUN_TEST(test_latency_bucket_bounds);
+    RUN_TEST(test_activity_trace_residency);
+    RUN_TEST(test_mode_names);
+    return test_report();
+}
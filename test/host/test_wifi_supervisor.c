@@ -0,0 +1,321 @@
+// WiFi reconnect supervisor driven by mocked WiFi events: fast first retry
+// on the cached AP, jittered exponential backoff, attempt timeouts, the
+// watchdog restart, link notifications and the offline histogram
+
+#include "test_host.h"
+#include "comm/wifi_supervisor.h"
+#include <string.h>
+
+#define MIN_MS      500
+#define MAX_MS      8000
+#define ATTEMPT_MS  3000
+#define WATCHDOG_MS 20000
+
+// Mock driver: counts calls, keeps the last arguments and the armed timer
+typedef struct {
+    int connects;
+    bool last_cached;
+    int disconnects;
+    int restarts;
+    int link_ups;
+    int link_downs;
+    uint32_t armed_ms;              // last arm_timer argument
+    int64_t timer_due_us;           // INT64_MAX = not armed
+    uint32_t random;
+} mock_wifi_t;
+
+static mock_wifi_t wifi;
+static wifi_supervisor_t sup;
+static int64_t now_us;
+
+static void mock_connect(void *ctx, bool use_cached_ap)
+{
+    wifi.connects++;
+    wifi.last_cached = use_cached_ap;
+}
+
+static void mock_disconnect(void *ctx)
+{
+    wifi.disconnects++;
+}
+
+static void mock_restart(void *ctx)
+{
+    wifi.restarts++;
+}
+
+static void mock_arm_timer(void *ctx, uint32_t ms)
+{
+    wifi.armed_ms = ms;
+    wifi.timer_due_us = ms ? now_us + (int64_t)ms * 1000 : INT64_MAX;
+}
+
+static void mock_link_changed(void *ctx, bool up)
+{
+    if (up) {
+        wifi.link_ups++;
+    } else {
+        wifi.link_downs++;
+    }
+}
+
+static uint32_t mock_random(void *ctx)
+{
+    return wifi.random;
+}
+
+static void setup(uint32_t watchdog_ms)
+{
+    memset(&wifi, 0, sizeof(wifi));
+    wifi.timer_due_us = INT64_MAX;
+    now_us = 1000000;
+
+    static const wifi_supervisor_ops_t ops = {
+        .connect = mock_connect,
+        .disconnect = mock_disconnect,
+        .restart = mock_restart,
+        .arm_timer = mock_arm_timer,
+        .link_changed = mock_link_changed,
+        .random = mock_random,
+    };
+    wifi_supervisor_config_t cfg = {
+        .backoff_min_ms = MIN_MS,
+        .backoff_max_ms = MAX_MS,
+        .attempt_timeout_ms = ATTEMPT_MS,
+        .watchdog_ms = watchdog_ms,
+    };
+    wifi_supervisor_init(&sup, &cfg, &ops);
+}
+
+static void event(wifi_sup_event_t evt)
+{
+    wifi_supervisor_handle(&sup, evt, now_us);
+}
+
+static void advance_ms(int64_t ms)
+{
+    now_us += ms * 1000;
+}
+
+// Let the armed timer expire
+static void fire_timer(void)
+{
+    TEST_ASSERT_TRUE(wifi.timer_due_us != INT64_MAX);
+    now_us = wifi.timer_due_us;
+    wifi.timer_due_us = INT64_MAX;
+    event(WIFI_SUP_EVT_TIMER);
+}
+
+static void go_online(void)
+{
+    event(WIFI_SUP_EVT_STARTED);
+    advance_ms(800);
+    event(WIFI_SUP_EVT_GOT_IP);
+    TEST_ASSERT_EQUAL(WIFI_SUP_ONLINE, sup.state);
+}
+
+static void test_boot_connects_on_cached_ap(void)
+{
+    setup(WATCHDOG_MS);
+
+    event(WIFI_SUP_EVT_STARTED);
+    TEST_ASSERT_EQUAL(WIFI_SUP_CONNECTING, sup.state);
+    TEST_ASSERT_EQUAL(1, wifi.connects);
+    TEST_ASSERT_TRUE(wifi.last_cached);
+    TEST_ASSERT_EQUAL(ATTEMPT_MS, wifi.armed_ms);
+
+    advance_ms(800);
+    event(WIFI_SUP_EVT_GOT_IP);
+    TEST_ASSERT_EQUAL(WIFI_SUP_ONLINE, sup.state);
+    TEST_ASSERT_EQUAL(1, wifi.link_ups);
+    TEST_ASSERT_EQUAL(INT64_MAX, wifi.timer_due_us);    // attempt timer cancelled
+    TEST_ASSERT_EQUAL(0, sup.stats.reconnects);         // first connect isn't a reconnect
+}
+
+static void test_drop_retries_at_once_and_reports_link(void)
+{
+    setup(WATCHDOG_MS);
+    go_online();
+
+    event(WIFI_SUP_EVT_DISCONNECTED);
+    TEST_ASSERT_EQUAL(1, wifi.link_downs);
+    TEST_ASSERT_EQUAL(2, wifi.connects);
+    TEST_ASSERT_TRUE(wifi.last_cached);
+    TEST_ASSERT_EQUAL(WIFI_SUP_CONNECTING, sup.state);
+
+    advance_ms(300);
+    event(WIFI_SUP_EVT_GOT_IP);
+    TEST_ASSERT_EQUAL(2, wifi.link_ups);                // MQTT flushes its outbox on this
+    TEST_ASSERT_EQUAL(1, sup.stats.disconnects);
+    TEST_ASSERT_EQUAL(1, sup.stats.reconnects);
+    TEST_ASSERT_EQUAL(300, sup.stats.last_offline_ms);
+}
+
+static void test_failed_attempts_back_off_exponentially(void)
+{
+    setup(0);
+    go_online();
+    event(WIFI_SUP_EVT_DISCONNECTED);
+
+    // random 0: the bottom of each jitter range, half the nominal delay
+    static const uint32_t expected_ms[] = { 250, 500, 1000, 2000, 4000, 4000, 4000 };
+    for (size_t i = 0; i < sizeof(expected_ms) / sizeof(expected_ms[0]); i++) {
+        event(WIFI_SUP_EVT_DISCONNECTED);               // attempt failed
+        TEST_ASSERT_EQUAL(WIFI_SUP_BACKOFF, sup.state);
+        TEST_ASSERT_EQUAL(expected_ms[i], wifi.armed_ms);
+
+        int connects = wifi.connects;
+        fire_timer();
+        TEST_ASSERT_EQUAL(connects + 1, wifi.connects);
+        TEST_ASSERT_FALSE(wifi.last_cached);            // full scan after the fast retry
+    }
+}
+
+static void test_jitter_uses_upper_half(void)
+{
+    setup(0);
+    go_online();
+    event(WIFI_SUP_EVT_DISCONNECTED);
+
+    wifi.random = MIN_MS / 2;                           // top of the first range
+    event(WIFI_SUP_EVT_DISCONNECTED);
+    TEST_ASSERT_EQUAL(MIN_MS, wifi.armed_ms);
+
+    fire_timer();
+    wifi.random = 123;
+    event(WIFI_SUP_EVT_DISCONNECTED);
+    TEST_ASSERT_EQUAL(MIN_MS + 123 % (MIN_MS + 1), wifi.armed_ms);
+}
+
+static void test_attempt_timeout_aborts_and_backs_off(void)
+{
+    setup(WATCHDOG_MS);
+    go_online();
+    event(WIFI_SUP_EVT_DISCONNECTED);
+
+    fire_timer();                                       // no IP within ATTEMPT_MS
+    TEST_ASSERT_EQUAL(1, wifi.disconnects);
+    TEST_ASSERT_EQUAL(WIFI_SUP_BACKOFF, sup.state);
+
+    // Our own disconnect echoes back as an event: ignored
+    int connects = wifi.connects;
+    event(WIFI_SUP_EVT_DISCONNECTED);
+    TEST_ASSERT_EQUAL(WIFI_SUP_BACKOFF, sup.state);
+    TEST_ASSERT_EQUAL(connects, wifi.connects);
+}
+
+static void test_watchdog_restarts_driver_and_bounds_outage(void)
+{
+    setup(WATCHDOG_MS);
+    go_online();
+    wifi.random = UINT32_MAX;
+    int64_t drop_us = now_us;
+    event(WIFI_SUP_EVT_DISCONNECTED);
+
+    // Every attempt times out; no backoff may run past the watchdog
+    while (wifi.restarts == 0) {
+        fire_timer();
+        TEST_ASSERT_TRUE(now_us - drop_us <= (int64_t)(WATCHDOG_MS + ATTEMPT_MS) * 1000);
+    }
+    TEST_ASSERT_EQUAL(WIFI_SUP_RESTARTING, sup.state);
+    TEST_ASSERT_EQUAL(1, sup.stats.watchdog_restarts);
+    TEST_ASSERT_TRUE(now_us - drop_us >= (int64_t)WATCHDOG_MS * 1000);
+
+    event(WIFI_SUP_EVT_STARTED);
+    TEST_ASSERT_EQUAL(WIFI_SUP_CONNECTING, sup.state);
+    TEST_ASSERT_FALSE(wifi.last_cached);
+    TEST_ASSERT_EQUAL(0, sup.failures);                 // backoff starts over
+}
+
+static void test_restart_without_start_event_counts_as_failure(void)
+{
+    setup(WATCHDOG_MS);
+    go_online();
+    event(WIFI_SUP_EVT_DISCONNECTED);
+    while (wifi.restarts == 0) {
+        fire_timer();
+    }
+
+    fire_timer();                                       // driver never reported STARTED
+    TEST_ASSERT_EQUAL(WIFI_SUP_BACKOFF, sup.state);
+}
+
+static void test_never_gives_up(void)
+{
+    setup(WATCHDOG_MS);
+    go_online();
+    event(WIFI_SUP_EVT_DISCONNECTED);
+
+    // A day of failures: it keeps trying and restarting
+    int64_t end_us = now_us + 24LL * 3600 * 1000000;
+    while (now_us < end_us) {
+        if (sup.state == WIFI_SUP_CONNECTING) {
+            event(WIFI_SUP_EVT_DISCONNECTED);
+        } else {
+            fire_timer();
+            if (sup.state == WIFI_SUP_RESTARTING) {
+                event(WIFI_SUP_EVT_STARTED);
+            }
+        }
+    }
+    TEST_ASSERT_TRUE(wifi.restarts >= 24 * 3600 / (WATCHDOG_MS / 1000 + ATTEMPT_MS / 1000));
+    TEST_ASSERT_TRUE(sup.stats.last_backoff_ms <= MAX_MS);
+
+    event(WIFI_SUP_EVT_GOT_IP);
+    TEST_ASSERT_EQUAL(WIFI_SUP_ONLINE, sup.state);
+    TEST_ASSERT_EQUAL(1, sup.stats.offline_hist[WIFI_OFFLINE_BUCKETS - 1]);
+}
+
+static void test_stale_timer_is_ignored(void)
+{
+    setup(WATCHDOG_MS);
+    go_online();
+    event(WIFI_SUP_EVT_DISCONNECTED);
+    int64_t attempt_due_us = wifi.timer_due_us;
+
+    advance_ms(100);
+    event(WIFI_SUP_EVT_GOT_IP);                         // cancels the attempt timer
+
+    now_us = attempt_due_us;                            // but its expiry was already queued
+    event(WIFI_SUP_EVT_TIMER);
+    TEST_ASSERT_EQUAL(WIFI_SUP_ONLINE, sup.state);
+    TEST_ASSERT_EQUAL(0, wifi.disconnects);
+}
+
+static void test_offline_histogram(void)
+{
+    setup(0);
+    go_online();
+
+    static const int outages_ms[] = { 300, 1500, 1500, 7000, 45000 };
+    for (size_t i = 0; i < sizeof(outages_ms) / sizeof(outages_ms[0]); i++) {
+        event(WIFI_SUP_EVT_DISCONNECTED);
+        advance_ms(outages_ms[i]);
+        event(WIFI_SUP_EVT_GOT_IP);
+    }
+
+    // Buckets: < 1 s, < 2 s, < 5 s, < 10 s, < 30 s, < 60 s, ...
+    TEST_ASSERT_EQUAL(1, sup.stats.offline_hist[0]);
+    TEST_ASSERT_EQUAL(2, sup.stats.offline_hist[1]);
+    TEST_ASSERT_EQUAL(0, sup.stats.offline_hist[2]);
+    TEST_ASSERT_EQUAL(1, sup.stats.offline_hist[3]);
+    TEST_ASSERT_EQUAL(1, sup.stats.offline_hist[5]);
+    TEST_ASSERT_EQUAL(5, sup.stats.reconnects);
+    TEST_ASSERT_EQUAL(45000, sup.stats.max_offline_ms);
+    TEST_ASSERT_EQUAL(45000, sup.stats.last_offline_ms);
+}
+
+int main(void)
+{
+    RUN_TEST(test_boot_connects_on_cached_ap);
+    RUN_TEST(test_drop_retries_at_once_and_reports_link);
+    RUN_TEST(test_failed_attempts_back_off_exponentially);
+    RUN_TEST(test_jitter_uses_upper_half);
+    RUN_TEST(test_attempt_timeout_aborts_and_backs_off);
+    RUN_TEST(test_watchdog_restarts_driver_and_bounds_outage);
+    RUN_TEST(test_restart_without_start_event_counts_as_failure);
+    RUN_TEST(test_never_gives_up);
+    RUN_TEST(test_stale_timer_is_ignored);
+    RUN_TEST(test_offline_histogram);
+    return test_report();
+}
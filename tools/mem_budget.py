@@ -0,0 +1,180 @@
+#!/usr/bin/env python3
+"""Static RAM budget per subsystem, from the GNU ld map file.
+
+Run after every build (tools/pio_mem_budget.py for PlatformIO, the POST_BUILD
+step in CMakeLists.txt for idf.py). Input sections are attributed to the
+source file that produced them and grouped by its directory under src/
+(app, comm, comm/uart, ...) or lib/; everything else is grouped by archive
+(ESP-IDF components). Sections are sorted into:
+
+  data  initialised RAM (.data, .sdata, .dram1)
+  bss   zeroed RAM (.bss, .sbss, COMMON, .noinit)
+  rtc   RTC memory (.rtc.*, .rtc_noinit)
+  iram  code in internal RAM (.iram1)
+
+Usage: mem_budget.py <project.map> [--src <project dir>] [--out <file>]
+"""
+
+import argparse
+import os
+import re
+import sys
+
+KINDS = ("data", "bss", "rtc", "iram")
+
+# Input section name prefix -> kind; first match wins
+SECTION_KINDS = (
+    (".rtc", "rtc"),
+    (".iram1", "iram"),
+    (".data", "data"),
+    (".sdata", "data"),
+    (".dram1", "data"),
+    (".bss", "bss"),
+    (".sbss", "bss"),
+    ("COMMON", "bss"),
+    (".noinit", "bss"),
+)
+
+# "<archive>(<object>)" or a bare object path
+OBJECT_RE = re.compile(r"^(?P<archive>[^()]+)\((?P<object>[^()]+)\)$")
+ENTRY_RE = re.compile(r"^\s+0x(?P<addr>[0-9a-f]+)\s+0x(?P<size>[0-9a-f]+)\s+(?P<obj>\S+)\s*$")
+SECTION_RE = re.compile(r"^ (?P<name>[.\w$]\S*|COMMON)(?P<rest>\s+0x.*)?$")
+
+SOURCE_DIRS = ("src", "lib")
+
+
+def section_kind(name):
+    for prefix, kind in SECTION_KINDS:
+        if name.startswith(prefix):
+            return kind
+    return None
+
+
+def source_index(project_dir):
+    """Object basename (trace.c.obj) -> subsystem (comm)."""
+    index = {}
+    for top in SOURCE_DIRS:
+        root = os.path.join(project_dir, top)
+        for dirpath, _, files in os.walk(root):
+            rel = os.path.relpath(dirpath, os.path.join(project_dir, "src" if top == "src" else ""))
+            if top == "lib":
+                # lib/TinyFrame/src -> lib/TinyFrame
+                rel = "/".join(rel.split(os.sep)[:2])
+            elif rel == ".":
+                rel = "main"
+            for name in files:
+                if name.endswith((".c", ".cpp")):
+                    index.setdefault(name + ".obj", rel.replace(os.sep, "/"))
+    return index
+
+
+def parse_map(path):
+    """Yield (section, size, archive, object) for every RAM input section."""
+    in_memory_map = False
+    pending = None
+    with open(path, encoding="utf-8", errors="replace") as f:
+        for line in f:
+            if not in_memory_map:
+                in_memory_map = line.startswith("Linker script and memory map")
+                continue
+            line = line.rstrip("\n")
+
+            if pending is not None:
+                # Long section name: address, size and object on the next line
+                m = ENTRY_RE.match(line)
+                name, pending = pending, None
+                if m:
+                    yield name, int(m.group("size"), 16), m.group("obj")
+                continue
+
+            m = SECTION_RE.match(line)
+            if not m or section_kind(m.group("name")) is None:
+                continue
+            if m.group("rest") is None:
+                pending = m.group("name")
+                continue
+            m2 = ENTRY_RE.match(" " + m.group("rest"))
+            if m2:
+                yield m.group("name"), int(m2.group("size"), 16), m2.group("obj")
+
+
+def split_object(obj):
+    m = OBJECT_RE.match(obj)
+    if m:
+        return os.path.basename(m.group("archive")), m.group("object")
+    return None, os.path.basename(obj)
+
+
+def symbol_of(section):
+    """.bss.task_stack_TF_TRANSPORT -> task_stack_TF_TRANSPORT"""
+    for prefix in (".bss.", ".sbss.", ".data.", ".sdata.", ".dram1.", ".rtc.data.", ".rtc.bss."):
+        if section.startswith(prefix):
+            return section[len(prefix):]
+    return section
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("map")
+    parser.add_argument("--src", default=os.path.join(os.path.dirname(__file__), ".."))
+    parser.add_argument("--out")
+    parser.add_argument("--top", type=int, default=12)
+    args = parser.parse_args()
+
+    index = source_index(args.src)
+    app = {}            # subsystem -> {kind: bytes}
+    libs = {}           # archive -> {kind: bytes}
+    symbols = []        # (bytes, symbol, source) of app sections
+
+    for section, size, obj in parse_map(args.map):
+        if size == 0:
+            continue
+        kind = section_kind(section)
+        archive, obj_name = split_object(obj)
+        subsystem = index.get(obj_name)
+        if subsystem is not None:
+            totals = app.setdefault(subsystem, dict.fromkeys(KINDS, 0))
+            if kind != "iram":
+                symbols.append((size, symbol_of(section), subsystem + "/" + obj_name[:-4]))
+        else:
+            totals = libs.setdefault(archive or obj_name, dict.fromkeys(KINDS, 0))
+        totals[kind] += size
+
+    lines = []
+
+    def table(title, rows, limit=None):
+        lines.append(title)
+        lines.append("  %-24s %8s %8s %8s %8s %8s" % (("",) + KINDS + ("total",)))
+        ordered = sorted(rows.items(), key=lambda kv: -sum(kv[1].values()))
+        for name, totals in ordered[:limit]:
+            lines.append("  %-24s %8d %8d %8d %8d %8d" % ((name,) + tuple(totals[k] for k in KINDS)
+                                                         + (sum(totals.values()),)))
+        if limit is not None and len(ordered) > limit:
+            rest = dict.fromkeys(KINDS, 0)
+            for _, totals in ordered[limit:]:
+                for k in KINDS:
+                    rest[k] += totals[k]
+            lines.append("  %-24s %8d %8d %8d %8d %8d" % (("(%d more)" % (len(ordered) - limit),)
+                                                         + tuple(rest[k] for k in KINDS)
+                                                         + (sum(rest.values()),)))
+        sums = [sum(t[k] for t in rows.values()) for k in KINDS]
+        lines.append("  %-24s %8d %8d %8d %8d %8d" % (("total",) + tuple(sums) + (sum(sums),)))
+        lines.append("")
+
+    table("Static RAM, application (bytes)", app)
+    lines.append("Largest application objects")
+    for size, symbol, source in sorted(symbols, reverse=True)[:args.top]:
+        lines.append("  %8d  %-36s %s" % (size, symbol, source))
+    lines.append("")
+    table("Static RAM, ESP-IDF and libraries (bytes)", libs, args.top)
+
+    report = "\n".join(lines)
+    print(report)
+    if args.out:
+        with open(args.out, "w", encoding="utf-8") as f:
+            f.write(report + "\n")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,35 @@
+"""PlatformIO post-build hook for tools/mem_budget.py.
+
+PlatformIO drives the ESP-IDF build itself and never runs the POST_BUILD
+command from CMakeLists.txt, so platformio.ini loads this script through
+extra_scripts to print the same report after the firmware is linked. The
+report is also written to <build dir>/mem_budget.txt.
+"""
+
+import glob
+import os
+
+Import("env")  # noqa: F821 (provided by SCons)
+
+
+def mem_budget(source, target, env):
+    build_dir = env.subst("$BUILD_DIR")
+    # The map is named after the ESP-IDF project, not PROGNAME
+    maps = glob.glob(os.path.join(build_dir, "*.map"))
+    if not maps:
+        print("mem_budget: no linker map in %s, skipping" % build_dir)
+        return
+    map_file = max(maps, key=os.path.getmtime)
+    project_dir = env.subst("$PROJECT_DIR")
+    env.Execute(env.VerboseAction(
+        '"$PYTHONEXE" "%s" "%s" --src "%s" --out "%s"' % (
+            os.path.join(project_dir, "tools", "mem_budget.py"),
+            map_file,
+            project_dir,
+            os.path.join(build_dir, "mem_budget.txt"),
+        ),
+        "Static RAM per subsystem",
+    ))
+
+
+env.AddPostAction("$BUILD_DIR/${PROGNAME}.elf", mem_budget)  # noqa: F821
@@ -0,0 +1,65 @@
+#!/usr/bin/env python3
+"""Rebuild a UART capture trace from its MQTT dump.
+
+The device publishes a dump as chunks (see src/app/capture_dump.h): an
+8-byte header (u32 offset, u32 total length, little-endian) and the trace
+bytes. Read the chunks as hex lines, one per message:
+
+  mosquitto_sub -h <broker> -t computor/esp32/events/capture -F %x \\
+      | tools/uart_capture_join.py -o trace.ucap
+
+Stops when the whole trace has been received. Chunks may arrive in any
+order or more than once (QoS 1).
+"""
+
+import argparse
+import struct
+import sys
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("-o", "--out", required=True, help="trace file to write")
+    parser.add_argument("input", nargs="?", help="hex lines (default: stdin)")
+    args = parser.parse_args()
+
+    source = open(args.input, encoding="ascii") if args.input else sys.stdin
+    trace = None
+    have = set()
+
+    for line in source:
+        line = line.strip()
+        if not line:
+            continue
+        try:
+            chunk = bytes.fromhex(line)
+        except ValueError:
+            print("skipping non-hex line", file=sys.stderr)
+            continue
+        if len(chunk) < 8:
+            continue
+        offset, total = struct.unpack_from("<II", chunk)
+        data = chunk[8:]
+
+        if trace is None or len(trace) != total:
+            # First chunk, or a new dump with a different length
+            trace = bytearray(total)
+            have = set()
+        trace[offset:offset + len(data)] = data
+        have.update(range(offset, offset + len(data)))
+        print("\r%d / %d bytes" % (len(have), total), end="", file=sys.stderr)
+
+        if len(have) == total:
+            break
+
+    print(file=sys.stderr)
+    if trace is None or len(have) != len(trace):
+        print("incomplete dump", file=sys.stderr)
+        return 1
+    with open(args.out, "wb") as f:
+        f.write(trace)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,13 @@
+#pragma once
+
+#include "esp_err.h"
+
+// Printed to stderr with the virtual time when the replay runs with -v
+void replay_log(char level, const char *tag, const char *format, ...)
+    __attribute__((format(printf, 3, 4)));
+
+#define ESP_LOGE(tag, format, ...)  replay_log('E', tag, format, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...)  replay_log('W', tag, format, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...)  replay_log('I', tag, format, ##__VA_ARGS__)
+#define ESP_LOGD(tag, format, ...)  replay_log('D', tag, format, ##__VA_ARGS__)
+#define ESP_LOGV(tag, format, ...)  replay_log('V', tag, format, ##__VA_ARGS__)
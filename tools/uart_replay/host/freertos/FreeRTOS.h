@@ -0,0 +1,41 @@
+#pragma once
+
+// Host stand-in for FreeRTOS (tools/uart_replay): one task runs at a time
+// on the replay's virtual clock, so critical sections and mutexes have
+// nothing to exclude.
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <assert.h>
+
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+typedef uint32_t TickType_t;
+typedef uint8_t StackType_t;
+
+typedef struct vtask *TaskHandle_t;
+typedef void (*TaskFunction_t)(void *arg);
+
+typedef struct { int unused; } StaticTask_t;
+typedef struct { int unused; } StaticSemaphore_t;
+typedef struct { int unused; } portMUX_TYPE;
+
+#define pdTRUE                  1
+#define pdFALSE                 0
+#define pdPASS                  1
+#define pdFAIL                  0
+#define portMAX_DELAY           UINT32_MAX
+#define configTICK_RATE_HZ      100         // CONFIG_FREERTOS_HZ
+#define portTICK_PERIOD_MS      (1000 / configTICK_RATE_HZ)
+#define pdMS_TO_TICKS(ms)       ((TickType_t)((uint64_t)(ms) * configTICK_RATE_HZ / 1000))
+#define tskNO_AFFINITY          0x7fffffff
+#define portNUM_PROCESSORS      2
+
+#define portMUX_INITIALIZER_UNLOCKED    { 0 }
+#define portENTER_CRITICAL(mux)         ((void)(mux))
+#define portEXIT_CRITICAL(mux)          ((void)(mux))
+#define portENTER_CRITICAL_ISR(mux)     ((void)(mux))
+#define portEXIT_CRITICAL_ISR(mux)      ((void)(mux))
+
+#define configASSERT(x)         assert(x)
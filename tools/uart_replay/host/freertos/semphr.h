@@ -0,0 +1,31 @@
+#pragma once
+
+#include "freertos/FreeRTOS.h"
+
+typedef StaticSemaphore_t *SemaphoreHandle_t;
+
+static inline SemaphoreHandle_t xSemaphoreCreateMutexStatic(StaticSemaphore_t *buf)
+{
+    return buf;
+}
+
+static inline SemaphoreHandle_t xSemaphoreCreateRecursiveMutexStatic(StaticSemaphore_t *buf)
+{
+    return buf;
+}
+
+static inline BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks)
+{
+    (void)sem;
+    (void)ticks;
+    return pdTRUE;
+}
+
+static inline BaseType_t xSemaphoreGive(SemaphoreHandle_t sem)
+{
+    (void)sem;
+    return pdTRUE;
+}
+
+#define xSemaphoreTakeRecursive(sem, ticks)     xSemaphoreTake(sem, ticks)
+#define xSemaphoreGiveRecursive(sem)            xSemaphoreGive(sem)
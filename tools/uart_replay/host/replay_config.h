@@ -0,0 +1,7 @@
+#pragma once
+
+// Forced include of the replay build (see Makefile)
+
+// TinyFrame errors (checksum mismatch, parser timeout, ...) are counted
+void replay_tf_error(const char *format, ...) __attribute__((format(printf, 1, 2)));
+#define TF_Error(format, ...)   replay_tf_error(format, ##__VA_ARGS__)
@@ -0,0 +1,3 @@
+#pragma once
+
+// Host build of tools/uart_replay: no ESP-IDF options
@@ -0,0 +1,339 @@
+// Virtual clock, esp_timer and FreeRTOS tasks for the replay
+//
+// Everything runs on the virtual clock, one piece at a time: the replay
+// loop, timer callbacks (the esp_timer task) and app tasks, each a thread
+// that only runs while it holds the baton. A task gives the baton back
+// when it blocks (ulTaskNotifyTake, vTaskDelay), and the loop advances
+// time to the next timer, task wake-up or TF tick. Runs are therefore
+// deterministic: same trace, same outputs.
+
+#include "replay.h"
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_timer.h"
+#include "comm/task_table.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define MAX_TIMERS  32
+#define MAX_TASKS   8
+#define NEVER       INT64_MAX
+
+static int64_t now_us = 0;
+static int64_t next_tick_us = NEVER;
+
+uint64_t host_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+// === esp_timer ===
+
+struct esp_timer {
+    esp_timer_cb_t callback;
+    void *arg;
+    const char *name;
+    int64_t due_us;
+    uint64_t period_us;             // 0 = one-shot
+    bool active;
+};
+
+static struct esp_timer timers[MAX_TIMERS];
+static int timer_count = 0;
+
+int64_t esp_timer_get_time(void)
+{
+    return now_us;
+}
+
+esp_err_t esp_timer_create(const esp_timer_create_args_t *args, esp_timer_handle_t *out)
+{
+    if (timer_count == MAX_TIMERS) {
+        return ESP_FAIL;
+    }
+    struct esp_timer *timer = &timers[timer_count++];
+    timer->callback = args->callback;
+    timer->arg = args->arg;
+    timer->name = args->name;
+    *out = timer;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_once(esp_timer_handle_t timer, uint64_t timeout_us)
+{
+    if (timer->active) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    timer->due_us = now_us + (int64_t)timeout_us;
+    timer->period_us = 0;
+    timer->active = true;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_start_periodic(esp_timer_handle_t timer, uint64_t period_us)
+{
+    if (timer->active) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    timer->due_us = now_us + (int64_t)period_us;
+    timer->period_us = period_us;
+    timer->active = true;
+    return ESP_OK;
+}
+
+esp_err_t esp_timer_stop(esp_timer_handle_t timer)
+{
+    if (!timer->active) {
+        return ESP_ERR_INVALID_STATE;
+    }
+    timer->active = false;
+    return ESP_OK;
+}
+
+bool esp_timer_is_active(esp_timer_handle_t timer)
+{
+    return timer->active;
+}
+
+static struct esp_timer *next_timer(void)
+{
+    struct esp_timer *next = NULL;
+    for (int i = 0; i < timer_count; i++) {
+        if (timers[i].active && (next == NULL || timers[i].due_us < next->due_us)) {
+            next = &timers[i];
+        }
+    }
+    return next;
+}
+
+// === Tasks ===
+
+struct vtask {
+    const char *name;
+    TaskFunction_t fn;
+    void *arg;
+    pthread_t thread;
+    pthread_cond_t wake;
+    uint32_t notify;
+    int64_t wake_us;                // NEVER: only a notification wakes it
+    bool takes_notify;              // blocked in ulTaskNotifyTake
+};
+
+static struct vtask tasks[MAX_TASKS];
+static int task_count = 0;
+
+#define TASK_GEN_NAME(id, task_name, core, prio, stack, storage)   [TASK_##id] = task_name,
+
+static const char *const task_names[TASK_COUNT] = {
+    TASK_TABLE(TASK_GEN_NAME)
+};
+
+// Held by whoever runs: the replay loop or one task
+static pthread_mutex_t baton = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t loop_wake = PTHREAD_COND_INITIALIZER;
+static struct vtask *running = NULL;    // NULL = the replay loop
+static bool baton_taken = false;
+
+static void take_baton(void)
+{
+    if (!baton_taken) {
+        pthread_mutex_lock(&baton);
+        baton_taken = true;
+    }
+}
+
+// Task side: hand the baton back to the loop until scheduled again
+static void task_yield(struct vtask *self)
+{
+    running = NULL;
+    pthread_cond_signal(&loop_wake);
+    while (running != self) {
+        pthread_cond_wait(&self->wake, &baton);
+    }
+}
+
+static void *task_thread(void *arg)
+{
+    struct vtask *self = arg;
+
+    pthread_mutex_lock(&baton);
+    while (running != self) {
+        pthread_cond_wait(&self->wake, &baton);
+    }
+    self->fn(self->arg);
+
+    // Returned (vTaskDelete): never ready again
+    self->wake_us = NEVER;
+    self->takes_notify = false;
+    running = NULL;
+    pthread_cond_signal(&loop_wake);
+    pthread_mutex_unlock(&baton);
+    return NULL;
+}
+
+static bool task_ready(const struct vtask *task)
+{
+    return task->wake_us <= now_us || (task->takes_notify && task->notify > 0);
+}
+
+// Loop side: let every ready task run until it blocks again
+static void run_ready_tasks(void)
+{
+    bool ran = true;
+    while (ran) {
+        ran = false;
+        for (int i = 0; i < task_count; i++) {
+            struct vtask *task = &tasks[i];
+            if (task_ready(task)) {
+                running = task;
+                pthread_cond_signal(&task->wake);
+                while (running != NULL) {
+                    pthread_cond_wait(&loop_wake, &baton);
+                }
+                ran = true;
+            }
+        }
+    }
+}
+
+bool task_create(task_id_t id, const char *name, TaskFunction_t fn, void *arg, TaskHandle_t *handle)
+{
+    if (task_count == MAX_TASKS || (unsigned)id >= TASK_COUNT) {
+        return false;
+    }
+    take_baton();
+
+    struct vtask *task = &tasks[task_count++];
+    task->name = name ? name : task_names[id];
+    task->fn = fn;
+    task->arg = arg;
+    task->wake_us = now_us;         // runs at the next scheduling point
+    pthread_cond_init(&task->wake, NULL);
+    if (pthread_create(&task->thread, NULL, task_thread, task) != 0) {
+        perror("pthread_create");
+        exit(2);
+    }
+    if (handle) {
+        *handle = task;
+    }
+    return true;
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+    return (TickType_t)(now_us / (1000000 / configTICK_RATE_HZ));
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+    return running;
+}
+
+static int64_t ticks_to_us(TickType_t ticks)
+{
+    return ticks == portMAX_DELAY ? NEVER : now_us + (int64_t)ticks * (1000000 / configTICK_RATE_HZ);
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear_on_exit, TickType_t ticks_to_wait)
+{
+    struct vtask *self = running;
+    if (self == NULL) {
+        return 0;                   // not from a task: nothing to wait for
+    }
+    if (self->notify == 0 && ticks_to_wait > 0) {
+        self->wake_us = ticks_to_us(ticks_to_wait);
+        self->takes_notify = true;
+        task_yield(self);
+        self->takes_notify = false;
+        self->wake_us = NEVER;
+    }
+    uint32_t value = self->notify;
+    if (value > 0) {
+        self->notify = clear_on_exit ? 0 : value - 1;
+    }
+    return value;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task)
+{
+    task->notify++;
+    return pdPASS;
+}
+
+void vTaskDelay(TickType_t ticks)
+{
+    struct vtask *self = running;
+    if (self == NULL) {
+        return;
+    }
+    self->wake_us = ticks_to_us(ticks);
+    task_yield(self);
+    self->wake_us = NEVER;
+}
+
+// === Clock ===
+
+int64_t sched_now(void)
+{
+    return now_us;
+}
+
+void sched_set_time(int64_t t)
+{
+    take_baton();
+    now_us = t;
+    next_tick_us = t + TRANSPORT_TICK_US;
+}
+
+int64_t sched_next_due(void)
+{
+    int64_t next = next_tick_us;
+    struct esp_timer *timer = next_timer();
+    if (timer && timer->due_us < next) {
+        next = timer->due_us;
+    }
+    for (int i = 0; i < task_count; i++) {
+        if (tasks[i].wake_us < next) {
+            next = tasks[i].wake_us;
+        }
+    }
+    return next;
+}
+
+void sched_run_until(int64_t t)
+{
+    take_baton();
+    for (;;) {
+        run_ready_tasks();
+
+        int64_t next = sched_next_due();
+        if (next > t) {
+            break;
+        }
+        if (next > now_us) {
+            now_us = next;
+        }
+
+        // Timers first, then the TF tick; tasks on the next pass
+        struct esp_timer *timer = next_timer();
+        if (timer && timer->due_us <= now_us) {
+            if (timer->period_us) {
+                timer->due_us += (int64_t)timer->period_us;
+            } else {
+                timer->active = false;
+            }
+            timer->callback(timer->arg);
+        } else if (next_tick_us <= now_us) {
+            next_tick_us += TRANSPORT_TICK_US;
+            transport_tick();
+        }
+    }
+    if (t > now_us) {
+        now_us = t;
+    }
+    run_ready_tasks();
+}
@@ -0,0 +1,188 @@
+// Host stand-ins for the services around the UART stack: logging, trace,
+// MQTT publishing, WiFi power policy, boot timeline and wall clock
+//
+// Everything sent out is written to the output file as one line per
+// message, prefixed with the virtual time in ms:
+//   <ms> TX <hex>                          UART frame written by TinyFrame
+//   <ms> PUB <topic> q<qos>[r] <payload>   mqtt_publish (r = retained)
+//   <ms> REPLY <topic> <payload>           mqtt_publish_reply
+// Payloads are printed as text when printable, otherwise as hex.
+
+#include "replay.h"
+#include "comm/mqtt_util.h"
+#include "comm/wifi_util.h"
+#include "comm/boot_timeline.h"
+#include "comm/trace.h"
+#include "esp_log.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/select.h>
+
+// Wall clock at virtual time 0, so timestamps in the output are stable
+#define REPLAY_EPOCH_S  1700000000
+
+int replay_verbose = 0;
+
+static FILE *out = NULL;
+
+static uint8_t *tx_bytes = NULL;
+static size_t tx_len = 0;
+static size_t tx_cap = 0;
+
+// === Output ===
+
+void output_open(const char *path)
+{
+    out = path ? fopen(path, "w+") : tmpfile();
+    if (out == NULL) {
+        perror(path ? path : "tmpfile");
+        exit(2);
+    }
+}
+
+FILE *output_finish(void)
+{
+    FILE *f = out;
+    out = NULL;
+    fflush(f);
+    rewind(f);
+    return f;
+}
+
+static void print_time(void)
+{
+    int64_t now = sched_now();
+    fprintf(out, "%lld.%03lld", (long long)(now / 1000), (long long)(now % 1000));
+}
+
+static void print_hex(const uint8_t *data, size_t len)
+{
+    for (size_t i = 0; i < len; i++) {
+        fprintf(out, "%02x", data[i]);
+    }
+}
+
+static void print_payload(const uint8_t *data, size_t len)
+{
+    bool text = true;
+    for (size_t i = 0; i < len && text; i++) {
+        text = data[i] >= 0x20 && data[i] < 0x7f;
+    }
+    if (text) {
+        fwrite(data, 1, len, out);
+    } else {
+        print_hex(data, len);
+    }
+}
+
+void output_tx(const uint8_t *data, size_t len)
+{
+    if (tx_len + len > tx_cap) {
+        tx_cap = (tx_len + len) * 2;
+        tx_bytes = realloc(tx_bytes, tx_cap);
+        if (tx_bytes == NULL) {
+            perror("realloc");
+            exit(2);
+        }
+    }
+    memcpy(tx_bytes + tx_len, data, len);
+    tx_len += len;
+
+    if (out == NULL) {
+        return;
+    }
+    print_time();
+    fputs(" TX ", out);
+    print_hex(data, len);
+    fputc('\n', out);
+}
+
+const uint8_t *output_tx_bytes(size_t *len)
+{
+    *len = tx_len;
+    return tx_bytes;
+}
+
+// === MQTT ===
+
+bool mqtt_publish(const char *topic, const uint8_t *data, int len, int qos, bool retain)
+{
+    if (out) {
+        print_time();
+        fprintf(out, " PUB %s q%d%s ", topic, qos, retain ? "r" : "");
+        print_payload(data, (size_t)len);
+        fputc('\n', out);
+    }
+    return true;
+}
+
+bool mqtt_publish_reply(const mqtt_reply_t *reply, const uint8_t *data, int len)
+{
+    if (out) {
+        print_time();
+        fprintf(out, " REPLY %s ", reply->topic);
+        print_payload(data, (size_t)len);
+        fputc('\n', out);
+    }
+    return true;
+}
+
+// === WiFi, boot timeline ===
+
+void wifi_note_activity(wifi_power_event_t event)
+{
+    (void)event;
+}
+
+void boot_timeline_mark(boot_tl_point_t point)
+{
+    (void)point;
+}
+
+// === Logging ===
+
+void replay_log(char level, const char *tag, const char *format, ...)
+{
+    if (!replay_verbose) {
+        return;
+    }
+    va_list ap;
+    va_start(ap, format);
+    fprintf(stderr, "%10.3f %c (%s) ", sched_now() / 1000.0, level, tag);
+    vfprintf(stderr, format, ap);
+    fputc('\n', stderr);
+    va_end(ap);
+}
+
+void trace_write(const trace_site_t *site, ...)
+{
+    if (!replay_verbose) {
+        return;
+    }
+    static const char levels[] = "-EWID";
+    int32_t args[TRACE_MAX_ARGS] = { 0 };
+    va_list ap;
+    va_start(ap, site);
+    for (int i = 0; i < site->nargs; i++) {
+        args[i] = va_arg(ap, int32_t);
+    }
+    va_end(ap);
+
+    fprintf(stderr, "%10.3f %c (%s) ", sched_now() / 1000.0, levels[site->level], site->tag);
+    fprintf(stderr, site->fmt, args[0], args[1], args[2], args[3]);
+    fputc('\n', stderr);
+}
+
+// === Wall clock ===
+
+// Replaces libc's: max_comm stamps published events with the wall time
+int gettimeofday(struct timeval *tv, void *tz)
+{
+    (void)tz;
+    int64_t now = sched_now();
+    tv->tv_sec = REPLAY_EPOCH_S + now / 1000000;
+    tv->tv_usec = now % 1000000;
+    return 0;
+}
@@ -0,0 +1,316 @@
+// uart_replay: run a recorded MAX32655 UART trace through the ESP32's
+// TinyFrame, protocol_handler and max_comm code on Linux
+//
+// Record on the device (see tf_transport_capture_* and app/capture_dump.h):
+//   mosquitto_pub -t computor/esp32/capture -m dump
+//   mosquitto_sub -t computor/esp32/events/capture -F %x | tools/uart_capture_join.py -o trace.ucap
+//
+// Replay:
+//   make -C tools/uart_replay
+//   tools/uart_replay/uart_replay [-v] [--speed N] [--out FILE] [--expect FILE] trace.ucap
+//
+//   --speed N      pace RX at N times the recorded rate (default 0: as fast as possible)
+//   --out FILE     write what the code sent (UART TX, MQTT publishes) to FILE
+//   --expect FILE  compare those outputs with an earlier --out; exit 1 if they differ
+//   -v             print logs and trace records to stderr
+//
+// The code under test runs on a virtual clock that follows the trace, so a
+// replay is deterministic: an --out saved before a change is the reference
+// for the run after it. The report gives the frame rate of the trace and
+// the replay's throughput, and per-layer time per unit (TinyFrame per RX
+// chunk, protocol_handler per frame, max_comm per callback).
+//
+// The replay sends its own heartbeats and queries; the recorded responses
+// only match them when the trace was captured from boot (not wrapped).
+
+#include "replay.h"
+#include "capture_format.h"
+#include "app/max_comm.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// Run this long after the last record so batches and timeouts play out
+#define DRAIN_US    1000000
+
+typedef struct {
+    uint8_t *data;
+    size_t len;
+    size_t cap;
+} bytes_t;
+
+static void bytes_append(bytes_t *b, const uint8_t *data, size_t len)
+{
+    if (b->len + len > b->cap) {
+        b->cap = (b->len + len) * 2;
+        b->data = realloc(b->data, b->cap);
+        if (b->data == NULL) {
+            perror("realloc");
+            exit(2);
+        }
+    }
+    memcpy(b->data + b->len, data, len);
+    b->len += len;
+}
+
+static uint8_t *load_file(const char *path, size_t *len)
+{
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+        perror(path);
+        exit(2);
+    }
+    bytes_t b = { 0 };
+    uint8_t chunk[4096];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0) {
+        bytes_append(&b, chunk, n);
+    }
+    fclose(f);
+    *len = b.len;
+    return b.data;
+}
+
+// Sleep until the wall clock reaches the virtual time at the given pace
+static void pace(int64_t virtual_us, int64_t start_us, uint64_t wall_start_ns, double speed)
+{
+    if (speed <= 0) {
+        return;
+    }
+    uint64_t due_ns = wall_start_ns + (uint64_t)((double)(virtual_us - start_us) * 1000.0 / speed);
+    uint64_t now = host_ns();
+    if (due_ns > now) {
+        struct timespec ts = {
+            .tv_sec = (time_t)((due_ns - now) / 1000000000u),
+            .tv_nsec = (long)((due_ns - now) % 1000000000u),
+        };
+        nanosleep(&ts, NULL);
+    }
+}
+
+// === Report ===
+
+static int cmp_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a;
+    uint64_t y = *(const uint64_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static void report_layer(const char *name, const char *unit, layer_t layer)
+{
+    const layer_stats_t *l = layer_get(layer);
+    if (l->n == 0) {
+        printf("  %-10s %8s\n", name, "-");
+        return;
+    }
+    qsort(l->samples, l->n, sizeof(l->samples[0]), cmp_u64);
+    printf("  %-10s %8llu %-7s avg %7.2f  p50 %7.2f  p99 %7.2f  max %8.2f us\n", name,
+           (unsigned long long)l->n, unit, (double)l->sum_ns / l->n / 1000.0,
+           l->samples[l->n / 2] / 1000.0, l->samples[l->n * 99 / 100] / 1000.0,
+           l->samples[l->n - 1] / 1000.0);
+}
+
+static void report_tx(const bytes_t *recorded, bool wrapped)
+{
+    size_t len;
+    const uint8_t *replayed = output_tx_bytes(&len);
+    size_t common = len < recorded->len ? len : recorded->len;
+    size_t i = 0;
+    while (i < common && replayed[i] == recorded->data[i]) {
+        i++;
+    }
+    if (i == common && len == recorded->len) {
+        printf("TX:          %zu bytes, identical to the recording\n", len);
+    } else {
+        printf("TX:          %zu bytes, recording %zu, first difference at byte %zu%s\n", len,
+               recorded->len, i, wrapped ? " (trace wrapped, not from boot)" : "");
+    }
+}
+
+// Returns true if the outputs match the expected file
+static bool compare_expected(FILE *actual, const char *expect_path)
+{
+    FILE *expected = fopen(expect_path, "r");
+    if (expected == NULL) {
+        perror(expect_path);
+        exit(2);
+    }
+    char a[8192];
+    char e[8192];
+    unsigned line = 0;
+    unsigned differing = 0;
+    unsigned first = 0;
+    for (;;) {
+        bool have_a = fgets(a, sizeof(a), actual) != NULL;
+        bool have_e = fgets(e, sizeof(e), expected) != NULL;
+        if (!have_a && !have_e) {
+            break;
+        }
+        line++;
+        if (have_a != have_e || strcmp(a, e) != 0) {
+            if (differing++ == 0) {
+                first = line;
+                printf("Outputs:     first difference at line %u\n", line);
+                printf("  expected:  %s", have_e ? e : "(end of file)\n");
+                printf("  replayed:  %s", have_a ? a : "(end of file)\n");
+            }
+        }
+    }
+    fclose(expected);
+    if (differing == 0) {
+        printf("Outputs:     %u lines, identical to %s\n", line, expect_path);
+        return true;
+    }
+    printf("Outputs:     %u of %u lines differ from %s (first: %u)\n", differing, line, expect_path, first);
+    return false;
+}
+
+static void usage(void)
+{
+    fprintf(stderr, "usage: uart_replay [-v] [--speed N] [--out FILE] [--expect FILE] trace.ucap\n");
+    exit(2);
+}
+
+int main(int argc, char **argv)
+{
+    const char *trace_path = NULL;
+    const char *out_path = NULL;
+    const char *expect_path = NULL;
+    double speed = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-v") == 0) {
+            replay_verbose = 1;
+        } else if (strcmp(argv[i], "--speed") == 0 && i + 1 < argc) {
+            speed = atof(argv[++i]);
+        } else if (strcmp(argv[i], "--out") == 0 && i + 1 < argc) {
+            out_path = argv[++i];
+        } else if (strcmp(argv[i], "--expect") == 0 && i + 1 < argc) {
+            expect_path = argv[++i];
+        } else if (argv[i][0] != '-' && trace_path == NULL) {
+            trace_path = argv[i];
+        } else {
+            usage();
+        }
+    }
+    if (trace_path == NULL) {
+        usage();
+    }
+
+    size_t file_len;
+    uint8_t *trace = load_file(trace_path, &file_len);
+    if (file_len < CAPTURE_HEADER_SIZE || memcmp(trace, CAPTURE_MAGIC, 4) != 0 ||
+        trace[4] != CAPTURE_VERSION) {
+        fprintf(stderr, "%s: not a version %d UART capture\n", trace_path, CAPTURE_VERSION);
+        return 2;
+    }
+    bool wrapped = trace[5] & CAPTURE_FLAG_WRAPPED;
+    uint32_t baud = capture_get_u32(trace + 8);
+    size_t records_len = capture_get_u32(trace + 12);
+    if (records_len > file_len - CAPTURE_HEADER_SIZE) {
+        fprintf(stderr, "%s: truncated (%zu of %zu record bytes)\n", trace_path,
+                file_len - CAPTURE_HEADER_SIZE, records_len);
+        records_len = file_len - CAPTURE_HEADER_SIZE;
+    }
+
+    output_open(out_path);
+
+    const uint8_t *p = trace + CAPTURE_HEADER_SIZE;
+    const uint8_t *end = p + records_len;
+    bytes_t recorded_tx = { 0 };
+    bool started = false;
+    int64_t t = 0;
+    int64_t first_us = 0;
+    uint64_t rx_records = 0;
+    uint64_t wall_start = 0;
+    uint64_t busy_ns = 0;
+
+    while (p < end) {
+        uint64_t dt;
+        uint64_t len_kind;
+        size_t n = capture_get_varint(p, (size_t)(end - p), &dt);
+        size_t m = n ? capture_get_varint(p + n, (size_t)(end - p - n), &len_kind) : 0;
+        if (m == 0 || (len_kind >> 2) > (uint64_t)(end - p - n - m)) {
+            fprintf(stderr, "%s: bad record at offset %zu\n", trace_path,
+                    (size_t)(p - trace));
+            break;
+        }
+        const uint8_t *data = p + n + m;
+        size_t len = (size_t)(len_kind >> 2);
+        capture_kind_t kind = (capture_kind_t)(len_kind & 3);
+        p = data + len;
+        t += (int64_t)dt;
+
+        if (kind == CAPTURE_TIME) {
+            if (len != 8) {
+                fprintf(stderr, "%s: bad time record\n", trace_path);
+                break;
+            }
+            t = 0;
+            for (int i = 7; i >= 0; i--) {
+                t = t << 8 | data[i];
+            }
+            if (!started) {
+                // The code under test starts at the trace's first instant
+                started = true;
+                first_us = t;
+                sched_set_time(t);
+                MaxComm_Init();
+                wall_start = host_ns();
+            }
+            continue;
+        }
+        if (!started) {
+            fprintf(stderr, "%s: records before the first time record\n", trace_path);
+            break;
+        }
+
+        pace(t, first_us, wall_start, speed);
+        uint64_t start = host_ns();
+        sched_run_until(t);
+        if (kind == CAPTURE_RX) {
+            transport_rx(data, len);
+            rx_records++;
+        } else if (kind == CAPTURE_TX) {
+            bytes_append(&recorded_tx, data, len);
+        }
+        busy_ns += host_ns() - start;
+    }
+    if (!started) {
+        fprintf(stderr, "%s: no records\n", trace_path);
+        return 2;
+    }
+    int64_t last_us = t;
+    uint64_t start = host_ns();
+    sched_run_until(last_us + DRAIN_US);
+    busy_ns += host_ns() - start;
+
+    // Report
+    const transport_stats_t *stats = transport_get_stats();
+    double span_s = (double)(last_us - first_us) / 1e6;
+    double busy_s = (double)busy_ns / 1e9;
+    printf("Trace:       %s, %u baud, %.3f s%s\n", trace_path, (unsigned)baud, span_s,
+           wrapped ? ", wrapped" : "");
+    printf("RX:          %llu records, %llu bytes\n", (unsigned long long)rx_records,
+           (unsigned long long)stats->rx_bytes);
+    printf("Frames:      %llu (%llu unhandled), %llu TinyFrame errors\n",
+           (unsigned long long)stats->frames, (unsigned long long)stats->unhandled,
+           (unsigned long long)stats->tf_errors);
+    printf("Rate:        %.1f frames/s recorded, %.0f frames/s replayed (%.3f s of CPU)\n",
+           span_s > 0 ? stats->frames / span_s : 0.0, busy_s > 0 ? stats->frames / busy_s : 0.0, busy_s);
+    printf("Per layer:\n");
+    report_layer("tinyframe", "chunks", LAYER_TF);
+    report_layer("protocol", "frames", LAYER_PROTOCOL);
+    report_layer("app", "calls", LAYER_APP);
+    report_tx(&recorded_tx, wrapped);
+
+    FILE *outputs = output_finish();
+    bool ok = true;
+    if (expect_path) {
+        ok = compare_expected(outputs, expect_path);
+    }
+    fclose(outputs);
+    return ok ? 0 : 1;
+}
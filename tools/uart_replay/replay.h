@@ -0,0 +1,78 @@
+#pragma once
+
+// Internals shared by the replay tool's files
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include "TinyFrame.h"
+
+// === Virtual clock and scheduler (host_sched.c) ===
+
+// Virtual esp_timer time (us)
+int64_t sched_now(void);
+
+// Set the clock before anything runs
+void sched_set_time(int64_t now_us);
+
+// Earliest time something is due: a timer, a task wake-up or a TF tick
+int64_t sched_next_due(void);
+
+// Run everything due up to t in time order, ending with the clock at t
+void sched_run_until(int64_t t);
+
+// Host nanoseconds (CLOCK_MONOTONIC), for layer timing
+uint64_t host_ns(void);
+
+// === Transport (replay_transport.c) ===
+
+// Feed one recorded RX chunk through TF_Accept at the current virtual time
+void transport_rx(const uint8_t *data, size_t len);
+
+// Housekeeping tick, every 10 ms of virtual time as in tf_task
+void transport_tick(void);
+
+#define TRANSPORT_TICK_US   10000
+
+typedef struct {
+    uint64_t n;
+    uint64_t sum_ns;
+    uint64_t *samples;              // for percentiles
+    size_t cap;
+} layer_stats_t;
+
+typedef enum {
+    LAYER_TF,                       // TinyFrame parsing, per RX chunk
+    LAYER_PROTOCOL,                 // protocol_handler listeners, per frame
+    LAYER_APP,                      // max_comm callbacks, per callback
+    LAYER_COUNT
+} layer_t;
+
+void layer_add(layer_t layer, uint64_t ns);
+const layer_stats_t *layer_get(layer_t layer);
+
+typedef struct {
+    uint64_t rx_chunks;
+    uint64_t rx_bytes;
+    uint64_t frames;                // dispatched to a listener
+    uint64_t unhandled;             // reached the generic listener
+    uint64_t tf_errors;             // TinyFrame errors (checksum, length, parser timeout)
+    uint64_t tx_bytes;
+} transport_stats_t;
+
+const transport_stats_t *transport_get_stats(void);
+
+// === Outputs (host_services.c) ===
+// Everything the code under test sends out (UART TX and MQTT publishes) is
+// written as one line per message, with the virtual time.
+
+// path NULL = a temporary file
+void output_open(const char *path);
+void output_tx(const uint8_t *data, size_t len);
+// Every byte passed to output_tx so far, to compare with the recorded TX
+const uint8_t *output_tx_bytes(size_t *len);
+// Flush and rewind the output for reading; the caller closes it
+FILE *output_finish(void);
+
+extern int replay_verbose;
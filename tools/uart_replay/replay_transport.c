@@ -0,0 +1,312 @@
+// Host tf_transport: TinyFrame fed from the trace, with per-layer timing
+//
+// The real protocol_handler and max_comm run on top. Every listener
+// registered through this transport is wrapped to time the protocol layer,
+// and protocol_init() is wrapped at link time (-Wl,--wrap=protocol_init) to
+// time the app callbacks max_comm hands to it.
+
+#include "replay.h"
+#include "tf_transport.h"
+#include "protocol_handler.h"
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static TinyFrame tf_instance;
+static TinyFrame *tf = &tf_instance;
+
+static transport_stats_t stats;
+static layer_stats_t layers[LAYER_COUNT];
+
+// Listeners behind the timing wrappers
+static tf_transport_listener_cb type_cbs[256];
+static tf_transport_listener_cb id_cbs[256];
+
+static int64_t rx_time_us = 0;
+
+// Timing of the RX path in progress
+static bool in_rx = false;
+static uint64_t rx_listener_ns = 0;     // listener time within the current chunk
+static uint64_t frame_app_ns = 0;       // app time within the current listener
+
+// === Layer statistics ===
+
+void layer_add(layer_t layer, uint64_t ns)
+{
+    layer_stats_t *l = &layers[layer];
+    if (l->n == l->cap) {
+        l->cap = l->cap ? l->cap * 2 : 4096;
+        l->samples = realloc(l->samples, l->cap * sizeof(l->samples[0]));
+        if (l->samples == NULL) {
+            perror("realloc");
+            exit(2);
+        }
+    }
+    l->samples[l->n++] = ns;
+    l->sum_ns += ns;
+}
+
+const layer_stats_t *layer_get(layer_t layer)
+{
+    return &layers[layer];
+}
+
+const transport_stats_t *transport_get_stats(void)
+{
+    return &stats;
+}
+
+void replay_tf_error(const char *format, ...)
+{
+    stats.tf_errors++;
+    if (replay_verbose) {
+        va_list ap;
+        va_start(ap, format);
+        fprintf(stderr, "%10.3f [TF] ", sched_now() / 1000.0);
+        vfprintf(stderr, format, ap);
+        fputc('\n', stderr);
+        va_end(ap);
+    }
+}
+
+// === Listener wrappers (protocol layer) ===
+
+static TF_Result timed_listener(tf_transport_listener_cb cb, TinyFrame *t, TF_Msg *msg)
+{
+    if (!in_rx) {
+        return cb(t, msg);          // expiry from TF_Tick, not a frame
+    }
+    frame_app_ns = 0;
+    uint64_t start = host_ns();
+    TF_Result result = cb(t, msg);
+    uint64_t ns = host_ns() - start;
+
+    stats.frames++;
+    rx_listener_ns += ns;
+    layer_add(LAYER_PROTOCOL, ns - frame_app_ns);
+    return result;
+}
+
+static TF_Result type_listener(TinyFrame *t, TF_Msg *msg)
+{
+    return timed_listener(type_cbs[msg->type], t, msg);
+}
+
+static TF_Result id_listener(TinyFrame *t, TF_Msg *msg)
+{
+    return timed_listener(id_cbs[(uint8_t)msg->frame_id], t, msg);
+}
+
+static TF_Result generic_listener(TinyFrame *t, TF_Msg *msg)
+{
+    (void)t;
+    if (in_rx) {
+        stats.frames++;
+        stats.unhandled++;
+    }
+    if (replay_verbose) {
+        fprintf(stderr, "%10.3f [TF] Unhandled type=%d id=%d len=%d\n", sched_now() / 1000.0,
+                msg->type, msg->frame_id, msg->len);
+    }
+    return TF_STAY;
+}
+
+// === App callback wrappers (wrapped protocol_init) ===
+
+void __real_protocol_init(const protocol_config_t *config);
+
+static protocol_config_t app_cfg;
+
+static uint64_t app_begin(void)
+{
+    return host_ns();
+}
+
+static void app_end(uint64_t start)
+{
+    uint64_t ns = host_ns() - start;
+    if (in_rx) {
+        frame_app_ns += ns;
+        layer_add(LAYER_APP, ns);
+    }
+}
+
+static void timed_cmd_response(const cmd_response_t *resp, int64_t timestamp_us, void *ctx)
+{
+    uint64_t start = app_begin();
+    app_cfg.on_cmd_response(resp, timestamp_us, ctx);
+    app_end(start);
+}
+
+static void timed_cmd_timeout(uint8_t cmd_id, void *ctx)
+{
+    uint64_t start = app_begin();
+    app_cfg.on_cmd_timeout(cmd_id, ctx);
+    app_end(start);
+}
+
+static void timed_state_event(const state_event_t *evt, int64_t timestamp_us)
+{
+    uint64_t start = app_begin();
+    app_cfg.on_state_event(evt, timestamp_us);
+    app_end(start);
+}
+
+static void timed_heartbeat(const uint8_t *data, uint16_t len)
+{
+    uint64_t start = app_begin();
+    app_cfg.on_heartbeat(data, len);
+    app_end(start);
+}
+
+static void timed_heartbeat_timeout(void)
+{
+    uint64_t start = app_begin();
+    app_cfg.on_heartbeat_timeout();
+    app_end(start);
+}
+
+void __wrap_protocol_init(const protocol_config_t *config)
+{
+    app_cfg = *config;
+    protocol_config_t timed = *config;
+    if (config->on_cmd_response) {
+        timed.on_cmd_response = timed_cmd_response;
+    }
+    if (config->on_cmd_timeout) {
+        timed.on_cmd_timeout = timed_cmd_timeout;
+    }
+    if (config->on_state_event) {
+        timed.on_state_event = timed_state_event;
+    }
+    if (config->on_heartbeat) {
+        timed.on_heartbeat = timed_heartbeat;
+    }
+    if (config->on_heartbeat_timeout) {
+        timed.on_heartbeat_timeout = timed_heartbeat_timeout;
+    }
+    __real_protocol_init(&timed);
+}
+
+// === Trace input ===
+
+void transport_rx(const uint8_t *data, size_t len)
+{
+    rx_time_us = sched_now();
+    stats.rx_chunks++;
+    stats.rx_bytes += len;
+
+    in_rx = true;
+    rx_listener_ns = 0;
+    uint64_t start = host_ns();
+    TF_Accept(tf, data, (uint32_t)len);
+    uint64_t ns = host_ns() - start;
+    in_rx = false;
+    layer_add(LAYER_TF, ns - rx_listener_ns);
+}
+
+void transport_tick(void)
+{
+    TF_Tick(tf);
+}
+
+// === tf_transport API ===
+
+void TF_WriteImpl(TinyFrame *t, const uint8_t *buff, uint32_t len)
+{
+    (void)t;
+    stats.tx_bytes += len;
+    output_tx(buff, len);
+}
+
+void tf_transport_init(void)
+{
+    TF_InitStatic(tf, TF_MASTER);
+    TF_AddGenericListener(tf, generic_listener);
+}
+
+bool tf_transport_add_listener(uint8_t msg_type, tf_transport_listener_cb callback)
+{
+    type_cbs[msg_type] = callback;
+    return TF_AddTypeListener(tf, msg_type, type_listener);
+}
+
+bool tf_transport_send(uint8_t msg_type, const uint8_t *data, uint16_t len)
+{
+    return TF_SendSimple(tf, msg_type, data, len);
+}
+
+static bool query(TF_Msg *msg, tf_transport_listener_cb on_response, tf_transport_timeout_cb on_timeout,
+                  uint16_t timeout_ticks)
+{
+    if (on_response == NULL) {
+        return TF_Query(tf, msg, NULL, on_timeout, timeout_ticks);
+    }
+    // No frame can arrive before the ID is known: input comes from this thread
+    if (!TF_Query(tf, msg, id_listener, on_timeout, timeout_ticks)) {
+        return false;
+    }
+    id_cbs[(uint8_t)msg->frame_id] = on_response;
+    return true;
+}
+
+bool tf_transport_query(uint8_t msg_type, const uint8_t *data, uint16_t len,
+                        tf_transport_listener_cb on_response,
+                        tf_transport_timeout_cb on_timeout,
+                        uint16_t timeout_ticks)
+{
+    TF_Msg msg;
+    TF_ClearMsg(&msg);
+    msg.type = msg_type;
+    msg.data = data;
+    msg.len = (TF_LEN)len;
+    return query(&msg, on_response, on_timeout, timeout_ticks);
+}
+
+bool tf_transport_query_ctx(uint8_t msg_type, const uint8_t *data, uint16_t len,
+                            tf_transport_listener_cb on_response, void *userdata,
+                            uint16_t timeout_ticks)
+{
+    TF_Msg msg;
+    TF_ClearMsg(&msg);
+    msg.type = msg_type;
+    msg.data = data;
+    msg.len = (TF_LEN)len;
+    msg.userdata = userdata;
+    return query(&msg, on_response, NULL, timeout_ticks);
+}
+
+bool tf_transport_respond(TF_Msg *original_msg, const uint8_t *data, uint16_t len)
+{
+    original_msg->data = data;
+    original_msg->len = (TF_LEN)len;
+    return TF_Respond(tf, original_msg);
+}
+
+int64_t tf_transport_rx_time(void)
+{
+    return rx_time_us;
+}
+
+// Nothing to capture on the host
+void tf_transport_capture_start(void)
+{
+}
+
+void tf_transport_capture_stop(void)
+{
+}
+
+uint32_t tf_transport_capture_size(void)
+{
+    return 0;
+}
+
+uint32_t tf_transport_capture_read(uint32_t offset, uint8_t *buf, uint32_t len)
+{
+    (void)offset;
+    (void)buf;
+    (void)len;
+    return 0;
+}